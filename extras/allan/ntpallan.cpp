@@ -0,0 +1,201 @@
+/**
+  * @file ntpallan.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host checks of `NTPAllanDeviation` against synthetic oscillators with known Allan deviation.
+  *
+  * Build on Linux:
+  *
+  *     g++ -std=c++11 -O2 -I../../src ntpallan.cpp ../../src/NTPAllanDeviation.cpp -o ntpallan
+  *
+  * Phase is generated for noise types whose Allan deviation is known and fed as `NTPClient` does after every
+  * accepted sync round, at `tau0` spaced times moved by up to `jitter` of `tau0`. Every octave must be within
+  * `tolerance` of theory. Interpolation to the grid averages neighbour samples, so white phase noise reads low as
+  * `jitter` grows, about 7% at 0.1:
+  *
+  * - White phase noise of `pm_us` deviation: `sqrt(3) * pm / tau`
+  * - White frequency noise of `fm` deviation at `tau0`: `fm * sqrt(tau0 / tau)`
+  * - Linear frequency drift of `drift` per second: `drift * tau / sqrt(2)`
+  *
+  * A gap longer than `NTP_ALLAN_MAX_GAP` must not add any second difference across it:
+  *
+  *     ./ntpallan synthetic samples=20000 tau0=64 jitter=0.02 pm_us=2000 fm=1e-5 drift=1e-9 tolerance=0.06 seed=1
+  *
+  * Exit status is 0 if every check passes.
+  */
+
+#include "NTPAllanDeviation.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <random>
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return atof (argv[i] + length + 1);
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Gets monotonic time in seconds
+  */
+static double seconds () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+  * @brief Synthetic oscillator parameters
+  */
+struct Oscillator {
+    const char* name; ///< @brief Noise type
+    double pmUs; ///< @brief White phase noise deviation, in microseconds
+    double fm; ///< @brief White frequency noise deviation at `tau0`
+    double drift; ///< @brief Frequency drift per second
+};
+
+/**
+  * @brief Gets theoretical Allan deviation of an oscillator
+  * @param tau0 Sample spacing in seconds
+  * @param tau Averaging time in seconds
+  */
+static double theory (const Oscillator& oscillator, double tau0, double tau) {
+    return sqrt (3.0) * oscillator.pmUs / 1e6 / tau
+           + oscillator.fm * sqrt (tau0 / tau)
+           + oscillator.drift * tau / sqrt (2.0);
+}
+
+/**
+  * @brief Feeds synthetic phase of an oscillator and compares every octave against theory
+  * @return Number of failed octaves
+  */
+static unsigned checkOscillator (const Oscillator& oscillator, uint32_t tau0, unsigned long samples, double jitter,
+                                 double tolerance, std::mt19937_64& random, double* nsPerSample) {
+    NTPAllanDeviation allan;
+    std::normal_distribution<double> gauss (0.0, 1.0);
+    std::uniform_real_distribution<double> shift (-jitter, jitter);
+    double tau0Us = tau0 * 1e6;
+    double walkUs = 0; // Integrated frequency noise, evaluated on the grid
+    unsigned failures = 0;
+    double elapsed = 0;
+
+    allan.begin (tau0);
+    for (unsigned long i = 0; i < samples; i++) {
+        // Measurement happens near grid point i. Noise processes are defined on grid, so interpolation error of
+        // the estimator only comes from moving measurement time
+        double offset = shift (random);
+        double gridUs = i * tau0Us;
+        double timeUs = gridUs + offset * tau0Us;
+        double phaseUs = walkUs + oscillator.fm * offset * tau0Us + oscillator.drift * timeUs * timeUs / 2e6
+                         + oscillator.pmUs * gauss (random);
+        walkUs += oscillator.fm * tau0Us * gauss (random);
+        double started = seconds ();
+        allan.addSample ((int64_t)timeUs + 1000000, (int64_t)llround (phaseUs));
+        elapsed += seconds () - started;
+    }
+    *nsPerSample = elapsed / samples * 1e9;
+
+    for (uint8_t k = 0; k < NTP_ALLAN_OCTAVES; k++) {
+        NTPAllanPoint_t point;
+        if (!allan.getPoint (k, &point)) {
+            printf ("  %-6s tau %6u s  no terms\n", oscillator.name, tau0 << k);
+            failures++;
+            continue;
+        }
+        double expected = theory (oscillator, tau0, point.tau);
+        double error = point.deviation / expected - 1.0;
+        bool ok = fabs (error) <= tolerance;
+        printf ("  %-6s tau %6.0f s  adev %.3e  theory %.3e  error %+6.2f%%  terms %lu %s\n", oscillator.name,
+                point.tau, point.deviation, expected, error * 100.0, (unsigned long)point.terms, ok ? "" : "FAIL");
+        failures += !ok;
+    }
+    return failures;
+}
+
+/**
+  * @brief Checks that grid restarts after a long gap instead of interpolating over it
+  * @return Number of failed checks
+  */
+static unsigned checkGap (uint32_t tau0) {
+    NTPAllanDeviation allan;
+    NTPAllanPoint_t point;
+    int64_t tau0Us = (int64_t)tau0 * 1000000;
+    unsigned failures = 0;
+
+    allan.begin (tau0);
+    for (int i = 0; i < 3; i++) {
+        allan.addSample (i * tau0Us, 0);
+    }
+    failures += !allan.getPoint (0, &point) || point.terms != 1 || point.deviation != 0;
+    // Phase jumps across gap. Without restart it would be interpolated into grid points and reach the sums
+    int64_t resume = 2 * tau0Us + (NTP_ALLAN_MAX_GAP + 1) * tau0Us;
+    allan.addSample (resume, 1000000);
+    allan.addSample (resume + tau0Us, 1000000);
+    failures += !allan.getPoint (0, &point) || point.terms != 1 || point.deviation != 0;
+    allan.addSample (resume + 2 * tau0Us, 1000000);
+    failures += !allan.getPoint (0, &point) || point.terms != 2 || point.deviation != 0;
+    // Time going backwards restarts too
+    allan.addSample (resume, 0);
+    allan.addSample (resume + tau0Us, 0);
+    failures += !allan.getPoint (0, &point) || point.terms != 2 || point.deviation != 0;
+
+    allan.begin (0);
+    allan.addSample (0, 0);
+    failures += allan.isEnabled () || allan.getPoint (0, &point);
+    printf ("  gap restart checks: %u failed\n", failures);
+    return failures;
+}
+
+/**
+  * @brief Runs every synthetic oscillator and gap checks
+  * @return `true` if all pass
+  */
+static bool checkSynthetic (int argc, char** argv) {
+    unsigned long samples = (unsigned long)option (argc, argv, "samples", 20000);
+    uint32_t tau0 = (uint32_t)option (argc, argv, "tau0", 64);
+    double jitter = option (argc, argv, "jitter", 0.02);
+    double tolerance = option (argc, argv, "tolerance", 0.06);
+    std::mt19937_64 random ((uint64_t)option (argc, argv, "seed", 1));
+    Oscillator oscillators[] = {
+        { "wpm", option (argc, argv, "pm_us", 2000), 0, 0 },
+        { "wfm", 0, option (argc, argv, "fm", 1e-5), 0 },
+        { "drift", 0, 0, option (argc, argv, "drift", 1e-9) },
+    };
+    unsigned failures = 0;
+    double nsPerSample = 0;
+
+    if (!tau0 || samples < (2u << NTP_ALLAN_OCTAVES) || jitter < 0 || jitter >= 0.5) {
+        return false;
+    }
+    for (const Oscillator& oscillator : oscillators) {
+        failures += checkOscillator (oscillator, tau0, samples, jitter, tolerance, random, &nsPerSample);
+    }
+    failures += checkGap (tau0);
+    printf ("add_sample_ns:      %.1f\n", nsPerSample);
+    printf ("failures:           %u\n", failures);
+    return !failures;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc < 2 || strcmp (argv[1], "synthetic")) {
+        fprintf (stderr, "Usage: %s synthetic [key=value...]\n", argv[0]);
+        return 1;
+    }
+    passed = checkSynthetic (argc, argv);
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,474 @@
+/**
+  * @file ntpcapture.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host round trip checks of `NTPPacketCapture` pcapng export.
+  *
+  * Build on Linux. Stand-ins for Arduino `Print` and lwIP `ip_addr_t` are shared with the serializer checks, and
+  * `ESP32` selects the atomic slot claim:
+  *
+  *     g++ -std=c++11 -O2 -pthread -DESP32 -I../serializer/host -I../../src ntpcapture.cpp ../../src/NTPPacketCapture.cpp -o ntpcapture
+  *
+  * Capture more packets than the ring keeps, IPv4 and IPv6, sent and received, truncated and with odd lengths.
+  * Export them and parse the stream back: block structure, interface link type, timestamps, direction flags,
+  * `uptime_us` comments, IP and UDP headers with their checksums and payload bytes must match what was captured,
+  * and only the last `NTP_CAPTURE_RING_SIZE` packets must be there, oldest first. Then `writers` threads capture
+  * `packets` packets each while the main thread exports and parses; every exported packet must be whole:
+  *
+  *     ./ntpcapture roundtrip writers=2 packets=200000
+  *
+  * Exit status is 0 if every check passes.
+  */
+
+#include "NTPPacketCapture.h"
+#include "NTPCore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return atof (argv[i] + length + 1);
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Collects written bytes in memory
+  */
+class MemoryPrint : public Print {
+public:
+    std::vector<uint8_t> data;
+
+    size_t write (uint8_t c) override {
+        data.push_back (c);
+        return 1;
+    }
+    size_t write (const uint8_t* buffer, size_t size) override {
+        data.insert (data.end (), buffer, buffer + size);
+        return size;
+    }
+};
+
+/**
+  * @brief Packet as parsed back from pcapng
+  */
+struct ParsedPacket {
+    NTPCaptureDirection_t direction;
+    uint8_t ipVersion;
+    uint8_t source[16];
+    uint8_t destination[16];
+    uint16_t sourcePort;
+    uint16_t destinationPort;
+    uint16_t length; ///< UDP payload length
+    std::vector<uint8_t> payload; ///< Captured UDP payload
+    uint64_t timestampUs;
+    uint64_t uptimeUs;
+};
+
+static uint16_t getLe16 (const uint8_t* in) {
+    return in[0] | in[1] << 8;
+}
+
+static uint32_t getLe32 (const uint8_t* in) {
+    return getLe16 (in) | (uint32_t)getLe16 (in + 2) << 16;
+}
+
+static uint16_t getBe16 (const uint8_t* in) {
+    return in[0] << 8 | in[1];
+}
+
+/**
+  * @brief Adds bytes to an Internet checksum, unfolded
+  */
+static uint32_t checksumAdd (uint32_t sum, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += getBe16 (data + i);
+    }
+    if (length & 1) {
+        sum += data[length - 1] << 8;
+    }
+    return sum;
+}
+
+/**
+  * @brief Checks that a checksummed range folds to all ones
+  */
+static bool checksumValid (uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return sum == 0xFFFF;
+}
+
+/**
+  * @brief Parses a pcapng stream written by `NTPPacketCapture::writePcapng()`
+  * @param stream Bytes
+  * @param packets Output packets
+  * @param error Output reason of failure
+  * @return `true` if stream is well formed and every header and checksum is valid
+  */
+static bool parsePcapng (const std::vector<uint8_t>& stream, std::vector<ParsedPacket>* packets, const char** error) {
+    const uint8_t* p = stream.data ();
+    const uint8_t* end = p + stream.size ();
+
+    packets->clear ();
+    if (stream.size () < 48 || getLe32 (p) != 0x0A0D0D0A || getLe32 (p + 4) != 28 || getLe32 (p + 8) != 0x1A2B3C4D
+        || getLe16 (p + 12) != 1 || getLe32 (p + 24) != 28) {
+        *error = "section header";
+        return false;
+    }
+    p += 28;
+    if (getLe32 (p) != 1 || getLe32 (p + 4) != 20 || getLe16 (p + 8) != NTP_PCAP_LINKTYPE_RAW || getLe32 (p + 16) != 20) {
+        *error = "interface description";
+        return false;
+    }
+    p += 20;
+    while (p < end) {
+        ParsedPacket packet;
+        if (end - p < 32 || getLe32 (p) != 6) {
+            *error = "packet block type";
+            return false;
+        }
+        uint32_t blockLength = getLe32 (p + 4);
+        if (blockLength % 4 || blockLength > (size_t)(end - p) || getLe32 (p + blockLength - 4) != blockLength) {
+            *error = "packet block length";
+            return false;
+        }
+        uint32_t capturedLength = getLe32 (p + 20);
+        uint32_t originalLength = getLe32 (p + 24);
+        const uint8_t* ip = p + 28;
+        const uint8_t* options = ip + ((capturedLength + 3) & ~3);
+        if (getLe32 (p + 8) != 0 || options > p + blockLength - 4) {
+            *error = "packet block fields";
+            return false;
+        }
+        packet.timestampUs = (uint64_t)getLe32 (p + 12) << 32 | getLe32 (p + 16);
+
+        size_t ipHeaderLength;
+        if (ip[0] == 0x45) {
+            ipHeaderLength = 20;
+            packet.ipVersion = 4;
+            if (!checksumValid (checksumAdd (0, ip, 20)) || ip[9] != 17 || getBe16 (ip + 2) != originalLength) {
+                *error = "IPv4 header";
+                return false;
+            }
+            memset (packet.source, 0, 16);
+            memset (packet.destination, 0, 16);
+            memcpy (packet.source, ip + 12, 4);
+            memcpy (packet.destination, ip + 16, 4);
+        } else if (ip[0] == 0x60) {
+            ipHeaderLength = 40;
+            packet.ipVersion = 6;
+            if (ip[6] != 17 || getBe16 (ip + 4) + 40u != originalLength) {
+                *error = "IPv6 header";
+                return false;
+            }
+            memcpy (packet.source, ip + 8, 16);
+            memcpy (packet.destination, ip + 24, 16);
+        } else {
+            *error = "IP version";
+            return false;
+        }
+        const uint8_t* udp = ip + ipHeaderLength;
+        uint16_t udpLength = getBe16 (udp + 4);
+        if (capturedLength < ipHeaderLength + 8 || udpLength + ipHeaderLength != originalLength) {
+            *error = "UDP length";
+            return false;
+        }
+        packet.sourcePort = getBe16 (udp);
+        packet.destinationPort = getBe16 (udp + 2);
+        packet.length = udpLength - 8;
+        packet.payload.assign (udp + 8, ip + capturedLength);
+        if (packet.ipVersion == 6 && capturedLength == originalLength) {
+            uint32_t sum = checksumAdd (0, ip + 8, 32) + udpLength + 17;
+            if (!getBe16 (udp + 6) || !checksumValid (checksumAdd (sum, udp, udpLength))) {
+                *error = "UDP checksum";
+                return false;
+            }
+        }
+
+        bool hasFlags = false;
+        packet.uptimeUs = UINT64_MAX;
+        while (options + 4 <= p + blockLength - 4) {
+            uint16_t code = getLe16 (options);
+            uint16_t length = getLe16 (options + 2);
+            if (!code) {
+                break;
+            }
+            if (code == 2 && length == 4) {
+                uint32_t flags = getLe32 (options + 4);
+                hasFlags = (flags & 3) == 1 || (flags & 3) == 2;
+                packet.direction = (flags & 3) == 2 ? captureSent : captureReceived;
+            } else if (code == 1) {
+                char comment[32] = {};
+                if (length >= sizeof (comment) || memcmp (options + 4, "uptime_us=", 10)) {
+                    *error = "comment";
+                    return false;
+                }
+                memcpy (comment, options + 4, length);
+                packet.uptimeUs = strtoull (comment + 10, NULL, 10);
+            }
+            options += 4 + ((length + 3) & ~3);
+        }
+        if (!hasFlags || packet.uptimeUs == UINT64_MAX) {
+            *error = "packet options";
+            return false;
+        }
+        packets->push_back (packet);
+        p += blockLength;
+    }
+    return true;
+}
+
+/**
+  * @brief Packet fed to capture
+  */
+struct TestPacket {
+    NTPCaptureDirection_t direction;
+    ip_addr_t local;
+    ip_addr_t remote;
+    uint16_t localPort;
+    uint16_t remotePort;
+    std::vector<uint8_t> payload;
+    uint64_t uptimeUs;
+    timeval wall;
+};
+
+/**
+  * @brief Makes an address
+  * @param version 4 or 6
+  * @param last Last byte, 0 for any
+  */
+static ip_addr_t makeAddress (uint8_t version, uint8_t last) {
+    ip_addr_t address = {};
+    if (version == 6) {
+        uint8_t* bytes = (uint8_t*)address.u_addr.ip6.addr;
+        address.type = IPADDR_TYPE_V6;
+        if (last) {
+            bytes[0] = 0x20;
+            bytes[1] = 0x01;
+            bytes[2] = 0x0d;
+            bytes[3] = 0xb8;
+            bytes[15] = last;
+        }
+    } else {
+        uint8_t bytes[4] = { 192, 168, 1, last };
+        uint32_t value;
+        memcpy (&value, bytes, 4);
+        ip_addr_set_ip4_u32 (&address, last ? value : 0);
+    }
+    return address;
+}
+
+/**
+  * @brief Compares a parsed packet with the one captured
+  * @return Reason of mismatch or `NULL`
+  */
+static const char* comparePacket (const ParsedPacket& parsed, const TestPacket& sent, const uint8_t* localFallback) {
+    uint8_t local[16] = {};
+    uint8_t remote[16] = {};
+    uint8_t version = IP_IS_V6 (&sent.remote) ? 6 : 4;
+    size_t captured = sent.payload.size () < (size_t)NTP_CAPTURE_SNAPLEN ? sent.payload.size () : NTP_CAPTURE_SNAPLEN;
+
+    memcpy (remote, version == 6 ? (const void*)sent.remote.u_addr.ip6.addr : (const void*)&sent.remote.u_addr.ip4.addr, version == 6 ? 16 : 4);
+    if (ip_addr_isany (&sent.local)) {
+        memcpy (local, localFallback, 16);
+    } else {
+        memcpy (local, version == 6 ? (const void*)sent.local.u_addr.ip6.addr : (const void*)&sent.local.u_addr.ip4.addr, version == 6 ? 16 : 4);
+    }
+    bool isSent = sent.direction == captureSent;
+    if (parsed.direction != sent.direction || parsed.ipVersion != version) {
+        return "direction or version";
+    }
+    if (memcmp (parsed.source, isSent ? local : remote, 16) || memcmp (parsed.destination, isSent ? remote : local, 16)) {
+        return "addresses";
+    }
+    if (parsed.sourcePort != (isSent ? sent.localPort : sent.remotePort)
+        || parsed.destinationPort != (isSent ? sent.remotePort : sent.localPort)) {
+        return "ports";
+    }
+    if (parsed.length != sent.payload.size () || parsed.payload.size () != captured
+        || memcmp (parsed.payload.data (), sent.payload.data (), captured)) {
+        return "payload";
+    }
+    if (parsed.timestampUs != (uint64_t)sent.wall.tv_sec * 1000000 + sent.wall.tv_usec || parsed.uptimeUs != sent.uptimeUs) {
+        return "timestamps";
+    }
+    return NULL;
+}
+
+/**
+  * @brief Captures a varied sequence of packets and checks exported stream against it
+  * @return Number of failed checks
+  */
+static unsigned checkRoundTrip () {
+    NTPPacketCapture capture;
+    std::vector<TestPacket> sent;
+    MemoryPrint out;
+    std::vector<ParsedPacket> parsed;
+    const char* error = "";
+    unsigned failures = 0;
+    const size_t lengths[] = { 48, 49, 68, 90, 1, 120 };
+    const unsigned total = 3 * NTP_CAPTURE_RING_SIZE + 3;
+
+    uint8_t request[NTP_PACKET_SIZE] = {};
+    timeval now = {};
+    capture.capture (captureSent, request, sizeof (request), NULL, 0, NULL, 0, 0, &now);
+    failures += capture.getCaptured () != 0; // Disabled
+    capture.setEnabled (true);
+
+    for (unsigned i = 0; i < total; i++) {
+        TestPacket packet;
+        uint8_t version = (i / 2) % 2 ? 6 : 4;
+        packet.direction = i % 2 ? captureReceived : captureSent;
+        // Requests do not know local address yet, replies do
+        packet.local = makeAddress (version, packet.direction == captureSent ? 0 : 10);
+        packet.remote = makeAddress (version, 100 + i);
+        packet.localPort = 50000 + i;
+        packet.remotePort = 123;
+        packet.payload.resize (lengths[i % (sizeof (lengths) / sizeof (lengths[0]))]);
+        for (size_t j = 0; j < packet.payload.size (); j++) {
+            packet.payload[j] = (uint8_t)(i * 31 + j);
+        }
+        packet.uptimeUs = i % 3 ? 999999 + i : (1ULL << 33) + i * 1000003ULL;
+        packet.wall.tv_sec = 1760000000 + i;
+        packet.wall.tv_usec = (i * 123457) % 1000000;
+        capture.capture (packet.direction, packet.payload.data (), packet.payload.size (), &packet.local, packet.localPort,
+                         &packet.remote, packet.remotePort, packet.uptimeUs, &packet.wall);
+        sent.push_back (packet);
+    }
+    failures += capture.getCaptured () != total;
+
+    size_t written = capture.writePcapng (out);
+    if (written != out.data.size () || !parsePcapng (out.data, &parsed, &error)) {
+        printf ("  parse error: %s\n", error);
+        return failures + 1;
+    }
+    if (parsed.size () != NTP_CAPTURE_RING_SIZE) {
+        printf ("  %zu packets exported, %d expected\n", parsed.size (), NTP_CAPTURE_RING_SIZE);
+        return failures + 1;
+    }
+    // Export takes local address of requests from last received packet of same version
+    uint8_t local4[16] = {};
+    uint8_t local6[16] = {};
+    ip_addr_t reply4 = makeAddress (4, 10);
+    ip_addr_t reply6 = makeAddress (6, 10);
+    memcpy (local4, &reply4.u_addr.ip4.addr, 4);
+    memcpy (local6, reply6.u_addr.ip6.addr, 16);
+    for (size_t i = 0; i < parsed.size (); i++) {
+        const TestPacket& packet = sent[total - NTP_CAPTURE_RING_SIZE + i];
+        const char* mismatch = comparePacket (parsed[i], packet, IP_IS_V6 (&packet.remote) ? local6 : local4);
+        if (mismatch) {
+            printf ("  packet %zu: %s\n", total - NTP_CAPTURE_RING_SIZE + i, mismatch);
+            failures++;
+        }
+    }
+    printf ("  round trip: %u packets captured, %zu exported in %zu bytes\n", total, parsed.size (), out.data.size ());
+    return failures;
+}
+
+/**
+  * @brief Exports while several threads capture
+  * @return Number of torn or malformed packets, or 1 if nothing was exported
+  */
+static unsigned long checkConcurrent (unsigned writers, unsigned long packets) {
+    NTPPacketCapture capture;
+    std::atomic<unsigned> running (writers);
+    std::vector<std::thread> threads;
+    unsigned long torn = 0;
+    unsigned long exported = 0;
+    unsigned long exports = 0;
+
+    capture.setEnabled (true);
+    for (unsigned w = 0; w < writers; w++) {
+        threads.emplace_back ([&, w] {
+            ip_addr_t remote = makeAddress (4, 1 + w);
+            ip_addr_t local = makeAddress (4, 200);
+            uint8_t payload[NTP_PACKET_SIZE];
+            timeval wall;
+            for (unsigned long n = 0; n < packets; n++) {
+                // Every field derives from n, a record mixing two packets can not pass
+                uint64_t uptimeUs = (uint64_t)w << 40 | n;
+                memset (payload, (uint8_t)n, sizeof (payload));
+                wall.tv_sec = (time_t)n;
+                wall.tv_usec = (long)(n % 1000000);
+                capture.capture (captureReceived, payload, sizeof (payload), &local, (uint16_t)n,
+                                 &remote, (uint16_t)(n >> 16), uptimeUs, &wall);
+                if (n % 256 == 0) {
+                    std::this_thread::yield ();
+                }
+            }
+            running--;
+        });
+    }
+    while (running) {
+        MemoryPrint out;
+        std::vector<ParsedPacket> parsed;
+        const char* error;
+        capture.writePcapng (out);
+        exports++;
+        if (!parsePcapng (out.data, &parsed, &error)) {
+            torn++;
+            continue;
+        }
+        for (const ParsedPacket& packet : parsed) {
+            uint64_t n = packet.uptimeUs & 0xFFFFFFFFFF;
+            unsigned w = packet.uptimeUs >> 40;
+            bool whole = packet.source[3] == 1 + w && packet.destinationPort == (uint16_t)n
+                         && packet.sourcePort == (uint16_t)(n >> 16) && packet.timestampUs == n * 1000000 + n % 1000000;
+            for (uint8_t byte : packet.payload) {
+                whole &= byte == (uint8_t)n;
+            }
+            torn += !whole;
+            exported++;
+        }
+        std::this_thread::yield ();
+    }
+    for (std::thread& thread : threads) {
+        thread.join ();
+    }
+    printf ("  concurrent: %u writers, %lu exports, %lu packets, %lu torn, %u captured\n", writers, exports, exported,
+            torn, capture.getCaptured ());
+    return torn + !exported + (capture.getCaptured () != writers * packets);
+}
+
+/**
+  * @brief Runs round trip and concurrent checks
+  * @return `true` if all pass
+  */
+static bool checkCapture (int argc, char** argv) {
+    unsigned writers = (unsigned)option (argc, argv, "writers", 2);
+    unsigned long packets = (unsigned long)option (argc, argv, "packets", 200000);
+
+    if (!writers || !packets) {
+        return false;
+    }
+    unsigned long failures = checkRoundTrip ();
+    failures += checkConcurrent (writers, packets);
+    printf ("failures:           %lu\n", failures);
+    return !failures;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc < 2 || strcmp (argv[1], "roundtrip")) {
+        fprintf (stderr, "Usage: %s roundtrip [key=value...]\n", argv[0]);
+        return 1;
+    }
+    passed = checkCapture (argc, argv);
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
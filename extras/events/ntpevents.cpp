@@ -0,0 +1,341 @@
+/**
+  * @file ntpevents.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host checks and benchmarks of event delivery in `NTPEventQueue.h`.
+  *
+  * Build on Linux:
+  *
+  *     g++ -std=c++11 -O2 -pthread -I../../src ntpevents.cpp -o ntpevents
+  *
+  * Check that `NTPEventRegistry` delivers every event only to subscribed listeners and that `NTPEventQueue` neither
+  * loses nor repeats events while several producers push at once. Then time a sync cycle, which emits
+  * `requestSent` and `timeSyncd`, for an application that only listens to `timeSyncd`. Former path built both
+  * events and called the single `onSyncEvent` handler. `cycles` sets how many cycles are timed:
+  *
+  *     ./ntpevents dispatch cycles=5000000 producers=4 pushes=200000
+  *
+  * Exit status is 0 if every check passes.
+  */
+
+#include "NTPEventQueue.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+constexpr auto QUEUE_SIZE = 8; ///< @brief Same as `NTP_EVENT_QUEUE_SIZE` in library
+constexpr auto MAX_LISTENERS = 4; ///< @brief Same as `MAX_NTP_EVENT_LISTENERS` in library
+constexpr int REQUEST_SENT = 1; ///< @brief `requestSent` event code
+constexpr int TIME_SYNCD = 0; ///< @brief `timeSyncd` event code
+
+/**
+  * @brief Stand in for Arduino `IPAddress`, which has a constructor and a virtual `printTo()`
+  */
+class HostAddress {
+public:
+    HostAddress () {
+        memset (bytes, 0, sizeof (bytes));
+    }
+    HostAddress (uint8_t a, uint8_t b, uint8_t c, uint8_t d) : HostAddress () {
+        bytes[0] = a;
+        bytes[1] = b;
+        bytes[2] = c;
+        bytes[3] = d;
+    }
+    virtual ~HostAddress () {}
+    virtual size_t printTo () const {
+        return bytes[0];
+    }
+
+protected:
+    uint8_t bytes[16];
+    uint8_t type = 4;
+};
+
+/**
+  * @brief Same layout as `NTPEvent_t`. `serverAddr` stands in for lwIP `ip_addr_t`
+  */
+struct HostEvent {
+    int event = 0;
+    struct {
+        double offset = 0.0;
+        double delay = 0.0;
+        float dispersion = 0.0;
+        HostAddress serverAddress;
+        uint8_t serverAddr[20] = {};
+        unsigned int port = 0;
+        unsigned int retrials = 0;
+    } info;
+    uint64_t uptimeUs = 0;
+    timeval time = {};
+};
+
+typedef std::function<void (HostEvent)> Handler; ///< @brief Same as `onSyncEvent_t`
+
+/**
+  * @brief Same as `ntpEventMask()`
+  */
+constexpr uint16_t eventMask (int event) {
+    return (uint16_t)(1 << (event + 8));
+}
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return atof (argv[i] + length + 1);
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Gets monotonic time in seconds
+  */
+static double seconds () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+  * @brief Builds an event as `NTPClient` does before emitting it
+  */
+static HostEvent buildEvent (int code, unsigned cycle) {
+    HostEvent event;
+    event.event = code;
+    event.info.offset = cycle * 1e-6;
+    event.info.delay = 0.012;
+    event.info.serverAddress = HostAddress (192, 168, 1, (uint8_t)cycle);
+    event.info.serverAddr[0] = (uint8_t)cycle;
+    event.info.port = 123;
+    event.info.retrials = cycle;
+    return event;
+}
+
+/**
+  * @brief Checks listener masks, slot reuse and removal
+  * @return Number of failed checks
+  */
+static unsigned checkRegistry () {
+    NTPEventRegistry<HostEvent, Handler, MAX_LISTENERS> registry;
+    unsigned received[MAX_LISTENERS + 1] = {};
+    unsigned failures = 0;
+    const uint16_t masks[] = { 0xFFFF, eventMask (TIME_SYNCD), eventMask (REQUEST_SENT) | eventMask (-1), eventMask (-8) };
+
+    for (int i = 0; i < MAX_LISTENERS; i++) {
+        if (registry.add ([&received, i] (HostEvent) { received[i]++; }, masks[i]) != i) {
+            failures++;
+        }
+    }
+    failures += registry.add ([&received] (HostEvent) { received[MAX_LISTENERS]++; }, 0xFFFF) != -1; // Full
+    failures += registry.add (Handler (), 0xFFFF) != -1;
+    for (int code = -8; code <= 7; code++) {
+        if (registry.wants (eventMask (code))) {
+            registry.dispatch (buildEvent (code, 0), eventMask (code));
+        }
+    }
+    failures += received[0] != 16;
+    failures += received[1] != 1;
+    failures += received[2] != 2;
+    failures += received[3] != 1;
+    failures += received[MAX_LISTENERS] != 0;
+
+    // Removed listener gets nothing. Once last listener for an event is gone, it is not wanted any more
+    failures += !registry.remove (3);
+    failures += registry.remove (3);
+    registry.dispatch (buildEvent (-8, 0), eventMask (-8));
+    failures += received[3] != 1;
+    failures += !registry.wants (eventMask (-8));
+    failures += !registry.remove (0);
+    failures += registry.wants (eventMask (-8));
+    // Freed slot is reused
+    failures += registry.add ([&received] (HostEvent) { received[MAX_LISTENERS]++; }, eventMask (7)) != 0;
+    registry.dispatch (buildEvent (7, 0), eventMask (7));
+    failures += received[MAX_LISTENERS] != 1;
+    return failures;
+}
+
+/**
+  * @brief Pushes from several producers while one consumer pops. Every producer numbers its events, so lost,
+  * repeated or reordered events show up
+  * @return Number of failed checks
+  */
+static unsigned checkQueue (unsigned producers, unsigned long pushes, unsigned long* popped, unsigned long* dropped) {
+    NTPEventQueue<HostEvent, QUEUE_SIZE> queue;
+    std::atomic<unsigned> running (producers);
+    std::vector<std::thread> threads;
+    std::vector<unsigned long> accepted (producers);
+    std::vector<long> last (producers, -1);
+    unsigned failures = 0;
+    HostEvent event;
+
+    // Single thread: FIFO order and overflow count
+    for (unsigned i = 0; i <= QUEUE_SIZE; i++) {
+        failures += queue.push (buildEvent (TIME_SYNCD, i)) != (i < QUEUE_SIZE);
+    }
+    failures += queue.getOverflows () != 1;
+    for (unsigned i = 0; i < QUEUE_SIZE; i++) {
+        failures += !queue.pop (event) || event.info.retrials != i;
+    }
+    failures += queue.pop (event);
+
+    for (unsigned p = 0; p < producers; p++) {
+        threads.emplace_back ([&, p] {
+            for (unsigned long i = 0; i < pushes; i++) {
+                HostEvent item = buildEvent (TIME_SYNCD, (unsigned)i);
+                item.info.port = p;
+                if (queue.push (item)) {
+                    accepted[p]++;
+                }
+                if (i % 4 == 0) {
+                    std::this_thread::yield (); // Consumer gets turns on single core hosts too
+                }
+            }
+            running--;
+        });
+    }
+    *popped = 0;
+    for (;;) {
+        bool finished = running == 0;
+        while (queue.pop (event)) {
+            unsigned p = event.info.port;
+            if (p >= producers || (long)event.info.retrials <= last[p]) {
+                failures++;
+            } else {
+                last[p] = event.info.retrials;
+            }
+            (*popped)++;
+        }
+        if (finished) {
+            break;
+        }
+        std::this_thread::yield ();
+    }
+    for (std::thread& thread : threads) {
+        thread.join ();
+    }
+    unsigned long total = 0;
+    for (unsigned long count : accepted) {
+        total += count;
+    }
+    *dropped = queue.getOverflows () - 1;
+    failures += *popped != total;
+    failures += total + *dropped != producers * pushes;
+    return failures;
+}
+
+/**
+  * @brief Checks registry and queue, then times a sync cycle through former and current paths
+  * @return `true` if every check passes
+  */
+static bool checkDispatch (int argc, char** argv) {
+    unsigned long cycles = (unsigned long)option (argc, argv, "cycles", 5000000);
+    unsigned producers = (unsigned)option (argc, argv, "producers", 4);
+    unsigned long pushes = (unsigned long)option (argc, argv, "pushes", 200000);
+    unsigned long popped = 0;
+    unsigned long dropped = 0;
+    volatile unsigned long delivered = 0;
+
+    if (!cycles || !producers || !pushes) {
+        return false;
+    }
+    unsigned registryFailures = checkRegistry ();
+    unsigned queueFailures = checkQueue (producers, pushes, &popped, &dropped);
+
+    // Application only cares about timeSyncd
+    auto application = [&delivered] (HostEvent event) {
+        if (event.event == TIME_SYNCD) {
+            delivered += event.info.retrials & 1;
+        }
+    };
+
+    // Former path: every event built and passed to the only handler
+    Handler single = application;
+    double start = seconds ();
+    for (unsigned long i = 0; i < cycles; i++) {
+        single (buildEvent (REQUEST_SENT, (unsigned)i));
+        single (buildEvent (TIME_SYNCD, (unsigned)i));
+    }
+    double former = seconds () - start;
+
+    // Registry, eventsImmediate. requestSent is never built
+    NTPEventRegistry<HostEvent, Handler, MAX_LISTENERS> registry;
+    registry.add (application, eventMask (TIME_SYNCD));
+    start = seconds ();
+    for (unsigned long i = 0; i < cycles; i++) {
+        if (registry.wants (eventMask (REQUEST_SENT))) {
+            registry.dispatch (buildEvent (REQUEST_SENT, (unsigned)i), eventMask (REQUEST_SENT));
+        }
+        if (registry.wants (eventMask (TIME_SYNCD))) {
+            registry.dispatch (buildEvent (TIME_SYNCD, (unsigned)i), eventMask (TIME_SYNCD));
+        }
+    }
+    double immediate = seconds () - start;
+
+    // Registry and queue, eventsAuto on ESP32. Events are timestamped, queued and drained later
+    NTPEventQueue<HostEvent, QUEUE_SIZE> queue;
+    start = seconds ();
+    for (unsigned long i = 0; i < cycles; i++) {
+        const int codes[] = { REQUEST_SENT, TIME_SYNCD };
+        for (int code : codes) {
+            if (registry.wants (eventMask (code))) {
+                HostEvent event = buildEvent (code, (unsigned)i);
+                gettimeofday (&event.time, NULL);
+                queue.push (event);
+            }
+        }
+        HostEvent event;
+        while (queue.pop (event)) {
+            registry.dispatch (event, eventMask (event.event));
+        }
+    }
+    double queued = seconds () - start;
+
+    // Nobody listens. Cost of an event source when events are not wanted at all
+    NTPEventRegistry<HostEvent, Handler, MAX_LISTENERS> empty;
+    start = seconds ();
+    for (unsigned long i = 0; i < cycles; i++) {
+        if (empty.wants (eventMask (REQUEST_SENT))) {
+            empty.dispatch (buildEvent (REQUEST_SENT, (unsigned)i), eventMask (REQUEST_SENT));
+        }
+        if (empty.wants (eventMask (TIME_SYNCD))) {
+            empty.dispatch (buildEvent (TIME_SYNCD, (unsigned)i), eventMask (TIME_SYNCD));
+        }
+    }
+    double unsubscribed = seconds () - start;
+
+    printf ("registry_failures:  %u\n", registryFailures);
+    printf ("queue_failures:     %u\n", queueFailures);
+    printf ("queue_popped:       %lu\n", popped);
+    printf ("queue_dropped:      %lu\n", dropped);
+    printf ("cycles:             %lu\n", cycles);
+    printf ("single_ns_cycle:    %.1f\n", former * 1e9 / cycles);
+    printf ("registry_ns_cycle:  %.1f\n", immediate * 1e9 / cycles);
+    printf ("queued_ns_cycle:    %.1f\n", queued * 1e9 / cycles);
+    printf ("no_listener_ns:     %.1f\n", unsubscribed * 1e9 / cycles);
+    return !registryFailures && !queueFailures && delivered != 1;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc < 2 || strcmp (argv[1], "dispatch")) {
+        fprintf (stderr, "Usage: %s dispatch [key=value...]\n", argv[0]);
+        return 1;
+    }
+    passed = checkDispatch (argc, argv);
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
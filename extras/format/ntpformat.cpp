@@ -0,0 +1,579 @@
+/**
+  * @file ntpformat.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host checks and benchmarks of time string formatting in `NTPTimeFormat.h`.
+  *
+  * Build on Linux:
+  *
+  *     g++ -std=c++11 -O2 -pthread -I../../src ntpformat.cpp ../../src/NTPTimeZone.cpp -o ntpformat
+  *
+  * Compare `getTimeDateString(timeval)` rendering through `NTPLocalTimeCache` with the former path, which called
+  * `localtime_r()`, `strftime()` and `snprintf()` on every call. `calls_per_s` sets how many times every second is
+  * rendered, as a dashboard refreshing many values does:
+  *
+  *     ./ntpformat cache calls_per_s=1000 seconds=7200
+  *
+  * Render into caller buffers with `ntpFormatLocalTime()` from several threads at once. Every thread renders the
+  * same instants, with and without microseconds and zone, into buffers of many sizes. Results are compared with
+  * strings rendered on one thread before, bytes after every buffer are checked for overruns and heap allocations
+  * done while rendering are counted:
+  *
+  *     ./ntpformat threads threads=8 instants=20000 rounds=20
+  *
+  * Check every `NTPFormat*` layout against `strftime()` and `snprintf()` rendering of the same time, in zones east,
+  * west and at UTC, into complete and truncated buffers. Then compare `NTPFormatRFC3339Us` through the local time
+  * cache, as `getTimeFormatted()` does, with `getTimeDateStringUs()` path and with plain `strftime()`. Both cached
+  * paths run with `calls_per_s` calls in every second, so they hit cache, and with one call per second, so they
+  * miss. Best of `rounds` rounds is reported:
+  *
+  *     ./ntpformat layouts calls_per_s=1000 seconds=7200 rounds=5
+  *
+  * Fast forward `NTPUptimeFormatter` across the points where 32 bit `micros()` and `millis()` counters wrap, and
+  * where days part gets longer, comparing every string with `snprintf()`. `step_ms` is time between calls:
+  *
+  *     ./ntpformat uptime step_ms=250 window_s=600
+  *
+  * `tz=RULE` sets POSIX time zone. Exit status is 0 if every check passes.
+  */
+
+#include "NTPTimeFormat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr auto DEFAULT_TEST_TZ = "CET-1CEST,M3.5.0,M10.5.0/3"; ///< @brief Zone used if `tz` option is not given
+constexpr auto TEST_FORMAT = "%02d/%02m/%04Y %02H:%02M:%02S"; ///< @brief Same as `TIME_DATE_STR_FORMAT` in library
+constexpr time_t TEST_START = 1774746000; ///< @brief 2026-03-29 01:00:00 UTC, one hour before DST starts in Europe
+constexpr auto CANARY = (char)0xA5; ///< @brief Filler byte after rendered buffer. Any change is an overrun
+constexpr auto CANARY_LENGTH = 16; ///< @brief Bytes checked after every buffer
+constexpr size_t TEST_LENGTHS[] = { 0, 1, 2, 11, 19, 20, 26, 27, 30, 31, MAX_TIME_STR_LENGTH }; ///< @brief Buffer sizes, most of them truncate
+
+extern "C" void* __libc_malloc (size_t size);
+
+static thread_local bool countAllocations = false; ///< @brief Set on render threads while rendering
+static std::atomic<unsigned long> allocations (0); ///< @brief Allocations done with `countAllocations` set
+
+/**
+  * @brief Replaces `malloc()` to count allocations done while rendering. `new` goes through it as well
+  */
+extern "C" void* malloc (size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+    return __libc_malloc (size);
+}
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static const char* option (int argc, char** argv, const char* key, const char* fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return argv[i] + length + 1;
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Gets numeric value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    const char* value = option (argc, argv, key, (const char*)NULL);
+    return value ? atof (value) : fallback;
+}
+
+/**
+  * @brief Gets monotonic time in seconds
+  */
+static double seconds () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+  * @brief Sets process time zone for both `localtime_r()` and compiled rules, as `NTPClient::setTimeZone()` does
+  */
+static void setZone (const char* rule) {
+    setenv ("TZ", rule, 1);
+    tzset ();
+    NTPTimeZone::setProcessRule (rule);
+}
+
+/**
+  * @brief Former `getTimeDateString(timeval)`. Time zone and format are evaluated on every call
+  */
+static char* renderUncached (char* buffer, size_t length, const timeval& moment, const char* format) {
+    tm local_tm;
+    localtime_r (&moment.tv_sec, &local_tm);
+    size_t index = strftime (buffer, length, format, &local_tm);
+    index += snprintf (buffer + index, length - index, ".%06ld", (long)moment.tv_usec);
+    strftime (buffer + index, length - index, " %Z", &local_tm);
+    return buffer;
+}
+
+/**
+  * @brief Renders same times with and without cache, checks that strings match and measures calls per second.
+  * Time zone is changed halfway, so stale cached strings would show up
+  * @return `true` if all strings match
+  */
+static bool checkCache (int argc, char** argv) {
+    const char* rule = option (argc, argv, "tz", DEFAULT_TEST_TZ);
+    unsigned callsPerSecond = (unsigned)option (argc, argv, "calls_per_s", 1000);
+    unsigned long span = (unsigned long)option (argc, argv, "seconds", 7200);
+    const char* otherRule = "EST5EDT,M3.2.0,M11.1.0";
+    unsigned long calls = span * callsPerSecond;
+    unsigned long mismatches = 0;
+    char expected[TIME_CACHE_STR_LENGTH];
+    char got[TIME_CACHE_STR_LENGTH];
+    volatile size_t sink = 0;
+    uint32_t generation = 0;
+    NTPTimeZone zone;
+    NTPLocalTimeCache cache;
+
+    if (!callsPerSecond || !span) {
+        return false;
+    }
+    // Strings must be the same through compiled rules and through localtime_r
+    for (int compiled = 1; compiled >= 0; compiled--) {
+        setZone (rule);
+        if (!compiled) {
+            NTPTimeZone::setProcessRule (NULL); // Cache falls back to localtime_r
+        }
+        generation++;
+        for (unsigned long i = 0; i < calls; i++) {
+            if (i == calls / 2) {
+                setZone (otherRule);
+                if (!compiled) {
+                    NTPTimeZone::setProcessRule (NULL);
+                }
+                generation++; // As NTPClient::setTimeZone() does
+            }
+            timeval moment;
+            moment.tv_sec = TEST_START + i / callsPerSecond;
+            moment.tv_usec = (i % callsPerSecond) * (1000000 / callsPerSecond);
+            renderUncached (expected, sizeof (expected), moment, TEST_FORMAT);
+            cache.renderUs (got, sizeof (got), moment, TEST_FORMAT, true, zone, generation);
+            if (strcmp (expected, got)) {
+                if (mismatches++ < 5) {
+                    fprintf (stderr, "%s: expected \"%s\" got \"%s\"\n", compiled ? "compiled" : "localtime_r", expected, got);
+                }
+            }
+        }
+    }
+
+    // Benchmarks, same zone for both
+    timeval moment;
+    setZone (rule);
+    generation++;
+    double start = seconds ();
+    for (unsigned long i = 0; i < calls; i++) {
+        moment.tv_sec = TEST_START + i / callsPerSecond;
+        moment.tv_usec = (i % callsPerSecond) * (1000000 / callsPerSecond);
+        sink += renderUncached (got, sizeof (got), moment, TEST_FORMAT)[20];
+    }
+    double uncached = seconds () - start;
+    start = seconds ();
+    for (unsigned long i = 0; i < calls; i++) {
+        moment.tv_sec = TEST_START + i / callsPerSecond;
+        moment.tv_usec = (i % callsPerSecond) * (1000000 / callsPerSecond);
+        sink += cache.renderUs (got, sizeof (got), moment, TEST_FORMAT, true, zone, generation)[20];
+    }
+    double cached = seconds () - start;
+    start = seconds ();
+    for (unsigned long i = 0; i < span; i++) { // Every call on a new second, worst case for cache
+        moment.tv_sec = TEST_START + i;
+        moment.tv_usec = 0;
+        sink += cache.renderUs (got, sizeof (got), moment, TEST_FORMAT, true, zone, generation)[20];
+    }
+    double missed = seconds () - start;
+
+    printf ("zone:               %s\n", rule);
+    printf ("calls:              %lu\n", calls);
+    printf ("calls_per_second:   %u\n", callsPerSecond);
+    printf ("mismatches:         %lu\n", mismatches);
+    printf ("uncached_calls_s:   %.0f\n", calls / uncached);
+    printf ("cached_calls_s:     %.0f\n", calls / cached);
+    printf ("speedup:            %.1f\n", uncached / cached);
+    printf ("all_miss_calls_s:   %.0f\n", span / missed);
+    return !mismatches && sink != 1;
+}
+
+/**
+  * @brief One string to render. `usec` is negative to render without microseconds
+  */
+struct RenderCase {
+    time_t moment;
+    long usec;
+    bool withZone;
+    std::string expected; ///< @brief Complete string, rendered on one thread
+};
+
+/**
+  * @brief Counters of one render thread
+  */
+struct RenderResult {
+    unsigned long calls = 0;
+    unsigned long mismatches = 0; ///< @brief Wrong string or wrong returned length
+    unsigned long overruns = 0; ///< @brief Canary bytes changed
+};
+
+/**
+  * @brief Renders every case into every buffer size, starting at a different case on each thread
+  */
+static void renderThread (const std::vector<RenderCase>* cases, unsigned thread, unsigned rounds, RenderResult* result) {
+    constexpr auto numLengths = sizeof (TEST_LENGTHS) / sizeof (TEST_LENGTHS[0]);
+    char area[MAX_TIME_STR_LENGTH + CANARY_LENGTH];
+    size_t count = cases->size ();
+
+    countAllocations = true;
+    for (unsigned round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < count; i++) {
+            const RenderCase& test = (*cases)[(i * 7919 + thread * 104729 + round) % count];
+            size_t length = TEST_LENGTHS[(i + thread + round) % numLengths];
+            memset (area, CANARY, sizeof (area));
+            size_t needed = ntpFormatLocalTime (length ? area : NULL, length, test.moment, test.usec, TEST_FORMAT, test.withZone);
+            result->calls++;
+            if (length) {
+                size_t copied = test.expected.size () < length ? test.expected.size () : length - 1;
+                if (memcmp (area, test.expected.data (), copied) || area[copied] != '\0') {
+                    result->mismatches++;
+                }
+            }
+            if (needed != test.expected.size ()) {
+                result->mismatches++;
+            }
+            for (size_t j = length; j < length + CANARY_LENGTH; j++) {
+                if (area[j] != CANARY) {
+                    result->overruns++;
+                    break;
+                }
+            }
+        }
+    }
+    countAllocations = false;
+}
+
+/**
+  * @brief Renders into caller buffers from several threads at once and checks strings, lengths, overruns
+  * and allocations
+  * @return `true` if every string and length is right, no byte outside buffers changed and nothing was allocated
+  */
+static bool checkThreads (int argc, char** argv) {
+    const char* rule = option (argc, argv, "tz", DEFAULT_TEST_TZ);
+    unsigned numThreads = (unsigned)option (argc, argv, "threads", 8);
+    unsigned long numInstants = (unsigned long)option (argc, argv, "instants", 20000);
+    unsigned rounds = (unsigned)option (argc, argv, "rounds", 20);
+    std::vector<RenderCase> cases;
+    std::vector<RenderResult> results (numThreads);
+    std::vector<std::thread> threads;
+    RenderResult total;
+    char buffer[MAX_TIME_STR_LENGTH];
+
+    if (!numThreads || !numInstants || !rounds) {
+        return false;
+    }
+    setZone (rule);
+    // Expected strings on this thread only. Instants cover DST changes of a whole year
+    for (unsigned long i = 0; i < numInstants; i++) {
+        RenderCase test;
+        test.moment = TEST_START - 86400 + (time_t)(i * (366ULL * 86400 / numInstants));
+        test.usec = i % 3 ? (long)(i * 7919 % 1000000) : -1;
+        test.withZone = i % 2;
+        size_t length = ntpFormatLocalTime (buffer, sizeof (buffer), test.moment, test.usec, TEST_FORMAT, test.withZone);
+        test.expected.assign (buffer, length);
+        cases.push_back (test);
+    }
+
+    double start = seconds ();
+    for (unsigned i = 0; i < numThreads; i++) {
+        threads.emplace_back (renderThread, &cases, i, rounds, &results[i]);
+    }
+    for (auto& thread : threads) {
+        thread.join ();
+    }
+    double elapsed = seconds () - start;
+    for (const auto& result : results) {
+        total.calls += result.calls;
+        total.mismatches += result.mismatches;
+        total.overruns += result.overruns;
+    }
+
+    printf ("zone:               %s\n", rule);
+    printf ("threads:            %u\n", numThreads);
+    printf ("calls:              %lu\n", total.calls);
+    printf ("mismatches:         %lu\n", total.mismatches);
+    printf ("overruns:           %lu\n", total.overruns);
+    printf ("allocations:        %lu\n", allocations.load ());
+    printf ("calls_s:            %.0f\n", total.calls / elapsed);
+    return total.calls && !total.mismatches && !total.overruns && !allocations.load ();
+}
+
+/**
+  * @brief A compiled layout and the `strftime()` format and suffixes that render the same string
+  */
+struct LayoutCase {
+    const char* name;
+    size_t (*format) (char* buffer, size_t length, const NTPTimeFields_t& t); ///< @brief `Layout::format`
+    size_t maxLength; ///< @brief `Layout::maxLength`
+    const char* strftimeFormat; ///< @brief Date and time part
+    int fractionDigits; ///< @brief 0, 3 or 6 digits after seconds
+    char offset; ///< @brief `z` for `+hh:mm`, `Z` for `Z` at UTC, 0 for none
+};
+
+static const LayoutCase layoutCases[] = {
+    { "ISO8601", NTPFormatISO8601::format, NTPFormatISO8601::maxLength, "%Y-%m-%dT%H:%M:%S", 0, 'z' },
+    { "RFC3339", NTPFormatRFC3339::format, NTPFormatRFC3339::maxLength, "%Y-%m-%dT%H:%M:%S", 0, 'Z' },
+    { "RFC3339Ms", NTPFormatRFC3339Ms::format, NTPFormatRFC3339Ms::maxLength, "%Y-%m-%dT%H:%M:%S", 3, 'Z' },
+    { "RFC3339Us", NTPFormatRFC3339Us::format, NTPFormatRFC3339Us::maxLength, "%Y-%m-%dT%H:%M:%S", 6, 'Z' },
+    { "Default", NTPFormatDefault::format, NTPFormatDefault::maxLength, "%d/%m/%Y %H:%M:%S", 0, 0 },
+    { "DefaultUs", NTPFormatDefaultUs::format, NTPFormatDefaultUs::maxLength, "%d/%m/%Y %H:%M:%S", 6, 0 },
+    { "JS", NTPFormatJS::format, NTPFormatJS::maxLength, "%m/%d/%Y %H:%M:%S", 0, 0 },
+    { "TimeUs", NTPFormatTimeUs::format, NTPFormatTimeUs::maxLength, "%H:%M:%S", 6, 0 },
+};
+constexpr size_t NUM_LAYOUT_CASES = sizeof (layoutCases) / sizeof (layoutCases[0]);
+
+/**
+  * @brief Renders what a layout should produce with `strftime()` and `snprintf()`
+  */
+static void renderReference (char* buffer, size_t length, const LayoutCase& layout, const tm& local_tm, long usec) {
+    size_t index = strftime (buffer, length, layout.strftimeFormat, &local_tm);
+    if (layout.fractionDigits == 3) {
+        index += snprintf (buffer + index, length - index, ".%03ld", usec / 1000);
+    } else if (layout.fractionDigits == 6) {
+        index += snprintf (buffer + index, length - index, ".%06ld", usec);
+    }
+    long offset = local_tm.tm_gmtoff;
+    if (layout.offset == 'Z' && offset == 0) {
+        snprintf (buffer + index, length - index, "Z");
+    } else if (layout.offset) {
+        long minutes = (offset < 0 ? -offset : offset) / 60;
+        snprintf (buffer + index, length - index, "%c%02ld:%02ld", offset < 0 ? '-' : '+', minutes / 60, minutes % 60);
+    }
+}
+
+/**
+  * @brief Keeps shortest time of several benchmark rounds
+  * @param best Shortest time so far
+  * @param elapsed Time of this round
+  * @param round Round number. First one is always kept
+  */
+static void keepBest (double* best, double elapsed, unsigned round) {
+    if (!round || elapsed < *best) {
+        *best = elapsed;
+    }
+}
+
+/**
+  * @brief Checks every layout against its reference in several zones and benchmarks RFC 3339 rendering
+  * @return `true` if every string and length matches
+  */
+static bool checkLayouts (int argc, char** argv) {
+    const char* rule = option (argc, argv, "tz", DEFAULT_TEST_TZ);
+    unsigned callsPerSecond = (unsigned)option (argc, argv, "calls_per_s", 1000);
+    unsigned long span = (unsigned long)option (argc, argv, "seconds", 7200);
+    unsigned rounds = (unsigned)option (argc, argv, "rounds", 5);
+    const char* zones[] = { rule, "UTC0", "NST3:30NDT,M3.2.0,M11.1.0" };
+    unsigned long checked = 0;
+    unsigned long mismatches = 0;
+    volatile size_t sink = 0;
+    uint32_t generation = 0;
+    NTPTimeZone zone;
+    NTPLocalTimeCache cache;
+
+    if (!callsPerSecond || !span || !rounds) {
+        return false;
+    }
+    for (const char* zoneRule : zones) {
+        setZone (zoneRule);
+        generation++;
+        // A year in steps of 7 hours and some seconds, so every hour, minute and DST change shows up
+        for (time_t t = TEST_START - 86400 * 90; t < TEST_START + 86400 * 275; t += 7 * 3600 + 1234) {
+            long usec = (long)((t * 7919) % 1000000);
+            tm local_tm;
+            localtime_r (&t, &local_tm);
+            NTPTimeFields_t fields = ntpTimeFields (*cache.localTm (t, zone, generation), usec, t);
+            for (const LayoutCase& layout : layoutCases) {
+                char expected[MAX_TIME_STR_LENGTH];
+                char got[MAX_TIME_STR_LENGTH];
+                renderReference (expected, sizeof (expected), layout, local_tm, usec);
+                size_t expectedLength = strlen (expected);
+                // Complete buffer, exact buffer and truncated ones
+                size_t lengths[] = { sizeof (got), layout.maxLength + 1, expectedLength + 1, expectedLength, 8, 1 };
+                for (size_t length : lengths) {
+                    memset (got, CANARY, sizeof (got));
+                    size_t written = layout.format (got, length, fields);
+                    size_t copied = expectedLength < length ? expectedLength : length - 1;
+                    checked++;
+                    if (written != expectedLength || memcmp (got, expected, copied) || got[copied] != '\0' ||
+                        (length < sizeof (got) && got[length] != CANARY)) {
+                        if (mismatches++ < 5) {
+                            fprintf (stderr, "%s in %s, length %zu: expected \"%s\" got \"%.*s\"\n",
+                                     layout.name, zoneRule, length, expected, (int)copied, got);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Benchmarks, same times for all, as `cache` mode. Loops take turns over `rounds` rounds and best round of each
+    // is kept, so a slow period of host hits all of them alike
+    unsigned long calls = span * callsPerSecond;
+    char buffer[MAX_TIME_STR_LENGTH];
+    timeval moment;
+    double uncached = 0;
+    double cached = 0;
+    double layout = 0;
+    double cachedMiss = 0;
+    double layoutMiss = 0;
+    setZone (rule);
+    generation++;
+    for (unsigned round = 0; round < rounds; round++) {
+        double start = seconds ();
+        for (unsigned long i = 0; i < calls; i++) {
+            moment.tv_sec = TEST_START + i / callsPerSecond;
+            moment.tv_usec = (i % callsPerSecond) * (1000000 / callsPerSecond);
+            sink += renderUncached (buffer, sizeof (buffer), moment, TEST_FORMAT)[20];
+        }
+        keepBest (&uncached, seconds () - start, round);
+        start = seconds ();
+        for (unsigned long i = 0; i < calls; i++) {
+            moment.tv_sec = TEST_START + i / callsPerSecond;
+            moment.tv_usec = (i % callsPerSecond) * (1000000 / callsPerSecond);
+            sink += cache.renderUs (buffer, sizeof (buffer), moment, TEST_FORMAT, true, zone, generation)[20];
+        }
+        keepBest (&cached, seconds () - start, round);
+        start = seconds ();
+        for (unsigned long i = 0; i < calls; i++) {
+            moment.tv_sec = TEST_START + i / callsPerSecond;
+            moment.tv_usec = (i % callsPerSecond) * (1000000 / callsPerSecond);
+            // As NTPClient::getTimeFormatted<NTPFormatRFC3339Us>()
+            sink += NTPFormatRFC3339Us::format (buffer, sizeof (buffer), cache.localFields (moment, zone, generation));
+        }
+        keepBest (&layout, seconds () - start, round);
+        start = seconds ();
+        for (unsigned long i = 0; i < span; i++) { // Every call on a new second, cache always misses
+            moment.tv_sec = TEST_START + i;
+            moment.tv_usec = 0;
+            sink += cache.renderUs (buffer, sizeof (buffer), moment, TEST_FORMAT, true, zone, generation)[20];
+        }
+        keepBest (&cachedMiss, seconds () - start, round);
+        start = seconds ();
+        for (unsigned long i = 0; i < span; i++) {
+            moment.tv_sec = TEST_START + i;
+            moment.tv_usec = 0;
+            sink += NTPFormatRFC3339Us::format (buffer, sizeof (buffer), cache.localFields (moment, zone, generation));
+        }
+        keepBest (&layoutMiss, seconds () - start, round);
+    }
+
+    printf ("layouts:            %zu\n", NUM_LAYOUT_CASES);
+    printf ("checked:            %lu\n", checked);
+    printf ("mismatches:         %lu\n", mismatches);
+    printf ("strftime_calls_s:   %.0f\n", calls / uncached);
+    printf ("datestr_us_calls_s: %.0f\n", calls / cached);
+    printf ("rfc3339us_calls_s:  %.0f\n", calls / layout);
+    printf ("speedup_vs_datestr: %.1f\n", cached / layout);
+    printf ("datestr_us_miss_s:  %.0f\n", span / cachedMiss);
+    printf ("rfc3339us_miss_s:   %.0f\n", span / layoutMiss);
+    printf ("miss_speedup:       %.1f\n", cachedMiss / layoutMiss);
+    return checked && !mismatches && sink != 1;
+}
+
+/**
+  * @brief Renders uptime around 32 bit counter wraps and checks it against `snprintf()`
+  * @return `true` if every string matches
+  */
+static bool checkUptime (int argc, char** argv) {
+    uint64_t step = (uint64_t)(option (argc, argv, "step_ms", 250) * 1000);
+    uint64_t window = (uint64_t)(option (argc, argv, "window_s", 600) * 1000000);
+    const uint64_t wrapUs = 1ULL << 32;
+    const uint64_t wrapMs = (1ULL << 32) * 1000;
+    // Points of interest in microseconds. Formatter keeps state between them, so it also sees jumps back
+    const uint64_t marks[] = {
+        window, // Boot
+        wrapUs, 2 * wrapUs, 3 * wrapUs, // micros() wraps every 71.6 minutes
+        wrapMs, 2 * wrapMs, 3 * wrapMs, 4 * wrapMs, // millis() wraps every 49.7 days
+        wrapUs, // Back in time
+        10000ULL * 86400 * 1000000, // Days part gets one more digit
+        wrapMs * 1000, // 32 bit seconds wrap, 136 years
+    };
+    unsigned long checked = 0;
+    unsigned long mismatches = 0;
+    volatile size_t sink = 0;
+    char expected[TIME_CACHE_STR_LENGTH];
+    NTPUptimeFormatter formatter;
+
+    if (!step || !window) {
+        return false;
+    }
+    for (uint64_t mark : marks) {
+        for (uint64_t us = mark - window; us < mark + window; us += step + checked % 997) {
+            uint64_t uptime = us / 1000000;
+            snprintf (expected, sizeof (expected), "%4lu days %02lu:%02lu:%02lu", (unsigned long)(uptime / 86400),
+                      (unsigned long)(uptime % 86400 / 3600), (unsigned long)(uptime % 3600 / 60), (unsigned long)(uptime % 60));
+            const char* got = formatter.render (us);
+            checked++;
+            if (strcmp (expected, got)) {
+                if (mismatches++ < 5) {
+                    fprintf (stderr, "At %llu us: expected \"%s\" got \"%s\"\n", (unsigned long long)us, expected, got);
+                }
+            }
+        }
+    }
+
+    // One call every millisecond for an hour, with and without formatter
+    const uint64_t calls = 3600000ULL;
+    const uint64_t startUs = 3 * wrapMs - 1800000000ULL;
+    double start = seconds ();
+    for (uint64_t i = 0; i < calls; i++) {
+        uint64_t uptime = (startUs + i * 1000) / 1000000;
+        snprintf (expected, sizeof (expected), "%4lu days %02lu:%02lu:%02lu", (unsigned long)(uptime / 86400),
+                  (unsigned long)(uptime % 86400 / 3600), (unsigned long)(uptime % 3600 / 60), (unsigned long)(uptime % 60));
+        sink += expected[12];
+    }
+    double printed = seconds () - start;
+    start = seconds ();
+    for (uint64_t i = 0; i < calls; i++) {
+        sink += formatter.render (startUs + i * 1000)[12];
+    }
+    double formatted = seconds () - start;
+
+    printf ("checked:            %lu\n", checked);
+    printf ("mismatches:         %lu\n", mismatches);
+    printf ("snprintf_calls_s:   %.0f\n", calls / printed);
+    printf ("formatter_calls_s:  %.0f\n", calls / formatted);
+    printf ("speedup:            %.1f\n", printed / formatted);
+    return checked && !mismatches && sink != 1;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc >= 2 && !strcmp (argv[1], "cache")) {
+        passed = checkCache (argc, argv);
+    } else if (argc >= 2 && !strcmp (argv[1], "threads")) {
+        passed = checkThreads (argc, argv);
+    } else if (argc >= 2 && !strcmp (argv[1], "layouts")) {
+        passed = checkLayouts (argc, argv);
+    } else if (argc >= 2 && !strcmp (argv[1], "uptime")) {
+        passed = checkUptime (argc, argv);
+    } else {
+        fprintf (stderr, "Usage: %s cache|threads|layouts|uptime [key=value...]\n", argv[0]);
+        return 1;
+    }
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
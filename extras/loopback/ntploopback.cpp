@@ -0,0 +1,819 @@
+/**
+  * @file ntploopback.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Stand in NTP server bound to localhost and host build of the client sync path, for integration tests
+  * without Wi-Fi or pool servers. Server faults are scriptable. Client runs `NTPCore` decode, checks and
+  * `NTPSyncFilter` over real UDP sockets and measures exchanges per second and clock accuracy.
+  *
+  * Build on Linux:
+  *
+  *     g++ -std=c++11 -O2 -pthread -I../../src ntploopback.cpp ../../src/NTPCore.cpp -o ntploopback
+  *
+  * Run server only, to point other clients to it:
+  *
+  *     ./ntploopback server port=12300 delay_ms=20 jitter_ms=5
+  *
+  * Run server in process and benchmark client against it. `connect=PORT` uses an external server instead,
+  * at `host=ADDRESS`, 127.0.0.1 by default:
+  *
+  *     ./ntploopback bench exchanges=100000
+  *     ./ntploopback bench exchanges=300 timeout_ms=200 script=faults.txt
+  *     ./ntploopback bench connect=123 host=::1
+  *
+  * Check a dual stack server, as the library opens with `IPADDR_TYPE_ANY`, answers IPv4 and IPv6 clients
+  * through one socket. Server binds to any address in this mode. Exit status is 0 if both clients sync:
+  *
+  *     ./ntploopback dualstack exchanges=1000
+  *
+  * Load a server, like a device running `beginServer()`, with requests at a fixed rate and measure answers and
+  * latency. Without `connect=PORT` the in process server is loaded:
+  *
+  *     ./ntploopback load host=192.168.1.50 connect=123 rate=200 duration_s=30
+  *
+  * Script files have one phase per line: number of requests followed by `key=value` server options. Options
+  * not set in a phase take command line values. Last phase repeats. Lines starting with `#` are comments:
+  *
+  *     # 50 good answers, 10 dropped, 5 unsynced server, 5 rate limit kiss of death
+  *     50
+  *     10 drop=1
+  *     5 li=3
+  *     5 kod=RATE
+  *
+  * Server options: `delay_ms`, `jitter_ms`, `asym`, `drop`, `li`, `stratum`, `version`, `mode`, `precision`,
+  * `dispersion_ms`, `offset_ms`, `kod`. Client options: `exchanges`, `boot_s`, `rounds`, `accuracy_us`,
+  * `threshold_us`, `retries`, `timeout_ms`. Load options: `rate`, `duration_s`, `timeout_ms`.
+  */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // ppoll
+#endif
+#include "NTPCore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+constexpr uint16_t LOOPBACK_DEFAULT_PORT = 12300; ///< @brief Default server port. 123 needs privileges
+
+/**
+  * @brief Server behaviour for a number of requests
+  */
+struct ServerPhase {
+    uint32_t requests = 0; ///< @brief Requests this phase lasts. 0 means forever
+    double delayMs = 0; ///< @brief Base round trip delay added by server
+    double jitterMs = 0; ///< @brief Mean of exponential extra delay on each direction
+    double asym = 0; ///< @brief Fraction of delay moved to upstream direction, -1 to 1
+    double drop = 0; ///< @brief Probability of not answering
+    int li = 0; ///< @brief Leap indicator
+    int stratum = 2; ///< @brief Stratum
+    int version = 4; ///< @brief NTP version
+    int mode = 4; ///< @brief NTP mode
+    int precision = -20; ///< @brief Precision, log2 seconds
+    double dispersionMs = 1; ///< @brief Root dispersion
+    double offsetMs = 0; ///< @brief Server clock error
+    char kod[5] = ""; ///< @brief Kiss of death code. Empty for normal answers
+};
+
+/**
+  * @brief Client settings and results
+  */
+struct ClientBench {
+    uint32_t exchanges = 10000; ///< @brief Requests to send
+    double bootS = 5; ///< @brief Initial client clock, seconds since epoch, as a device that just booted
+    NTPSyncConfig_t config; ///< @brief Sync filter settings
+    
+    uint32_t responses = 0; ///< @brief Responses received
+    uint32_t timeouts = 0; ///< @brief Requests without response in time
+    uint32_t steps = 0; ///< @brief Clock adjustments
+    uint32_t actions[syncApply + 1] = { 0 }; ///< @brief Filter decisions by `NTPSyncAction_t`
+    uint32_t rejected[NUM_REJECT_REASONS] = { 0 }; ///< @brief Rejected responses by reason
+    double seconds = 0; ///< @brief Benchmark duration
+    double delaySumUs = 0; ///< @brief Sum of measured round trip delays
+    double errorSumUs = 0; ///< @brief Sum of absolute clock error after first sync
+    double maxErrorUs = 0; ///< @brief Maximum absolute clock error after first sync
+    uint32_t errorCount = 0; ///< @brief Error samples after first sync
+    int64_t finalErrorUs = 0; ///< @brief Clock error at end
+};
+
+/**
+  * @brief Load test settings and results
+  */
+struct LoadTest {
+    double rate = 100; ///< @brief Requests per second
+    double durationS = 10; ///< @brief Time sending requests
+    uint16_t timeoutMs = 1000; ///< @brief Time answers are waited for after last request
+    
+    uint32_t sent = 0; ///< @brief Requests sent
+    uint32_t answered = 0; ///< @brief Matching answers
+    uint32_t unsynced = 0; ///< @brief Answers with leap indicator 3, server not synchronized
+    uint32_t kissOfDeath = 0; ///< @brief Answers with stratum 0
+    uint32_t duplicates = 0; ///< @brief Answers to a request already answered
+    uint32_t stratumSeen = 0; ///< @brief Stratum of last synchronized answer
+    double seconds = 0; ///< @brief Time sending requests, measured
+    std::vector<double> latencyUs; ///< @brief Round trip time of every answer
+};
+
+/**
+  * @brief Gets wall clock time in microseconds. Taken as true time
+  */
+static int64_t nowUs () {
+    timespec ts;
+    clock_gettime (CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+  * @brief Converts microseconds to `timeval`
+  */
+static timeval toTimeval (int64_t us) {
+    timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return tv;
+}
+
+/**
+  * @brief Sets a server option from `key=value` text
+  * @return `false` if option is not a server option
+  */
+static bool setServerOption (ServerPhase& p, const char* option) {
+    const char* equal = strchr (option, '=');
+    if (!equal) {
+        return false;
+    }
+    std::string key (option, equal - option);
+    const char* value = equal + 1;
+    if (key == "delay_ms") p.delayMs = atof (value);
+    else if (key == "jitter_ms") p.jitterMs = atof (value);
+    else if (key == "asym") p.asym = atof (value);
+    else if (key == "drop") p.drop = atof (value);
+    else if (key == "li") p.li = atoi (value);
+    else if (key == "stratum") p.stratum = atoi (value);
+    else if (key == "version") p.version = atoi (value);
+    else if (key == "mode") p.mode = atoi (value);
+    else if (key == "precision") p.precision = atoi (value);
+    else if (key == "dispersion_ms") p.dispersionMs = atof (value);
+    else if (key == "offset_ms") p.offsetMs = atof (value);
+    else if (key == "kod") strncpy (p.kod, value, sizeof (p.kod) - 1);
+    else return false;
+    return true;
+}
+
+/**
+  * @brief Sets a client option from `key=value` text
+  * @return `false` if option is not a client option
+  */
+static bool setClientOption (ClientBench& c, const char* option) {
+    const char* equal = strchr (option, '=');
+    if (!equal) {
+        return false;
+    }
+    std::string key (option, equal - option);
+    double value = atof (equal + 1);
+    if (key == "exchanges") c.exchanges = (uint32_t)value;
+    else if (key == "boot_s") c.bootS = value;
+    else if (key == "rounds") c.config.numAveRounds = (unsigned int)value;
+    else if (key == "accuracy_us") c.config.minSyncAccuracyUs = (long)value;
+    else if (key == "threshold_us") c.config.timeSyncThreshold = (long)value;
+    else if (key == "retries") c.config.maxNumSyncRetry = (unsigned int)value;
+    else if (key == "timeout_ms") c.config.ntpTimeout = (uint16_t)value;
+    else return false;
+    return true;
+}
+
+/**
+  * @brief Sets a load test option from `key=value` text
+  * @return `false` if option is not a load option
+  */
+static bool setLoadOption (LoadTest& l, const char* option) {
+    const char* equal = strchr (option, '=');
+    if (!equal) {
+        return false;
+    }
+    std::string key (option, equal - option);
+    double value = atof (equal + 1);
+    if (key == "rate") l.rate = value;
+    else if (key == "duration_s") l.durationS = value;
+    else if (key == "timeout_ms") l.timeoutMs = (uint16_t)value;
+    else return false;
+    return true;
+}
+
+/**
+  * @brief Loads phases from a script file
+  * @param path File name
+  * @param base Settings for options a phase does not set
+  * @param phases Output phases
+  * @return `false` if file could not be read or has unknown options
+  */
+static bool loadScript (const char* path, const ServerPhase& base, std::vector<ServerPhase>& phases) {
+    FILE* file = fopen (path, "r");
+    char line[256];
+    
+    if (!file) {
+        fprintf (stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    while (fgets (line, sizeof (line), file)) {
+        char* token = strtok (line, " \t\r\n");
+        if (!token || token[0] == '#') {
+            continue;
+        }
+        ServerPhase phase = base;
+        phase.requests = strtoul (token, NULL, 10);
+        while ((token = strtok (NULL, " \t\r\n"))) {
+            if (!setServerOption (phase, token)) {
+                fprintf (stderr, "Unknown script option %s\n", token);
+                fclose (file);
+                return false;
+            }
+        }
+        phases.push_back (phase);
+    }
+    fclose (file);
+    return !phases.empty ();
+}
+
+/**
+  * @brief Scriptable NTP server. Answers are held in a queue until their delay expires, so delays do not
+  * limit throughput
+  */
+class LoopbackServer {
+public:
+    /**
+      * @brief Binds server socket to localhost
+      * @param port UDP port. 0 to get any free port
+      * @param dualStack Bind an IPv6 socket to any address that takes IPv4 clients too, as mapped addresses
+      * @return `false` on socket error
+      */
+    bool begin (uint16_t port, bool dualStack = false) {
+        sockaddr_storage address;
+        socklen_t length = sizeof (address);
+        
+        memset (&address, 0, sizeof (address));
+        if (dualStack) {
+            sockaddr_in6* address6 = (sockaddr_in6*)&address;
+            int v6only = 0;
+            sock = socket (AF_INET6, SOCK_DGRAM, 0);
+            if (sock < 0 || setsockopt (sock, IPPROTO_IPV6, IPV6_V6ONLY, &v6only, sizeof (v6only)) < 0) {
+                return false;
+            }
+            address6->sin6_family = AF_INET6;
+            address6->sin6_addr = in6addr_any;
+            address6->sin6_port = htons (port);
+        } else {
+            sockaddr_in* address4 = (sockaddr_in*)&address;
+            sock = socket (AF_INET, SOCK_DGRAM, 0);
+            if (sock < 0) {
+                return false;
+            }
+            address4->sin_family = AF_INET;
+            address4->sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+            address4->sin_port = htons (port);
+        }
+        if (bind (sock, (sockaddr*)&address, dualStack ? sizeof (sockaddr_in6) : sizeof (sockaddr_in)) < 0
+            || getsockname (sock, (sockaddr*)&address, &length) < 0) {
+            close (sock);
+            sock = -1;
+            return false;
+        }
+        this->port = ntohs (dualStack ? ((sockaddr_in6*)&address)->sin6_port : ((sockaddr_in*)&address)->sin_port);
+        return true;
+    }
+
+    /**
+      * @brief Serves requests until `stop()` is called
+      * @param phases Behaviour script. Last phase repeats
+      */
+    void run (const std::vector<ServerPhase>& phases) {
+        std::mt19937_64 random (1);
+        std::uniform_real_distribution<double> uniform (0.0, 1.0);
+        std::exponential_distribution<double> exponential (1.0);
+        size_t phaseIndex = 0;
+        uint32_t phaseCount = 0;
+        
+        while (!stopped) {
+            int64_t now = nowUs ();
+            int64_t wait = 100000;
+            if (!pending.empty ()) {
+                wait = pending.front ().sendUs - now;
+                wait = wait < 0 ? 0 : (wait < 100000 ? wait : 100000);
+            }
+            // Microsecond timeout. Millisecond poll would add hidden downstream delay after transmit timestamp
+            timespec timeout = { 0, (long)wait * 1000 };
+            pollfd fd = { sock, POLLIN, 0 };
+            if (ppoll (&fd, 1, &timeout, NULL) > 0) {
+                Pending request;
+                request.clientLength = sizeof (request.client);
+                ssize_t size = recvfrom (sock, &request.packet, sizeof (request.packet), 0, (sockaddr*)&request.client, &request.clientLength);
+                if (size >= NTP_PACKET_SIZE) {
+                    const sockaddr_in6* client6 = (const sockaddr_in6*)&request.client;
+                    if (request.client.ss_family == AF_INET6 && !IN6_IS_ADDR_V4MAPPED (&client6->sin6_addr)) {
+                        requestsIPv6++;
+                    }
+                    const ServerPhase& phase = phases[phaseIndex];
+                    if (phase.requests && ++phaseCount >= phase.requests && phaseIndex + 1 < phases.size ()) {
+                        phaseIndex++;
+                        phaseCount = 0;
+                    }
+                    requests++;
+                    if (uniform (random) < phase.drop) {
+                        dropped++;
+                    } else {
+                        int64_t up = (int64_t)(phase.delayMs * 500.0 * (1.0 + phase.asym) + phase.jitterMs * 1000.0 * exponential (random));
+                        int64_t down = (int64_t)(phase.delayMs * 500.0 * (1.0 - phase.asym) + phase.jitterMs * 1000.0 * exponential (random));
+                        // Request is taken as received `up` later. Answer leaves `down` after transmit timestamp
+                        int64_t received = nowUs () + up;
+                        reply (phase, request.packet, received);
+                        request.sendUs = received + 20 + down;
+                        insert (request);
+                    }
+                }
+            }
+            now = nowUs ();
+            while (!pending.empty () && pending.front ().sendUs <= now) {
+                sendto (sock, &pending.front ().packet, NTP_PACKET_SIZE, 0, (sockaddr*)&pending.front ().client, pending.front ().clientLength);
+                pending.erase (pending.begin ());
+            }
+        }
+        close (sock);
+    }
+
+    /// @brief Makes `run()` return
+    void stop () {
+        stopped = true;
+    }
+
+    uint16_t port = 0; ///< @brief Bound port
+    std::atomic<uint32_t> requests { 0 }; ///< @brief Requests received
+    std::atomic<uint32_t> dropped { 0 }; ///< @brief Requests not answered on purpose
+    std::atomic<uint32_t> requestsIPv6 { 0 }; ///< @brief Requests from native IPv6 clients, not IPv4 mapped ones
+
+protected:
+    /**
+      * @brief Answer waiting for its send time
+      */
+    struct Pending {
+        int64_t sendUs; ///< @brief Wall clock time to send answer
+        sockaddr_storage client; ///< @brief Client address, IPv4 or IPv6
+        socklen_t clientLength; ///< @brief Length of `client`
+        NTPUndecodedPacket_t packet; ///< @brief Request, replaced by answer
+    };
+
+    int sock = -1; ///< @brief Server socket
+    std::atomic<bool> stopped { false }; ///< @brief Stop requested
+    std::vector<Pending> pending; ///< @brief Answers sorted by send time
+
+    /// @brief Adds an answer keeping send time order
+    void insert (const Pending& request) {
+        auto position = pending.end ();
+        while (position != pending.begin () && (position - 1)->sendUs > request.sendUs) {
+            position--;
+        }
+        pending.insert (position, request);
+    }
+
+    /**
+      * @brief Builds answer in place of request
+      * @param phase Server behaviour
+      * @param packet Request, overwritten with answer
+      * @param receivedUs Wall clock time request is taken as received
+      */
+    static void reply (const ServerPhase& phase, NTPUndecodedPacket_t& packet, int64_t receivedUs) {
+        int64_t serverUs = receivedUs + (int64_t)(phase.offsetMs * 1000);
+        timeval received = toTimeval (serverUs);
+        timeval transmitted = toTimeval (serverUs + 20);
+        timeval reference = toTimeval (serverUs - 60000000);
+        timestamp64_t origin = packet.transmit;
+        
+        memset (&packet, 0, sizeof (packet));
+        packet.flags = (phase.li << 6) | ((phase.version & 0x07) << 3) | (phase.mode & 0x07);
+        packet.peerStratum = phase.kod[0] ? 0 : phase.stratum;
+        packet.pollingInterval = 6;
+        packet.clockPrecission = phase.precision;
+        packet.rootDelay = seconds2timestamp32 (0.01);
+        packet.dispersion = seconds2timestamp32 (phase.dispersionMs / 1000.0);
+        if (phase.kod[0]) {
+            memcpy (packet.refID, phase.kod, 4);
+        } else {
+            memcpy (packet.refID, "LOOP", 4);
+        }
+        packet.reference = timeval2timestamp64 (&reference);
+        packet.origin = origin;
+        packet.receive = timeval2timestamp64 (&received);
+        packet.transmit = timeval2timestamp64 (&transmitted);
+    }
+};
+
+/**
+  * @brief Opens a UDP socket connected to a server
+  * @param host Server numeric address, IPv4 or IPv6
+  * @param port Server port
+  * @return Socket or -1 on error
+  */
+static int connectClient (const char* host, uint16_t port) {
+    addrinfo hints;
+    addrinfo* server;
+    char service[8];
+    
+    memset (&hints, 0, sizeof (hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = AI_NUMERICHOST | AI_NUMERICSERV;
+    snprintf (service, sizeof (service), "%u", port);
+    if (getaddrinfo (host, service, &hints, &server)) {
+        fprintf (stderr, "Invalid address %s\n", host);
+        return -1;
+    }
+    int sock = socket (server->ai_family, SOCK_DGRAM, 0);
+    if (sock >= 0 && connect (sock, server->ai_addr, server->ai_addrlen) < 0) {
+        close (sock);
+        sock = -1;
+    }
+    freeaddrinfo (server);
+    return sock;
+}
+
+/**
+  * @brief Runs client sync path against a server. Requests are sent back to back, without waiting for the
+  * interval the filter asks for, so the whole decode, check, filter and adjust path is measured
+  * @param bench Settings and results
+  * @param host Server numeric address, IPv4 or IPv6
+  * @param port Server port
+  * @return `false` on socket error
+  */
+static bool runClient (ClientBench& bench, const char* host, uint16_t port) {
+    NTPSyncFilter filter;
+    NTPStatus_t status = unsyncd;
+    int64_t correction = (int64_t)(bench.bootS * 1e6) - nowUs (); // Client clock minus true time
+    bool synced = false;
+    
+    int sock = connectClient (host, port);
+    if (sock < 0) {
+        return false;
+    }
+    
+    int64_t start = nowUs ();
+    for (uint32_t i = 0; i < bench.exchanges; i++) {
+        NTPUndecodedPacket_t request;
+        memset (&request, 0, sizeof (request));
+        request.flags = 0b11100011;
+        request.pollingInterval = 6;
+        request.clockPrecission = 0xEC;
+        timeval sent = toTimeval (nowUs () + correction);
+        request.transmit = timeval2timestamp64 (&sent);
+        send (sock, &request, NTP_PACKET_SIZE, 0);
+        
+        // Wait for the answer to this request. Late answers to older ones are discarded
+        uint8_t buffer[NTP_PACKET_SIZE * 2];
+        ssize_t size = -1;
+        timeval destination;
+        int64_t deadline = nowUs () + bench.config.ntpTimeout * 1000LL;
+        for (;;) {
+            int64_t remaining = deadline - nowUs ();
+            pollfd fd = { sock, POLLIN, 0 };
+            if (remaining <= 0 || poll (&fd, 1, (int)((remaining + 999) / 1000)) <= 0) {
+                size = -1;
+                break;
+            }
+            size = recv (sock, buffer, sizeof (buffer), 0);
+            destination = toTimeval (nowUs () + correction);
+            if (size >= 32 && !memcmp (buffer + 24, &request.transmit, sizeof (request.transmit))) {
+                break;
+            }
+        }
+        if (size < 0) {
+            bench.timeouts++;
+            continue;
+        }
+        bench.responses++;
+        
+        NTPPacket_t packet;
+        double offset, delay;
+        if (size < NTP_PACKET_SIZE || !ntpDecodePacket (buffer, size, &destination, &packet)) {
+            bench.rejected[size < NTP_PACKET_SIZE ? rejectShortPacket : rejectDecode]++;
+            continue;
+        }
+        ntpCalculateOffset (&packet, &offset, &delay);
+        bench.delaySumUs += delay * 1e6;
+        // Same conversion as NTPClient::calculateOffset
+        timeval tvOffset;
+        tvOffset.tv_sec = (time_t)offset;
+        tvOffset.tv_usec = (offset - (double)tvOffset.tv_sec) * 1000000.0;
+        int64_t offsetUs = (int64_t)tvOffset.tv_sec * 1000000L + (int64_t)tvOffset.tv_usec;
+        
+        NTPSyncDecision_t decision = filter.processSample (packet, offsetUs, status, bench.config);
+        bench.actions[decision.action]++;
+        status = decision.status;
+        if (decision.action == syncRejected || decision.action == syncAccuracyError) {
+            bench.rejected[decision.reason]++;
+        }
+        if (decision.action == syncApply) {
+            correction += decision.offsetUs;
+            bench.steps++;
+        }
+        if (status == syncd) {
+            synced = true;
+        }
+        if (synced) {
+            double error = fabs ((double)correction);
+            bench.errorSumUs += error;
+            bench.errorCount++;
+            if (error > bench.maxErrorUs) {
+                bench.maxErrorUs = error;
+            }
+        }
+    }
+    bench.seconds = (nowUs () - start) / 1e6;
+    bench.finalErrorUs = correction;
+    close (sock);
+    return true;
+}
+
+/**
+  * @brief Sends requests at a fixed rate and collects answers. Request number goes in transmit timestamp, which
+  * servers echo as origin, so every answer is matched without keeping per request state on the wire
+  * @param load Settings and results
+  * @param host Server numeric address, IPv4 or IPv6
+  * @param port Server port
+  * @return `false` on socket error
+  */
+static bool runLoad (LoadTest& load, const char* host, uint16_t port) {
+    uint32_t total = (uint32_t)(load.rate * load.durationS);
+    std::vector<int64_t> sentUs (total, 0);
+    std::vector<bool> answered (total, false);
+    
+    int sock = connectClient (host, port);
+    if (sock < 0 || !total) {
+        return false;
+    }
+    int64_t start = nowUs ();
+    int64_t end = start + (int64_t)(load.durationS * 1e6) + load.timeoutMs * 1000LL;
+    for (;;) {
+        int64_t now = nowUs ();
+        while (load.sent < total && start + (int64_t)(load.sent * 1e6 / load.rate) <= now) {
+            NTPUndecodedPacket_t request;
+            memset (&request, 0, sizeof (request));
+            request.flags = 0b11100011;
+            request.pollingInterval = 6;
+            request.clockPrecission = 0xEC;
+            request.transmit.secondsOffset = htonl (load.sent);
+            request.transmit.fraction = htonl (0x4C4F4144); // Marks load test requests
+            sentUs[load.sent] = now;
+            send (sock, &request, NTP_PACKET_SIZE, 0);
+            load.sent++;
+        }
+        if (load.sent == total && load.answered + load.duplicates >= total) {
+            break; // Everything answered, do not wait for timeout
+        }
+        int64_t wait = load.sent < total ? start + (int64_t)(load.sent * 1e6 / load.rate) - now : end - now;
+        if (wait < 0 || now >= end) {
+            if (now >= end) {
+                break;
+            }
+            wait = 0;
+        }
+        timespec timeout = { (time_t)(wait / 1000000), (long)(wait % 1000000) * 1000 };
+        pollfd fd = { sock, POLLIN, 0 };
+        if (ppoll (&fd, 1, &timeout, NULL) <= 0) {
+            continue;
+        }
+        NTPUndecodedPacket_t answer;
+        ssize_t size = recv (sock, &answer, sizeof (answer), 0);
+        int64_t received = nowUs ();
+        uint32_t index = ntohl (answer.origin.secondsOffset);
+        if (size < NTP_PACKET_SIZE || answer.origin.fraction != htonl (0x4C4F4144) || index >= load.sent) {
+            continue;
+        }
+        if (answered[index]) {
+            load.duplicates++;
+            continue;
+        }
+        answered[index] = true;
+        load.answered++;
+        load.latencyUs.push_back ((double)(received - sentUs[index]));
+        if (answer.peerStratum == 0) {
+            load.kissOfDeath++;
+        } else if (answer.flags >> 6 == 3) {
+            load.unsynced++;
+        } else {
+            load.stratumSeen = answer.peerStratum;
+        }
+    }
+    load.seconds = (sentUs[load.sent - 1] - start) / 1e6;
+    close (sock);
+    return true;
+}
+
+/**
+  * @brief Prints load test results
+  */
+static void printLoad (LoadTest& l) {
+    std::vector<double>& latency = l.latencyUs;
+    std::sort (latency.begin (), latency.end ());
+    double sum = 0;
+    for (double value : latency) {
+        sum += value;
+    }
+    auto percentile = [&latency] (double p) {
+        return latency.empty () ? -1.0 : latency[(size_t)(p * (latency.size () - 1))];
+    };
+    
+    printf ("requests_sent:      %u\n", l.sent);
+    printf ("send_rate_per_s:    %.1f\n", l.seconds > 0 ? (l.sent - 1) / l.seconds : 0.0);
+    printf ("answered:           %u\n", l.answered);
+    printf ("lost:               %u\n", l.sent - l.answered);
+    printf ("loss_percent:       %.2f\n", l.sent ? 100.0 * (l.sent - l.answered) / l.sent : 0.0);
+    printf ("duplicates:         %u\n", l.duplicates);
+    printf ("kiss_of_death:      %u\n", l.kissOfDeath);
+    printf ("unsynced_answers:   %u\n", l.unsynced);
+    printf ("stratum:            %u\n", l.stratumSeen);
+    printf ("latency_mean_us:    %.1f\n", latency.empty () ? -1.0 : sum / latency.size ());
+    printf ("latency_p50_us:     %.1f\n", percentile (0.5));
+    printf ("latency_p99_us:     %.1f\n", percentile (0.99));
+    printf ("latency_max_us:     %.1f\n", latency.empty () ? -1.0 : latency.back ());
+}
+
+/**
+  * @brief Prints benchmark results
+  */
+static void printBench (const ClientBench& b) {
+    static const char* actionNames[] = { "averaging", "skipped", "converged", "rejected", "accuracyError", "apply" };
+    static const char* reasonNames[] = { "short", "decode", "leap", "version", "mode", "stratum", "precision", "dispersion" };
+    
+    printf ("exchanges:          %u\n", b.exchanges);
+    printf ("seconds:            %.3f\n", b.seconds);
+    printf ("exchanges_per_s:    %.0f\n", b.exchanges / b.seconds);
+    printf ("responses:          %u\n", b.responses);
+    printf ("timeouts:           %u\n", b.timeouts);
+    printf ("mean_delay_us:      %.1f\n", b.responses ? b.delaySumUs / b.responses : 0.0);
+    printf ("steps:              %u\n", b.steps);
+    printf ("mean_abs_error_us:  %.1f\n", b.errorCount ? b.errorSumUs / b.errorCount : -1.0);
+    printf ("max_abs_error_us:   %.1f\n", b.errorCount ? b.maxErrorUs : -1.0);
+    printf ("final_error_us:     %lld\n", (long long)b.finalErrorUs);
+    for (int i = 0; i <= syncApply; i++) {
+        printf ("action_%-12s %u\n", actionNames[i], b.actions[i]);
+    }
+    for (int i = 0; i < NUM_REJECT_REASONS; i++) {
+        if (b.rejected[i]) {
+            printf ("rejected_%-10s %u\n", reasonNames[i], b.rejected[i]);
+        }
+    }
+}
+
+int main (int argc, char** argv) {
+    ServerPhase base;
+    ClientBench bench;
+    LoadTest load;
+    std::vector<ServerPhase> phases;
+    const char* script = NULL;
+    const char* host = "127.0.0.1";
+    uint16_t port = LOOPBACK_DEFAULT_PORT;
+    uint16_t connectPort = 0;
+    bool serverOnly;
+    bool dualStack;
+    bool loadMode;
+    
+    if (argc < 2 || (strcmp (argv[1], "server") && strcmp (argv[1], "bench") && strcmp (argv[1], "dualstack")
+                     && strcmp (argv[1], "load"))) {
+        fprintf (stderr, "Usage: %s server|bench|dualstack|load [key=value...]\n", argv[0]);
+        return 1;
+    }
+    serverOnly = !strcmp (argv[1], "server");
+    dualStack = !strcmp (argv[1], "dualstack");
+    loadMode = !strcmp (argv[1], "load");
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], "script=", 7)) {
+            script = argv[i] + 7;
+        } else if (!strncmp (argv[i], "host=", 5)) {
+            host = argv[i] + 5;
+        } else if (!strncmp (argv[i], "port=", 5)) {
+            port = atoi (argv[i] + 5);
+        } else if (!strncmp (argv[i], "connect=", 8)) {
+            connectPort = atoi (argv[i] + 8);
+        } else if (loadMode && setLoadOption (load, argv[i])) {
+            continue;
+        } else if (!setServerOption (base, argv[i]) && !setClientOption (bench, argv[i])) {
+            fprintf (stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (script) {
+        if (!loadScript (script, base, phases)) {
+            return 1;
+        }
+    } else {
+        phases.push_back (base);
+    }
+    
+    if (serverOnly) {
+        LoopbackServer server;
+        if (!server.begin (port)) {
+            perror ("Server socket");
+            return 1;
+        }
+        printf ("Serving on 127.0.0.1:%u\n", server.port);
+        server.run (phases);
+        return 0;
+    }
+    
+    if (loadMode) {
+        LoopbackServer server;
+        std::thread serverThread;
+        if (!connectPort) {
+            if (!server.begin (0)) {
+                perror ("Server socket");
+                return 1;
+            }
+            serverThread = std::thread ([&] { server.run (phases); });
+        }
+        bool ok = runLoad (load, host, connectPort ? connectPort : server.port);
+        if (!connectPort) {
+            server.stop ();
+            serverThread.join ();
+        }
+        if (!ok) {
+            perror ("Client socket");
+            return 1;
+        }
+        printLoad (load);
+        return 0;
+    }
+    
+    if (connectPort) {
+        if (!runClient (bench, host, connectPort)) {
+            perror ("Client socket");
+            return 1;
+        }
+        printBench (bench);
+        return 0;
+    }
+    
+    if (dualStack) {
+        LoopbackServer server;
+        const char* hosts[] = { "127.0.0.1", "::1" };
+        bool passed = true;
+        if (!server.begin (0, true)) {
+            perror ("Dual stack server socket");
+            return 1;
+        }
+        std::thread serverThread ([&] { server.run (phases); });
+        for (const char* clientHost : hosts) {
+            ClientBench client = bench;
+            printf ("# client %s\n", clientHost);
+            if (!runClient (client, clientHost, server.port)) {
+                perror ("Client socket");
+                passed = false;
+                continue;
+            }
+            printBench (client);
+            if (!client.responses || !client.actions[syncApply] || client.maxErrorUs > 1000) {
+                passed = false;
+            }
+        }
+        server.stop ();
+        serverThread.join ();
+        uint32_t requests = server.requests.load ();
+        uint32_t requestsIPv6 = server.requestsIPv6.load ();
+        printf ("server_requests_v4: %u\n", requests - requestsIPv6);
+        printf ("server_requests_v6: %u\n", requestsIPv6);
+        if (!requestsIPv6 || requestsIPv6 == requests) {
+            passed = false;
+        }
+        printf ("%s\n", passed ? "PASS" : "FAIL");
+        return passed ? 0 : 1;
+    }
+    
+    LoopbackServer server;
+    if (!server.begin (0)) {
+        perror ("Server socket");
+        return 1;
+    }
+    std::thread serverThread ([&] { server.run (phases); });
+    bool ok = runClient (bench, host, server.port);
+    server.stop ();
+    serverThread.join ();
+    if (!ok) {
+        perror ("Client socket");
+        return 1;
+    }
+    printBench (bench);
+    printf ("server_requests:    %u\n", server.requests.load ());
+    printf ("server_dropped:     %u\n", server.dropped.load ());
+    return 0;
+}
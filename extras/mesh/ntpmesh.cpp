@@ -0,0 +1,434 @@
+/**
+  * @file ntpmesh.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Simulator of a mesh of devices sharing time in symmetric peer mode. Every node runs `NTPSyncFilter` and
+  * packet coding from `NTPCore` with the same peer selection, reply contents and upstream failure accounting
+  * `NTPClient` uses. Only gateway nodes reach an upstream server.
+  *
+  * Build on host:
+  *
+  *     g++ -std=c++11 -O2 -I../../src ntpmesh.cpp ../../src/NTPCore.cpp -o ntpmesh
+  *
+  * Run with `key=value` options:
+  *
+  *     ./ntpmesh nodes=10 gateways=0,5 unsynced=0 hours=12
+  *
+  * Each node peers with the nodes up to two positions away on a ring, as many as `MAX_NTP_PEERS` allows.
+  * `unsynced=LIST` makes the upstream server of those gateways answer with leap indicator 3. They must give up
+  * that server and follow their peers. `reset_before_checks=1` resets upstream failure count on any reply, before
+  * checks, to compare with former behaviour.
+  *
+  * Exit status is 0 if every node is synchronized and within `max_error_us` of true time at the end.
+  */
+
+#include "NTPCore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+constexpr auto MESH_MAX_PEERS = 4; ///< @brief Same as `MAX_NTP_PEERS` in library
+constexpr auto MESH_NUM_TIMEOUTS = 3; ///< @brief Same as `DEAULT_NUM_TIMEOUTS` in library
+constexpr double MESH_CLOCK_PHI = 15e-6; ///< @brief Same as `NTP_CLOCK_PHI` in library
+constexpr int64_t TICK_US = 100000; ///< @brief Loop and receiver task period on ESP32
+constexpr int64_t SAMPLE_PERIOD_US = 10000000; ///< @brief Clock error sampling period
+constexpr int64_t REFERENCE_EPOCH_US = 1760000000LL * 1000000; ///< @brief True UNIX time at simulation start
+
+/**
+  * @brief Sample origin, as `NTPSampleSource_t` in library
+  */
+enum SampleSource {
+    unicastSample, ///< @brief Response from upstream server
+    peerSample ///< @brief Symmetric mode response from a peer
+};
+
+/**
+  * @brief Mesh settings
+  */
+struct Mesh {
+    unsigned nodes = 10; ///< @brief Number of devices
+    std::vector<bool> gateway; ///< @brief Nodes that reach upstream server
+    std::vector<bool> unsynced; ///< @brief Gateways whose upstream server answers with leap indicator 3
+    double hours = 12; ///< @brief Simulated time
+    uint64_t seed = 1; ///< @brief Random seed
+    double driftPpm = 20; ///< @brief Maximum oscillator frequency error of a node
+    double lanDelayMs = 2; ///< @brief Round trip delay between nodes
+    double wanDelayMs = 20; ///< @brief Round trip delay to upstream server
+    double jitterMs = 0.5; ///< @brief Mean of exponential extra delay on each direction
+    double maxErrorUs = 50000; ///< @brief Largest clock error accepted at the end. 20 ppm drift is 36 ms in a long interval
+    bool resetBeforeChecks = false; ///< @brief Reset upstream failures on any reply, as before checks were required
+    NTPSyncConfig_t config; ///< @brief Sync filter settings of every node
+};
+
+/**
+  * @brief Peer status, as `NTPPeer_t` in library
+  */
+struct Peer {
+    unsigned node; ///< @brief Peer node index
+    uint8_t stratum = 16; ///< @brief Last stratum announced by peer
+    float rootDistance = 16; ///< @brief Peer root distance plus half round trip delay
+    int64_t lastResponse = 0; ///< @brief Monotonic milliseconds of last response
+    bool everAnswered = false; ///< @brief `lastResponse` is valid
+};
+
+/**
+  * @brief Simulated device
+  */
+struct Node {
+    double frequency = 0; ///< @brief Oscillator frequency error
+    int64_t clockBase = 0; ///< @brief System time minus monotonic time
+    NTPSyncFilter filter; ///< @brief Sync filter
+    NTPStatus_t status = unsyncd; ///< @brief Sync status
+    bool upstreamValid = false; ///< @brief Snapshot of last applied sample is valid, as `NTPUpstream_t`
+    uint8_t upstreamStratum = 16; ///< @brief Stratum of last applied sample source
+    float rootDelay = 0; ///< @brief Root delay through last applied sample source
+    float rootDispersion = 0; ///< @brief Root dispersion of last applied sample source
+    int64_t reference = 0; ///< @brief System time when last sample was applied
+    unsigned upstreamFailures = 0; ///< @brief Consecutive failed requests to upstream server
+    unsigned numTimeouts = 0; ///< @brief Consecutive timeouts, for interval reset
+    uint32_t actualInterval; ///< @brief Current request interval
+    int64_t lastGotTime = 0; ///< @brief Monotonic milliseconds of last request
+    bool firstLoop = true; ///< @brief No request sent yet
+    std::vector<Peer> peers; ///< @brief Configured peers
+    double syncedAtS = -1; ///< @brief True time when node was first synchronized
+    uint32_t peerSamples = 0; ///< @brief Samples taken from peers
+    uint32_t peerReplies = 0; ///< @brief Peer replies processed
+
+    int64_t monotonic (int64_t trueUs) const {
+        return (int64_t)(trueUs * (1.0 + frequency));
+    }
+    int64_t systemTime (int64_t trueUs) const {
+        return monotonic (trueUs) + clockBase;
+    }
+    bool synchronized () const {
+        return status != unsyncd && upstreamValid;
+    }
+    bool upstreamLost () const {
+        return upstreamFailures >= MESH_NUM_TIMEOUTS;
+    }
+};
+
+/**
+  * @brief Converts microseconds to `timeval`
+  */
+static timeval toTimeval (int64_t us) {
+    timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return tv;
+}
+
+/**
+  * @brief Builds packet header from local clock, as `NTPClient::fillLocalClockInfo`
+  */
+static void fillLocalClockInfo (const Node& node, int64_t trueUs, NTPUndecodedPacket_t* packet, uint8_t mode) {
+    bool synchronized = node.synchronized ();
+    memset (packet, 0, sizeof (NTPUndecodedPacket_t));
+    packet->flags = (synchronized ? 0 : 3) << 6 | 4 << 3 | mode;
+    packet->peerStratum = synchronized ? (node.upstreamStratum < 15 ? node.upstreamStratum + 1 : 15) : 16;
+    packet->pollingInterval = 6;
+    packet->clockPrecission = 0xEC;
+    if (!synchronized) {
+        return;
+    }
+    float sinceSync = (node.systemTime (trueUs) - node.reference) / 1e6;
+    timeval reference = toTimeval (node.reference);
+    packet->rootDelay = seconds2timestamp32 (node.rootDelay);
+    packet->dispersion = seconds2timestamp32 (node.rootDispersion + MESH_CLOCK_PHI * sinceSync);
+    packet->reference = timeval2timestamp64 (&reference);
+}
+
+/**
+  * @brief Offset of a decoded packet as `int64_t` microseconds, with `NTPClient::calculateOffset` conversion
+  */
+static int64_t offsetUs (NTPPacket_t* packet, double* delay) {
+    double offset;
+    ntpCalculateOffset (packet, &offset, delay);
+    timeval tvOffset;
+    tvOffset.tv_sec = (time_t)offset;
+    tvOffset.tv_usec = (offset - (double)tvOffset.tv_sec) * 1000000.0;
+    return (int64_t)tvOffset.tv_sec * 1000000L + (int64_t)tvOffset.tv_usec;
+}
+
+/**
+  * @brief Sample processing of `NTPClient::processSample`
+  */
+static void processSample (const Mesh& mesh, Node& node, NTPPacket_t& packet, int64_t offset, double delay,
+                           SampleSource source, int64_t trueUs) {
+    NTPSyncConfig_t config = mesh.config;
+    config.acceptPeer = true;
+    bool sane = ntpCheckResponse (&packet, offset, unsyncd, config, NULL);
+    NTPSyncDecision_t decision = node.filter.processSample (packet, offset, node.status, config);
+    bool accepted = sane && decision.action != syncRejected && decision.action != syncAccuracyError;
+
+    if (source == unicastSample) {
+        if (accepted || mesh.resetBeforeChecks) {
+            node.upstreamFailures = 0;
+        } else if (!sane) {
+            node.upstreamFailures++;
+        }
+    }
+    node.actualInterval = decision.interval;
+    switch (decision.action) {
+    case syncAveraging:
+    case syncRejected:
+    case syncAccuracyError:
+        return;
+    case syncSkipped:
+    case syncConverged:
+        node.status = decision.status;
+        break;
+    case syncApply:
+        node.clockBase += decision.offsetUs;
+        node.upstreamValid = true;
+        node.upstreamStratum = packet.flags.li == 3 ? 16 : packet.peerStratum;
+        node.rootDelay = packet.rootDelay + (float)fabs (delay);
+        node.rootDispersion = packet.dispersion;
+        node.reference = node.systemTime (trueUs);
+        node.status = decision.status;
+        if (source == peerSample) {
+            node.peerSamples++;
+        }
+        break;
+    }
+    if (node.status == syncd && node.syncedAtS < 0) {
+        node.syncedAtS = trueUs / 1e6;
+    }
+}
+
+/**
+  * @brief Root distance of local clock, as `NTPClient::rootDistance`
+  */
+static float rootDistance (const Node& node, int64_t trueUs) {
+    if (!node.synchronized ()) {
+        return 16.0;
+    }
+    float sinceSync = (node.systemTime (trueUs) - node.reference) / 1e6;
+    return node.rootDelay / 2.0 + node.rootDispersion + MESH_CLOCK_PHI * sinceSync;
+}
+
+/**
+  * @brief Peer selection of `NTPClient::selectPeer`
+  */
+static Peer* selectPeer (const Mesh& mesh, Node& node, int64_t trueUs) {
+    Peer* best = NULL;
+    float localDistance = rootDistance (node, trueUs);
+    uint8_t localStratum = node.synchronized () ? node.upstreamStratum + 1 : 16;
+    int64_t millis = node.monotonic (trueUs) / 1000;
+
+    for (Peer& peer : node.peers) {
+        if (peer.stratum < 1 || peer.stratum > 15 || !peer.everAnswered
+            || millis - peer.lastResponse > 2 * (int64_t)mesh.config.longInterval) {
+            continue;
+        }
+        if (peer.stratum >= localStratum && peer.rootDistance >= localDistance) {
+            continue;
+        }
+        if (!best || peer.rootDistance < best->rootDistance) {
+            best = &peer;
+        }
+    }
+    return best;
+}
+
+/**
+  * @brief Sets a mesh option from `key=value` text
+  * @return `false` if option is unknown
+  */
+static bool setOption (Mesh& m, const char* option) {
+    const char* equal = strchr (option, '=');
+    if (!equal) {
+        return false;
+    }
+    size_t length = equal - option;
+    double value = atof (equal + 1);
+    struct { const char* key; double* target; } doubles[] = {
+        { "hours", &m.hours }, { "drift_ppm", &m.driftPpm }, { "lan_delay_ms", &m.lanDelayMs },
+        { "wan_delay_ms", &m.wanDelayMs }, { "jitter_ms", &m.jitterMs }, { "max_error_us", &m.maxErrorUs }
+    };
+    for (auto& d : doubles) {
+        if (strlen (d.key) == length && !strncmp (option, d.key, length)) {
+            *d.target = value;
+            return true;
+        }
+    }
+    if (!strncmp (option, "nodes=", 6)) m.nodes = (unsigned)value;
+    else if (!strncmp (option, "seed=", 5)) m.seed = strtoull (equal + 1, NULL, 10);
+    else if (!strncmp (option, "reset_before_checks=", 20)) m.resetBeforeChecks = value != 0;
+    else if (!strncmp (option, "long_s=", 7)) m.config.longInterval = (uint32_t)(value * 1000);
+    else if (!strncmp (option, "gateways=", 9) || !strncmp (option, "unsynced=", 9)) {
+        std::vector<bool>& list = option[0] == 'g' ? m.gateway : m.unsynced;
+        list.assign (256, false);
+        for (const char* item = equal + 1; *item; item++) {
+            list[atoi (item) & 0xFF] = true;
+            item = strchr (item, ',');
+            if (!item) {
+                break;
+            }
+        }
+    }
+    else return false;
+    return true;
+}
+
+int main (int argc, char** argv) {
+    Mesh mesh;
+
+    mesh.gateway.assign (256, false);
+    mesh.unsynced.assign (256, false);
+    mesh.gateway[0] = true;
+    for (int i = 1; i < argc; i++) {
+        if (!setOption (mesh, argv[i])) {
+            fprintf (stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (mesh.nodes < 2 || mesh.nodes > 255) {
+        fprintf (stderr, "nodes must be 2 to 255\n");
+        return 1;
+    }
+
+    std::mt19937_64 random (mesh.seed);
+    std::uniform_real_distribution<double> uniform (-1.0, 1.0);
+    std::exponential_distribution<double> exponential (1.0);
+    auto oneWay = [&] (double roundTripMs) {
+        return (int64_t)(roundTripMs * 500.0 + mesh.jitterMs * 1000.0 * exponential (random));
+    };
+
+    std::vector<Node> nodes (mesh.nodes);
+    for (unsigned i = 0; i < mesh.nodes; i++) {
+        Node& node = nodes[i];
+        node.frequency = mesh.driftPpm * 1e-6 * uniform (random);
+        node.clockBase = (int64_t)(5e6 + 5e6 * uniform (random)); // Devices boot in 1970
+        node.actualInterval = mesh.config.shortInterval;
+        const int offsets[] = { 1, -1, 2, -2 };
+        for (int k = 0; k < MESH_MAX_PEERS && node.peers.size () < mesh.nodes - 1; k++) {
+            Peer peer;
+            peer.node = (i + mesh.nodes + offsets[k]) % mesh.nodes;
+            bool known = false;
+            for (Peer& other : node.peers) {
+                known = known || other.node == peer.node;
+            }
+            if (!known && peer.node != i) {
+                node.peers.push_back (peer);
+            }
+        }
+    }
+
+    const int64_t end = (int64_t)(mesh.hours * 3600e6);
+    double errorSum = 0;
+    uint32_t errorCount = 0;
+    double maxLateError = 0;
+    for (int64_t now = 0; now <= end; now += TICK_US) {
+        for (unsigned i = 0; i < mesh.nodes; i++) {
+            Node& node = nodes[i];
+            int64_t millis = node.monotonic (now) / 1000;
+            if (!node.firstLoop && millis - node.lastGotTime < node.actualInterval) {
+                continue;
+            }
+            node.firstLoop = false;
+            node.lastGotTime = millis;
+
+            // Upstream request. Only gateways get an answer
+            if (mesh.gateway[i]) {
+                NTPUndecodedPacket_t reply;
+                int64_t sent = node.systemTime (now);
+                int64_t arrival = now + oneWay (mesh.wanDelayMs);
+                timeval origin = toTimeval (sent);
+                timeval serverTime = toTimeval (REFERENCE_EPOCH_US + arrival);
+                memset (&reply, 0, sizeof (reply));
+                reply.flags = (mesh.unsynced[i] ? 3 : 0) << 6 | 4 << 3 | 4;
+                reply.peerStratum = mesh.unsynced[i] ? 16 : 1;
+                reply.pollingInterval = 6;
+                reply.clockPrecission = -20;
+                reply.rootDelay = seconds2timestamp32 (0.001);
+                reply.dispersion = seconds2timestamp32 (0.001);
+                reply.origin = timeval2timestamp64 (&origin);
+                reply.receive = timeval2timestamp64 (&serverTime);
+                reply.transmit = reply.receive;
+                int64_t back = arrival + oneWay (mesh.wanDelayMs);
+                timeval received = toTimeval (node.systemTime (back));
+                NTPPacket_t packet;
+                double delay;
+                ntpDecodePacket ((uint8_t*)&reply, NTP_PACKET_SIZE, &received, &packet);
+                int64_t offset = offsetUs (&packet, &delay);
+                processSample (mesh, node, packet, offset, delay, unicastSample, now);
+            } else {
+                node.upstreamFailures++;
+                if (++node.numTimeouts >= MESH_NUM_TIMEOUTS) {
+                    node.numTimeouts = 0;
+                    node.actualInterval = mesh.config.shortInterval;
+                }
+            }
+
+            // Symmetric active packets to every peer. Receiver task takes every reply from its peer slot
+            std::vector<NTPUndecodedPacket_t> replies (node.peers.size ());
+            std::vector<int64_t> arrivals (node.peers.size ());
+            for (size_t k = 0; k < node.peers.size (); k++) {
+                NTPUndecodedPacket_t request;
+                Node& other = nodes[node.peers[k].node];
+                fillLocalClockInfo (node, now, &request, 1);
+                timeval sent = toTimeval (node.systemTime (now));
+                request.transmit = timeval2timestamp64 (&sent);
+                int64_t arrival = now + oneWay (mesh.lanDelayMs);
+                fillLocalClockInfo (other, arrival, &replies[k], 2);
+                timeval otherTime = toTimeval (other.systemTime (arrival));
+                replies[k].origin = request.transmit;
+                replies[k].receive = timeval2timestamp64 (&otherTime);
+                replies[k].transmit = replies[k].receive;
+                arrivals[k] = arrival + oneWay (mesh.lanDelayMs);
+            }
+            for (size_t k = 0; k < node.peers.size (); k++) {
+                // Same as NTPClient::processPeerPacket
+                Peer& peer = node.peers[k];
+                timeval received = toTimeval (node.systemTime (arrivals[k]));
+                NTPPacket_t packet;
+                double delay;
+                ntpDecodePacket ((uint8_t*)&replies[k], NTP_PACKET_SIZE, &received, &packet);
+                int64_t offset = offsetUs (&packet, &delay);
+                peer.stratum = packet.flags.li == 3 ? 16 : packet.peerStratum;
+                peer.rootDistance = packet.rootDelay / 2.0 + packet.dispersion + (float)fabs (delay) / 2.0;
+                peer.lastResponse = node.monotonic (arrivals[k]) / 1000;
+                peer.everAnswered = true;
+                node.peerReplies++;
+                if (node.upstreamLost () && selectPeer (mesh, node, arrivals[k]) == &peer) {
+                    processSample (mesh, node, packet, offset, delay, peerSample, arrivals[k]);
+                }
+            }
+        }
+
+        if (now % SAMPLE_PERIOD_US == 0 && now >= end / 2) {
+            for (Node& node : nodes) {
+                double error = fabs ((double)(node.systemTime (now) - (REFERENCE_EPOCH_US + now)));
+                errorSum += error;
+                errorCount++;
+                if (error > maxLateError) {
+                    maxLateError = error;
+                }
+            }
+        }
+    }
+
+    bool passed = true;
+    printf ("%4s %8s %8s %8s %12s %12s %10s %8s\n", "node", "gateway", "status", "stratum", "synced_at_s", "error_us",
+            "peer_syncs", "replies");
+    for (unsigned i = 0; i < mesh.nodes; i++) {
+        Node& node = nodes[i];
+        double error = (double)(node.systemTime (end) - (REFERENCE_EPOCH_US + end));
+        NTPUndecodedPacket_t announced;
+        fillLocalClockInfo (node, end, &announced, 4);
+        bool good = node.status != unsyncd && fabs (error) <= mesh.maxErrorUs;
+        passed = passed && good;
+        printf ("%4u %8s %8s %8u %12.1f %12.1f %10u %8u\n", i, mesh.gateway[i] ? (mesh.unsynced[i] ? "unsynced" : "yes") : "no",
+                node.status == syncd ? "syncd" : node.status == partialSync ? "partial" : "unsyncd", announced.peerStratum,
+                node.syncedAtS, error, node.peerSamples, node.peerReplies);
+    }
+    printf ("mean_abs_error_us:  %.1f (second half, all nodes)\n", errorCount ? errorSum / errorCount : 0.0);
+    printf ("max_abs_error_us:   %.1f\n", maxLateError);
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,487 @@
+/**
+  * @file ntpreplay.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Replays recorded NTP exchanges through `NTPCore` decode, checks and `NTPSyncFilter` at host speed,
+  * with no sockets or timers. Prints applied corrections and resulting clock error, so an algorithm change can
+  * be compared against the same field traces.
+  *
+  * Build on host:
+  *
+  *     g++ -std=c++11 -O2 -I../../src ntpreplay.cpp ../../src/NTPCore.cpp -o ntpreplay
+  *
+  * Run:
+  *
+  *     ./ntpreplay trace.csv series=series.csv rounds=2 threshold_us=1000
+  *     ./ntpreplay capture.pcapng
+  *
+  * Input is detected by content:
+  * - CSV with one exchange per line:
+  *   `t1,t2,t3,t4,li,version,mode,stratum,precision,root_delay,dispersion[,uptime_us[,error_us]]`.
+  *   Times are UNIX seconds with up to 6 decimals. `precision` is log2 seconds, `root_delay` and `dispersion` are
+  *   seconds. `uptime_us` is monotonic time at `t4`. Without it, recording clock is taken as never adjusted.
+  *   `error_us` is recording clock minus true time at `t4`. Without it, server time is taken as truth. Lines not
+  *   starting with a digit are skipped. `ntpsim trace=FILE` writes this format.
+  * - pcapng written by `NTPClient::dumpPacketCapture()`. Every received server response is one exchange. Its
+  *   capture timestamp is `t4` and its `uptime_us` comment is monotonic time.
+  *
+  * Recorded `t1` and `t4` come from a clock the recording algorithm was already adjusting. Replay clock is
+  * monotonic time plus its own base, so `t1` and `t4` are moved by the difference between replay base and
+  * recording base, `t4 - uptime_us`, before offset is calculated. Clock is taken as not adjusted between `t1` and
+  * `t4`. Request intervals asked by the filter are not simulated: samples come at recorded times.
+  *
+  * Clock error is sampled as `ntpsim` does: every 10 s of true time after first sync, replay clock minus true
+  * clock. True clock comes from `error_us` or, without it, from offset of replies that pass header checks, and is
+  * interpolated between exchanges. Sampling ends at last exchange. First applied correction sets the clock from
+  * its boot value, so it is reported as `boot_step_us` and left out of `mean_correction_us`.
+  *
+  * For A/B evaluation build one binary per `NTPCore` version, run both on the same trace and compare summaries
+  * or `series` outputs.
+  */
+
+#include "NTPCore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+constexpr uint32_t PCAPNG_SECTION_HEADER = 0x0A0D0D0A; ///< @brief Section Header Block type
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D; ///< @brief Byte order magic, as read on little endian
+constexpr uint32_t PCAPNG_ENHANCED_PACKET = 0x00000006; ///< @brief Enhanced Packet Block type
+constexpr uint16_t PCAPNG_OPT_COMMENT = 1; ///< @brief Comment option code
+constexpr size_t REPLAY_OUTPUT_BUFFER = 1 << 20; ///< @brief Series output buffer size
+constexpr int64_t SAMPLE_PERIOD_US = 10000000; ///< @brief Clock error sampling period, same as `ntpsim`
+
+/**
+  * @brief Recorded exchange
+  */
+typedef struct {
+    uint8_t packet[NTP_PACKET_SIZE]; ///< @brief Server response as on the network
+    int64_t destinationUs; ///< @brief `t4`, recording clock in microseconds since epoch
+    int64_t clockBaseUs; ///< @brief Recording clock minus monotonic time at `t4`
+    int64_t errorUs; ///< @brief Recording clock minus true time at `t4`
+    bool hasError; ///< @brief `errorUs` is known
+} ReplaySample_t;
+
+/**
+  * @brief Replay results
+  */
+struct ReplayReport {
+    uint64_t samples = 0; ///< @brief Exchanges replayed
+    uint64_t decodeErrors = 0; ///< @brief Exchanges that could not be decoded
+    uint64_t steps = 0; ///< @brief Clock adjustments
+    double bootStepUs = 0; ///< @brief First applied correction, which sets clock from its boot value
+    double correctionSumUs = 0; ///< @brief Sum of absolute applied corrections, without boot step
+    uint64_t actions[syncApply + 1] = { 0 }; ///< @brief Filter decisions by `NTPSyncAction_t`
+    uint64_t rejected[NUM_REJECT_REASONS] = { 0 }; ///< @brief Rejected samples by reason
+    uint64_t errorCount = 0; ///< @brief Error samples after first sync, every `SAMPLE_PERIOD_US` of true time
+    double errorSumUs = 0; ///< @brief Sum of absolute error after first sync
+    double errorSquares = 0; ///< @brief Sum of squared error after first sync
+    double maxErrorUs = 0; ///< @brief Maximum absolute error after first sync
+    double seconds = 0; ///< @brief Processing time, without input parsing
+};
+
+/**
+  * @brief Parses a decimal number with up to 6 decimals into millionths, without floating point rounding
+  * @param text Pointer to text position. Updated to next character after number
+  * @param value Output value
+  * @return `false` if there is no number
+  */
+static bool parseMicros (const char** text, int64_t* value) {
+    const char* p = *text;
+    bool negative = false;
+    int64_t integer = 0, fraction = 0;
+    int digits = 0;
+    
+    while (*p == ' ' || *p == '\t' || *p == ',') {
+        p++;
+    }
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+    if ((*p < '0' || *p > '9') && *p != '.') {
+        return false;
+    }
+    while (*p >= '0' && *p <= '9') {
+        integer = integer * 10 + (*p++ - '0');
+    }
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9') {
+            if (digits < 6) {
+                fraction = fraction * 10 + (*p - '0');
+                digits++;
+            }
+            p++;
+        }
+    }
+    for (; digits < 6; digits++) {
+        fraction *= 10;
+    }
+    *value = (negative ? -1 : 1) * (integer * 1000000 + fraction);
+    *text = p;
+    return true;
+}
+
+/**
+  * @brief Parses an integer field
+  * @param text Pointer to text position. Updated to next character after number
+  * @param value Output value
+  * @return `false` if there is no number
+  */
+static bool parseInteger (const char** text, int64_t* value) {
+    char* end;
+    
+    while (**text == ' ' || **text == '\t' || **text == ',') {
+        (*text)++;
+    }
+    *value = strtoll (*text, &end, 10);
+    if (end == *text) {
+        return false;
+    }
+    *text = end;
+    return true;
+}
+
+/**
+  * @brief Converts microseconds to `timeval`
+  */
+static timeval toTimeval (int64_t us) {
+    timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return tv;
+}
+
+/**
+  * @brief Builds a sample from a CSV line
+  * @return `false` if line has not enough fields
+  */
+static bool parseCsvLine (const char* line, ReplaySample_t* sample) {
+    int64_t t[4], header[5], rootDelay, dispersion, uptime;
+    
+    for (int i = 0; i < 4; i++) {
+        if (!parseMicros (&line, &t[i])) {
+            return false;
+        }
+    }
+    for (int i = 0; i < 5; i++) {
+        if (!parseInteger (&line, &header[i])) {
+            return false;
+        }
+    }
+    if (!parseMicros (&line, &rootDelay) || !parseMicros (&line, &dispersion)) {
+        return false;
+    }
+    NTPUndecodedPacket_t raw;
+    timeval t1 = toTimeval (t[0]);
+    timeval t2 = toTimeval (t[1]);
+    timeval t3 = toTimeval (t[2]);
+    memset (&raw, 0, sizeof (raw));
+    raw.flags = (uint8_t)(header[0] << 6 | (header[1] & 0x07) << 3 | (header[2] & 0x07));
+    raw.peerStratum = (uint8_t)header[3];
+    raw.pollingInterval = 6;
+    raw.clockPrecission = (int8_t)header[4];
+    raw.rootDelay = seconds2timestamp32 (rootDelay / 1e6);
+    raw.dispersion = seconds2timestamp32 (dispersion / 1e6);
+    raw.origin = timeval2timestamp64 (&t1);
+    raw.receive = timeval2timestamp64 (&t2);
+    raw.transmit = timeval2timestamp64 (&t3);
+    raw.reference = raw.receive;
+    memcpy (sample->packet, &raw, NTP_PACKET_SIZE);
+    sample->destinationUs = t[3];
+    sample->clockBaseUs = parseInteger (&line, &uptime) ? t[3] - uptime : 0;
+    sample->hasError = parseInteger (&line, &sample->errorUs);
+    return true;
+}
+
+/**
+  * @brief Loads a CSV trace
+  */
+static bool loadCsv (FILE* file, std::vector<ReplaySample_t>& samples) {
+    char line[512];
+    ReplaySample_t sample;
+    
+    while (fgets (line, sizeof (line), file)) {
+        if ((line[0] >= '0' && line[0] <= '9') && parseCsvLine (line, &sample)) {
+            samples.push_back (sample);
+        }
+    }
+    return true;
+}
+
+/// @brief Reads little endian 32 bit value
+static uint32_t getLe32 (const uint8_t* p) {
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/**
+  * @brief Loads server responses from a pcapng file with raw IP link type and microsecond timestamps, as written
+  * by `NTPPacketCapture`
+  */
+static bool loadPcapng (FILE* file, std::vector<ReplaySample_t>& samples) {
+    std::vector<uint8_t> block;
+    uint8_t header[8];
+    
+    while (fread (header, 1, 8, file) == 8) {
+        uint32_t type = getLe32 (header);
+        uint32_t length = getLe32 (header + 4);
+        if (length < 12 || length % 4) {
+            fprintf (stderr, "Bad pcapng block length\n");
+            return false;
+        }
+        block.resize (length - 8);
+        if (fread (block.data (), 1, block.size (), file) != block.size ()) {
+            fprintf (stderr, "Truncated pcapng file\n");
+            return false;
+        }
+        if (type == PCAPNG_SECTION_HEADER && getLe32 (block.data ()) != PCAPNG_BYTE_ORDER_MAGIC) {
+            fprintf (stderr, "Only little endian pcapng is supported\n");
+            return false;
+        }
+        if (type != PCAPNG_ENHANCED_PACKET || block.size () < 24) {
+            continue;
+        }
+        const uint8_t* b = block.data ();
+        uint64_t timestamp = (uint64_t)getLe32 (b + 4) << 32 | getLe32 (b + 8);
+        uint32_t captured = getLe32 (b + 12);
+        const uint8_t* ip = b + 20;
+        if (captured > block.size () - 24) {
+            continue;
+        }
+        size_t ipHeader = (ip[0] >> 4) == 4 ? (ip[0] & 0x0F) * 4 : ((ip[0] >> 4) == 6 ? 40 : 0);
+        if (!ipHeader || captured < ipHeader + 8 + NTP_PACKET_SIZE) {
+            continue;
+        }
+        const uint8_t* ntp = ip + ipHeader + 8;
+        uint8_t mode = ntp[0] & 0x07;
+        if (mode != 4 && mode != 5) { // Requests sent by client
+            continue;
+        }
+        ReplaySample_t sample;
+        memcpy (sample.packet, ntp, NTP_PACKET_SIZE);
+        sample.destinationUs = (int64_t)timestamp;
+        sample.clockBaseUs = 0;
+        // Options follow padded packet data. Comment has monotonic time
+        size_t option = 20 + ((captured + 3) & ~3u);
+        while (option + 4 <= block.size () - 4) {
+            uint16_t code = b[option] | b[option + 1] << 8;
+            uint16_t optionLength = b[option + 2] | b[option + 3] << 8;
+            if (code == 0 || option + 4 + optionLength > block.size () - 4) {
+                break;
+            }
+            if (code == PCAPNG_OPT_COMMENT && optionLength > 10 && !memcmp (b + option + 4, "uptime_us=", 10)) {
+                std::string uptime ((const char*)b + option + 14, optionLength - 10);
+                sample.clockBaseUs = sample.destinationUs - strtoll (uptime.c_str (), NULL, 10);
+            }
+            option += 4 + ((optionLength + 3) & ~3u);
+        }
+        sample.errorUs = 0;
+        sample.hasError = false;
+        samples.push_back (sample);
+    }
+    return true;
+}
+
+/**
+  * @brief Replays samples
+  * @param samples Recorded exchanges
+  * @param config Sync filter settings under test
+  * @param series Output for per sample series. May be `NULL`
+  * @return Results
+  */
+static ReplayReport replay (const std::vector<ReplaySample_t>& samples, const NTPSyncConfig_t& config, FILE* series) {
+    static const char* actionNames[] = { "averaging", "skipped", "converged", "rejected", "accuracyError", "apply" };
+    ReplayReport report;
+    NTPSyncFilter filter;
+    NTPStatus_t status = unsyncd;
+    int64_t base = samples.empty () ? 0 : samples[0].clockBaseUs; // Replay clock minus monotonic time
+    bool synced = false;
+    bool truthValid = false;
+    int64_t lastTrueUs = 0; // True time of last sample that gave truth
+    int64_t lastTruthUs = 0; // True time minus monotonic time at that sample
+    int64_t nextGridUs = 0; // Next error sampling point, true time
+    std::vector<char> output;
+    size_t used = 0;
+    timespec start, end;
+    
+    if (series) {
+        output.resize (REPLAY_OUTPUT_BUFFER);
+        fputs ("index,t4_us,action,offset_us,applied_us,error_us\n", series);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    for (size_t i = 0; i < samples.size (); i++) {
+        const ReplaySample_t& sample = samples[i];
+        int64_t shift = base - sample.clockBaseUs; // Replay clock minus recording clock
+        timeval destination = toTimeval (sample.destinationUs + shift);
+        NTPPacket_t packet;
+        double offset, delay;
+        
+        report.samples++;
+        if (!ntpDecodePacket (sample.packet, NTP_PACKET_SIZE, &destination, &packet)) {
+            report.decodeErrors++;
+            continue;
+        }
+        int64_t originUs = (int64_t)packet.origin.tv_sec * 1000000 + packet.origin.tv_usec + shift;
+        packet.origin = toTimeval (originUs);
+        ntpCalculateOffset (&packet, &offset, &delay);
+        // Same conversion as NTPClient::calculateOffset
+        timeval tvOffset;
+        tvOffset.tv_sec = (time_t)offset;
+        tvOffset.tv_usec = (offset - (double)tvOffset.tv_sec) * 1000000.0;
+        int64_t offsetUs = (int64_t)tvOffset.tv_sec * 1000000L + (int64_t)tvOffset.tv_usec;
+        
+        // True time minus monotonic time at t4. Recorded error is exact, server time is taken only from sane replies
+        int64_t monotonicUs = sample.destinationUs - sample.clockBaseUs;
+        int64_t truthUs = 0;
+        bool hasTruth = sample.hasError || ntpCheckResponse (&packet, offsetUs, unsyncd, config, NULL);
+        if (hasTruth) {
+            truthUs = sample.hasError ? sample.clockBaseUs - sample.errorUs : base + offsetUs;
+            int64_t trueUs = monotonicUs + truthUs;
+            if (truthValid && trueUs > lastTrueUs) {
+                // Sample replay clock error on a true time grid up to this sample, as ntpsim does. Clock was not
+                // adjusted since last sample and truth is interpolated between samples
+                for (; nextGridUs < trueUs; nextGridUs += SAMPLE_PERIOD_US) {
+                    if (!synced || nextGridUs < lastTrueUs) {
+                        continue;
+                    }
+                    double truth = lastTruthUs + (double)(truthUs - lastTruthUs) * (nextGridUs - lastTrueUs) / (trueUs - lastTrueUs);
+                    double error = base - truth;
+                    report.errorCount++;
+                    report.errorSumUs += fabs (error);
+                    report.errorSquares += error * error;
+                    if (fabs (error) > report.maxErrorUs) {
+                        report.maxErrorUs = fabs (error);
+                    }
+                }
+            }
+            if (!truthValid || trueUs > lastTrueUs) {
+                if (!truthValid || nextGridUs < trueUs) {
+                    nextGridUs = (trueUs / SAMPLE_PERIOD_US + 1) * SAMPLE_PERIOD_US;
+                }
+                truthValid = true;
+                lastTrueUs = trueUs;
+                lastTruthUs = truthUs;
+            }
+        }
+        
+        NTPSyncDecision_t decision = filter.processSample (packet, offsetUs, status, config);
+        report.actions[decision.action]++;
+        status = decision.status;
+        if (decision.action == syncRejected || decision.action == syncAccuracyError) {
+            report.rejected[decision.reason]++;
+        }
+        int64_t applied = 0;
+        if (decision.action == syncApply) {
+            applied = decision.offsetUs;
+            base += applied;
+            shift += applied;
+            if (report.steps++) {
+                report.correctionSumUs += fabs ((double)applied);
+            } else {
+                report.bootStepUs = (double)applied;
+            }
+        }
+        // Replay clock error right after this sample, for series. Server is reference when true error was not recorded
+        int64_t error = sample.hasError ? sample.errorUs + shift : applied - offsetUs;
+        if (status == syncd) {
+            synced = true;
+        }
+        if (series) {
+            if (REPLAY_OUTPUT_BUFFER - used < 128) {
+                fwrite (output.data (), 1, used, series);
+                used = 0;
+            }
+            used += snprintf (output.data () + used, REPLAY_OUTPUT_BUFFER - used, "%zu,%lld,%s,%lld,%lld,%lld\n", i,
+                              (long long)(sample.destinationUs + shift), actionNames[decision.action],
+                              (long long)offsetUs, (long long)applied, (long long)error);
+        }
+    }
+    if (series && used) {
+        fwrite (output.data (), 1, used, series);
+    }
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    report.seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    return report;
+}
+
+/**
+  * @brief Prints replay summary
+  */
+static void printReport (const ReplayReport& r) {
+    static const char* actionNames[] = { "averaging", "skipped", "converged", "rejected", "accuracyError", "apply" };
+    static const char* reasonNames[] = { "short", "decode", "leap", "version", "mode", "stratum", "precision", "dispersion" };
+    
+    printf ("samples:            %llu\n", (unsigned long long)r.samples);
+    printf ("decode_errors:      %llu\n", (unsigned long long)r.decodeErrors);
+    printf ("steps:              %llu\n", (unsigned long long)r.steps);
+    printf ("boot_step_us:       %.1f\n", r.bootStepUs);
+    printf ("mean_correction_us: %.1f\n", r.steps > 1 ? r.correctionSumUs / (r.steps - 1) : 0.0);
+    printf ("mean_abs_error_us:  %.1f\n", r.errorCount ? r.errorSumUs / r.errorCount : -1.0);
+    printf ("rms_error_us:       %.1f\n", r.errorCount ? sqrt (r.errorSquares / r.errorCount) : -1.0);
+    printf ("max_abs_error_us:   %.1f\n", r.errorCount ? r.maxErrorUs : -1.0);
+    for (int i = 0; i <= syncApply; i++) {
+        printf ("action_%-12s %llu\n", actionNames[i], (unsigned long long)r.actions[i]);
+    }
+    for (int i = 0; i < NUM_REJECT_REASONS; i++) {
+        if (r.rejected[i]) {
+            printf ("rejected_%-10s %llu\n", reasonNames[i], (unsigned long long)r.rejected[i]);
+        }
+    }
+    printf ("samples_per_minute: %.0f\n", r.seconds > 0 ? r.samples / r.seconds * 60 : 0.0);
+}
+
+int main (int argc, char** argv) {
+    NTPSyncConfig_t config;
+    const char* seriesPath = NULL;
+    std::vector<ReplaySample_t> samples;
+    
+    if (argc < 2) {
+        fprintf (stderr, "Usage: %s trace.csv|capture.pcapng [series=FILE] [key=value...]\n", argv[0]);
+        return 1;
+    }
+    for (int i = 2; i < argc; i++) {
+        const char* equal = strchr (argv[i], '=');
+        double value = equal ? atof (equal + 1) : 0;
+        if (!strncmp (argv[i], "series=", 7)) seriesPath = argv[i] + 7;
+        else if (!strncmp (argv[i], "rounds=", 7)) config.numAveRounds = (unsigned int)value;
+        else if (!strncmp (argv[i], "accuracy_us=", 12)) config.minSyncAccuracyUs = (long)value;
+        else if (!strncmp (argv[i], "threshold_us=", 13)) config.timeSyncThreshold = (long)value;
+        else if (!strncmp (argv[i], "retries=", 8)) config.maxNumSyncRetry = (unsigned int)value;
+        else if (!strncmp (argv[i], "dispersion_errors=", 18)) config.maxDispersionErrors = (unsigned int)value;
+        else {
+            fprintf (stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    
+    FILE* file = fopen (argv[1], "rb");
+    uint8_t magic[4] = { 0 };
+    if (!file) {
+        perror (argv[1]);
+        return 1;
+    }
+    size_t got = fread (magic, 1, 4, file);
+    rewind (file);
+    bool loaded = (got == 4 && getLe32 (magic) == PCAPNG_SECTION_HEADER) ? loadPcapng (file, samples) : loadCsv (file, samples);
+    fclose (file);
+    if (!loaded) {
+        return 1;
+    }
+    
+    FILE* series = NULL;
+    if (seriesPath && !(series = fopen (seriesPath, "w"))) {
+        perror (seriesPath);
+        return 1;
+    }
+    printReport (replay (samples, config, series));
+    if (series) {
+        fclose (series);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+/**
+  * @file Arduino.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Minimal host stand-in for Arduino core types used by `NTPEventSerializer` and `NTPPacketCapture`. Not a core emulation
+  */
+
+#ifndef _HostArduino_h
+#define _HostArduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+/**
+  * @brief Heap backed string, as Arduino `String` without small string buffer
+  */
+class String {
+public:
+    explicit String (const char* text) {
+        size_t length = strlen (text);
+        buffer = (char*)malloc (length + 1);
+        memcpy (buffer, text, length + 1);
+    }
+    String (const String& other) : String (other.buffer) {}
+    String& operator= (const String&) = delete;
+    ~String () {
+        free (buffer);
+    }
+    const char* c_str () const {
+        return buffer;
+    }
+
+protected:
+    char* buffer;
+};
+
+/**
+  * @brief Byte output stream, as Arduino `Print`
+  */
+class Print {
+public:
+    virtual ~Print () {}
+    virtual size_t write (uint8_t c) = 0;
+    virtual size_t write (const uint8_t* buffer, size_t size) {
+        size_t written = 0;
+        while (size--) {
+            written += write (*buffer++);
+        }
+        return written;
+    }
+};
+
+/**
+  * @brief IPv4 address, as Arduino `IPAddress` on cores without IPv6 support
+  */
+class IPAddress {
+public:
+    IPAddress () {}
+    IPAddress (uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+        bytes[0] = a;
+        bytes[1] = b;
+        bytes[2] = c;
+        bytes[3] = d;
+    }
+    virtual ~IPAddress () {}
+    operator uint32_t () const {
+        uint32_t value;
+        memcpy (&value, bytes, 4);
+        return value;
+    }
+    String toString () const {
+        char text[16];
+        snprintf (text, sizeof (text), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+        return String (text);
+    }
+
+protected:
+    uint8_t bytes[4] = {};
+};
+
+#endif // _HostArduino_h
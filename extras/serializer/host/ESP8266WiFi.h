@@ -0,0 +1,9 @@
+/**
+  * @file ESP8266WiFi.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host stand-in. `NTPEventTypes.h` only needs `IPAddress` from it
+  */
+
+#include "Arduino.h"
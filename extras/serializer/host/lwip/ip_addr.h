@@ -0,0 +1,79 @@
+/**
+  * @file ip_addr.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host stand-in for dual stack lwIP `ip_addr_t`, with the macros `NTPEventSerializer` and `NTPPacketCapture` use
+  */
+
+#ifndef _HostIpAddr_h
+#define _HostIpAddr_h
+
+#include <stdint.h>
+#include <arpa/inet.h>
+
+#define LWIP_IPV6 1
+#define IPADDR_TYPE_V4 0U
+#define IPADDR_TYPE_V6 6U
+
+typedef struct {
+    uint32_t addr; ///< Network order
+} ip4_addr_t;
+
+typedef struct {
+    uint32_t addr[4]; ///< Network order
+    uint8_t zone;
+} ip6_addr_t;
+
+typedef struct {
+    union {
+        ip6_addr_t ip6;
+        ip4_addr_t ip4;
+    } u_addr;
+    uint8_t type;
+} ip_addr_t;
+
+#define IP_IS_V6(ipaddr) ((ipaddr)->type == IPADDR_TYPE_V6)
+#define ip_2_ip4(ipaddr) (&((ipaddr)->u_addr.ip4))
+#define ip_2_ip6(ipaddr) (&((ipaddr)->u_addr.ip6))
+#define ip4_addr_get_u32(src_ipaddr) ((src_ipaddr)->addr)
+#define ip_addr_set_ip4_u32(ipaddr, val) do { (ipaddr)->type = IPADDR_TYPE_V4; (ipaddr)->u_addr.ip4.addr = (val); } while (0)
+#define ip_addr_isany(ipaddr) ((ipaddr) == NULL || (IP_IS_V6 (ipaddr) \
+    ? !((ipaddr)->u_addr.ip6.addr[0] | (ipaddr)->u_addr.ip6.addr[1] | (ipaddr)->u_addr.ip6.addr[2] | (ipaddr)->u_addr.ip6.addr[3]) \
+    : !(ipaddr)->u_addr.ip4.addr))
+
+/**
+  * @brief Formats an address as lwIP does. IPv4 digits are written one by one as in `ip4addr_ntoa_r()`, glibc
+  * `inet_ntop()` would go through `sprintf()` and distort timings
+  * @return `buf` or `NULL` if it is too short
+  */
+static inline char* ipaddr_ntoa_r (const ip_addr_t* addr, char* buf, int buflen) {
+    if (IP_IS_V6 (addr)) {
+        return (char*)inet_ntop (AF_INET6, addr->u_addr.ip6.addr, buf, buflen);
+    }
+    const uint8_t* bytes = (const uint8_t*)&addr->u_addr.ip4.addr;
+    char* out = buf;
+    int length = 0;
+    for (int i = 0; i < 4; i++) {
+        char digits[3];
+        int numDigits = 0;
+        uint8_t value = bytes[i];
+        do {
+            digits[numDigits++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        while (numDigits) {
+            if (++length >= buflen) {
+                return NULL;
+            }
+            *out++ = digits[--numDigits];
+        }
+        if (++length >= buflen) {
+            return NULL;
+        }
+        *out++ = i < 3 ? '.' : '\0';
+    }
+    return buf;
+}
+
+#endif // _HostIpAddr_h
@@ -0,0 +1,346 @@
+/**
+  * @file ntpserializer.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host checks and benchmarks of `NTPEventSerializer`.
+  *
+  * Build on Linux. `host` has stand-ins for the few Arduino and lwIP types the serializer uses:
+  *
+  *     g++ -std=c++11 -O2 -Ihost -I../../src ntpserializer.cpp ../../src/NTPEventSerializer.cpp ../../src/NTPTimeZone.cpp -o ntpserializer
+  *
+  * Decode binary records and compare JSON lines with the events they came from, for IPv4 and IPv6 servers and
+  * saturated values. Then encode the same `timeSyncd` events as binary records, as JSON and as text the way
+  * `ntpEvent2str()` does now and did before, which was with `IPAddress::toString()` and current time. Both text
+  * paths go through a local time cache as the library does. They run once with every render in the same second
+  * and once with the cache invalidated before every render (`_miss`). Paths take turns over `rounds` rounds and the
+  * best one is reported. Heap allocations are counted for every path:
+  *
+  *     ./ntpserializer encode events=1000000 rounds=5
+  *
+  * Exit status is 0 if every check passes.
+  */
+
+#include "NTPEventSerializer.h"
+#include "NTPTimeFormat.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+constexpr auto EVENT_STR_LENGTH = 150; ///< @brief Same as in library
+constexpr auto TIME_DATE_STR_FORMAT = "%02d/%02m/%04Y %02H:%02M:%02S"; ///< @brief Same as in library
+
+extern "C" void* __libc_malloc (size_t size);
+
+static bool countAllocations = false; ///< @brief Set while a timed path runs
+static unsigned long allocations = 0; ///< @brief Allocations done with `countAllocations` set
+
+/**
+  * @brief Replaces `malloc()` to count allocations. `new` goes through it as well
+  */
+extern "C" void* malloc (size_t size) {
+    if (countAllocations) {
+        allocations++;
+    }
+    return __libc_malloc (size);
+}
+
+/**
+  * @brief `Print` that keeps last written bytes, like a network client buffer
+  */
+class BufferPrint : public Print {
+public:
+    size_t write (uint8_t c) override {
+        return write (&c, 1);
+    }
+    size_t write (const uint8_t* data, size_t size) override {
+        if (length + size > sizeof (buffer) - 1) {
+            size = sizeof (buffer) - 1 - length;
+        }
+        memcpy (buffer + length, data, size);
+        length += size;
+        buffer[length] = '\0';
+        return size;
+    }
+    void clear () {
+        length = 0;
+        buffer[0] = '\0';
+    }
+
+    char buffer[512];
+    size_t length = 0;
+};
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return atof (argv[i] + length + 1);
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Gets monotonic time in seconds
+  */
+static double seconds () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+  * @brief Reads a little endian integer
+  */
+static uint64_t getLittleEndian (const uint8_t* buffer, uint8_t bytes) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)buffer[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+  * @brief Seconds to nanoseconds as the serializer rounds them, without saturation
+  */
+static int64_t nanoseconds (double value) {
+    return (int64_t)llround (value * 1e9);
+}
+
+/**
+  * @brief Builds an event with an IPv4 or IPv6 server
+  */
+static NTPEvent_t buildEvent (NTPSyncEventType_t code, unsigned index, bool ipv6) {
+    NTPEvent_t event;
+    event.event = code;
+    event.info.offset = ((int)(index % 2001) - 1000) * 1.234567e-4;
+    event.info.delay = 0.001 + (index % 97) * 1.1e-4;
+    event.info.dispersion = 0.0005f + (index % 13) * 0.0001f;
+    event.info.port = 123;
+    event.info.retrials = index % 5;
+    event.uptimeUs = 1000000ULL * index + 123457;
+    event.time.tv_sec = 1774746000 + index;
+    event.time.tv_usec = (index * 7919) % 1000000;
+    event.info.serverAddress = IPAddress (192, 168, (uint8_t)(index >> 8), (uint8_t)index);
+    if (ipv6) {
+        event.info.serverAddr.type = IPADDR_TYPE_V6;
+        const uint8_t bytes[16] = { 0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, (uint8_t)(index >> 8), (uint8_t)index };
+        memcpy (event.info.serverAddr.u_addr.ip6.addr, bytes, 16);
+    } else {
+        ip_addr_set_ip4_u32 (&event.info.serverAddr, (uint32_t)event.info.serverAddress);
+    }
+    return event;
+}
+
+/**
+  * @brief Checks record fields against event
+  * @return Number of wrong fields
+  */
+static unsigned checkRecord (const NTPEvent_t& event, const uint8_t* record, int64_t offsetNs, int64_t delayNs, int64_t dispersionNs) {
+    unsigned failures = 0;
+    bool ipv6 = IP_IS_V6 (&event.info.serverAddr);
+
+    failures += record[0] != NTP_EVENT_RECORD_VERSION;
+    failures += (int8_t)record[1] != event.event;
+    failures += getLittleEndian (record + 2, 2) != event.info.port;
+    failures += getLittleEndian (record + 4, 2) != (event.info.retrials > 0xFFFF ? 0xFFFF : event.info.retrials);
+    failures += record[6] != (ipv6 ? 6 : 4);
+    failures += record[7] != 0;
+    failures += getLittleEndian (record + 8, 8) != event.uptimeUs;
+    failures += (int64_t)getLittleEndian (record + 16, 8) != offsetNs;
+    failures += (int32_t)getLittleEndian (record + 24, 4) != delayNs;
+    failures += getLittleEndian (record + 28, 4) != (uint64_t)dispersionNs;
+    failures += memcmp (record + 32, ipv6 ? (const void*)event.info.serverAddr.u_addr.ip6.addr : (const void*)&event.info.serverAddr.u_addr.ip4.addr, ipv6 ? 16 : 4) != 0;
+    return failures;
+}
+
+/**
+  * @brief Builds expected JSON line with `snprintf()`
+  */
+static void expectedJson (char* buffer, size_t length, const NTPEvent_t& event) {
+    char address[IP_ADDRESS_STR_LENGTH];
+    ntpFormatIPAddress (&event.info.serverAddr, address, sizeof (address));
+    snprintf (buffer, length, "{\"event\":%d,\"name\":\"%s\",\"uptime_us\":%llu,\"server\":\"%s\",\"port\":%u,"
+              "\"offset_ns\":%lld,\"delay_ns\":%lld,\"dispersion_ns\":%lld,\"retrials\":%u}",
+              event.event, ntpEventName (event.event), (unsigned long long)event.uptimeUs, address, event.info.port,
+              (long long)nanoseconds (event.info.offset), (long long)nanoseconds (event.info.delay),
+              (long long)nanoseconds (event.info.dispersion), event.info.retrials);
+}
+
+static NTPTimeZone zone; ///< @brief Not set, so cache falls back to `localtime_r()` as the library without `setTimeZone()`
+static NTPLocalTimeCache timeCache; ///< @brief Instance local time cache both text paths use, as in the library
+static uint32_t generation = 0; ///< @brief Cache generation. Incremented before every render for cache miss runs
+
+/**
+  * @brief `timeSyncd` text as `ntpEvent2str()` renders it now: event time through instance cache into a local
+  * buffer, address with lwIP
+  */
+static size_t currentText (char* result, const NTPEvent_t& e) {
+    char address[IP_ADDRESS_STR_LENGTH];
+    char eventTime[MAX_TIME_STR_LENGTH];
+
+    ntpFormatIPAddress (&e.info.serverAddr, address, sizeof (address));
+    timeCache.renderUs (eventTime, sizeof (eventTime), e.time, TIME_DATE_STR_FORMAT, true, zone, generation);
+    return snprintf (result, EVENT_STR_LENGTH, "%d:    Got NTP time %s from %s:%u. Offset: %0.3f ms. Delay: %0.3f ms. Dispersion: %0.3f ms",
+                     e.event, eventTime, address, e.info.port, e.info.offset * 1000, e.info.delay * 1000, e.info.dispersion * 1000);
+}
+
+/**
+  * @brief `timeSyncd` text as `ntpEvent2str()` rendered it before: current time through instance cache, as
+  * `getTimeDateStringUs()`, and `IPAddress::toString()`
+  */
+static size_t formerText (char* result, const NTPEvent_t& e) {
+    char strBuffer[MAX_TIME_STR_LENGTH];
+    timeval currentTime;
+
+    gettimeofday (&currentTime, NULL);
+    timeCache.renderUs (strBuffer, sizeof (strBuffer), currentTime, TIME_DATE_STR_FORMAT, true, zone, generation);
+    return snprintf (result, EVENT_STR_LENGTH, "%d:    Got NTP time %s from %s:%u. Offset: %0.3f ms. Delay: %0.3f ms. Dispersion: %0.3f ms",
+                     e.event, strBuffer, e.info.serverAddress.toString ().c_str (), e.info.port,
+                     e.info.offset * 1000, e.info.delay * 1000, e.info.dispersion * 1000);
+}
+
+/**
+  * @brief Result of timing one encoding path
+  */
+struct PathResult {
+    double seconds;
+    unsigned long bytes;
+    unsigned long allocations;
+};
+
+/**
+  * @brief Checks records and JSON, then times every encoding path over the same events
+  * @return `true` if every check passes and record and JSON paths do not allocate
+  */
+static bool checkEncode (int argc, char** argv) {
+    unsigned long count = (unsigned long)option (argc, argv, "events", 1000000);
+    unsigned rounds = (unsigned)option (argc, argv, "rounds", 5);
+    const NTPSyncEventType_t codes[] = { timeSyncd, noResponse, requestSent, partlySync, syncTraced, accuracyError };
+    unsigned long checked = 0;
+    unsigned long failures = 0;
+    uint8_t record[NTP_EVENT_RECORD_SIZE];
+    char expected[512];
+    BufferPrint out;
+
+    if (!count || !rounds) {
+        return false;
+    }
+    setenv ("TZ", "CET-1CEST,M3.5.0,M10.5.0/3", 1);
+    tzset ();
+
+    for (unsigned i = 0; i < 4096; i++) {
+        NTPEvent_t event = buildEvent (codes[i % 6], i, i % 2);
+        ntpEventToRecord (event, record);
+        failures += checkRecord (event, record, nanoseconds (event.info.offset), nanoseconds (event.info.delay), nanoseconds (event.info.dispersion));
+        out.clear ();
+        size_t written = ntpEventToJson (event, out);
+        expectedJson (expected, sizeof (expected), event);
+        if (strcmp (expected, out.buffer) || written != out.length) {
+            if (failures++ < 5) {
+                fprintf (stderr, "expected %s\ngot      %s\n", expected, out.buffer);
+            }
+        }
+        checked++;
+    }
+    // Saturated record fields and an event without address
+    NTPEvent_t extreme = buildEvent (syncError, 70000, false);
+    extreme.info.delay = 10.0;
+    extreme.info.dispersion = -1.0f;
+    extreme.info.retrials = 70000;
+    ntpEventToRecord (extreme, record);
+    failures += checkRecord (extreme, record, nanoseconds (extreme.info.offset), INT32_MAX, 0);
+    extreme.info.delay = -10.0;
+    extreme.info.dispersion = 10.0f;
+    ntpEventToRecord (extreme, record);
+    failures += checkRecord (extreme, record, nanoseconds (extreme.info.offset), INT32_MIN, UINT32_MAX);
+    ip_addr_set_ip4_u32 (&extreme.info.serverAddr, 0);
+    ntpEventToRecord (extreme, record);
+    failures += record[6] != 0;
+    checked += 3;
+
+    // Timing, timeSyncd from IPv4 servers so former path renders the same address
+    // Text paths run twice. First with every render in the same second, so cached part of time string is reused.
+    // Then with cache invalidated before every render, as when events are further apart than any other render
+    std::vector<NTPEvent_t> events;
+    std::vector<NTPEvent_t> sameSecond;
+    for (unsigned i = 0; i < 1024; i++) {
+        events.push_back (buildEvent (timeSyncd, i, false));
+        sameSecond.push_back (events.back ());
+        sameSecond.back ().time.tv_sec = events[0].time.tv_sec;
+    }
+    char text[EVENT_STR_LENGTH];
+    PathResult results[6] = {};
+    // Paths take turns in every round and best round is kept, so a slow period of host hits all paths alike
+    for (unsigned round = 0; round < rounds; round++) {
+        for (int path = 0; path < 6; path++) {
+            allocations = 0;
+            countAllocations = true;
+            results[path].bytes = 0;
+            double start = seconds ();
+            for (unsigned long i = 0; i < count; i++) {
+                const NTPEvent_t& event = events[i & 1023];
+                switch (path) {
+                case 0:
+                    results[path].bytes += ntpEventToRecord (event, record);
+                    break;
+                case 1:
+                    out.clear ();
+                    results[path].bytes += ntpEventToJson (event, out);
+                    break;
+                case 2:
+                    results[path].bytes += currentText (text, sameSecond[i & 1023]);
+                    break;
+                case 3:
+                    results[path].bytes += formerText (text, event);
+                    break;
+                case 4:
+                    generation++;
+                    results[path].bytes += currentText (text, event);
+                    break;
+                default:
+                    generation++;
+                    results[path].bytes += formerText (text, event);
+                    break;
+                }
+            }
+            double elapsed = seconds () - start;
+            countAllocations = false;
+            if (!round || elapsed < results[path].seconds) {
+                results[path].seconds = elapsed;
+            }
+            results[path].allocations = allocations;
+        }
+    }
+
+    const char* names[] = { "record", "json", "text", "former_text", "text_miss", "former_miss" };
+    printf ("checked:            %lu\n", checked);
+    printf ("failures:           %lu\n", failures);
+    printf ("events:             %lu x %u rounds\n", count, rounds);
+    for (int path = 0; path < 6; path++) {
+        printf ("%-12s        %6.1f ns/event  %5.1f bytes/event  %lu allocations\n", names[path],
+                results[path].seconds * 1e9 / count, (double)results[path].bytes / count, results[path].allocations);
+    }
+    return !failures && !results[0].allocations && !results[1].allocations && !results[2].allocations
+           && !results[4].allocations;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc < 2 || strcmp (argv[1], "encode")) {
+        fprintf (stderr, "Usage: %s encode [key=value...]\n", argv[0]);
+        return 1;
+    }
+    passed = checkEncode (argc, argv);
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,587 @@
+/**
+  * @file ntpsim.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Deterministic discrete event simulator of the sync process. It runs `NTPSyncFilter` and packet
+  * coding from `NTPCore` against a virtual oscillator, a virtual UDP path and a simulated server, with the
+  * same loop, receiver and timeout timing `NTPClient` uses on ESP32.
+  *
+  * Build on host:
+  *
+  *     g++ -std=c++11 -O2 -I../../src ntpsim.cpp ../../src/NTPCore.cpp -o ntpsim
+  *
+  * Run one scenario with `key=value` options, or the benchmark suite:
+  *
+  *     ./ntpsim days=7 delay_ms=30 jitter_ms=5 asym=0.3 loss=0.05 drift_ppm=20
+  *     ./ntpsim suite
+  *
+  * `trace=FILE` writes every processed exchange as CSV, with true clock error, in the format `ntpreplay` reads.
+  *
+  * `broadcast_s=N` makes the server broadcast every N seconds, as `setBroadcastMode()` expects. The device
+  * calibrates one way delay with a unicast exchange and then only listens. `bad_replies=N` makes the server
+  * answer its first N requests with leap indicator 3, as a server that has just booted; calibration must wait
+  * for a reply that passes the checks:
+  *
+  *     ./ntpsim broadcast_s=64 bad_replies=3 asym=0.3
+  *
+  * Same options and seed always give the same result.
+  */
+
+#include "NTPCore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <queue>
+#include <random>
+#include <vector>
+
+/**
+  * @brief Simulation scenario
+  */
+struct Scenario {
+    const char* name = "custom"; ///< @brief Name for reports
+    double days = 2; ///< @brief Simulated time
+    uint64_t seed = 1; ///< @brief Random seed
+    double driftPpm = 10; ///< @brief Oscillator frequency error
+    double wanderPpb = 1; ///< @brief Frequency random walk, in ppb per square root of second
+    double delayMs = 20; ///< @brief Base round trip delay
+    double jitterMs = 2; ///< @brief Mean of exponential extra delay on each direction
+    double asym = 0; ///< @brief Fraction of base delay moved to upstream direction, -1 to 1
+    double loss = 0; ///< @brief Packet loss probability on each direction
+    double serverOffsetMs = 0; ///< @brief Server clock error
+    double serverDispersionMs = 1; ///< @brief Root dispersion announced by server
+    int serverLi = 0; ///< @brief Leap indicator sent by server
+    int serverStratum = 2; ///< @brief Stratum sent by server
+    int serverPrecision = -20; ///< @brief Server precision, log2 seconds
+    double bootS = 5; ///< @brief Device clock value at start. Devices boot in 1970
+    double broadcastS = 0; ///< @brief Server broadcast period. 0 disables broadcast mode
+    uint32_t badReplies = 0; ///< @brief First requests answered with leap indicator 3
+    NTPSyncConfig_t config; ///< @brief Sync filter settings under test
+    FILE* trace = NULL; ///< @brief Output for exchange trace. May be `NULL`
+};
+
+/**
+  * @brief Simulation results
+  */
+struct Report {
+    double timeToSyncS = -1; ///< @brief True time until status was first synced
+    double timeToAccuracyS = -1; ///< @brief True time until error was first under `minSyncAccuracyUs`
+    double meanAbsErrorUs = 0; ///< @brief Mean absolute clock error after first sync
+    double rmsErrorUs = 0; ///< @brief RMS clock error after first sync
+    double maxAbsErrorUs = 0; ///< @brief Maximum absolute clock error after first sync
+    uint32_t queries = 0; ///< @brief Requests sent
+    uint32_t responses = 0; ///< @brief Responses processed
+    uint32_t timeouts = 0; ///< @brief Requests without response in time
+    uint32_t late = 0; ///< @brief Responses that arrived after timeout
+    uint32_t steps = 0; ///< @brief Clock adjustments
+    uint32_t actions[syncApply + 1] = { 0 }; ///< @brief Filter decisions by `NTPSyncAction_t`
+    uint32_t rejected[NUM_REJECT_REASONS] = { 0 }; ///< @brief Rejected responses by reason
+    uint32_t broadcasts = 0; ///< @brief Broadcast packets processed
+    uint32_t uncalibrated = 0; ///< @brief Broadcast packets dropped because delay was not calibrated
+    uint32_t calibrationRequests = 0; ///< @brief Unicast requests sent to calibrate delay
+    uint32_t calibrationRefused = 0; ///< @brief Calibration replies that did not pass the checks
+    double calibrationS = -1; ///< @brief True time when delay was calibrated
+    double broadcastDelayUs = 0; ///< @brief Calibrated one way delay
+};
+
+/**
+  * @brief Device oscillator. Monotonic time runs at `1 + frequency` times true time
+  */
+class Oscillator {
+public:
+    Oscillator (const Scenario& scenario, std::mt19937_64& random) : random (random) {
+        frequency = scenario.driftPpm * 1e-6;
+        wander = scenario.wanderPpb * 1e-9;
+    }
+
+    /// @brief Advances to a true time and returns monotonic time, in microseconds
+    int64_t at (int64_t trueUs) {
+        if (trueUs > lastTrue) {
+            double dt = (trueUs - lastTrue) / 1e6;
+            monotonic += (trueUs - lastTrue) * (1.0 + frequency);
+            frequency += wander * sqrt (dt) * normal (random);
+            lastTrue = trueUs;
+        }
+        return (int64_t)monotonic;
+    }
+
+    /// @brief Estimates true time when monotonic time reaches a value
+    int64_t trueWhen (int64_t monotonicUs) const {
+        return lastTrue + (int64_t)ceil ((monotonicUs - monotonic) / (1.0 + frequency));
+    }
+
+protected:
+    std::mt19937_64& random; ///< @brief Shared random source
+    std::normal_distribution<double> normal; ///< @brief Standard normal distribution
+    double frequency; ///< @brief Current frequency error
+    double wander; ///< @brief Random walk step per square root of second
+    double monotonic = 0; ///< @brief Monotonic time at `lastTrue`, microseconds
+    int64_t lastTrue = 0; ///< @brief Last true time advanced to
+};
+
+/**
+  * @brief Simulation event kinds
+  */
+enum EventType {
+    loopTick, ///< @brief Loop task checks if a request is due
+    serverReceive, ///< @brief Request arrives to server
+    clientReceive, ///< @brief Response arrives to device. lwIP callback timestamps it
+    receiverTick, ///< @brief Receiver task processes pending response
+    broadcastSend, ///< @brief Server sends a broadcast packet
+    broadcastReceive, ///< @brief Broadcast packet arrives to device. lwIP callback timestamps it
+    broadcastTick, ///< @brief Receiver task processes pending broadcast packet
+    responseTimeout, ///< @brief Response timer fires
+    errorSample ///< @brief Clock error measurement
+};
+
+/**
+  * @brief Scheduled event
+  */
+struct Event {
+    int64_t time; ///< @brief True time, microseconds since simulation start
+    EventType type; ///< @brief Event kind
+    uint32_t request; ///< @brief Request number the event belongs to
+    NTPUndecodedPacket_t packet; ///< @brief Packet in flight
+    bool operator> (const Event& other) const {
+        return time > other.time;
+    }
+};
+
+constexpr int64_t TASK_PERIOD_US = 100000; ///< @brief Loop and receiver task period on ESP32
+constexpr int64_t SAMPLE_PERIOD_US = 10000000; ///< @brief Clock error sampling period
+constexpr int64_t REFERENCE_EPOCH_US = 1760000000LL * 1000000; ///< @brief True UNIX time at simulation start
+constexpr auto SIM_NUM_TIMEOUTS = 3; ///< @brief Same as `DEAULT_NUM_TIMEOUTS` in library
+
+/**
+  * @brief Converts microseconds to `timeval`
+  */
+static timeval toTimeval (int64_t us) {
+    timeval tv;
+    tv.tv_sec = us / 1000000;
+    tv.tv_usec = us % 1000000;
+    return tv;
+}
+
+/**
+  * @brief Runs a scenario
+  * @param scenario Scenario to simulate
+  * @return Results
+  */
+static Report simulate (const Scenario& scenario) {
+    Report report;
+    std::mt19937_64 random (scenario.seed);
+    std::uniform_real_distribution<double> uniform (0.0, 1.0);
+    std::exponential_distribution<double> exponential (1.0);
+    Oscillator oscillator (scenario, random);
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+    NTPSyncConfig_t config = scenario.config;
+    const int64_t end = (int64_t)(scenario.days * 86400e6);
+
+    NTPSyncFilter filter;
+    NTPStatus_t status = unsyncd;
+    int64_t clockBase = (int64_t)(scenario.bootS * 1e6); // System time minus monotonic time
+    int64_t lastGotTime = 0;
+    uint32_t actualInterval = config.shortInterval;
+    uint32_t requestNumber = 0;
+    bool ntpRequested = false;
+    bool responseValid = false;
+    bool firstLoop = true;
+    unsigned int numTimeouts = 0;
+    NTPUndecodedPacket_t response;
+    timeval responseReceived;
+    int64_t responseUptime = 0; // Monotonic time when response arrived
+    int64_t responseError = 0; // Device clock minus true time when response arrived
+    double errorSum = 0, errorSquares = 0;
+    uint32_t errorCount = 0;
+    uint32_t served = 0;
+    bool broadcastSourceValid = false;
+    bool broadcastCalibrated = false;
+    bool broadcastCalibrating = false;
+    bool broadcastValid = false;
+    double broadcastDelay = 0;
+    int64_t lastBroadcast = 0; // Monotonic milliseconds when last broadcast was processed
+    NTPUndecodedPacket_t broadcastPacket;
+    timeval broadcastReceived;
+    
+    config.acceptBroadcast = scenario.broadcastS > 0;
+
+    auto systemTime = [&] (int64_t trueUs) { return oscillator.at (trueUs) + clockBase; };
+    auto oneWay = [&] (bool upstream) {
+        double base = scenario.delayMs * 500.0 * (1.0 + (upstream ? scenario.asym : -scenario.asym));
+        return (int64_t)(base + scenario.jitterMs * 1000.0 * exponential (random));
+    };
+    auto schedule = [&] (int64_t time, EventType type, uint32_t request, const NTPUndecodedPacket_t* packet) {
+        Event event;
+        event.time = time;
+        event.type = type;
+        event.request = request;
+        if (packet) {
+            event.packet = *packet;
+        }
+        events.push (event);
+    };
+    auto nextTask = [&] (int64_t trueUs) { // Tasks wake on multiples of their period, in device time
+        int64_t now = oscillator.at (trueUs);
+        return oscillator.trueWhen ((now / TASK_PERIOD_US + 1) * TASK_PERIOD_US);
+    };
+    auto applyDecision = [&] (const NTPSyncDecision_t& decision, int64_t now) {
+        report.actions[decision.action]++;
+        actualInterval = decision.interval;
+        status = decision.status;
+        if (decision.action == syncRejected || decision.action == syncAccuracyError) {
+            report.rejected[decision.reason]++;
+        }
+        if (decision.action == syncApply) {
+            clockBase += decision.offsetUs;
+            report.steps++;
+        }
+        if (status == syncd && report.timeToSyncS < 0) {
+            report.timeToSyncS = now / 1e6;
+        }
+    };
+
+    schedule (0, loopTick, 0, NULL);
+    if (scenario.broadcastS > 0) {
+        schedule ((int64_t)(scenario.broadcastS * 1e6), broadcastSend, 0, NULL);
+    }
+    schedule (SAMPLE_PERIOD_US, errorSample, 0, NULL);
+
+    while (!events.empty ()) {
+        Event event = events.top ();
+        events.pop ();
+        if (event.time > end) {
+            break;
+        }
+        int64_t now = event.time;
+        
+        switch (event.type) {
+        case loopTick: {
+            int64_t millis = oscillator.at (now) / 1000;
+            // Same as NTPClient::broadcastSyncActive
+            bool listening = broadcastCalibrated && millis - lastBroadcast < config.longInterval;
+            bool requestDue = firstLoop || millis - lastGotTime >= actualInterval;
+            if (requestDue) {
+                firstLoop = false;
+                lastGotTime = millis;
+            }
+            if (requestDue && !listening) {
+                if (broadcastSourceValid && !broadcastCalibrated) {
+                    broadcastCalibrating = true;
+                    report.calibrationRequests++;
+                }
+                NTPUndecodedPacket_t request;
+                memset (&request, 0, sizeof (request));
+                request.flags = 0b11100011;
+                request.pollingInterval = 6;
+                request.clockPrecission = 0xEC;
+                timeval sent = toTimeval (systemTime (now));
+                request.transmit = timeval2timestamp64 (&sent);
+                requestNumber++;
+                report.queries++;
+                ntpRequested = true;
+                schedule (oscillator.trueWhen (oscillator.at (now) + config.ntpTimeout * 1000LL), responseTimeout, requestNumber, NULL);
+                if (uniform (random) >= scenario.loss) {
+                    schedule (now + oneWay (true), serverReceive, requestNumber, &request);
+                }
+            }
+            // Sleep until request is due instead of simulating every idle tick
+            int64_t due = oscillator.trueWhen ((lastGotTime + actualInterval) * 1000LL);
+            schedule (due > now ? due : nextTask (now), loopTick, 0, NULL);
+            break;
+        }
+        case serverReceive: {
+            NTPUndecodedPacket_t reply;
+            int64_t serverNow = REFERENCE_EPOCH_US + now + (int64_t)(scenario.serverOffsetMs * 1000);
+            timeval received = toTimeval (serverNow);
+            timeval transmitted = toTimeval (serverNow + 30);
+            timeval reference = toTimeval (serverNow - 60000000);
+            memset (&reply, 0, sizeof (reply));
+            reply.flags = ((served++ < scenario.badReplies ? 3 : scenario.serverLi) << 6) | (4 << 3) | 4;
+            reply.peerStratum = scenario.serverStratum;
+            reply.pollingInterval = event.packet.pollingInterval;
+            reply.clockPrecission = scenario.serverPrecision;
+            reply.rootDelay = seconds2timestamp32 (0.01);
+            reply.dispersion = seconds2timestamp32 (scenario.serverDispersionMs / 1000.0);
+            reply.reference = timeval2timestamp64 (&reference);
+            reply.origin = event.packet.transmit;
+            reply.receive = timeval2timestamp64 (&received);
+            reply.transmit = timeval2timestamp64 (&transmitted);
+            if (uniform (random) >= scenario.loss) {
+                schedule (now + 30 + oneWay (false), clientReceive, event.request, &reply);
+            }
+            break;
+        }
+        case clientReceive:
+            if (!responseValid) {
+                response = event.packet;
+                responseReceived = toTimeval (systemTime (now));
+                responseUptime = oscillator.at (now);
+                responseError = systemTime (now) - (REFERENCE_EPOCH_US + now);
+                responseValid = true;
+                schedule (nextTask (now), receiverTick, event.request, NULL);
+            }
+            break;
+        case receiverTick: {
+            responseValid = false;
+            if (!ntpRequested) {
+                report.late++;
+                break;
+            }
+            ntpRequested = false;
+            report.responses++;
+            NTPPacket_t packet;
+            double offset, delay;
+            ntpDecodePacket ((uint8_t*)&response, NTP_PACKET_SIZE, &responseReceived, &packet);
+            ntpCalculateOffset (&packet, &offset, &delay);
+            if (scenario.trace) {
+                fprintf (scenario.trace, "%ld.%06ld,%ld.%06ld,%ld.%06ld,%ld.%06ld,%u,%u,%u,%u,%d,%.6f,%.6f,%lld,%lld\n",
+                         (long)packet.origin.tv_sec, (long)packet.origin.tv_usec, (long)packet.receive.tv_sec, (long)packet.receive.tv_usec,
+                         (long)packet.transmit.tv_sec, (long)packet.transmit.tv_usec, (long)responseReceived.tv_sec, (long)responseReceived.tv_usec,
+                         packet.flags.li, packet.flags.vers, packet.flags.mode, packet.peerStratum, scenario.serverPrecision,
+                         packet.rootDelay, packet.dispersion, (long long)responseUptime, (long long)responseError);
+            }
+            // Same conversion as NTPClient::calculateOffset
+            timeval tvOffset;
+            tvOffset.tv_sec = (time_t)offset;
+            tvOffset.tv_usec = (offset - (double)tvOffset.tv_sec) * 1000000.0;
+            int64_t offsetUs = (int64_t)tvOffset.tv_sec * 1000000L + (int64_t)tvOffset.tv_usec;
+            
+            // Same acceptance as NTPClient::processSample
+            bool sane = ntpCheckResponse (&packet, offsetUs, unsyncd, config, NULL);
+            NTPSyncDecision_t decision = filter.processSample (packet, offsetUs, status, config);
+            bool accepted = sane && decision.action != syncRejected && decision.action != syncAccuracyError;
+            if (broadcastCalibrating) {
+                if (accepted) {
+                    broadcastCalibrating = false;
+                    broadcastCalibrated = true;
+                    broadcastDelay = delay / 2.0;
+                    lastBroadcast = oscillator.at (now) / 1000;
+                    report.calibrationS = now / 1e6;
+                    report.broadcastDelayUs = broadcastDelay * 1e6;
+                } else {
+                    report.calibrationRefused++;
+                }
+            }
+            applyDecision (decision, now);
+            break;
+        }
+        case broadcastSend: {
+            NTPUndecodedPacket_t packet;
+            int64_t serverNow = REFERENCE_EPOCH_US + now + (int64_t)(scenario.serverOffsetMs * 1000);
+            timeval transmitted = toTimeval (serverNow);
+            timeval reference = toTimeval (serverNow - 60000000);
+            memset (&packet, 0, sizeof (packet));
+            packet.flags = (scenario.serverLi << 6) | (4 << 3) | 5;
+            packet.peerStratum = scenario.serverStratum;
+            packet.pollingInterval = 6;
+            packet.clockPrecission = scenario.serverPrecision;
+            packet.rootDelay = seconds2timestamp32 (0.01);
+            packet.dispersion = seconds2timestamp32 (scenario.serverDispersionMs / 1000.0);
+            packet.reference = timeval2timestamp64 (&reference);
+            packet.transmit = timeval2timestamp64 (&transmitted);
+            if (uniform (random) >= scenario.loss) {
+                schedule (now + oneWay (false), broadcastReceive, 0, &packet);
+            }
+            schedule (now + (int64_t)(scenario.broadcastS * 1e6), broadcastSend, 0, NULL);
+            break;
+        }
+        case broadcastReceive:
+            if (!broadcastValid) {
+                broadcastPacket = event.packet;
+                broadcastReceived = toTimeval (systemTime (now));
+                broadcastSourceValid = true;
+                broadcastValid = true;
+                schedule (nextTask (now), broadcastTick, 0, NULL);
+            }
+            break;
+        case broadcastTick: {
+            // Same path as NTPClient::processBroadcastPacket
+            broadcastValid = false;
+            NTPPacket_t packet;
+            ntpDecodePacket ((uint8_t*)&broadcastPacket, NTP_PACKET_SIZE, &broadcastReceived, &packet);
+            if (!broadcastCalibrated) {
+                report.uncalibrated++;
+                break;
+            }
+            lastBroadcast = oscillator.at (now) / 1000;
+            report.broadcasts++;
+            double t3 = packet.transmit.tv_sec + packet.transmit.tv_usec / 1000000.0;
+            double t4 = packet.destination.tv_sec + packet.destination.tv_usec / 1000000.0;
+            double offset = t3 + broadcastDelay - t4;
+            timeval tvOffset;
+            tvOffset.tv_sec = (time_t)offset;
+            tvOffset.tv_usec = (offset - (double)tvOffset.tv_sec) * 1000000.0;
+            int64_t offsetUs = (int64_t)tvOffset.tv_sec * 1000000L + (int64_t)tvOffset.tv_usec;
+            applyDecision (filter.processSample (packet, offsetUs, status, config), now);
+            break;
+        }
+        case responseTimeout:
+            if (ntpRequested && event.request == requestNumber) {
+                ntpRequested = false;
+                report.timeouts++;
+                if (++numTimeouts >= SIM_NUM_TIMEOUTS) {
+                    numTimeouts = 0;
+                    actualInterval = config.shortInterval;
+                }
+            }
+            break;
+        case errorSample: {
+            double error = (double)(systemTime (now) - (REFERENCE_EPOCH_US + now));
+            if (report.timeToAccuracyS < 0 && fabs (error) < config.minSyncAccuracyUs) {
+                report.timeToAccuracyS = now / 1e6;
+            }
+            if (report.timeToSyncS >= 0) {
+                errorSum += fabs (error);
+                errorSquares += error * error;
+                errorCount++;
+                if (fabs (error) > report.maxAbsErrorUs) {
+                    report.maxAbsErrorUs = fabs (error);
+                }
+            }
+            schedule (now + SAMPLE_PERIOD_US, errorSample, 0, NULL);
+            break;
+        }
+        }
+    }
+    if (errorCount) {
+        report.meanAbsErrorUs = errorSum / errorCount;
+        report.rmsErrorUs = sqrt (errorSquares / errorCount);
+    }
+    return report;
+}
+
+/**
+  * @brief Sets a scenario option from `key=value` text
+  * @return `false` if option is unknown
+  */
+static bool setOption (Scenario& s, const char* option) {
+    const char* equal = strchr (option, '=');
+    if (!equal) {
+        return false;
+    }
+    size_t length = equal - option;
+    double value = atof (equal + 1);
+    struct { const char* key; double* target; } doubles[] = {
+        { "days", &s.days }, { "drift_ppm", &s.driftPpm }, { "wander_ppb", &s.wanderPpb },
+        { "delay_ms", &s.delayMs }, { "jitter_ms", &s.jitterMs }, { "asym", &s.asym }, { "loss", &s.loss },
+        { "server_offset_ms", &s.serverOffsetMs }, { "dispersion_ms", &s.serverDispersionMs }, { "boot_s", &s.bootS }
+    };
+    for (auto& d : doubles) {
+        if (strlen (d.key) == length && !strncmp (option, d.key, length)) {
+            *d.target = value;
+            return true;
+        }
+    }
+    if (!strncmp (option, "seed=", 5)) s.seed = strtoull (equal + 1, NULL, 10);
+    else if (!strncmp (option, "trace=", 6)) {
+        s.trace = fopen (equal + 1, "w");
+        if (!s.trace) {
+            perror (equal + 1);
+            exit (1);
+        }
+        fputs ("# t1,t2,t3,t4,li,version,mode,stratum,precision,root_delay,dispersion,uptime_us,error_us\n", s.trace);
+    }
+    else if (!strncmp (option, "li=", 3)) s.serverLi = (int)value;
+    else if (!strncmp (option, "broadcast_s=", 12)) s.broadcastS = value;
+    else if (!strncmp (option, "bad_replies=", 12)) s.badReplies = (uint32_t)value;
+    else if (!strncmp (option, "stratum=", 8)) s.serverStratum = (int)value;
+    else if (!strncmp (option, "precision=", 10)) s.serverPrecision = (int)value;
+    else if (!strncmp (option, "short_s=", 8)) s.config.shortInterval = (uint32_t)(value * 1000);
+    else if (!strncmp (option, "long_s=", 7)) s.config.longInterval = (uint32_t)(value * 1000);
+    else if (!strncmp (option, "timeout_ms=", 11)) s.config.ntpTimeout = (uint16_t)value;
+    else if (!strncmp (option, "rounds=", 7)) s.config.numAveRounds = (unsigned int)value;
+    else if (!strncmp (option, "accuracy_us=", 12)) s.config.minSyncAccuracyUs = (long)value;
+    else if (!strncmp (option, "threshold_us=", 13)) s.config.timeSyncThreshold = (long)value;
+    else if (!strncmp (option, "retries=", 8)) s.config.maxNumSyncRetry = (unsigned int)value;
+    else return false;
+    return true;
+}
+
+/**
+  * @brief Prints full report of a scenario
+  */
+static void printReport (const Scenario& s, const Report& r) {
+    static const char* actionNames[] = { "averaging", "skipped", "converged", "rejected", "accuracyError", "apply" };
+    static const char* reasonNames[] = { "short", "decode", "leap", "version", "mode", "stratum", "precision", "dispersion" };
+    
+    printf ("scenario:           %s\n", s.name);
+    printf ("simulated_days:     %g\n", s.days);
+    printf ("time_to_sync_s:     %.1f\n", r.timeToSyncS);
+    printf ("time_to_accuracy_s: %.1f\n", r.timeToAccuracyS);
+    printf ("mean_abs_error_us:  %.1f\n", r.meanAbsErrorUs);
+    printf ("rms_error_us:       %.1f\n", r.rmsErrorUs);
+    printf ("max_abs_error_us:   %.1f\n", r.maxAbsErrorUs);
+    printf ("queries:            %u\n", r.queries);
+    printf ("responses:          %u\n", r.responses);
+    printf ("timeouts:           %u\n", r.timeouts);
+    printf ("late_responses:     %u\n", r.late);
+    printf ("steps:              %u\n", r.steps);
+    for (int i = 0; i <= syncApply; i++) {
+        printf ("action_%-12s %u\n", actionNames[i], r.actions[i]);
+    }
+    for (int i = 0; i < NUM_REJECT_REASONS; i++) {
+        if (r.rejected[i]) {
+            printf ("rejected_%-10s %u\n", reasonNames[i], r.rejected[i]);
+        }
+    }
+    if (s.broadcastS > 0) {
+        printf ("broadcasts:         %u\n", r.broadcasts);
+        printf ("uncalibrated:       %u\n", r.uncalibrated);
+        printf ("calib_requests:     %u\n", r.calibrationRequests);
+        printf ("calib_refused:      %u\n", r.calibrationRefused);
+        printf ("calibrated_at_s:    %.1f\n", r.calibrationS);
+        printf ("broadcast_delay_us: %.1f\n", r.broadcastDelayUs);
+    }
+}
+
+/**
+  * @brief Runs fixed benchmark scenarios and prints one line for each
+  */
+static void runSuite () {
+    std::vector<Scenario> suite (7);
+    suite[0].name = "ideal";
+    suite[0].delayMs = 1; suite[0].jitterMs = 0.05; suite[0].driftPpm = 0; suite[0].wanderPpb = 0;
+    suite[1].name = "wifi";
+    suite[2].name = "asymmetric";
+    suite[2].asym = 0.5; suite[2].delayMs = 40;
+    suite[3].name = "lossy";
+    suite[3].loss = 0.2; suite[3].jitterMs = 10;
+    suite[4].name = "bad_crystal";
+    suite[4].driftPpm = 80; suite[4].wanderPpb = 20;
+    suite[5].name = "server_unsynced";
+    suite[5].serverLi = 3;
+    suite[6].name = "low_dispersion";
+    suite[6].serverDispersionMs = 0.01;
+    
+    printf ("%-16s %10s %10s %10s %10s %10s %8s %8s %8s %6s\n", "scenario", "sync_s", "accur_s", "mean_us", "rms_us", "max_us",
+            "queries", "timeouts", "rejected", "steps");
+    for (auto& s : suite) {
+        s.days = 7;
+        Report r = simulate (s);
+        printf ("%-16s %10.1f %10.1f %10.1f %10.1f %10.1f %8u %8u %8u %6u\n", s.name, r.timeToSyncS, r.timeToAccuracyS,
+                r.meanAbsErrorUs, r.rmsErrorUs, r.maxAbsErrorUs, r.queries, r.timeouts,
+                r.actions[syncRejected] + r.actions[syncAccuracyError], r.steps);
+    }
+}
+
+int main (int argc, char** argv) {
+    Scenario scenario;
+    
+    if (argc > 1 && !strcmp (argv[1], "suite")) {
+        runSuite ();
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (!setOption (scenario, argv[i])) {
+            fprintf (stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    printReport (scenario, simulate (scenario));
+    if (scenario.trace) {
+        fclose (scenario.trace);
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+/**
+  * @file ntpstats.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host checks of sync statistics in `NTPCore`.
+  *
+  * Build on Linux:
+  *
+  *     g++ -std=c++11 -O2 -pthread -I../../src ntpstats.cpp ../../src/NTPCore.cpp -o ntpstats
+  *
+  * Check histogram bucket limits, then update statistics from one writer as `NTPClient` does for every accepted
+  * reply while readers take snapshots with `ntpSeqlockRead()`. Every update keeps counters and histogram totals
+  * equal, so a torn snapshot shows up. Same reads without sequence counter are done as control, they must see
+  * torn snapshots or the check proves nothing:
+  *
+  *     ./ntpstats seqlock readers=4 updates=200000
+  *
+  * Exit status is 0 if every check passes.
+  */
+
+#include "NTPCore.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return atof (argv[i] + length + 1);
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Gets monotonic time in seconds
+  */
+static double seconds () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+  * @brief Adds all buckets of a histogram
+  */
+static uint32_t histogramTotal (const uint32_t* histogram) {
+    uint32_t total = 0;
+    for (int i = 0; i < NTP_HISTOGRAM_BUCKETS; i++) {
+        total += histogram[i];
+    }
+    return total;
+}
+
+/**
+  * @brief Checks that a snapshot comes from a single point between updates
+  * @return `true` if counters and histogram totals agree
+  */
+static bool consistent (const NTPStats_t& snapshot) {
+    uint32_t samples = snapshot.responses;
+    return snapshot.requests == samples &&
+           histogramTotal (snapshot.offset) == samples &&
+           histogramTotal (snapshot.delay) == samples &&
+           histogramTotal (snapshot.dispersion) == samples &&
+           histogramTotal (snapshot.jitter) == (samples ? samples - 1 : 0);
+}
+
+/**
+  * @brief Checks bucket limits and one sample of every histogram
+  * @return Number of failed checks
+  */
+static unsigned checkBuckets () {
+    unsigned failures = 0;
+    NTPStats_t stats = {};
+    int64_t previous = 1000;
+
+    failures += ntpHistogramBucket (0) != 0;
+    failures += ntpHistogramBucket (1) != 1;
+    failures += ntpHistogramBucket (2) != 2;
+    failures += ntpHistogramBucket (3) != 2;
+    failures += ntpHistogramBucket (4) != 3;
+    for (int n = 1; n < NTP_HISTOGRAM_BUCKETS - 1; n++) {
+        // Bucket n covers [2^(n-1), 2^n)
+        failures += ntpHistogramBucket (1ULL << (n - 1)) != n;
+        failures += ntpHistogramBucket ((1ULL << n) - 1) != n;
+    }
+    failures += ntpHistogramBucket (1ULL << (NTP_HISTOGRAM_BUCKETS - 1)) != NTP_HISTOGRAM_BUCKETS - 1;
+    failures += ntpHistogramBucket (UINT64_MAX) != NTP_HISTOGRAM_BUCKETS - 1;
+
+    ntpStatsAddSample (&stats, -1500, 20000, 0.0005f, NULL); // First sample, no jitter
+    ntpStatsAddSample (&stats, 500, -5, 0.0f, &previous);
+    failures += stats.offset[ntpHistogramBucket (1500)] != 1; // Absolute value
+    failures += stats.offset[ntpHistogramBucket (500)] != 1;
+    failures += stats.delay[ntpHistogramBucket (20000)] != 1;
+    failures += stats.delay[0] != 1; // Negative delay clamped
+    failures += stats.dispersion[ntpHistogramBucket (500)] != 1;
+    failures += stats.dispersion[0] != 1;
+    failures += stats.jitter[ntpHistogramBucket (500)] != 1;
+    failures += histogramTotal (stats.jitter) != 1;
+    return failures;
+}
+
+/**
+  * @brief Readers copy statistics while a writer updates them
+  * @param guarded `true` to read with `ntpSeqlockRead()`, `false` for plain copies
+  * @return Number of inconsistent snapshots
+  */
+static unsigned long runReaders (bool guarded, unsigned readers, unsigned long updates, unsigned long* snapshots) {
+    NTPStats_t stats = {};
+    volatile uint32_t sequence = 0;
+    std::atomic<bool> writing (true);
+    std::atomic<unsigned long> torn (0);
+    std::atomic<unsigned long> reads (0);
+    std::vector<std::thread> threads;
+
+    for (unsigned r = 0; r < readers; r++) {
+        threads.emplace_back ([&] {
+            unsigned long localTorn = 0;
+            unsigned long localReads = 0;
+            NTPStats_t snapshot;
+            while (writing) {
+                if (guarded && (sequence & 1)) {
+                    std::this_thread::yield (); // Spinning would take whole time slice of single core hosts from writer
+                    continue;
+                }
+                if (guarded) {
+                    ntpSeqlockRead (&sequence, &stats, &snapshot, sizeof (NTPStats_t));
+                } else {
+                    memcpy (&snapshot, (const void*)&stats, sizeof (NTPStats_t));
+                }
+                localReads++;
+                if (!consistent (snapshot)) {
+                    localTorn++;
+                }
+                std::this_thread::yield ();
+            }
+            torn += localTorn;
+            reads += localReads;
+        });
+    }
+    int64_t previous = 0;
+    for (unsigned long i = 0; i < updates; i++) {
+        int64_t offset = (int64_t)(i * 7919 % 20001) - 10000;
+        ntpSeqlockBeginWrite (&sequence);
+        stats.responses++;
+        if (i % 64 == 0) {
+            std::this_thread::yield (); // Readers get turns in the middle of an update on single core hosts too
+        }
+        ntpStatsAddSample (&stats, offset, 1000 + i % 50000, 0.0001f * (i % 100), i ? &previous : NULL);
+        stats.requests++;
+        ntpSeqlockEndWrite (&sequence);
+        previous = offset;
+        if (i % 64 == 32) {
+            std::this_thread::yield (); // And between updates
+        }
+    }
+    writing = false;
+    for (std::thread& thread : threads) {
+        thread.join ();
+    }
+    *snapshots = reads;
+    return torn + !consistent (stats);
+}
+
+/**
+  * @brief Checks buckets and snapshot consistency under concurrent updates
+  * @return `true` if every guarded snapshot is consistent and the unguarded control saw torn ones
+  */
+static bool checkSeqlock (int argc, char** argv) {
+    unsigned readers = (unsigned)option (argc, argv, "readers", 4);
+    unsigned long updates = (unsigned long)option (argc, argv, "updates", 200000);
+    unsigned long guardedReads = 0;
+    unsigned long plainReads = 0;
+
+    if (!readers || !updates) {
+        return false;
+    }
+    unsigned bucketFailures = checkBuckets ();
+    double start = seconds ();
+    unsigned long guardedTorn = runReaders (true, readers, updates, &guardedReads);
+    double elapsed = seconds () - start;
+    unsigned long plainTorn = runReaders (false, readers, updates, &plainReads);
+
+    printf ("bucket_failures:    %u\n", bucketFailures);
+    printf ("updates:            %lu\n", updates);
+    printf ("seqlock_snapshots:  %lu\n", guardedReads);
+    printf ("seqlock_torn:       %lu\n", guardedTorn);
+    printf ("plain_snapshots:    %lu\n", plainReads);
+    printf ("plain_torn:         %lu\n", plainTorn);
+    printf ("seconds:            %.3f\n", elapsed);
+    return !bucketFailures && guardedReads && !guardedTorn && plainTorn;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc < 2 || strcmp (argv[1], "seqlock")) {
+        fprintf (stderr, "Usage: %s seqlock [key=value...]\n", argv[0]);
+        return 1;
+    }
+    passed = checkSeqlock (argc, argv);
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
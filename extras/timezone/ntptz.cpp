@@ -0,0 +1,613 @@
+/**
+  * @file ntptz.cpp
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Host checks of `NTPTimeZone`.
+  *
+  * Build on Linux:
+  *
+  *     g++ -std=c++11 -O2 -pthread -I../../src ntptz.cpp ../../src/NTPTimeZone.cpp -o ntptz
+  *
+  * Check that concurrent instances following the process wide rule never see a mix of two rules and all end on
+  * the last one set, while a writer keeps changing it, as `NTPClient` instances on several tasks do:
+  *
+  *     ./ntptz threads readers=8 changes=100000
+  *
+  * Drive several instances, each a `NTPTimeZone` with its own `NTPLocalTimeCache` as in `NTPClient`, from their
+  * own threads while the main thread bumps the shared cache generation as clock steps do. First every instance
+  * has a different zone and its rendered strings and cached fields must match an uncached conversion with that
+  * zone. Then instances follow the process rule while it changes: every string must come whole from one rule and
+  * all instances must end on the last one:
+  *
+  *     ./ntptz instances instances=4 renders=200000 changes=20000
+  *
+  * Compare every zone in `TZdef.h` with glibc, which gets the same rule through `TZ` as `setenv()` and `tzset()`
+  * did in the library before. Offset, DST flag, broken down time and abbreviation are checked every `step_s`
+  * seconds across `years` years from `start_year`, and local times are converted back to UTC. Both conversions
+  * are timed over the same timestamps:
+  *
+  *     ./ntptz compare tzdef=../../src/TZdef.h start_year=2025 years=3 step_s=1800
+  *
+  * Convert a batch of sorted timestamps, as a sensor node does with its buffered readings, with `localFields()`
+  * and render them with `NTPFormatDefaultUs`, as `NTPClient::getTimeFormatted()` batch overload does. Fields are
+  * checked against `localtime_r()` and both paths are compared with `localtime_r()`, `strftime()` and
+  * `snprintf()` per element, as `getTimeDateString(timeval)` did. `interval_ms` is mean time between readings:
+  *
+  *     ./ntptz batch count=1000000 interval_ms=1000 tz=CET-1CEST,M3.5.0,M10.5.0/3
+  *
+  * Exit status is 0 if every check passes.
+  */
+
+#include "NTPTimeZone.h"
+#include "NTPTimeFormat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+  * @brief Rules the writer switches between. Different offsets, DST rules and lengths, so a torn copy shows up
+  */
+static const char* const testRules[] = {
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "EST5EDT,M3.2.0,M11.1.0",
+    "<+0545>-5:45",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",
+    "<-03>3",
+};
+constexpr size_t NUM_TEST_RULES = sizeof (testRules) / sizeof (testRules[0]);
+constexpr time_t PROBE_WINTER = 1736942400; ///< @brief 2025-01-15 12:00:00 UTC
+constexpr time_t PROBE_SUMMER = 1752580800; ///< @brief 2025-07-15 12:00:00 UTC
+
+/**
+  * @brief Offsets a rule gives at probe instants. Identifies which rule an instance has loaded
+  */
+struct RuleSignature {
+    int32_t winter; ///< @brief Offset at `PROBE_WINTER`
+    int32_t summer; ///< @brief Offset at `PROBE_SUMMER`
+
+    bool operator== (const RuleSignature& other) const {
+        return winter == other.winter && summer == other.summer;
+    }
+};
+
+/**
+  * @brief Gets offsets of a zone at probe instants
+  */
+static RuleSignature signature (NTPTimeZone& zone) {
+    RuleSignature result;
+    result.winter = zone.getOffset (PROBE_WINTER);
+    result.summer = zone.getOffset (PROBE_SUMMER);
+    return result;
+}
+
+/**
+  * @brief Gets value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static const char* option (int argc, char** argv, const char* key, const char* fallback) {
+    size_t length = strlen (key);
+    for (int i = 2; i < argc; i++) {
+        if (!strncmp (argv[i], key, length) && argv[i][length] == '=') {
+            return argv[i] + length + 1;
+        }
+    }
+    return fallback;
+}
+
+/**
+  * @brief Gets numeric value of a `key=value` argument
+  * @return Value or `fallback` if argument is not present
+  */
+static double option (int argc, char** argv, const char* key, double fallback) {
+    const char* value = option (argc, argv, key, (const char*)NULL);
+    return value ? atof (value) : fallback;
+}
+
+/**
+  * @brief Gets monotonic time in seconds
+  */
+static double seconds () {
+    timespec ts;
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+  * @brief Readers follow process rule while a writer changes it
+  * @return `true` if no reader saw an unknown rule and all ended on the last one
+  */
+static bool checkThreads (int argc, char** argv) {
+    unsigned readers = (unsigned)option (argc, argv, "readers", 8);
+    unsigned long changes = (unsigned long)option (argc, argv, "changes", 100000);
+    RuleSignature expected[NUM_TEST_RULES];
+    std::atomic<bool> writing { true };
+    std::atomic<unsigned long> torn { 0 };
+    std::atomic<unsigned long> reloads { 0 };
+    std::atomic<unsigned long> conversions { 0 };
+    std::vector<std::thread> threads;
+    std::vector<RuleSignature> final (readers);
+
+    for (size_t i = 0; i < NUM_TEST_RULES; i++) {
+        NTPTimeZone reference;
+        if (!reference.parse (testRules[i])) {
+            fprintf (stderr, "Cannot parse %s\n", testRules[i]);
+            return false;
+        }
+        expected[i] = signature (reference);
+    }
+    NTPTimeZone::setProcessRule (testRules[0]);
+
+    double start = seconds ();
+    for (unsigned r = 0; r < readers; r++) {
+        threads.emplace_back ([&, r] {
+            NTPTimeZone zone; // One per instance, as every NTPClient has its own
+            unsigned long localTorn = 0, localReloads = 0, localConversions = 0;
+            bool last;
+            do {
+                last = !writing.load ();
+                if (zone.followProcessRule ()) {
+                    localReloads++;
+                }
+                RuleSignature got = signature (zone);
+                localConversions += 2;
+                bool known = false;
+                for (size_t i = 0; i < NUM_TEST_RULES && !known; i++) {
+                    known = got == expected[i];
+                }
+                if (!known || !zone.isValid ()) {
+                    localTorn++;
+                }
+                std::this_thread::yield (); // Writer gets turns on single core hosts too
+            } while (!last);
+            final[r] = signature (zone);
+            torn += localTorn;
+            reloads += localReloads;
+            conversions += localConversions;
+        });
+    }
+    for (unsigned long i = 1; i <= changes; i++) {
+        NTPTimeZone::setProcessRule (testRules[i % NUM_TEST_RULES]);
+        std::this_thread::yield (); // Let readers catch changes
+    }
+    writing = false;
+    for (std::thread& thread : threads) {
+        thread.join ();
+    }
+    double elapsed = seconds () - start;
+
+    unsigned long diverged = 0;
+    for (unsigned r = 0; r < readers; r++) {
+        if (!(final[r] == expected[changes % NUM_TEST_RULES])) {
+            diverged++;
+        }
+    }
+    printf ("readers:            %u\n", readers);
+    printf ("rule_changes:       %lu\n", changes);
+    printf ("seconds:            %.3f\n", elapsed);
+    printf ("reloads:            %lu\n", reloads.load ());
+    printf ("conversions:        %lu\n", conversions.load ());
+    printf ("unknown_rule:       %lu\n", torn.load ());
+    printf ("diverged_at_end:    %lu\n", diverged);
+    return !torn && !diverged;
+}
+
+/// @brief Cache generation shared by all instances, as `NTPClient::timeCacheGeneration`
+static volatile uint32_t cacheGeneration = 0;
+
+/// @brief Formats instances switch between. Cache compares them by address
+static const char* const testFormats[] = { "%Y-%m-%dT%H:%M:%S", "%d/%m/%Y %H:%M:%S" };
+
+/**
+  * @brief Renders a time with microseconds without any cache, as reference
+  */
+static void renderReference (char* buffer, size_t length, NTPTimeZone& zone, const timeval& moment, const char* format) {
+    tm local;
+    zone.localTime (moment.tv_sec, &local);
+    size_t used = strftime (buffer, length, format, &local);
+    snprintf (buffer + used, length - used, ".%06ld", (long)moment.tv_usec);
+}
+
+/**
+  * @brief Gets time an instance renders at a step. Several steps share a second so cache hits are raced too
+  */
+static timeval instanceMoment (unsigned instance, unsigned long step) {
+    timeval moment;
+    moment.tv_sec = PROBE_WINTER + (time_t)(step / 4) * 3607 + instance * 86400 * 37;
+    moment.tv_usec = (long)((step * 7919 + instance) % 1000000);
+    return moment;
+}
+
+/**
+  * @brief Instances with their own zones and caches render concurrently, then follow a changing process rule
+  * @return `true` if every string and cached field is right for its zone and all instances end on last rule
+  */
+static bool checkInstances (int argc, char** argv) {
+    unsigned instances = (unsigned)option (argc, argv, "instances", 4);
+    unsigned long renders = (unsigned long)option (argc, argv, "renders", 200000);
+    unsigned long changes = (unsigned long)option (argc, argv, "changes", 20000);
+    std::atomic<unsigned> running { 0 };
+    std::atomic<unsigned long> wrong { 0 };
+    std::atomic<unsigned long> mixed { 0 };
+    std::atomic<unsigned long> checked { 0 };
+    std::vector<std::thread> threads;
+    std::vector<int> diverged (instances, 0);
+    unsigned long bumps = 0;
+
+    if (!instances || !renders || NTPTimeZone::getProcessRuleGeneration ()) {
+        return false; // Own zones only hold while process rule was never set
+    }
+    double start = seconds ();
+    // Own zone per instance. Process rule is not set, so zones are not replaced
+    running = instances;
+    for (unsigned t = 0; t < instances; t++) {
+        threads.emplace_back ([&, t] {
+            NTPTimeZone zone;
+            NTPTimeZone reference;
+            NTPLocalTimeCache cache;
+            char got[TIME_CACHE_STR_LENGTH];
+            char expected[TIME_CACHE_STR_LENGTH];
+            unsigned long localWrong = 0;
+            zone.parse (testRules[t % NUM_TEST_RULES]);
+            reference.parse (testRules[t % NUM_TEST_RULES]);
+            for (unsigned long i = 0; i < renders; i++) {
+                timeval moment = instanceMoment (t, i);
+                const char* format = testFormats[(i / 3) % 2];
+                cache.renderUs (got, sizeof (got), moment, format, false, zone, cacheGeneration);
+                renderReference (expected, sizeof (expected), reference, moment, format);
+                tm fields;
+                reference.localTime (moment.tv_sec, &fields);
+                const tm* cached = cache.localTm (moment.tv_sec, zone, cacheGeneration);
+                if (strcmp (got, expected) || cached->tm_hour != fields.tm_hour || cached->tm_mday != fields.tm_mday
+                    || cached->tm_isdst != fields.tm_isdst) {
+                    localWrong++;
+                }
+                if (i % 64 == 0) {
+                    std::this_thread::yield (); // Other instances get turns on single core hosts too
+                }
+            }
+            wrong += localWrong;
+            checked += renders;
+            running--;
+        });
+    }
+    while (running) {
+        cacheGeneration = cacheGeneration + 1; // As a clock step does
+        bumps++;
+        std::this_thread::yield ();
+    }
+    for (std::thread& thread : threads) {
+        thread.join ();
+    }
+    threads.clear ();
+
+    // All instances follow process rule, as NTPClient does, while a writer changes it as setTimeZone() does
+    std::atomic<bool> writing { true };
+    NTPTimeZone::setProcessRule (testRules[0]);
+    cacheGeneration = cacheGeneration + 1;
+    for (unsigned t = 0; t < instances; t++) {
+        threads.emplace_back ([&, t] {
+            NTPTimeZone zone;
+            NTPTimeZone references[NUM_TEST_RULES];
+            NTPLocalTimeCache cache;
+            char got[TIME_CACHE_STR_LENGTH];
+            char expected[TIME_CACHE_STR_LENGTH];
+            unsigned long localMixed = 0;
+            unsigned long i = 0;
+            bool last;
+            for (size_t r = 0; r < NUM_TEST_RULES; r++) {
+                references[r].parse (testRules[r]);
+            }
+            do {
+                last = !writing.load ();
+                timeval moment = instanceMoment (t, i);
+                const char* format = testFormats[(i / 3) % 2];
+                cache.renderUs (got, sizeof (got), moment, format, false, zone, cacheGeneration);
+                size_t match = NUM_TEST_RULES;
+                for (size_t r = 0; r < NUM_TEST_RULES && match == NUM_TEST_RULES; r++) {
+                    renderReference (expected, sizeof (expected), references[r], moment, format);
+                    if (!strcmp (got, expected)) {
+                        match = r;
+                    }
+                }
+                localMixed += match == NUM_TEST_RULES;
+                if (last) {
+                    // Writer is done, instance must be on last rule
+                    renderReference (expected, sizeof (expected), references[changes % NUM_TEST_RULES], moment, format);
+                    diverged[t] = strcmp (got, expected) != 0;
+                }
+                if (++i % 16 == 0) {
+                    std::this_thread::yield ();
+                }
+            } while (!last);
+            mixed += localMixed;
+            checked += i;
+        });
+    }
+    for (unsigned long i = 1; i <= changes; i++) {
+        NTPTimeZone::setProcessRule (testRules[i % NUM_TEST_RULES]);
+        cacheGeneration = cacheGeneration + 1;
+        std::this_thread::yield ();
+    }
+    writing = false;
+    for (std::thread& thread : threads) {
+        thread.join ();
+    }
+    double elapsed = seconds () - start;
+
+    unsigned long divergedCount = 0;
+    for (int d : diverged) {
+        divergedCount += d;
+    }
+    printf ("instances:          %u\n", instances);
+    printf ("generation_bumps:   %lu\n", bumps);
+    printf ("rule_changes:       %lu\n", changes);
+    printf ("renders_checked:    %lu\n", checked.load ());
+    printf ("wrong_own_zone:     %lu\n", wrong.load ());
+    printf ("mixed_rules:        %lu\n", mixed.load ());
+    printf ("diverged_at_end:    %lu\n", divergedCount);
+    printf ("seconds:            %.3f\n", elapsed);
+    return !wrong && !mixed && !divergedCount;
+}
+
+/**
+  * @brief Zone name and POSIX rule from a `TZdef.h` line
+  */
+struct ZoneDefinition {
+    std::string name;
+    std::string rule;
+};
+
+/**
+  * @brief Reads zones from `TZdef.h`. Lines look like `#define TZ_Europe_Madrid<TAB>PSTR("CET-1CEST,M3.5.0,M10.5.0/3")`
+  * @return Zones in file order. Empty if file cannot be read
+  */
+static std::vector<ZoneDefinition> readZones (const char* path) {
+    std::vector<ZoneDefinition> zones;
+    char line[256];
+    FILE* file = fopen (path, "r");
+
+    if (!file) {
+        return zones;
+    }
+    while (fgets (line, sizeof (line), file)) {
+        char name[128];
+        char rule[128];
+        if (sscanf (line, "#define TZ_%127s PSTR(\"%127[^\"]\")", name, rule) == 2) {
+            ZoneDefinition zone;
+            zone.name = name;
+            zone.rule = rule;
+            zones.push_back (zone);
+        }
+    }
+    fclose (file);
+    return zones;
+}
+
+/**
+  * @brief Checks every zone in `TZdef.h` against glibc and times both
+  * @return `true` if all zones parse and every conversion matches glibc
+  */
+static bool checkCompare (int argc, char** argv) {
+    const char* path = option (argc, argv, "tzdef", "../../src/TZdef.h");
+    int32_t startYear = (int32_t)option (argc, argv, "start_year", 2025);
+    int32_t years = (int32_t)option (argc, argv, "years", 3);
+    time_t step = (time_t)option (argc, argv, "step_s", 1800);
+    std::vector<ZoneDefinition> zones = readZones (path);
+    unsigned long checked = 0;
+    unsigned long parseErrors = 0;
+    unsigned long offsetErrors = 0;
+    unsigned long fieldErrors = 0;
+    unsigned long nameErrors = 0;
+    unsigned long roundTripErrors = 0;
+    double glibcTime = 0;
+    double zoneTime = 0;
+    volatile long sink = 0;
+
+    if (zones.empty () || years <= 0 || step <= 0) {
+        fprintf (stderr, "No zones read from %s\n", path);
+        return false;
+    }
+    time_t first = (time_t)NTPTimeZone::daysFromCivil (startYear, 1, 1) * SECS_PER_DAY_TZ;
+    time_t last = (time_t)NTPTimeZone::daysFromCivil (startYear + years, 1, 1) * SECS_PER_DAY_TZ;
+
+    for (const ZoneDefinition& definition : zones) {
+        NTPTimeZone zone;
+        if (!zone.parse (definition.rule.c_str ())) {
+            if (parseErrors++ < 5) {
+                fprintf (stderr, "%s: cannot parse %s\n", definition.name.c_str (), definition.rule.c_str ());
+            }
+            continue;
+        }
+        setenv ("TZ", definition.rule.c_str (), 1);
+        tzset ();
+        unsigned long errors = 0;
+        for (time_t t = first; t < last; t += step) {
+            tm expected;
+            tm got;
+            bool dst;
+            localtime_r (&t, &expected);
+            int32_t offset = zone.getOffset (t, &dst);
+            zone.localTime (t, &got);
+            checked++;
+            if (offset != expected.tm_gmtoff || dst != (expected.tm_isdst > 0)) {
+                offsetErrors++;
+                errors++;
+            }
+            if (got.tm_year != expected.tm_year || got.tm_mon != expected.tm_mon || got.tm_mday != expected.tm_mday ||
+                got.tm_hour != expected.tm_hour || got.tm_min != expected.tm_min || got.tm_sec != expected.tm_sec ||
+                got.tm_wday != expected.tm_wday || got.tm_yday != expected.tm_yday || got.tm_isdst != expected.tm_isdst) {
+                fieldErrors++;
+                errors++;
+            }
+            if (strcmp (zone.getAbbreviation (dst), expected.tm_zone)) {
+                nameErrors++;
+                errors++;
+            }
+            if (zone.toUtc (t + offset, dst ? 1 : 0) != t) {
+                roundTripErrors++;
+                errors++;
+            }
+            if (errors == 1) {
+                errors++; // Report first error of each zone only
+                fprintf (stderr, "%s (%s) at %ld: glibc %02d:%02d %+ld %s, got %02d:%02d %+d %s\n",
+                         definition.name.c_str (), definition.rule.c_str (), (long)t,
+                         expected.tm_hour, expected.tm_min, expected.tm_gmtoff, expected.tm_zone,
+                         got.tm_hour, got.tm_min, offset, zone.getAbbreviation (dst));
+            }
+        }
+
+        // Same timestamps, conversion only
+        double start = seconds ();
+        for (time_t t = first; t < last; t += step) {
+            tm expected;
+            sink += localtime_r (&t, &expected)->tm_hour;
+        }
+        glibcTime += seconds () - start;
+        start = seconds ();
+        for (time_t t = first; t < last; t += step) {
+            tm got;
+            sink += zone.localTime (t, &got)->tm_hour;
+        }
+        zoneTime += seconds () - start;
+    }
+
+    printf ("zones:              %zu\n", zones.size ());
+    printf ("span:               %d..%d every %lds\n", startYear, startYear + years - 1, (long)step);
+    printf ("conversions:        %lu\n", checked);
+    printf ("parse_errors:       %lu\n", parseErrors);
+    printf ("offset_errors:      %lu\n", offsetErrors);
+    printf ("field_errors:       %lu\n", fieldErrors);
+    printf ("name_errors:        %lu\n", nameErrors);
+    printf ("round_trip_errors:  %lu\n", roundTripErrors);
+    printf ("glibc_ns:           %.1f\n", glibcTime * 1e9 / checked);
+    printf ("ntptimezone_ns:     %.1f\n", zoneTime * 1e9 / checked);
+    printf ("speedup:            %.1f\n", glibcTime / zoneTime);
+    return checked && !parseErrors && !offsetErrors && !fieldErrors && !nameErrors && !roundTripErrors && sink != 1;
+}
+
+/**
+  * @brief Converts sorted timestamps in one batch and per element, checks fields and measures elements per second
+  * @return `true` if batch fields match `localtime_r()` for every element
+  */
+static bool checkBatch (int argc, char** argv) {
+    constexpr size_t CHUNK = 16; ///< Same as `TIME_BATCH_CHUNK` in library
+    constexpr size_t STRIDE = NTPFormatDefaultUs::maxLength + 1;
+    const char* rule = option (argc, argv, "tz", "CET-1CEST,M3.5.0,M10.5.0/3");
+    size_t count = (size_t)option (argc, argv, "count", 1000000);
+    double interval = option (argc, argv, "interval_ms", 1000) * 1000;
+    std::vector<int64_t> epochUs (count);
+    std::vector<NTPTimeFields_t> fields (count);
+    std::vector<char> strings (count * STRIDE);
+    unsigned long mismatches = 0;
+    volatile long sink = 0;
+    NTPTimeZone zone;
+
+    if (!count || interval <= 0 || !zone.parse (rule)) {
+        fprintf (stderr, "Bad options or rule %s\n", rule);
+        return false;
+    }
+    setenv ("TZ", rule, 1);
+    tzset ();
+    // Readings with jitter, starting a week before DST starts in Europe so transitions fall in long batches
+    srand (1);
+    int64_t t = (int64_t)1774137600 * 1000000;
+    for (size_t i = 0; i < count; i++) {
+        t += (int64_t)(interval * (0.5 + rand () / (double)RAND_MAX));
+        epochUs[i] = t;
+    }
+
+    double start = seconds ();
+    zone.localFields (epochUs.data (), fields.data (), count);
+    double batchFields = seconds () - start;
+
+    for (size_t i = 0; i < count; i++) {
+        time_t second = (time_t)(epochUs[i] / 1000000);
+        tm expected;
+        localtime_r (&second, &expected);
+        const NTPTimeFields_t& got = fields[i];
+        if (got.year != expected.tm_year + 1900 || got.month != expected.tm_mon + 1 || got.day != expected.tm_mday ||
+            got.hour != expected.tm_hour || got.minute != expected.tm_min || got.second != expected.tm_sec ||
+            got.usec != (uint32_t)(epochUs[i] % 1000000) || got.utcOffset != expected.tm_gmtoff) {
+            if (mismatches++ < 5) {
+                fprintf (stderr, "Element %zu at %ld: expected %02d:%02d:%02d %+ld got %02u:%02u:%02u %+d\n", i, (long)second,
+                         expected.tm_hour, expected.tm_min, expected.tm_sec, expected.tm_gmtoff,
+                         got.hour, got.minute, got.second, got.utcOffset);
+            }
+        }
+    }
+
+    // Batch rendering in chunks, as NTPClient::getTimeFormatted(epochUs, count, buffer, stride)
+    start = seconds ();
+    NTPTimeFields_t chunkFields[CHUNK];
+    for (size_t done = 0; done < count; done += CHUNK) {
+        size_t chunk = count - done < CHUNK ? count - done : CHUNK;
+        zone.localFields (epochUs.data () + done, chunkFields, chunk);
+        for (size_t i = 0; i < chunk; i++) {
+            NTPFormatDefaultUs::format (&strings[(done + i) * STRIDE], STRIDE, chunkFields[i]);
+        }
+    }
+    double batchFormat = seconds () - start;
+    sink += strings[count / 2 * STRIDE];
+
+    start = seconds ();
+    for (size_t i = 0; i < count; i++) {
+        time_t second = (time_t)(epochUs[i] / 1000000);
+        tm local_tm;
+        sink += localtime_r (&second, &local_tm)->tm_sec;
+    }
+    double perCallFields = seconds () - start;
+
+    char buffer[64];
+    unsigned long formatMismatches = 0;
+    start = seconds ();
+    for (size_t i = 0; i < count; i++) {
+        time_t second = (time_t)(epochUs[i] / 1000000);
+        tm local_tm;
+        localtime_r (&second, &local_tm);
+        size_t index = strftime (buffer, sizeof (buffer), "%d/%m/%Y %H:%M:%S", &local_tm);
+        snprintf (buffer + index, sizeof (buffer) - index, ".%06ld", (long)(epochUs[i] % 1000000));
+        formatMismatches += strcmp (buffer, &strings[i * STRIDE]) != 0;
+    }
+    double perCallFormat = seconds () - start;
+    if (formatMismatches) {
+        fprintf (stderr, "%lu rendered strings differ from strftime\n", formatMismatches);
+    }
+
+    printf ("zone:               %s\n", rule);
+    printf ("elements:           %zu\n", count);
+    printf ("span_days:          %.1f\n", (epochUs[count - 1] - epochUs[0]) / 86400e6);
+    printf ("mismatches:         %lu\n", mismatches + formatMismatches);
+    printf ("localtime_r_el_s:   %.0f\n", count / perCallFields);
+    printf ("batch_fields_el_s:  %.0f\n", count / batchFields);
+    printf ("fields_speedup:     %.1f\n", perCallFields / batchFields);
+    printf ("strftime_el_s:      %.0f\n", count / perCallFormat);
+    printf ("batch_format_el_s:  %.0f\n", count / batchFormat);
+    printf ("format_speedup:     %.1f\n", perCallFormat / batchFormat);
+    return !mismatches && !formatMismatches && sink != 1;
+}
+
+int main (int argc, char** argv) {
+    bool passed;
+
+    if (argc >= 2 && !strcmp (argv[1], "threads")) {
+        passed = checkThreads (argc, argv);
+    } else if (argc >= 2 && !strcmp (argv[1], "instances")) {
+        passed = checkInstances (argc, argv);
+    } else if (argc >= 2 && !strcmp (argv[1], "compare")) {
+        passed = checkCompare (argc, argv);
+    } else if (argc >= 2 && !strcmp (argv[1], "batch")) {
+        passed = checkBatch (argc, argv);
+    } else {
+        fprintf (stderr, "Usage: %s threads|instances|compare|batch [key=value...]\n", argv[0]);
+        return 1;
+    }
+    printf ("%s\n", passed ? "PASS" : "FAIL");
+    return passed ? 0 : 1;
+}
@@ -48,6 +48,16 @@ const char* extractFileName (const char* path);
 #endif
 
 
+#ifdef NTP_SYNC_TRACE
+#define NTP_TRACE_BEGIN() traceBegin()
+#define NTP_TRACE_MARK(phase) traceMark(phase)
+#define NTP_TRACE_END() traceEnd()
+#else
+#define NTP_TRACE_BEGIN()
+#define NTP_TRACE_MARK(phase)
+#define NTP_TRACE_END()
+#endif // NTP_SYNC_TRACE
+
 #ifdef ESP8266
 const char* IRAM_ATTR extractFileName (const char* path) {
     size_t i = 0;
@@ -66,7 +76,15 @@ const char* IRAM_ATTR extractFileName (const char* path) {
 
 NTPClient NTP;
 
-const int seventyYears = 2208988800UL; // From 1900 to 1970
+volatile uint32_t NTPClient::timeCacheGeneration = 0;
+
+#ifdef ESP32
+#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
+#ifdef CONFIG_LWIP_TCPIP_CORE_LOCKING
+static bool udpCoreLocked = false; // True only if lock was taken by udp_mutex_lock. Callbacks run with lock already held by lwIP
+#endif
+#endif
+#endif
 
 void udp_mutex_lock() {
   #ifdef ESP32
@@ -74,6 +92,7 @@ void udp_mutex_lock() {
       #ifdef CONFIG_LWIP_TCPIP_CORE_LOCKING
         if (!sys_thread_tcpip(LWIP_CORE_LOCK_QUERY_HOLDER)) {
           LOCK_TCPIP_CORE();
+          udpCoreLocked = true;
         }
 			#endif
     #endif
@@ -84,7 +103,8 @@ void udp_mutex_unlock() {
 	#ifdef ESP32
 		#if (ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 0, 0))
       #ifdef CONFIG_LWIP_TCPIP_CORE_LOCKING
-        if (sys_thread_tcpip(LWIP_CORE_LOCK_QUERY_HOLDER)) {
+        if (udpCoreLocked && sys_thread_tcpip(LWIP_CORE_LOCK_QUERY_HOLDER)) {
+          udpCoreLocked = false;
           UNLOCK_TCPIP_CORE();
         }
       #endif
@@ -92,34 +112,6 @@ void udp_mutex_unlock() {
 	#endif
 }
 
-int32_t flipInt32 (int32_t number) {
-    uint8_t output[sizeof (int32_t)];
-    uint8_t* input = (uint8_t*)&number;
-    //DEBUGLOGV ("Input number %08X", number);
-
-    for (unsigned int i = 1; i <= sizeof (int32_t); i++) {
-        output[i - 1] = input[sizeof (int32_t) - i];
-    }
-
-    //DEBUGLOGV ("Output number %08X", *(int32_t*)output);
-    int32_t* result = (int32_t*)output;
-    return *result;
-}
-
-int16_t flipInt16 (int16_t number) {
-    uint8_t output[sizeof (int16_t)];
-    uint8_t* input = (uint8_t*)&number;
-    //DEBUGLOGV ("Input number %08X", number);
-
-    for (unsigned int i = 1; i <= sizeof (int16_t); i++) {
-        output[i - 1] = input[sizeof (int16_t) - i];
-    }
-
-    //DEBUGLOGV ("Output number %08X", *(int32_t*)output);
-    int16_t* result = (int16_t*)output;
-    return *result;
-}
-
 char* dumpNTPPacket (char* data, size_t length, char* buffer, int len) {
     int remaining = len - 1;
     int index = 0;
@@ -144,6 +136,53 @@ char* dumpNTPPacket (char* data, size_t length, char* buffer, int len) {
     return buffer;
 }
 
+udp_pcb* newNtpSocket () {
+#if LWIP_IPV6
+    return udp_new_ip_type (IPADDR_TYPE_ANY); // Dual stack socket
+#else
+    return udp_new ();
+#endif // LWIP_IPV6
+}
+
+err_t bindNtpSocket (udp_pcb* udp, uint16_t port, bool anyAddress = false) {
+    err_t result;
+#if LWIP_IPV6
+    // Bind to any address so that both IPv4 and IPv6 servers may be reached, even on IPv6 only networks
+    DEBUGLOGI ("Bind UDP port %d to any IPv4 or IPv6 address", port);
+    udp_mutex_lock();
+    result = udp_bind (udp, IP_ANY_TYPE, port);
+    udp_mutex_unlock();
+#else
+    ip_addr_t localAddress;
+    ip_addr_set_ip4_u32 (&localAddress, anyAddress ? 0 : (uint32_t)getDeviceIP ());
+    DEBUGLOGI ("Bind UDP port %d to %s", port, ipaddr_ntoa (&localAddress));
+    udp_mutex_lock();
+    result = udp_bind (udp, &localAddress, port);
+    udp_mutex_unlock();
+#endif // LWIP_IPV6
+    return result;
+}
+
+IPAddress ipAddr2IPAddress (const ip_addr_t* address) {
+#if defined ESP32 && ESP_ARDUINO_VERSION_MAJOR >= 3
+    IPAddress result;
+    result.from_ip_addr_t (address);
+    return result;
+#elif defined ESP8266
+    return IPAddress (*address);
+#else // ESP32 Arduino 2.x IPAddress is IPv4 only
+    if (IP_IS_V4 (address)) {
+        return IPAddress (ip4_addr_get_u32 (ip_2_ip4 (address)));
+    }
+    return IPAddress ();
+#endif
+}
+
+void NTPClient::setEventAddress (NTPEvent_t& event, const ip_addr_t* address) {
+    ip_addr_copy (event.info.serverAddr, *address);
+    event.info.serverAddress = ipAddr2IPAddress (address);
+}
+
 bool NTPClient::begin (const char* ntpServerName, bool manageWifi) {
     err_t result;
 
@@ -169,7 +208,7 @@ bool NTPClient::begin (const char* ntpServerName, bool manageWifi) {
         udp = NULL;
     }
     
-    udp = udp_new ();
+    udp = newNtpSocket ();
     udp_mutex_unlock();
     
     if (!udp) {
@@ -179,18 +218,7 @@ bool NTPClient::begin (const char* ntpServerName, bool manageWifi) {
     DEBUGLOGI ("NTP socket created");
     
     if (connectionStatus ()) {
-        ip_addr_t localAddress;
-#ifdef ESP32
-        localAddress.u_addr.ip4.addr = getDeviceIP ();
-        localAddress.type = IPADDR_TYPE_V4;
-        DEBUGLOGI ("Bind UDP port %d to %s", DEFAULT_LOCAL_PORT, IPAddress (localAddress.u_addr.ip4.addr).toString ().c_str ());
-#else
-        localAddress.addr = getDeviceIP ();
-        DEBUGLOGI ("Bind UDP port %d to %s", DEFAULT_LOCAL_PORT, IPAddress (localAddress.addr).toString ().c_str ());
-#endif
-        udp_mutex_lock();
-        result = udp_bind (udp, /*IP_ADDR_ANY*/ &localAddress, DEFAULT_LOCAL_PORT);
-        udp_mutex_unlock();
+        result = bindNtpSocket (udp, localPort);
         
         if (result) {
             DEBUGLOGE ("Failed to bind to NTP port. %d: %s", result, lwip_strerr (result));
@@ -254,6 +282,7 @@ bool NTPClient::begin (const char* ntpServerName, bool manageWifi) {
             &receiverHandle, /* Task handle to keep track of created task */
             CONFIG_ARDUINO_RUNNING_CORE);
     }
+    startEventTask ();
 #else
     loopTimer.attach_ms (ESP8266_LOOP_TASK_INTERVAL, &NTPClient::s_getTimeloop, (void*)this);
     receiverTimer.attach_ms (ESP8266_RECEIVER_TASK_INTERVAL, &NTPClient::s_receiverTask, (void*)this);
@@ -268,8 +297,6 @@ bool NTPClient::begin (const char* ntpServerName, bool manageWifi) {
 
 void NTPClient::processPacket (struct pbuf* packet) {
     NTPPacket_t ntpPacket;
-    bool offsetApplied = false;
-    static bool wasPartial;
     
     if (!packet) {
         DEBUGLOGE ("Received packet empty");
@@ -283,20 +310,24 @@ void NTPClient::processPacket (struct pbuf* packet) {
     }
     
     ntpRequested = false;
+    statsCount (stats.responses);
+    NTP_TRACE_MARK (traceProcessing);
     
     if (packet->len < NTP_PACKET_SIZE) {
         DEBUGLOGE ("Response Error");
+        statsCount (stats.rejected[rejectShortPacket]);
         status = unsyncd;
         DEBUGLOGW ("Status set to UNSYNCD");
-        if (onSyncEvent) {
+        if (wantsEvent (responseError)) {
             NTPEvent_t event;
             event.event = responseError;
-            event.info.serverAddress = ntpServerIPAddress;
+            setEventAddress (event, &ntpServerAddr);
             event.info.port = DEFAULT_NTP_PORT;
             event.info.offset = 0;
             event.info.delay = 0;
-            onSyncEvent (event);
+            emitEvent (event);
         }  
+        NTP_TRACE_END ();
         //pbuf_free (packet);
         return;
     }
@@ -305,135 +336,147 @@ void NTPClient::processPacket (struct pbuf* packet) {
 
     if (!decodeNtpMessage ((uint8_t*)packet->payload, packet->len, &ntpPacket)) {
         DEBUGLOGE ("Null pointer packet");
+        statsCount (stats.rejected[rejectDecode]);
+        NTP_TRACE_END ();
         return;
     }
     timeval tvOffset = calculateOffset (&ntpPacket);
+    NTP_TRACE_MARK (traceDecoded);
+    
+    processSample (&ntpPacket, tvOffset, unicastSample, &requestAddr);
+    NTP_TRACE_END ();
+}
+
+void NTPClient::processSample (NTPPacket_t* packet, timeval tvOffset, NTPSampleSource_t source, const ip_addr_t* sourceAddress) {
+    NTPPacket_t& ntpPacket = *packet;
     
     int64_t offset_us = (int64_t)tvOffset.tv_sec * 1000000L + (int64_t)tvOffset.tv_usec;
-    offsetSum += offset_us;
-    round++;
-    offsetAve = offsetSum / round;
-    DEBUGLOGI ("offset %lld -- sum %lld -- round %u -- average %lld", offset_us, offsetSum, round, offsetAve);
-    
-    if (round >= numAveRounds) {
-        tvOffset.tv_sec = offsetAve / 1000000L;
-        tvOffset.tv_usec = offsetAve - tvOffset.tv_sec * 1000000;
-        //Serial.printf ("\nResult offset = %ld.%06ld\n\n", tvOffset.tv_sec, tvOffset.tv_usec);
-        round = 0;
-        offsetSum = 0;
-    } else {
-        actualInterval = ntpTimeout + 500; // Set retry period equal to timeout + 500 ms
+    NTPSyncConfig_t config = getSyncConfig ();
+    NTPRejectReason_t reason = NUM_REJECT_REASONS;
+    // Header checks on this reply alone. Accuracy checks need the averaged offset, filter does them
+    bool sane = ntpCheckResponse (&ntpPacket, offset_us, unsyncd, config, &reason);
+    NTPSyncFilter& filter = source == peerSample ? peerFilter : syncFilter;
+    NTPSyncDecision_t decision = filter.processSample (ntpPacket, offset_us, status, config);
+    bool accepted = sane && decision.action != syncRejected && decision.action != syncAccuracyError;
+    int64_t offsetAve = decision.offsetUs;
+    DEBUGLOGI ("offset %lld -- average %lld", offset_us, offsetAve);
+    
+    if (source == unicastSample && accepted) {
+        upstreamFailures = 0;
+        peerFilter.reset (); // Upstream is back. A peer round left half done must not be resumed later
+        statsAddSample (offset_us, (int64_t)(delay * 1000000.0), ntpPacket.dispersion); // Rejected ones only count in stats.rejected
+        if (broadcastCalibrating && ip_addr_cmp (sourceAddress, &broadcastSourceAddr)) {
+            broadcastCalibrating = false;
+            broadcastDelay = delay / 2.0;
+            broadcastCalibrated = true;
+            DEBUGLOGI ("Broadcast one way delay calibrated to %0.3f ms", broadcastDelay * 1000.0);
+        }
+    } else if (source == unicastSample && !sane) {
+        upstreamFailures++; // Server answers but does not serve time, as with LI=3 or Kiss-o'-Death
+        poolMemberFailed (true); // Only a reply that fails header checks proves this member is not usable
+        if (decision.action != syncRejected && decision.action != syncAccuracyError) {
+            statsCount (stats.rejected[reason]); // Filter only checks last reply of an averaging round
+        }
+    }
+    
+    actualInterval = decision.interval;
+    tvOffset.tv_sec = offsetAve / 1000000L;
+    tvOffset.tv_usec = offsetAve - tvOffset.tv_sec * 1000000;
+    if (source == unicastSample && accepted
+        && (decision.action == syncApply || decision.action == syncSkipped || decision.action == syncConverged)) {
+        allanAddSample (tvOffset); // Averaged offset, before it is applied. Phase must not include rejected or partial rounds
+    }
+    
+    switch (decision.action) {
+    case syncAveraging:
         DEBUGLOGI ("Retry in %u ms", actualInterval);
         return;
-    }
     
-    if (abs (offsetAve) < timeSyncThreshold) {
-        DEBUGLOGW ("Offset under threshold. Not updating");
-        status = syncd;
-        numDispersionErrors = 0;
-        actualInterval = longInterval;
-        numSyncRetry = 0;
+    case syncConverged:
+    case syncSkipped:
+        status = decision.status;
         DEBUGLOGI ("Offset %0.3f ms is under threshold %ld. Not updating", offsetAve / 1000.0, timeSyncThreshold);
-        if (wasPartial) {
-            wasPartial = false;
-            if (onSyncEvent) {
+        if (decision.action == syncConverged) {
+            if (wantsEvent (timeSyncd)) {
                 NTPEvent_t event;
                 event.event = timeSyncd;
                 DEBUGLOGI ("Status set to SYNCD");
                 event.info.offset = offsetAve / 1000000.0;
-                event.info.serverAddress = ntpServerIPAddress;
+                setEventAddress (event, sourceAddress);
                 event.info.port = DEFAULT_NTP_PORT;
                 event.info.delay = delay;
                 event.info.dispersion = ntpPacket.dispersion;
-                onSyncEvent (event);
+                emitEvent (event);
             }
-
         } else {
-            if (onSyncEvent) {
+            if (wantsEvent (syncNotNeeded)) {
                 NTPEvent_t event;
                 event.event = syncNotNeeded;
                 event.info.offset = offsetAve / 1000000.0;
                 event.info.dispersion = ntpPacket.dispersion;
-                event.info.serverAddress = ntpServerIPAddress;
+                setEventAddress (event, sourceAddress);
                 event.info.port = DEFAULT_NTP_PORT;
-                onSyncEvent (event);
+                emitEvent (event);
             }
         }
         return;
-    }
-        
-    if (!checkNTPresponse (&ntpPacket, offsetAve)) {
-        numDispersionErrors++;
-        DEBUGLOGW ("Not valid or inaccurate response #%d", numDispersionErrors);
-        if (numDispersionErrors > maxDispersionErrors) {
-            numDispersionErrors = 0;
-            
-            if (onSyncEvent) {
+    
+    case syncRejected:
+    case syncAccuracyError:
+        statsCount (stats.rejected[decision.reason]);
+        DEBUGLOGW ("Not valid or inaccurate response. Reason %d", decision.reason);
+        if (decision.action == syncAccuracyError) {
+            if (wantsEvent (accuracyError)) {
                 NTPEvent_t event;
                 event.event = accuracyError;
                 event.info.offset = offsetAve / 1000000.0;
                 event.info.dispersion = ntpPacket.dispersion;
-                event.info.serverAddress = ntpServerIPAddress;
+                setEventAddress (event, sourceAddress);
                 event.info.port = DEFAULT_NTP_PORT;
-                onSyncEvent (event);
+                emitEvent (event);
             }
-                            
-            // if (status == syncd) {
-            //     actualInterval = longInterval;
-            // } else {
-            actualInterval = shortInterval;
-            // }
             DEBUGLOGI ("Status = %s. Next sync in %d milliseconds", status == syncd ? "SYNCD" : "UNSYNCD", actualInterval);
-        } else {
-	    actualInterval = shortInterval *4;
-	}
+        }
         return;
-    } else {
-        numDispersionErrors = 0;
-        lastNtpPacket = ntpPacket;
-        DEBUGLOGI ("Valid NTP response");
+    
+    case syncApply:
+        break;
     }
-
-    if (!adjustOffset (&tvOffset)) {
+    
+    if (source == unicastSample) {
+        poolMemberSucceeded ();
+        preferredAddrType = IP_GET_TYPE (&ntpServerAddr);
+    }
+    lastNtpPacket = ntpPacket;
+    DEBUGLOGI ("Valid NTP response");
+
+    if (adjustOffset (&tvOffset)) {
+        NTPUpstream_t source;
+        source.valid = true;
+        ip_addr_copy (source.address, *sourceAddress);
+        source.stratum = ntpPacket.flags.li == 3 ? 16 : ntpPacket.peerStratum;
+        source.rootDelay = ntpPacket.rootDelay + (float)fabs (delay);
+        source.rootDispersion = ntpPacket.dispersion;
+        source.reference = lastSyncd;
+        setUpstream (source);
+    } else {
         DEBUGLOGE ("Error applying offset");
-        if (onSyncEvent) {
+        if (wantsEvent (syncError)) {
             NTPEvent_t event;
             event.event = syncError;
-            event.info.serverAddress = ntpServerIPAddress;
+            setEventAddress (event, sourceAddress);
             event.info.port = DEFAULT_NTP_PORT;
             event.info.offset = (float)tvOffset.tv_sec + (float)tvOffset.tv_usec / 1000000.0;
-            onSyncEvent (event);
+            emitEvent (event);
         }
     }
-    offsetApplied = true;
 
-    if (tvOffset.tv_sec != 0 || abs (tvOffset.tv_usec) > minSyncAccuracyUs) { // Offset bigger than 10 ms
+    status = decision.status;
+    if (status == partialSync) {
         DEBUGLOGW ("Minimum accuracy not reached. Repeating sync");
-        if (numSyncRetry < maxNumSyncRetry) {
-            DEBUGLOGI ("Status set to PARTIAL SYNC");
-            status = partialSync;
-            numSyncRetry++;
-            wasPartial = true;
-        } else {
-            status = syncd;
-            numSyncRetry = 0;
-            wasPartial = false;
-        }
+        DEBUGLOGI ("Status set to PARTIAL SYNC");
     } else {
         DEBUGLOGI ("Status set to SYNCD");
-        DEBUGLOGI ("Next sync programmed for %d seconds", getLongInterval ());
-        status = syncd;
-        numSyncRetry = 0;
-        if (wasPartial) {
-            offsetApplied = true;
-        }
-        //Serial.printf ("Status: %d wasPartial: %d offsetApplied %d Offset %0.3f\n", status, wasPartial, offsetApplied, ((float)tvOffset.tv_sec + (float)tvOffset.tv_usec / 1000000.0) * 1000);
-        wasPartial = false;
-    }
-    if (status == partialSync) {
-        actualInterval = ntpTimeout + 500; //shortInterval;
-    } else {
-        actualInterval = longInterval;
         DEBUGLOGI ("Sync frequency set low");
     }
     DEBUGLOGI ("Interval set to = %d", actualInterval);
@@ -441,11 +484,11 @@ void NTPClient::processPacket (struct pbuf* packet) {
     if (!firstSync.tv_sec) {
         firstSync = lastSyncd;
     }
-    if (offsetApplied && onSyncEvent) {
+    if (wantsEvent (status == partialSync ? partlySync : timeSyncd)) {
         NTPEvent_t event;
         if (status == partialSync) {
             event.event = partlySync;
-            event.info.retrials = numSyncRetry;
+            event.info.retrials = decision.retries;
             //event.info.offset = offset;
         } else {
             event.event = timeSyncd;
@@ -453,9 +496,9 @@ void NTPClient::processPacket (struct pbuf* packet) {
         event.info.offset = (float)tvOffset.tv_sec + (float)tvOffset.tv_usec / 1000000.0;
         event.info.delay = delay;
         event.info.dispersion = ntpPacket.dispersion;
-        event.info.serverAddress = ntpServerIPAddress;
+        setEventAddress (event, sourceAddress);
         event.info.port = DEFAULT_NTP_PORT;
-        onSyncEvent (event);
+        emitEvent (event);
     }
 }
 
@@ -465,6 +508,19 @@ void NTPClient::s_recvPacket (void* arg, struct udp_pcb* pcb, struct pbuf* p,
     
     NTPClient* self = reinterpret_cast<NTPClient*>(arg);
     gettimeofday (&(self->packetLastReceived), NULL);
+#ifdef NTP_PACKET_CAPTURE
+    if (self->packetCapture.isEnabled ()) {
+        unsigned long started = ::micros ();
+        self->packetCapture.capture (captureReceived, (const uint8_t*)p->payload, p->len, ip_current_dest_addr (), self->localPort,
+                                     addr, port, getUptimeUs (), &(self->packetLastReceived));
+        updateMaxTime (self->maxCaptureTime, started);
+    }
+#endif // NTP_PACKET_CAPTURE
+#ifdef NTP_SYNC_TRACE
+    if (self->ntpRequested) {
+        self->traceMark (traceReceived); // Late or unrequested replies do not belong to current cycle
+    }
+#endif // NTP_SYNC_TRACE
     DEBUGLOGI ("NTP Packet received from %s:%d", ipaddr_ntoa (addr), port);
     self->lastNtpResponsePacket = p;
     self->responsePacketValid = true;
@@ -476,6 +532,7 @@ void NTPClient::s_receiverTask (void* arg) {
     for (;;) {
     //while (!self->terminateTasks) {
 #endif
+        unsigned long started = ::micros ();
         if (self->responsePacketValid) {
             self->processPacket (self->lastNtpResponsePacket);
             if (self->lastNtpResponsePacket->ref > 0) {
@@ -489,6 +546,17 @@ void NTPClient::s_receiverTask (void* arg) {
             }
             self->responsePacketValid = false;
         }
+        if (self->broadcastPacketValid) {
+            self->processBroadcastPacket ();
+            self->broadcastPacketValid = false;
+        }
+        for (uint8_t i = 0; i < self->numPeers; i++) {
+            if (self->peerPacketValid[i]) {
+                self->processPeerPacket (i);
+                self->peerPacketValid[i] = false;
+            }
+        }
+        updateMaxTime (self->maxReceiveContextTime, started);
 #ifdef ESP32
         const TickType_t xDelay = 100 / portTICK_PERIOD_MS;
         vTaskDelay (xDelay);
@@ -498,25 +566,28 @@ void NTPClient::s_receiverTask (void* arg) {
 #endif
 }
 
-char* NTPClient::getUptimeString () {
-    uint16_t days;
-    uint8_t hours;
-    uint8_t minutes;
-    uint8_t seconds;
-
-    time_t uptime = getUptime ();
-
-    seconds = uptime % SECS_PER_MIN;
-    uptime -= seconds;
-    minutes = (uptime % SECS_PER_HOUR) / SECS_PER_MIN;
-    uptime -= minutes * SECS_PER_MIN;
-    hours = (uptime % SECS_PER_DAY) / SECS_PER_HOUR;
-    uptime -= hours * SECS_PER_HOUR;
-    days = uptime / SECS_PER_DAY;
-
-    snprintf (strBuffer, sizeof (strBuffer) - 1, "%4u days %02d:%02d:%02d", days, hours, minutes, seconds);
+size_t NTPClient::formatLocalTime (char* buffer, size_t length, time_t moment, long usec, const char* format, bool withZone) {
+    return ntpFormatLocalTime (buffer, length, moment, usec, format, withZone);
+}
 
-    return strBuffer;
+void NTPClient::getTimeFields (const int64_t* epochUs, NTPTimeFields_t* fields, size_t count) {
+    localZone.followProcessRule ();
+    if (localZone.isValid ()) {
+        localZone.localFields (epochUs, fields, count);
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        timeval moment;
+        int64_t seconds = epochUs[i] / 1000000;
+        int32_t usec = (int32_t)(epochUs[i] - seconds * 1000000);
+        if (usec < 0) {
+            seconds--;
+            usec += 1000000;
+        }
+        moment.tv_sec = (time_t)seconds;
+        moment.tv_usec = usec;
+        fields[i] = timeCache.localFields (moment, localZone, timeCacheGeneration);
+    }
 }
 
 void NTPClient::s_getTimeloop (void* arg) {
@@ -526,13 +597,24 @@ void NTPClient::s_getTimeloop (void* arg) {
    // while (!self->terminateTasks) {
 #endif // ESP32
         //DEBUGLOGI ("Running periodic task");
-        static time_t lastGotTime;
-        if (::millis () - lastGotTime >= self->actualInterval) {
-            lastGotTime = ::millis ();
-            DEBUGLOGI ("Periodic loop. Millis = %d", lastGotTime);
+        unsigned long loopStarted = ::micros ();
+        if (self->reconnectRequested) {
+            self->reconnectRequested = false;
+            connectionReconnect ();
+        }
+        if (::millis () - self->lastGotTime >= self->actualInterval) {
+            self->lastGotTime = ::millis ();
+            DEBUGLOGI ("Periodic loop. Millis = %lu", self->lastGotTime);
             if (self->isConnected) {
                 if (connectionStatus ()) {
-                    self->getTime ();
+                    if (self->broadcastSyncActive ()) {
+                        DEBUGLOGD ("Getting time from broadcasts. No request sent");
+                    } else {
+                        self->getTime ();
+                    }
+                    if (self->numPeers) {
+                        self->sendPeerPackets ();
+                    }
                 } else {
                     DEBUGLOGE ("DISCONNECTED");
                     udp_mutex_lock();
@@ -555,7 +637,7 @@ void NTPClient::s_getTimeloop (void* arg) {
                         self->udp = NULL;
                     }
 
-                    self->udp = udp_new ();
+                    self->udp = newNtpSocket ();
                     udp_mutex_unlock();
                     
                     if (!self->udp) {
@@ -563,16 +645,7 @@ void NTPClient::s_getTimeloop (void* arg) {
                         return; // false;
                     }
 
-                    ip_addr_t localAddress;
-#ifdef ESP32
-                    localAddress.u_addr.ip4.addr = getDeviceIP ();
-                    localAddress.type = IPADDR_TYPE_V4;
-#else // ESP8266
-                    localAddress.addr = getDeviceIP ();
-#endif // ESP32
-                    udp_mutex_lock();
-                    err_t result = udp_bind (self->udp, /*IP_ADDR_ANY*/ &localAddress, DEFAULT_LOCAL_PORT);
-                    udp_mutex_unlock();
+                    err_t result = bindNtpSocket (self->udp, self->localPort);
                     
                     DEBUGLOGI ("Bind UDP port");
                     if (result) {
@@ -599,7 +672,13 @@ void NTPClient::s_getTimeloop (void* arg) {
                     self->getTime ();
                 }
             }
+        } else if (self->isConnected && !self->ntpRequested && self->dnsCacheNeedsRefresh ()) {
+            DEBUGLOGI ("Refreshing NTP server address before it expires");
+            if (connectionStatus ()) {
+                self->resolveNtpServer (false);
+            }
         }
+        updateMaxTime (self->maxLoopBlockingTime, loopStarted);
 #ifdef ESP32
 
         const TickType_t xDelay = 100 / portTICK_PERIOD_MS;
@@ -615,83 +694,380 @@ void NTPClient::s_getTimeloop (void* arg) {
 #endif // ESP32
 }
 
-void NTPClient::getTime () {
+#if LWIP_IPV6
+constexpr uint8_t dnsAddrTypes[] = { LWIP_DNS_ADDRTYPE_IPV4, LWIP_DNS_ADDRTYPE_IPV6 }; ///< A and AAAA records are looked up separately
+#else
+constexpr uint8_t dnsAddrTypes[] = { 0 };
+#endif // LWIP_IPV6
+constexpr uint8_t numDnsAddrTypes = sizeof (dnsAddrTypes) / sizeof (dnsAddrTypes[0]);
+
+void NTPClient::resolveNtpServer (bool sendWhenResolved) {
+    ip_addr_t address;
     err_t result;
-    static unsigned int dnsErrors = 0;
     
-    result = WiFi.hostByName (getNtpServerName (), ntpServerIPAddress);
-    if (!result) {
+    if (sendWhenResolved) {
+        sendAfterResolve = true;
+    }
+    if (dnsRequested) {
+        DEBUGLOGD ("DNS request already in progress");
+        return;
+    }
+    
+    dnsRoundSucceeded = false;
+    dnsRequested = numDnsAddrTypes;
+    lastDnsRequest = ::millis ();
+    for (uint8_t i = 0; i < numDnsAddrTypes; i++) {
+        udp_mutex_lock();
+#if LWIP_IPV6
+        result = dns_gethostbyname_addrtype (getNtpServerName (), &address, &NTPClient::s_dnsFound, this, dnsAddrTypes[i]);
+#else
+        result = dns_gethostbyname (getNtpServerName (), &address, &NTPClient::s_dnsFound, this);
+#endif // LWIP_IPV6
+        udp_mutex_unlock();
+        
+        if (result == ERR_OK) {
+            DEBUGLOGD ("NTP server address got from lwIP cache");
+            processDnsResponse (&address);
+        } else if (result == ERR_INPROGRESS) {
+            DEBUGLOGD ("DNS request sent for %s", ntpServerName);
+        } else {
+            DEBUGLOGE ("DNS request error. %d: %s", result, lwip_strerr (result));
+            processDnsResponse (NULL);
+        }
+    }
+}
+
+void NTPClient::s_dnsFound (const char* name, const ip_addr_t* ipaddr, void* callback_arg) {
+    NTPClient* self = reinterpret_cast<NTPClient*>(callback_arg);
+    if (strncmp (name, self->ntpServerName, SERVER_NAME_LENGTH)) {
+        DEBUGLOGW ("Discarding DNS response for old server name %s", name);
+        if (self->dnsRequested) {
+            self->dnsRequested--;
+        }
+        self->sendAfterResolve = false;
+        return;
+    }
+    self->processDnsResponse (ipaddr);
+}
+
+void NTPClient::processDnsResponse (const ip_addr_t* address) {
+    if (dnsRequested) {
+        dnsRequested--;
+    }
+    
+    if (!address || ip_addr_isany (address)) {
+        if (dnsRequested || dnsRoundSucceeded) {
+            DEBUGLOGW ("No address for one of the address families");
+            return; // Other family may still answer
+        }
         DEBUGLOGE ("HostByName error");
+        if (sendAfterResolve) {
+            NTP_TRACE_END ();
+        }
+        sendAfterResolve = false;
         dnsErrors++;
-        if (onSyncEvent) {
+        statsCount (stats.dnsFailures);
+        upstreamFailures++;
+        if (wantsEvent (invalidAddress)) {
             NTPEvent_t event;
             event.event = invalidAddress;
-            event.info.serverAddress = ntpServerIPAddress;
+            setEventAddress (event, &ntpServerAddr);
             event.info.port = DEFAULT_NTP_PORT;
 
-            onSyncEvent (event);
+            emitEvent (event);
         }
         if (dnsErrors >= 3) {
             dnsErrors = 0;
             if (manageWifi) {
                 DEBUGLOGW ("Reconnecting WiFi");
-                connectionReconnect ();
+                reconnectRequested = true; // Not safe to reconnect from lwIP context. Loop will do it
             }
+        } else {
+            actualInterval = ntpTimeout + 500;
+            DEBUGLOGI ("Set interval to = %d", actualInterval);
         }
         return;
-    } else {
-        DEBUGLOGI ("NTP server address %s resolved to %s", ntpServerName, ntpServerIPAddress.toString ().c_str ());
     }
+    DEBUGLOGI ("NTP server address %s resolved to %s", ntpServerName, ipaddr_ntoa (address));
     dnsErrors = 0;
-    if (ntpServerIPAddress == IPAddress (INADDR_NONE)) {
-        DEBUGLOGE ("IP address unset. Aborting");
-        actualInterval = ntpTimeout + 500;
-        DEBUGLOGI ("Set interval to = %d", actualInterval);
-        if (onSyncEvent) {
-            NTPEvent_t event;
-            event.event = invalidAddress;
-            event.info.serverAddress = ntpServerIPAddress;
-            event.info.port = DEFAULT_NTP_PORT;
-            onSyncEvent (event);
+    dnsRoundSucceeded = true;
+    uint8_t member = addPoolMember (address);
+    
+    if (sendAfterResolve) {
+        // Happy eyeballs: first address family to answer is used for pending request
+        sendAfterResolve = false;
+        if (preferredAddrType < 0) {
+            preferredAddrType = IP_GET_TYPE (address);
+        }
+        setCurrentServer (address);
+        NTP_TRACE_MARK (traceResolved);
+        sendRequest (member);
+    }
+}
+
+uint32_t ipAddrHash (const ip_addr_t* address) {
+    const uint8_t* bytes;
+    size_t length;
+    uint32_t hash = 2166136261UL; // FNV-1a
+    
+#if LWIP_IPV6
+    if (IP_IS_V6 (address)) {
+        bytes = (const uint8_t*)ip_2_ip6 (address)->addr;
+        length = 16;
+    } else
+#endif // LWIP_IPV6
+    {
+        bytes = (const uint8_t*)&ip_2_ip4 (address)->addr;
+        length = 4;
+    }
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619UL;
+    }
+    return hash;
+}
+
+uint8_t NTPClient::addPoolMember (const ip_addr_t* address) {
+    unsigned long now = ::millis ();
+    uint8_t oldest = 0;
+    uint8_t index;
+    uint32_t hash = ipAddrHash (address);
+    bool seen = false;
+    
+    poolLock ();
+    for (uint8_t i = 0; i < poolSize; i++) {
+        if (ip_addr_cmp (&serverPool[i].address, address)) {
+            serverPool[i].resolved = now;
+            poolUnlock ();
+            return i;
+        }
+        if (now - serverPool[i].resolved > now - serverPool[oldest].resolved) {
+            oldest = i;
+        }
+    }
+    if (poolSize < MAX_POOL_ADDRESSES) {
+        index = poolSize;
+        poolSize++;
+    } else {
+        index = oldest;
+    }
+    ip_addr_copy (serverPool[index].address, *address);
+    serverPool[index].resolved = now;
+    serverPool[index].requests = 0;
+    serverPool[index].failures = 0;
+    // Pool names may hand out an evicted address again. Count it only once
+    for (unsigned int i = 0; i < poolDistinctAddresses && i < POOL_DIVERSITY_HISTORY; i++) {
+        if (poolSeenHashes[i] == hash) {
+            seen = true;
+            break;
         }
+    }
+    if (!seen) {
+        poolSeenHashes[poolDistinctAddresses % POOL_DIVERSITY_HISTORY] = hash;
+        poolDistinctAddresses++;
+    }
+    poolUnlock ();
+    DEBUGLOGI ("Added %s to server pool as member %u", ipaddr_ntoa (address), index);
+    return index;
+}
+
+void NTPClient::setCurrentServer (const ip_addr_t* address) {
+    ip_addr_copy (ntpServerAddr, *address);
+}
+
+void NTPClient::prunePool () {
+    unsigned long now = ::millis ();
+    uint8_t kept = 0;
+    
+    if (poolFlushRequested) {
+        poolFlushRequested = false;
+        poolLock ();
+        poolSize = 0;
+        poolIndex = 0;
+        poolUnlock ();
+        DEBUGLOGI ("Server pool flushed");
         return;
     }
+    poolLock ();
+    uint8_t previousSize = poolSize;
+    for (uint8_t i = 0; i < poolSize; i++) {
+        if (now - serverPool[i].resolved >= dnsCacheTtl || serverPool[i].failures >= MAX_POOL_MEMBER_FAILURES) {
+            continue;
+        }
+        if (kept != i) {
+            serverPool[kept] = serverPool[i];
+        }
+        kept++;
+    }
+    poolSize = kept;
+    if (poolIndex >= poolSize) {
+        poolIndex = 0;
+    }
+    poolUnlock ();
+    if (kept != previousSize) {
+        DEBUGLOGW ("Evicted %u addresses from server pool", previousSize - kept);
+    }
+}
+
+NTPPoolMember_t* NTPClient::requestPoolMember () {
+    if (requestMember == NO_POOL_MEMBER) {
+        return NULL;
+    }
+    if (requestMember < poolSize && ip_addr_cmp (&serverPool[requestMember].address, &requestAddr)) {
+        return &serverPool[requestMember];
+    }
+    // Pool was compacted or refilled since request was sent
+    for (uint8_t i = 0; i < poolSize; i++) {
+        if (ip_addr_cmp (&serverPool[i].address, &requestAddr)) {
+            return &serverPool[i];
+        }
+    }
+    return NULL;
+}
+
+void NTPClient::poolMemberFailed (bool evict) {
+    poolLock ();
+    NTPPoolMember_t* member = requestPoolMember ();
+    if (member) {
+        if (evict) {
+            member->failures = MAX_POOL_MEMBER_FAILURES;
+        } else if (member->failures < MAX_POOL_MEMBER_FAILURES) {
+            member->failures++;
+        }
+    }
+    poolUnlock ();
+}
+
+NTPPoolMember_t NTPClient::getServerPoolMember (uint8_t index) {
+    NTPPoolMember_t member;
     
-    ip_addr ntpAddr;
-#ifdef ESP32
-    ntpAddr.type = IPADDR_TYPE_V4;
-    ntpAddr.u_addr.ip4.addr = ntpServerIPAddress;
-#else
-    ntpAddr.addr = ntpServerIPAddress;
-#endif
+    memset (&member, 0, sizeof (member));
+    poolLock ();
+    if (index < poolSize) {
+        member = serverPool[index];
+    }
+    poolUnlock ();
+    return member;
+}
+
+void NTPClient::poolMemberSucceeded () {
+    poolLock ();
+    NTPPoolMember_t* member = requestPoolMember ();
+    if (member) {
+        member->failures = 0;
+    }
+    poolUnlock ();
+}
+
+bool NTPClient::dnsCacheNeedsRefresh () {
+    unsigned long now = ::millis ();
+    bool refresh = false;
+    
+    if (now - lastDnsRequest < dnsCacheTtl / 10) {
+        return false;
+    }
+    poolLock ();
+    for (uint8_t i = 0; i < poolSize; i++) {
+        if (now - serverPool[i].resolved >= dnsCacheTtl - dnsCacheTtl / 10) {
+            refresh = true;
+            break;
+        }
+    }
+    poolUnlock ();
+    return refresh;
+}
+
+void NTPClient::getTime () {
+    if (broadcastEnabled && !broadcastCalibrated && broadcastSourceValid) {
+        DEBUGLOGI ("Calibrating delay to broadcast server %s", ipaddr_ntoa (&broadcastSourceAddr));
+        ip_addr_copy (ntpServerAddr, broadcastSourceAddr);
+        broadcastCalibrating = true;
+        NTP_TRACE_BEGIN ();
+        NTP_TRACE_MARK (traceResolved);
+        sendRequest ();
+        return;
+    }
+    NTP_TRACE_BEGIN ();
+    prunePool ();
+    if (!poolSize) {
+        resolveNtpServer (true); // Request will be sent as soon as address is resolved
+        return;
+    }
+    if (poolSize < MAX_POOL_ADDRESSES) {
+        resolveNtpServer (false); // Lazily look for more pool members
+        if (!poolSize) {
+            NTP_TRACE_END ();
+            return;
+        }
+    }
+    ip_addr_t address;
+    poolLock (); // DNS callback may be adding a member right now
+    uint8_t next = (poolIndex + 1) % poolSize;
+    if (preferredAddrType >= 0) {
+        for (uint8_t i = 0; i < poolSize; i++) {
+            uint8_t candidate = (poolIndex + 1 + i) % poolSize;
+            if (IP_GET_TYPE (&serverPool[candidate].address) == preferredAddrType) {
+                next = candidate;
+                break;
+            }
+        }
+    }
+    poolIndex = next;
+    ip_addr_copy (address, serverPool[next].address);
+    poolUnlock ();
+    setCurrentServer (&address);
+    DEBUGLOGD ("Using cached NTP server address %s", ipaddr_ntoa (&ntpServerAddr));
+    NTP_TRACE_MARK (traceResolved);
+    sendRequest (next);
+}
+
+void NTPClient::sendRequest (uint8_t member) {
+    err_t result;
+    
+    if (!udp) {
+        DEBUGLOGE ("UDP connection not available");
+        NTP_TRACE_END ();
+        return;
+    }
+    
+    ip_addr_t ntpAddr;
+    ip_addr_copy (ntpAddr, ntpServerAddr);
     DEBUGLOGI ("NTP server IP address %s", ipaddr_ntoa (&ntpAddr));
     
     udp_mutex_lock();
     result = udp_connect (udp, &ntpAddr, DEFAULT_NTP_PORT);
     udp_mutex_unlock();
+    NTP_TRACE_MARK (traceConnected);
     
     if (result == ERR_USE) {
         DEBUGLOGE ("Port already used");
-        if (onSyncEvent) {
+        if (wantsEvent (invalidPort)) {
             NTPEvent_t event;
             event.event = invalidPort;
-            event.info.serverAddress = ntpServerIPAddress;
+            setEventAddress (event, &ntpServerAddr);
             event.info.port = DEFAULT_NTP_PORT;
-            onSyncEvent (event);
+            emitEvent (event);
         }
     }
     if (result == ERR_RTE) {
         DEBUGLOGE ("Port already used");
-        if (onSyncEvent) {
+        if (wantsEvent (invalidAddress)) {
             NTPEvent_t event;
             event.event = invalidAddress;
-            event.info.serverAddress = ntpServerIPAddress;
+            setEventAddress (event, &ntpServerAddr);
             event.info.port = DEFAULT_NTP_PORT;
-            onSyncEvent (event);
+            emitEvent (event);
         }
     }
     
     DEBUGLOGI ("Sending UDP packet");
+    poolLock ();
+    requestMember = member;
+    ip_addr_copy (requestAddr, ntpAddr);
+    NTPPoolMember_t* poolMember = requestPoolMember ();
+    if (poolMember) {
+        poolMember->requests++;
+    }
+    poolUnlock ();
     NTPStatus_t prevStatus = status;
     ntpRequested = true;
     DEBUGLOGI ("Status set to REQUESTED");
@@ -702,21 +1078,24 @@ void NTPClient::getTime () {
         DEBUGLOGE ("NTP request error");
         status = prevStatus;
         DEBUGLOGE ("Status recovered due to UDP send error");
-        if (onSyncEvent) {
+        if (wantsEvent (errorSending)) {
             NTPEvent_t event;
             event.event = errorSending;
-            event.info.serverAddress = ntpServerIPAddress;
+            setEventAddress (event, &ntpServerAddr);
             event.info.port = DEFAULT_NTP_PORT;
-            onSyncEvent (event);
+            emitEvent (event);
         }
+        NTP_TRACE_END ();
         return;
     }
-    if (onSyncEvent) {
+    NTP_TRACE_MARK (traceSent);
+    statsCount (stats.requests);
+    if (wantsEvent (requestSent)) {
         NTPEvent_t event;
         event.event = requestSent;
-        event.info.serverAddress = ntpServerIPAddress;
+        setEventAddress (event, &ntpServerAddr);
         event.info.port = DEFAULT_NTP_PORT;
-        onSyncEvent (event);
+        emitEvent (event);
     }
     //udp_mutex_lock();
     //udp_disconnect (udp);
@@ -747,18 +1126,9 @@ boolean NTPClient::sendNTPpacket () {
     
     DEBUGLOGI ("sendNTPpacket");
     
-    if (currentime.tv_sec != 0) {
-        packet.transmit.secondsOffset = flipInt32 (currentime.tv_sec + seventyYears);
-        DEBUGLOGV ("Current time: %ld.%ld", currentime.tv_sec, currentime.tv_usec);
-        uint32_t timestamp_us = (uint32_t)((double)(currentime.tv_usec) / 1000000.0 * (double)0x100000000);
-        DEBUGLOGV ("timestamp_us = 0x%08X %lu", timestamp_us, timestamp_us);
-        packet.transmit.fraction = flipInt32 (timestamp_us);
-        DEBUGLOGV ("Transmit: 0x%08X : 0x%08X", packet.transmit.secondsOffset, packet.transmit.fraction);
-        
-    } else {
-        packet.transmit.secondsOffset = 0;
-        packet.transmit.fraction = 0;
-    }
+    DEBUGLOGV ("Current time: %ld.%ld", currentime.tv_sec, currentime.tv_usec);
+    packet.transmit = timeval2timestamp64 (&currentime);
+    DEBUGLOGV ("Transmit: 0x%08X : 0x%08X", packet.transmit.secondsOffset, packet.transmit.fraction);
 
 #if DEBUG_NTPCLIENT > 4
     const int sizeStr = 200;
@@ -784,6 +1154,10 @@ boolean NTPClient::sendNTPpacket () {
     }
     if (result == ERR_OK) {
         DEBUGLOGI ("UDP packet sent");
+#ifdef NTP_PACKET_CAPTURE
+        packetCapture.capture (captureSent, (const uint8_t*)&packet, sizeof (NTPUndecodedPacket_t), NULL, localPort,
+                               &ntpServerAddr, DEFAULT_NTP_PORT, getUptimeUs (), &currentime);
+#endif // NTP_PACKET_CAPTURE
         return true;
     } else {
         DEBUGLOGE ("Error sending UDP datagram. %d: %s", result, lwip_strerr (result));
@@ -792,60 +1166,747 @@ boolean NTPClient::sendNTPpacket () {
 }
 
 void ICACHE_RAM_ATTR NTPClient::s_processRequestTimeout (void* arg) {
+    unsigned long started = ::micros ();
     NTPClient* self = reinterpret_cast<NTPClient*>(arg);
     self->processRequestTimeout ();
+    updateMaxTime (self->maxTimerContextTime, started);
 }
 
-void ICACHE_RAM_ATTR NTPClient::processRequestTimeout () {
-    //NTPStatus_t prevStatus = status;
-    //DEBUGLOGW ("Status set to UNSYNCD");
-    numTimeouts++;
-    ntpRequested = false;
-    responseTimer.detach ();
-    DEBUGLOGE ("NTP response Timeout");
-    if (onSyncEvent) {
-        NTPEvent_t event;
-        event.event = noResponse;
-        event.info.serverAddress = ntpServerIPAddress;
-        event.info.port = DEFAULT_NTP_PORT;
-        onSyncEvent (event);
+void NTPClient::emitEvent (NTPEvent_t& event) {
+    event.uptimeUs = getUptimeUs ();
+    gettimeofday (&event.time, NULL);
+#ifdef ESP32
+    if (eventDispatch == eventsImmediate) {
+#else
+    // Scheduling a function from timer or network callbacks would allocate there, so deliver right away
+    if (eventDispatch != eventsManual) {
+#endif
+        dispatchEvent (event);
+        return;
     }
-    if (numTimeouts >= DEAULT_NUM_TIMEOUTS) {
-        numTimeouts = 0;
-        actualInterval = shortInterval;
-        DEBUGLOGE ("Waiting for %u ms", actualInterval);
+    if (!eventQueue.push (event)) {
+        DEBUGLOGW ("Event queue full. Event %d lost", event.event);
+        return;
     }
-    // if (status==syncd) {
-    //     actualInterval = longInterval;
-    // } else {
-    //     actualInterval = shortInterval;
-    // }
-    //DEBUGLOGI ("Set interval to = %d", actualInterval);
+#ifdef ESP32
+    if (eventDispatch == eventsAuto && eventHandle) {
+        xTaskNotifyGive (eventHandle);
+    }
+#endif
 }
 
-bool NTPClient::setNtpServerName (const char* serverName) {
-    if (!serverName) {
-        return false;
+#ifdef NTP_SYNC_TRACE
+void NTPClient::traceBegin () {
+    if (traceActive) {
+        traceEnd ();
     }
-    if (!strlen (serverName)) {
-        return false;
+    NTPSyncTrace_t& trace = traces[traceIndex];
+    trace.cycle = traceCycles++;
+    trace.startUs = getUptimeUs ();
+    for (uint8_t i = 0; i < NUM_TRACE_PHASES; i++) {
+        trace.phaseUs[i] = NTP_TRACE_NOT_REACHED;
     }
-    DEBUGLOGI ("NTP server set to %s", serverName);
-    memset (ntpServerName, 0, SERVER_NAME_LENGTH);
-    strncpy (ntpServerName, serverName, strnlen (serverName, SERVER_NAME_LENGTH));
-    return true;
+    trace.phaseUs[traceStart] = 0;
+    traceActive = true;
 }
 
-bool NTPClient::setInterval (int interval) {
-    unsigned int newInterval = interval * 1000;
-    if (interval >= MIN_NTP_INTERVAL) {
-        if (longInterval != newInterval) {
-            longInterval = newInterval;
-            DEBUGLOGI ("Sync interval set to %d s", interval);
-            if (syncStatus () == syncd) {
-                actualInterval = longInterval;
-                DEBUGLOGI ("Set interval to = %d", actualInterval);
-            }
+void NTPClient::traceMark (NTPTracePhase_t phase) {
+    if (!traceActive) {
+        return; // Broadcast and peer samples are not part of a cycle
+    }
+    NTPSyncTrace_t& trace = traces[traceIndex];
+    trace.phaseUs[phase] = (uint32_t)(getUptimeUs () - trace.startUs);
+}
+
+void NTPClient::traceEnd () {
+    if (!traceActive) {
+        return;
+    }
+    traceActive = false;
+    NTPSyncTrace_t& trace = traces[traceIndex];
+    traceIndex = (traceIndex + 1) % (NTP_TRACE_RING_SIZE + 1);
+    
+    if (traceEvents && wantsEvent (syncTraced)) {
+        uint32_t last = 0;
+        for (uint8_t i = 0; i < NUM_TRACE_PHASES; i++) {
+            if (trace.phaseUs[i] != NTP_TRACE_NOT_REACHED && trace.phaseUs[i] > last) {
+                last = trace.phaseUs[i];
+            }
+        }
+        NTPEvent_t event;
+        event.event = syncTraced;
+        event.info.offset = last / 1000000.0;
+        if (trace.phaseUs[traceSent] != NTP_TRACE_NOT_REACHED && trace.phaseUs[traceReceived] != NTP_TRACE_NOT_REACHED) {
+            event.info.delay = (trace.phaseUs[traceReceived] - trace.phaseUs[traceSent]) / 1000000.0;
+        }
+        event.info.retrials = trace.cycle;
+        setEventAddress (event, &ntpServerAddr);
+        event.info.port = DEFAULT_NTP_PORT;
+        emitEvent (event);
+    }
+}
+
+bool NTPClient::getSyncTrace (uint8_t age, NTPSyncTrace_t* trace) {
+    uint32_t finished = traceCycles - (traceActive ? 1 : 0);
+    
+    if (!trace || age >= NTP_TRACE_RING_SIZE || age >= finished) {
+        return false;
+    }
+    *trace = traces[(traceIndex + NTP_TRACE_RING_SIZE - age) % (NTP_TRACE_RING_SIZE + 1)];
+    return true;
+}
+#endif // NTP_SYNC_TRACE
+
+void NTPClient::statsAddSample (int64_t offsetUs, int64_t delayUs, float dispersion) {
+    statsBeginUpdate ();
+    ntpStatsAddSample (&stats, offsetUs, delayUs, dispersion, lastSampleValid ? &lastSampleOffset : NULL);
+    statsEndUpdate ();
+    lastSampleOffset = offsetUs;
+    lastSampleValid = true;
+}
+
+void NTPClient::allanAddSample (timeval tvOffset) {
+    if (!allan.isEnabled ()) {
+        return;
+    }
+    timeval now;
+    gettimeofday (&now, NULL);
+    int64_t uptimeUs = getUptimeUs ();
+    // Reference time minus oscillator time. System clock steps change both terms by the same amount
+    int64_t phaseUs = (int64_t)now.tv_sec * 1000000L + now.tv_usec - uptimeUs
+                      + (int64_t)tvOffset.tv_sec * 1000000L + tvOffset.tv_usec;
+    statsBeginUpdate ();
+    allan.addSample (uptimeUs, phaseUs);
+    statsEndUpdate ();
+}
+
+void NTPClient::enableAllanDeviation (uint32_t tau0) {
+    statsBeginUpdate ();
+    allan.begin (tau0);
+    statsEndUpdate ();
+}
+
+bool NTPClient::getAllanDeviation (uint8_t octave, NTPAllanPoint_t* point) {
+    NTPAllanDeviation copy;
+    NTPAllanPoint_t result;
+    
+    ntpSeqlockRead (&statsSequence, &allan, &copy, sizeof (NTPAllanDeviation));
+    if (!copy.getPoint (octave, &result)) {
+        return false;
+    }
+    if (point) {
+        *point = result;
+    }
+    return true;
+}
+
+NTPStats_t NTPClient::getStats () {
+    NTPStats_t snapshot;
+    
+    ntpSeqlockRead (&statsSequence, &stats, &snapshot, sizeof (NTPStats_t));
+    snapshot.poolDiversity = poolDistinctAddresses;
+    return snapshot;
+}
+
+void NTPClient::resetStats () {
+    statsBeginUpdate ();
+    memset (&stats, 0, sizeof (NTPStats_t));
+    statsEndUpdate ();
+    lastSampleValid = false;
+}
+
+unsigned int NTPClient::handleEvents () {
+    NTPEvent_t event;
+    unsigned int delivered = 0;
+    
+    while (eventQueue.pop (event)) {
+        dispatchEvent (event);
+        delivered++;
+    }
+    return delivered;
+}
+
+void NTPClient::dispatchEvent (const NTPEvent_t& event) {
+    eventListeners.dispatch (event, ntpEventMask (event.event));
+}
+
+int NTPClient::addEventListener (onSyncEvent_t handler, uint16_t mask) {
+    int id = eventListeners.add (handler, mask);
+    if (id < 0 && handler && mask) {
+        DEBUGLOGE ("Too many event listeners");
+    }
+    return id;
+}
+
+bool NTPClient::removeEventListener (int id) {
+    // A pending event may still be delivered to remaining listeners
+    if (!eventListeners.remove (id)) {
+        return false;
+    }
+    if (id == legacyListener) {
+        legacyListener = -1;
+    }
+    return true;
+}
+
+void NTPClient::setEventDispatch (NTPEventDispatch_t mode) {
+    eventDispatch = mode;
+#ifdef ESP32
+    if (loopHandle) {
+        startEventTask ();
+    }
+#endif
+}
+
+#ifdef ESP32
+void NTPClient::startEventTask () {
+    if (eventDispatch != eventsAuto || eventHandle) {
+        return;
+    }
+    xTaskCreateUniversal (
+        &NTPClient::s_eventTask, /* Task function. */
+        "NTP events", /* name of task. */
+        4096, /* Stack size of task. User handler runs here */
+        this, /* parameter of the task */
+        1, /* priority of the task */
+        &eventHandle, /* Task handle to keep track of created task */
+        CONFIG_ARDUINO_RUNNING_CORE);
+}
+
+void NTPClient::s_eventTask (void* arg) {
+    NTPClient* self = reinterpret_cast<NTPClient*>(arg);
+    for (;;) {
+        ulTaskNotifyTake (pdTRUE, portMAX_DELAY);
+        if (self->eventDispatch == eventsAuto) {
+            self->handleEvents ();
+        }
+    }
+}
+#endif // ESP32
+
+void ICACHE_RAM_ATTR NTPClient::processRequestTimeout () {
+    //NTPStatus_t prevStatus = status;
+    //DEBUGLOGW ("Status set to UNSYNCD");
+    numTimeouts++;
+    upstreamFailures++;
+    statsCount (stats.timeouts);
+    ntpRequested = false;
+    poolMemberFailed ();
+    if (IP_GET_TYPE (&ntpServerAddr) == preferredAddrType) {
+        preferredAddrType = -1; // Let any address family answer first
+    }
+    responseTimer.detach ();
+    NTP_TRACE_END ();
+    DEBUGLOGE ("NTP response Timeout");
+    if (wantsEvent (noResponse)) {
+        NTPEvent_t event;
+        event.event = noResponse;
+        setEventAddress (event, &ntpServerAddr);
+        event.info.port = DEFAULT_NTP_PORT;
+        emitEvent (event);
+    }
+    if (numTimeouts >= DEAULT_NUM_TIMEOUTS) {
+        numTimeouts = 0;
+        poolFlushRequested = true; // Server may have changed its address
+        actualInterval = shortInterval;
+        DEBUGLOGE ("Waiting for %u ms", actualInterval);
+    }
+    // if (status==syncd) {
+    //     actualInterval = longInterval;
+    // } else {
+    //     actualInterval = shortInterval;
+    // }
+    //DEBUGLOGI ("Set interval to = %d", actualInterval);
+}
+
+bool NTPClient::openListener (uint16_t port) {
+    err_t result;
+    
+    if (listenUdp) {
+        if (port != listenPort) {
+            DEBUGLOGW ("Already listening on port %u", listenPort);
+        }
+        return true;
+    }
+    
+    udp_mutex_lock();
+    listenUdp = newNtpSocket ();
+    udp_mutex_unlock();
+    if (!listenUdp) {
+        DEBUGLOGE ("Failed to create NTP listener socket");
+        return false;
+    }
+    
+    result = bindNtpSocket (listenUdp, port, true);
+    if (result) {
+        DEBUGLOGE ("Failed to bind NTP listener to port %u. %d: %s", port, result, lwip_strerr (result));
+        udp_mutex_lock();
+        udp_remove (listenUdp);
+        udp_mutex_unlock();
+        listenUdp = NULL;
+        return false;
+    }
+    listenPort = port;
+    
+    udp_mutex_lock();
+    ip_set_option (listenUdp, SOF_BROADCAST); // Needed to receive broadcasts if lwIP filters them
+    udp_recv (listenUdp, &NTPClient::s_listenRecvPacket, this);
+    udp_mutex_unlock();
+    DEBUGLOGI ("Listening on port %u", port);
+    return true;
+}
+
+void NTPClient::closeListener (bool force) {
+    if (listenUdp && (force || (!serverEnabled && !broadcastEnabled && !numPeers))) {
+        udp_mutex_lock();
+        udp_remove (listenUdp);
+        udp_mutex_unlock();
+        listenUdp = NULL;
+        DEBUGLOGI ("NTP listener closed");
+    }
+}
+
+bool NTPClient::beginServer (uint16_t port) {
+    if (!openListener (port)) {
+        return false;
+    }
+    serverEnabled = true;
+    DEBUGLOGI ("NTP server started");
+    return true;
+}
+
+void NTPClient::stopServer () {
+    serverEnabled = false;
+    closeListener ();
+}
+
+bool NTPClient::setBroadcastMode (bool enable, bool joinMulticast) {
+#if LWIP_IGMP
+    ip4_addr_t group;
+    ip4_addr_set_u32 (&group, (uint32_t)NTP_MULTICAST_ADDRESS);
+    if (multicastJoined && (!enable || !joinMulticast)) {
+        udp_mutex_lock();
+        igmp_leavegroup (IP4_ADDR_ANY4, &group);
+        udp_mutex_unlock();
+        multicastJoined = false;
+    }
+#endif // LWIP_IGMP
+    if (!enable) {
+        broadcastEnabled = false;
+        broadcastCalibrated = false;
+        broadcastCalibrating = false;
+        broadcastSourceValid = false;
+        closeListener ();
+        return true;
+    }
+    if (!openListener (listenUdp ? listenPort : DEFAULT_NTP_PORT)) {
+        return false;
+    }
+#if LWIP_IGMP
+    if (joinMulticast && !multicastJoined) {
+        udp_mutex_lock();
+        err_t result = igmp_joingroup (IP4_ADDR_ANY4, &group);
+        udp_mutex_unlock();
+        if (result) {
+            DEBUGLOGE ("Cannot join NTP multicast group. %d: %s", result, lwip_strerr (result));
+        } else {
+            multicastJoined = true;
+        }
+    }
+#endif // LWIP_IGMP
+    broadcastEnabled = true;
+    DEBUGLOGI ("Broadcast mode enabled");
+    return true;
+}
+
+bool NTPClient::broadcastSyncActive () {
+    return broadcastEnabled && broadcastCalibrated && (::millis () - lastBroadcastReceived < longInterval);
+}
+
+void NTPClient::s_listenRecvPacket (void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                                    const ip_addr_t* addr, u16_t port) {
+    timeval received;
+    uint8_t flags;
+    
+    unsigned long started = ::micros ();
+    gettimeofday (&received, NULL);
+    NTPClient* self = reinterpret_cast<NTPClient*>(arg);
+#ifdef NTP_PACKET_CAPTURE
+    if (self->packetCapture.isEnabled ()) {
+        unsigned long captureStarted = ::micros ();
+        self->packetCapture.capture (captureReceived, (const uint8_t*)p->payload, p->len, ip_current_dest_addr (), self->listenPort,
+                                     addr, port, getUptimeUs (), &received);
+        updateMaxTime (self->maxCaptureTime, captureStarted);
+    }
+#endif // NTP_PACKET_CAPTURE
+    
+    if (p->tot_len >= NTP_PACKET_SIZE && pbuf_copy_partial (p, &flags, 1, 0) == 1) {
+        switch (flags & 0b111) {
+        case 3: // Client request
+            if (self->serverEnabled) {
+                self->serverRequests++;
+                self->processServerRequest (pcb, p, addr, port, &received);
+            }
+            break;
+        case 1: // Symmetric active
+            if (self->findPeer (addr)) {
+                self->processPeerRequest (pcb, p, addr, port, &received);
+            }
+            break;
+        case 2: { // Symmetric passive, response to our symmetric active packet
+            // Every peer has its own slot. Peers answer at once and one reply must not hide the others
+            NTPPeer_t* peer = self->findPeer (addr);
+            if (peer) {
+                uint8_t index = peer - self->peers;
+                if (!self->peerPacketValid[index]) {
+                    pbuf_copy_partial (p, &(self->peerPacket[index]), NTP_PACKET_SIZE, 0);
+                    self->peerPacketReceived[index] = received;
+                    self->peerPacketValid[index] = true;
+                }
+            }
+            break;
+        }
+        case 5: // Broadcast
+            if (self->broadcastEnabled && !self->broadcastPacketValid) {
+                pbuf_copy_partial (p, &(self->broadcastPacket), NTP_PACKET_SIZE, 0);
+                self->broadcastPacketReceived = received;
+                if (!self->broadcastSourceValid || !ip_addr_cmp (&(self->broadcastSourceAddr), addr)) {
+                    DEBUGLOGI ("New broadcast server %s", ipaddr_ntoa (addr));
+                    ip_addr_copy (self->broadcastSourceAddr, *addr);
+                    self->broadcastSourceValid = true;
+                    self->broadcastCalibrated = false;
+                }
+                self->broadcastPacketValid = true;
+            }
+            break;
+        default:
+            DEBUGLOGD ("Discarding packet from %s:%u. Mode %u", ipaddr_ntoa (addr), port, flags & 0b111);
+        }
+    }
+    pbuf_free (p);
+    updateMaxTime (self->maxReceiveContextTime, started);
+}
+
+void NTPClient::processBroadcastPacket () {
+    NTPPacket_t ntpPacket;
+    timeval tvOffset;
+    
+    if (!decodeNtpMessage ((uint8_t*)&broadcastPacket, NTP_PACKET_SIZE, &ntpPacket)) {
+        return;
+    }
+    ntpPacket.destination = broadcastPacketReceived;
+    lastBroadcastReceived = ::millis ();
+    if (!broadcastCalibrated) {
+        DEBUGLOGD ("Broadcast received before delay calibration");
+        return;
+    }
+    
+    // Offset is server transmit time plus one way delay minus local receive time
+    double t3 = ntpPacket.transmit.tv_sec + ntpPacket.transmit.tv_usec / 1000000.0;
+    double t4 = ntpPacket.destination.tv_sec + ntpPacket.destination.tv_usec / 1000000.0;
+    offset = t3 + broadcastDelay - t4;
+    delay = broadcastDelay * 2.0;
+    tvOffset.tv_sec = (time_t)offset;
+    tvOffset.tv_usec = (offset - (double)tvOffset.tv_sec) * 1000000.0;
+    DEBUGLOGI ("Broadcast offset %f sec", offset);
+    
+    processSample (&ntpPacket, tvOffset, broadcastSample, &broadcastSourceAddr);
+}
+
+void NTPClient::fillLocalClockInfo (NTPUndecodedPacket_t* packet, uint8_t version, uint8_t mode) {
+    timeval now;
+    NTPUpstream_t source = getUpstream ();
+    bool synchronized = status != unsyncd && source.valid;
+    
+    memset (packet, 0, sizeof (NTPUndecodedPacket_t));
+    // LI = 3 (unsynchronized) and stratum 16 if local clock is not synchronized
+    packet->flags = (synchronized ? 0 : 3) << 6 | version << 3 | mode;
+    packet->peerStratum = synchronized ? (source.stratum < 15 ? source.stratum + 1 : 15) : 16;
+    packet->pollingInterval = 6;
+    packet->clockPrecission = 0xEC; // 1 us
+    if (!synchronized) {
+        return;
+    }
+    
+    gettimeofday (&now, NULL);
+    float sinceSync = (float)(now.tv_sec - source.reference.tv_sec) + (float)(now.tv_usec - source.reference.tv_usec) / 1000000.0;
+    packet->rootDelay = seconds2timestamp32 (source.rootDelay);
+    packet->dispersion = seconds2timestamp32 (source.rootDispersion + NTP_CLOCK_PHI * sinceSync);
+    
+    // Above stratum 1 reference ID is upstream IPv4 address or first 4 octets of MD5 hash of its IPv6 address
+#if LWIP_IPV6
+    if (IP_IS_V6 (&source.address)) {
+        uint8_t hash[16];
+        MD5Builder md5;
+        md5.begin ();
+        md5.add ((uint8_t*)ip_2_ip6 (&source.address)->addr, 16);
+        md5.calculate ();
+        md5.getBytes (hash);
+        memcpy (packet->refID, hash, 4);
+    } else
+#endif // LWIP_IPV6
+    {
+        uint32_t refAddress = ip4_addr_get_u32 (ip_2_ip4 (&source.address));
+        memcpy (packet->refID, &refAddress, 4);
+    }
+    
+    packet->reference = timeval2timestamp64 (&source.reference);
+}
+
+err_t NTPClient::sendNtpPacketTo (struct udp_pcb* pcb, NTPUndecodedPacket_t* packet, const ip_addr_t* addr, u16_t port) {
+    timeval now;
+    
+    pbuf* buffer = pbuf_alloc (PBUF_TRANSPORT, sizeof (NTPUndecodedPacket_t), PBUF_RAM);
+    if (!buffer) {
+        DEBUGLOGE ("Cannot allocate UDP packet buffer");
+        return ERR_MEM;
+    }
+    gettimeofday (&now, NULL);
+    packet->transmit = timeval2timestamp64 (&now);
+    memcpy (buffer->payload, packet, sizeof (NTPUndecodedPacket_t));
+    
+    udp_mutex_lock();
+    err_t result = udp_sendto (pcb, buffer, addr, port);
+    udp_mutex_unlock();
+    pbuf_free (buffer);
+#ifdef NTP_PACKET_CAPTURE
+    if (result == ERR_OK) {
+        packetCapture.capture (captureSent, (const uint8_t*)packet, sizeof (NTPUndecodedPacket_t), NULL, pcb == udp ? localPort : listenPort,
+                               addr, port, getUptimeUs (), &now);
+    }
+#endif // NTP_PACKET_CAPTURE
+    
+    if (result == ERR_OK) {
+        DEBUGLOGD ("Packet sent to %s:%u", ipaddr_ntoa (addr), port);
+    } else {
+        DEBUGLOGE ("Error sending packet. %d: %s", result, lwip_strerr (result));
+    }
+    return result;
+}
+
+void NTPClient::processServerRequest (struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port, const timeval* received) {
+    NTPUndecodedPacket_t request;
+    NTPUndecodedPacket_t response;
+    
+    if (p->tot_len < NTP_PACKET_SIZE || pbuf_copy_partial (p, &request, NTP_PACKET_SIZE, 0) != NTP_PACKET_SIZE) {
+        DEBUGLOGW ("Short packet from %s:%u", ipaddr_ntoa (addr), port);
+        serverRefused++;
+        return;
+    }
+    uint8_t version = request.flags >> 3 & 0b111;
+    uint8_t mode = request.flags & 0b111;
+    if (mode != 3 || version < NTP_MIN_VER) {
+        DEBUGLOGW ("Not a client request. Mode %u version %u", mode, version);
+        serverRefused++;
+        return;
+    }
+    if (status == unsyncd || !getUpstream ().valid) {
+        DEBUGLOGW ("Clock not synchronized. Request from %s refused", ipaddr_ntoa (addr));
+        serverRefused++;
+        return;
+    }
+    
+    fillLocalClockInfo (&response, version, 4);
+    response.pollingInterval = request.pollingInterval;
+    response.origin = request.transmit;
+    response.receive = timeval2timestamp64 (received);
+    
+    if (sendNtpPacketTo (pcb, &response, addr, port) == ERR_OK) {
+        serverResponses++;
+    }
+}
+
+NTPPeer_t* NTPClient::findPeer (const ip_addr_t* address) {
+    for (uint8_t i = 0; i < numPeers; i++) {
+        if (ip_addr_cmp (&peers[i].address, address)) {
+            return &peers[i];
+        }
+    }
+    return NULL;
+}
+
+bool NTPClient::addPeer (const char* address) {
+    ip_addr_t peerAddress;
+    
+    if (!address || !ipaddr_aton (address, &peerAddress)) {
+        DEBUGLOGE ("Invalid peer address");
+        return false;
+    }
+    if (findPeer (&peerAddress)) {
+        return true;
+    }
+    if (numPeers >= MAX_NTP_PEERS) {
+        DEBUGLOGE ("Too many peers");
+        return false;
+    }
+    if (!openListener (listenUdp ? listenPort : DEFAULT_NTP_PORT)) {
+        return false;
+    }
+    memset (&peers[numPeers], 0, sizeof (NTPPeer_t));
+    ip_addr_copy (peers[numPeers].address, peerAddress);
+    peers[numPeers].stratum = 16;
+    numPeers++;
+    DEBUGLOGI ("Added peer %s", ipaddr_ntoa (&peerAddress));
+    return true;
+}
+
+bool NTPClient::removePeer (const char* address) {
+    ip_addr_t peerAddress;
+    
+    if (!address || !ipaddr_aton (address, &peerAddress)) {
+        return false;
+    }
+    NTPPeer_t* peer = findPeer (&peerAddress);
+    if (!peer) {
+        return false;
+    }
+    numPeers--;
+    *peer = peers[numPeers];
+    peerFilter.reset (); // Round may have samples from removed peer
+    closeListener ();
+    return true;
+}
+
+void NTPClient::sendPeerPackets () {
+    NTPUndecodedPacket_t packet;
+    
+    if (!listenUdp) {
+        return;
+    }
+    for (uint8_t i = 0; i < numPeers; i++) {
+        fillLocalClockInfo (&packet, 4, 1); // Symmetric active
+        if (sendNtpPacketTo (listenUdp, &packet, &peers[i].address, DEFAULT_NTP_PORT) == ERR_OK) {
+            peers[i].transmit = packet.transmit;
+            peers[i].sent++;
+        }
+    }
+}
+
+void NTPClient::processPeerRequest (struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port, const timeval* received) {
+    NTPUndecodedPacket_t request;
+    NTPUndecodedPacket_t response;
+    
+    if (pbuf_copy_partial (p, &request, NTP_PACKET_SIZE, 0) != NTP_PACKET_SIZE) {
+        return;
+    }
+    // Symmetric passive response. Peer decides if it may use it looking at stratum and LI
+    fillLocalClockInfo (&response, request.flags >> 3 & 0b111, 2);
+    response.origin = request.transmit;
+    response.receive = timeval2timestamp64 (received);
+    sendNtpPacketTo (pcb, &response, addr, port);
+}
+
+float NTPClient::rootDistance () {
+    timeval now;
+    NTPUpstream_t source = getUpstream ();
+    
+    if (status == unsyncd || !source.valid) {
+        return 16.0; // Maximum distance, as in RFC 5905 MAXDIST
+    }
+    gettimeofday (&now, NULL);
+    float sinceSync = (float)(now.tv_sec - source.reference.tv_sec) + (float)(now.tv_usec - source.reference.tv_usec) / 1000000.0;
+    return source.rootDelay / 2.0 + source.rootDispersion + NTP_CLOCK_PHI * sinceSync;
+}
+
+NTPPeer_t* NTPClient::selectPeer () {
+    NTPPeer_t* best = NULL;
+    float localDistance = rootDistance ();
+    NTPUpstream_t source = getUpstream ();
+    uint8_t localStratum = status != unsyncd && source.valid ? source.stratum + 1 : 16;
+    
+    for (uint8_t i = 0; i < numPeers; i++) {
+        NTPPeer_t* peer = &peers[i];
+        if (peer->stratum < 1 || peer->stratum > 15 || ::millis () - peer->lastResponse > 2 * longInterval) {
+            continue;
+        }
+        // Peers that take time from us announce a higher stratum, so lower strata cannot form a loop. Local
+        // distance is not compared with them: after following a peer it is a copy of that peer's distance
+        if (peer->stratum >= localStratum && peer->rootDistance >= localDistance) {
+            continue;
+        }
+        if (!best || peer->rootDistance < best->rootDistance) {
+            best = peer;
+        }
+    }
+    return best;
+}
+
+void NTPClient::processPeerPacket (uint8_t index) {
+    NTPPacket_t ntpPacket;
+    NTPPeer_t* peer = &peers[index];
+    
+    // Response must echo the transmit timestamp of our last packet to this peer. This also drops a reply left
+    // in a slot that removePeer() gave to another peer
+    if (memcmp (&peerPacket[index].origin, &peer->transmit, sizeof (timestamp64_t))) {
+        DEBUGLOGW ("Unexpected packet from peer %s", ipaddr_ntoa (&peer->address));
+        return;
+    }
+    memset (&peer->transmit, 0, sizeof (timestamp64_t)); // Discard duplicates
+    
+    if (!decodeNtpMessage ((uint8_t*)&peerPacket[index], NTP_PACKET_SIZE, &ntpPacket)) {
+        return;
+    }
+    ntpPacket.destination = peerPacketReceived[index];
+    
+    // calculateOffset stores offset and delay for server responses. Keep them unless this peer is used
+    double serverOffset = offset;
+    double serverDelay = delay;
+    timeval tvOffset = calculateOffset (&ntpPacket);
+    
+    peer->stratum = ntpPacket.flags.li == 3 ? 16 : ntpPacket.peerStratum;
+    peer->offset = offset;
+    peer->delay = delay;
+    peer->rootDistance = ntpPacket.rootDelay / 2.0 + ntpPacket.dispersion + (float)fabs (delay) / 2.0;
+    peer->lastResponse = ::millis ();
+    peer->received++;
+    DEBUGLOGI ("Peer %s stratum %u offset %0.3f ms delay %0.3f ms", ipaddr_ntoa (&peer->address), peer->stratum, offset * 1000.0, delay * 1000.0);
+    
+    if (upstreamLost () && selectPeer () == peer) {
+        DEBUGLOGI ("Upstream servers not reachable. Using peer %s", ipaddr_ntoa (&peer->address));
+        processSample (&ntpPacket, tvOffset, peerSample, &peer->address);
+    } else {
+        offset = serverOffset;
+        delay = serverDelay;
+    }
+}
+
+bool NTPClient::setNtpServerName (const char* serverName) {
+    if (!serverName) {
+        return false;
+    }
+    if (!strlen (serverName)) {
+        return false;
+    }
+    DEBUGLOGI ("NTP server set to %s", serverName);
+    memset (ntpServerName, 0, SERVER_NAME_LENGTH);
+    strncpy (ntpServerName, serverName, strnlen (serverName, SERVER_NAME_LENGTH));
+    poolFlushRequested = true;
+    poolLock ();
+    poolDistinctAddresses = 0;
+    poolUnlock ();
+    return true;
+}
+
+bool NTPClient::setDnsCacheTtl (unsigned int seconds) {
+    if (seconds >= MIN_DNS_CACHE_TTL) {
+        dnsCacheTtl = seconds * 1000;
+        DEBUGLOGI ("DNS cache TTL set to %u s", seconds);
+        return true;
+    }
+    DEBUGLOGW ("DNS cache TTL should be at least %u s. You've tried to set %u s", MIN_DNS_CACHE_TTL, seconds);
+    return false;
+}
+
+bool NTPClient::setInterval (int interval) {
+    unsigned int newInterval = interval * 1000;
+    if (interval >= MIN_NTP_INTERVAL) {
+        if (longInterval != newInterval) {
+            longInterval = newInterval;
+            DEBUGLOGI ("Sync interval set to %d s", interval);
+            if (syncStatus () == syncd) {
+                actualInterval = longInterval;
+                DEBUGLOGI ("Set interval to = %d", actualInterval);
+            }
         }
         return true;
     } else {
@@ -916,13 +1977,9 @@ void NTPClient::dumpNtpPacketInfo (NTPPacket_t* decPacket) {
 }
 
 NTPPacket_t* NTPClient::decodeNtpMessage (uint8_t* messageBuffer, size_t length, NTPPacket_t* decPacket) {
-    int32_t timestamp_s;
-    uint32_t timestamp_us;
-
-    if (length < NTP_PACKET_SIZE) {
+    if (!ntpDecodePacket (messageBuffer, length, &packetLastReceived, decPacket)) {
         return NULL;
     }
-
     memcpy (&recPacket, messageBuffer, NTP_PACKET_SIZE);
 
     DEBUGLOGI ("Decoded NTP message");
@@ -930,167 +1987,52 @@ NTPPacket_t* NTPClient::decodeNtpMessage (uint8_t* messageBuffer, size_t length,
     char buffer[250];
 #endif
     DEBUGLOGV ("\n%s", dumpNTPPacket ((char*)messageBuffer, length, buffer, 250));
-
-    decPacket->flags.li = recPacket.flags >> 6;
     DEBUGLOGD ("LI = %u", decPacket->flags.li);
-
-    decPacket->flags.vers = recPacket.flags >> 3 & 0b111;
     DEBUGLOGD ("Version = %u", decPacket->flags.vers);
-
-    decPacket->flags.mode = recPacket.flags & 0b111;
     DEBUGLOGD ("Mode = %u", decPacket->flags.mode);
-
-    decPacket->peerStratum = recPacket.peerStratum;
     DEBUGLOGD ("Peer Stratum = %u", decPacket->peerStratum);
-
-    decPacket->pollingInterval = pow (2, recPacket.pollingInterval);
     DEBUGLOGD ("Polling Interval = %u", decPacket->pollingInterval);
-
-    decPacket->clockPrecission = pow (2, recPacket.clockPrecission);
     DEBUGLOGD ("Clock Precission = %0.3f us", decPacket->clockPrecission * 1000000);
-
-    int16_t ts16_s = flipInt16 (recPacket.rootDelay.secondsOffset);
-    uint16_t ts16_us = flipInt16 (recPacket.rootDelay.fraction);
-    decPacket->rootDelay = (float)ts16_s + (float)ts16_us / (float)0x10000;
-    DEBUGLOGD ("Root delay: 0x%08X", recPacket.rootDelay);
     DEBUGLOGD ("Root delay: %0.3f ms", decPacket->rootDelay * 1000);
-
-    ts16_s = flipInt16 (recPacket.dispersion.secondsOffset);
-    ts16_us = flipInt16 (recPacket.dispersion.fraction);
-    decPacket->dispersion = (float)ts16_s + (float)ts16_us / (float)0x10000;
-    DEBUGLOGD ("Dispersion: 0x%08X", recPacket.dispersion);
     DEBUGLOGD ("Dispersion: %0.3f ms", decPacket->dispersion * 1000);
-
-    memcpy (&(decPacket->refID), &(recPacket.refID), 4);
     if (decPacket->peerStratum > 1) {
         DEBUGLOGD ("refID: %u.%u.%u.%u", decPacket->refID[0], decPacket->refID[1], decPacket->refID[2], decPacket->refID[3]);
     } else {
         DEBUGLOGD ("refID: %.*s", 4, (char*)(decPacket->refID));
     }
-
-    // Reference timestamp
-    timestamp_s = flipInt32 (recPacket.reference.secondsOffset);
-    timestamp_us = flipInt32 (recPacket.reference.fraction);
-    //DEBUGLOGV ("timestamp_us %08X = %lu", timestamp_us, timestamp_us);
-    if (timestamp_s) {
-        decPacket->reference.tv_sec = timestamp_s - seventyYears;
-    } else {
-        decPacket->reference.tv_sec = 0;
-    }
-    decPacket->reference.tv_usec = ((float)(timestamp_us) / (float)0x100000000 * 1000000.0);
-    //DEBUGLOGV ("Reference: seconds %08X fraction %08X", recPacket.reference.secondsOffset, recPacket.reference.fraction);
-    //DEBUGLOGV ("Reference: %d.%06ld", decPacket->reference.tv_sec, decPacket->reference.tv_usec);
     DEBUGLOGV ("Reference: %s.%06ld", ctime (&(decPacket->reference.tv_sec)), decPacket->reference.tv_usec);
-
-    // Origin timestamp
-    timestamp_s = flipInt32 (recPacket.origin.secondsOffset);
-    timestamp_us = flipInt32 (recPacket.origin.fraction);
-    //DEBUGLOGV ("timestamp_us %08X = %lu", timestamp_us, timestamp_us);
-    if (timestamp_s) {
-        decPacket->origin.tv_sec = timestamp_s - seventyYears;
-    } else {
-        decPacket->origin.tv_sec = 0;
-    }
-    decPacket->origin.tv_usec = ((float)(timestamp_us) / (float)0x100000000 * 1000000.0);
-    //DEBUGLOGV ("Origin: seconds %08X fraction %08X", recPacket.origin.secondsOffset, recPacket.origin.fraction);
-    //DEBUGLOGV ("Origin: %d.%06ld", decPacket->origin.tv_sec, decPacket->origin.tv_usec);
     DEBUGLOGV ("Origin: %s.%06ld", ctime (&(decPacket->origin.tv_sec)), decPacket->origin.tv_usec);
-
-    // Receive timestamp
-    timestamp_s = flipInt32 (recPacket.receive.secondsOffset);
-    timestamp_us = flipInt32 (recPacket.receive.fraction);
-    //DEBUGLOGV ("timestamp_us %08X = %lu", timestamp_us, timestamp_us);
-    if (timestamp_s) {
-        decPacket->receive.tv_sec = timestamp_s - seventyYears;
-    } else {
-        decPacket->receive.tv_sec = 0;
-    }
-    decPacket->receive.tv_usec = ((float)(timestamp_us) / (float)0x100000000 * 1000000.0);
-    //DEBUGLOGV ("Receive: seconds %08X fraction %08X", recPacket.receive.secondsOffset, recPacket.receive.fraction);
-    //DEBUGLOGV ("Receive: %d.%06ld", decPacket->receive.tv_sec, decPacket->receive.tv_usec);
     DEBUGLOGV ("Receive: %s.%06ld", ctime (&(decPacket->receive.tv_sec)), decPacket->receive.tv_usec);
-
-    // Transmit timestamp
-    timestamp_s = flipInt32 (recPacket.transmit.secondsOffset);
-    timestamp_us = flipInt32 (recPacket.transmit.fraction);
-    //DEBUGLOGV ("timestamp_us %08X = %lu", timestamp_us, timestamp_us);
-
-    if (timestamp_s) {
-        decPacket->transmit.tv_sec = timestamp_s - seventyYears;
-    } else {
-        decPacket->transmit.tv_sec = 0;
-    }
-    decPacket->transmit.tv_usec = ((float)(timestamp_us) / (float)0x100000000 * 1000000.0);
-    //DEBUGLOGV ("Transmit: seconds %08X fraction %08X", recPacket.transmit.secondsOffset, recPacket.transmit.fraction);
-    //DEBUGLOGV ("Transmit: %d.%06ld", decPacket->transmit.tv_sec, decPacket->transmit.tv_usec);
     DEBUGLOGV ("Transmit: %s.%06ld", ctime (&(decPacket->transmit.tv_sec)), decPacket->transmit.tv_usec);
-    
-    decPacket->destination = packetLastReceived;
 
     return decPacket;
 }
 
-bool NTPClient::checkNTPresponse (NTPPacket_t* ntpPacket, int64_t offsetUs) {
-    //dumpNtpPacketInfo (ntpPacket);
-    if (ntpPacket->flags.li != 0) {
-        DEBUGLOGE ("Leap indicator error: %d", ntpPacket->flags.li);
-        return false;
-    }
+NTPSyncConfig_t NTPClient::getSyncConfig () {
+    NTPSyncConfig_t config;
     
-    if (ntpPacket->flags.vers < NTP_MIN_VER) {
-        DEBUGLOGE ("NTP version error: %d", ntpPacket->flags.vers);
-        return false;
-    }
-
-    if (ntpPacket->flags.mode != 4) {
-        DEBUGLOGE ("NTP mode error: %d", ntpPacket->flags.mode);
-        return false;
-    }
-    
-    if (ntpPacket->peerStratum < 1 || ntpPacket->peerStratum > 15) {
-        DEBUGLOGE ("Peer stratum error: %d", ntpPacket->peerStratum);
-        return false;
-    }
-
-    if (status == syncd || status == partialSync) {
-        //Serial.printf ("Peer precission:   %0.9f s\n", ntpPacket->clockPrecission);
-        //Serial.printf ("minSyncAccuracyUs: %0.9f s\n", minSyncAccuracyUs / 10000000.0);
-        if (ntpPacket->clockPrecission > (float)(minSyncAccuracyUs / 10000000.0)/* || ntpPacket->clockPrecission == 0.0*/) { // 5 zeroes, that's correct. us*1000000 / 10
-            DEBUGLOGE ("Peer precission error: %0.3f us > minSyncAccuracyUs/10 %0.3f", ntpPacket->clockPrecission * 1000000.0, minSyncAccuracyUs / 10.0);
-            return false;
-        }
-
-        //Serial.printf ("Dispersion:        %0.6f s\n", ntpPacket->dispersion);
-        //Serial.printf ("Offset:            %0.6f s\n", offsetUs / 1000000.0);
-        if (ntpPacket->dispersion > abs (offsetUs / 1000000.0) || ntpPacket->dispersion == 0.0) {
-            DEBUGLOGE ("Dispersion error: %0.3f ms > Offset: %0.3f ms", ntpPacket->dispersion * 1000.0, (float)(offsetUs / 1000.0));
-            return false;
-        }
-    }
-
-    return true;
+    config.numAveRounds = numAveRounds;
+    config.timeSyncThreshold = timeSyncThreshold;
+    config.minSyncAccuracyUs = minSyncAccuracyUs;
+    config.maxNumSyncRetry = maxNumSyncRetry;
+    config.maxDispersionErrors = maxDispersionErrors;
+    config.shortInterval = shortInterval;
+    config.longInterval = longInterval;
+    config.ntpTimeout = ntpTimeout;
+    config.acceptBroadcast = broadcastEnabled;
+    config.acceptPeer = numPeers > 0;
+    return config;
 }
 
 timeval NTPClient::calculateOffset (NTPPacket_t* ntpPacket) {
-    double t1, t2, t3, t4;
     timeval tv_offset;
 
-    t1 = ntpPacket->origin.tv_sec + ntpPacket->origin.tv_usec / 1000000.0;
-    t2 = ntpPacket->receive.tv_sec + ntpPacket->receive.tv_usec / 1000000.0;
-    t3 = ntpPacket->transmit.tv_sec + ntpPacket->transmit.tv_usec / 1000000.0;
-    t4 = ntpPacket->destination.tv_sec + ntpPacket->destination.tv_usec / 1000000.0;
-    offset = ((t2 - t1) / 2.0 + (t3 - t4) / 2.0); // in seconds
-    delay = (t4 - t1) - (t3 - t2); // in seconds
+    ntpCalculateOffset (ntpPacket, &offset, &delay);
 
-    DEBUGLOGV ("T1: %f T2: %f T3: %f T4: %f", t1, t2, t3, t4);
     DEBUGLOGD ("T1: %s", getTimeDateString (ntpPacket->origin));
-    //DEBUGLOGV ("T1: %016X  %016X", ntpPacket->origin.tv_sec, ntpPacket->origin.tv_usec);
     DEBUGLOGD ("T2: %s", getTimeDateString (ntpPacket->receive));
-    //DEBUGLOGV ("T2: %016X  %016X", ntpPacket->receive.tv_sec, ntpPacket->receive.tv_usec);
     DEBUGLOGD ("T3: %s", getTimeDateString (ntpPacket->transmit));
-    //DEBUGLOGV ("T3: %016X  %016X", ntpPacket->transmit.tv_sec, ntpPacket->transmit.tv_usec);
     DEBUGLOGD ("T4: %s", getTimeDateString (ntpPacket->destination));
-    //DEBUGLOGV ("T4: %016X  %016X", ntpPacket->destination.tv_sec, ntpPacket->destination.tv_usec);
     DEBUGLOGI ("Offset: %f, Delay: %f", offset, delay);
 
     tv_offset.tv_sec = (time_t)offset;
@@ -1132,6 +2074,7 @@ bool NTPClient::adjustOffset (timeval* offset) {
     if (settimeofday (&newtime, (timezone*)NULL)) { // hard adjustment
         return false;
     }
+    invalidateTimeCache ();
     //Serial.printf ("millis() offset 1: %lld\n", currenttime_us / 1000 - millis ());
     //Serial.printf ("millis() offset 2: %lld\n", newtime_us / 1000 - millis ());
     DEBUGLOGD ("Offset: %lld", (newtime_us - currenttime_us));
@@ -1140,21 +2083,31 @@ bool NTPClient::adjustOffset (timeval* offset) {
     //Serial.printf ("Requested new time %s\n", ctime (&(newtime.tv_sec)));
 
     DEBUGLOGI ("Hard adjust");
+    statsCount (stats.steps);
 
     lastSyncd = newtime;
+    NTP_TRACE_MARK (traceAdjusted);
     DEBUGLOGI ("Offset adjusted");
     return true;
 }
 
 char* NTPClient::ntpEvent2str (NTPEvent_t e) {
-    const int resultMaxSize = 150;
-    static char result[resultMaxSize];
+    const int resultMaxSize = EVENT_STR_LENGTH;
+    char* result = eventStrBuffer;
+    char address[IP_ADDRESS_STR_LENGTH];
+    char eventTime[MAX_TIME_STR_LENGTH] = "";
+    
+    ntpFormatIPAddress (&e.info.serverAddr, address, sizeof (address));
+    if (e.event == timeSyncd || e.event == partlySync) {
+        // Time of event, not of delivery. Same cache as getTimeDateStringUs(), into a local buffer so strBuffer is kept
+        timeCache.renderUs (eventTime, sizeof (eventTime), e.time, TIME_DATE_STR_FORMAT, true, localZone, timeCacheGeneration);
+    }
     switch (e.event) {
     case timeSyncd:
         snprintf (result, resultMaxSize, "%d:    Got NTP time %s from %s:%u. Offset: %0.3f ms. Delay: %0.3f ms. Dispersion: %0.3f ms",
                   e.event,
-                  NTP.getTimeDateStringUs (),
-                  e.info.serverAddress.toString ().c_str (),
+                  eventTime,
+                  address,
                   e.info.port,
                   e.info.offset * 1000,
                   e.info.delay * 1000,
@@ -1163,13 +2116,13 @@ char* NTPClient::ntpEvent2str (NTPEvent_t e) {
     case noResponse:
         snprintf (result, resultMaxSize, "%d:   No response from NTP server %s:%u",
                   e.event,
-                  e.info.serverAddress.toString ().c_str (),
+                  address,
                   e.info.port);
         break;
     case invalidAddress:
         snprintf (result, resultMaxSize, "%d:   Invalid address %s",
                   e.event,
-                  e.info.serverAddress.toString ().c_str ());
+                  address);
         break;
     case invalidPort:
         snprintf (result, resultMaxSize, "%d:   Invalid port %u",
@@ -1179,15 +2132,15 @@ char* NTPClient::ntpEvent2str (NTPEvent_t e) {
     case requestSent:
         snprintf (result, resultMaxSize, "%d:    NTP request sent to %s:%u",
                   e.event,
-                  e.info.serverAddress.toString ().c_str (),
+                  address,
                   e.info.port);
         break;
     case partlySync:
         snprintf (result, resultMaxSize, "%d: #%u Partial sync %s from %s:%u. Offset: %0.3f ms. Delay: %0.3f ms. Dispersion: %0.3f ms",
                   e.event,
                   e.info.retrials,
-                  NTP.getTimeDateStringUs (),
-                  e.info.serverAddress.toString ().c_str (),
+                  eventTime,
+                  address,
                   e.info.port,
                   e.info.offset * 1000,
                   e.info.delay * 1000,
@@ -1196,7 +2149,7 @@ char* NTPClient::ntpEvent2str (NTPEvent_t e) {
     case accuracyError:
         snprintf (result, resultMaxSize, "%d:   Accuracy error from %s:%u. Offset: %0.3f ms. Dispersion: %0.3f ms",
                   e.event,
-                  e.info.serverAddress.toString ().c_str (),
+                  address,
                   e.info.port,
                   e.info.offset * 1000,
                   e.info.dispersion * 1000);
@@ -1204,18 +2157,25 @@ char* NTPClient::ntpEvent2str (NTPEvent_t e) {
     case syncNotNeeded:
         snprintf (result, resultMaxSize, "%d:    Sync not needed from %s:%u. Offset: %0.3f ms. Dispersion: %0.3f ms",
                   e.event,
-                  e.info.serverAddress.toString ().c_str (),
+                  address,
                   e.info.port,
                   e.info.offset * 1000,
                   e.info.dispersion * 1000);
         break;
+    case syncTraced:
+        snprintf (result, resultMaxSize, "%d:    Sync cycle #%u took %0.3f ms. Waited %0.3f ms for response",
+                  e.event,
+                  e.info.retrials,
+                  e.info.offset * 1000,
+                  e.info.delay * 1000);
+        break;
     case errorSending:
         snprintf (result, resultMaxSize, "%d:   Error sending NTP request", e.event);
         break;
     case responseError:
         snprintf (result, resultMaxSize, "%d:   NTP response error from %s:%u",
                   e.event,
-                  e.info.serverAddress.toString ().c_str (),
+                  address,
                   e.info.port);
         break;
     case syncError:
@@ -27,6 +27,7 @@ extern "C" {
 #include "sys/time.h"
 #include "time.h"
 #include "lwip/udp.h"
+#include "lwip/igmp.h"
 }
 
 #ifdef ESP32
@@ -36,37 +37,45 @@ extern "C" {
 #endif
 
 #ifdef ESP32
+#include "esp_timer.h"
 #include "TZdef.h"
 #else
 #include "TZ.h"
 #endif
+#include "NTPCore.h"
 
-
-constexpr auto NTP_MIN_VER = 3; /// 
+//#define NTP_PACKET_CAPTURE ///< @brief Define to keep last raw packets for pcapng export. See `NTPClient::dumpPacketCapture()`
+//#define NTP_SYNC_TRACE ///< @brief Define to record timestamps of every sync cycle phase. See `NTPClient::getSyncTrace()`
 
 constexpr auto DEFAULT_NTP_SERVER = "pool.ntp.org"; ///< @brief Default international NTP server. I recommend you to select a closer server to get better accuracy
 constexpr auto DEFAULT_NTP_PORT = 123; ///< @brief Default local udp port. Select a different one if neccesary (usually not needed)
 constexpr auto DEFAULT_LOCAL_PORT = 12323; /// 
-constexpr auto DEFAULT_NTP_INTERVAL = 1800; ///< @brief Default sync interval 30 minutes
-constexpr auto DEFAULT_NTP_SHORTINTERVAL = 15; ///< @brief Sync interval when sync has not been achieved. 15 seconds
-constexpr auto DEFAULT_NTP_TIMEOUT = 5000; ///< @brief Default NTP timeout ms
 //constexpr auto FAST_NTP_SYNCNTERVAL = DEFAULT_NTP_TIMEOUT * 1.1; ///< @brief Sync interval when sync has not reached required accuracy in ms
 constexpr auto MIN_NTP_TIMEOUT = 250; ///< @brief Minumum admisible ntp timeout in ms
 constexpr auto MIN_NTP_INTERVAL = 10; ///< @brief Minumum NTP request interval in seconds
-constexpr auto DEFAULT_MIN_SYNC_ACCURACY_US = 5000; ///< @brief Minimum sync accuracy in us
-constexpr auto DEFAULT_MAX_RESYNC_RETRY = 3; ///< @brief Maximum number of sync retrials if offset is above accuravy
 constexpr auto DEAULT_NUM_TIMEOUTS = 3; ///< @brief After this number of timeouts there is no more continiuos
 #ifdef ESP8266
 constexpr auto ESP8266_LOOP_TASK_INTERVAL = 500; ///< @brief Loop task period on ESP8266
 constexpr auto ESP8266_RECEIVER_TASK_INTERVAL = 100; ///< @brief Receiver task period on ESP8266
 #endif // ESP8266
-constexpr auto DEFAULT_TIME_SYNC_THRESHOLD = 2500; ///< @brief If calculated offset is less than this in us clock will not be corrected
-constexpr auto DEFAULT_NUM_OFFSET_AVE_ROUNDS = 1; ///< @brief Number of NTP request and response rounds to calculate offset average
+constexpr auto DEFAULT_DNS_CACHE_TTL = 3600; ///< @brief Default time a resolved NTP server address is reused, in seconds
+constexpr auto MIN_DNS_CACHE_TTL = 60; ///< @brief Minimum admisible DNS cache TTL in seconds
+constexpr auto MAX_POOL_ADDRESSES = 4; ///< @brief Maximum number of addresses kept for a NTP server name, useful for pool names
+constexpr auto MAX_POOL_MEMBER_FAILURES = 2; ///< @brief A pool address is evicted after this number of timeouts or invalid responses
+constexpr auto POOL_DIVERSITY_HISTORY = 16; ///< @brief Number of past pool addresses remembered to count distinct ones
+constexpr uint8_t NO_POOL_MEMBER = 0xFF; ///< @brief Request was not sent to a server pool address, as in broadcast delay calibration
 constexpr auto MAX_OFFSET_AVERAGE_ROUNDS = 5; ///< @brief Maximum number of NTP request for offset average calculation
 
+constexpr uint32_t NTP_MULTICAST_ADDRESS = 0x010100E0; ///< @brief NTP IPv4 multicast group 224.0.1.1, in network order
+constexpr auto NTP_TRACE_RING_SIZE = 4; ///< @brief Number of finished sync cycles kept when `NTP_SYNC_TRACE` is defined
+constexpr uint32_t NTP_TRACE_NOT_REACHED = 0xFFFFFFFF; ///< @brief Phase time of a phase that sync cycle did not get to
+constexpr auto MAX_NTP_EVENT_LISTENERS = 4; ///< @brief Maximum number of event listeners
+constexpr auto NTP_EVENT_QUEUE_SIZE = 8; ///< @brief Events waiting to be delivered to user code. Must be a power of two
+constexpr auto MAX_NTP_PEERS = 4; ///< @brief Maximum number of symmetric mode peers
+constexpr auto NTP_CLOCK_PHI = 15e-6; ///< @brief Frequency tolerance used to grow dispersion with time since last sync, as in RFC 5905
+
 constexpr auto TZNAME_LENGTH = 60; ///< @brief Max TZ name description length
 constexpr auto SERVER_NAME_LENGTH = 40; ///< @brief Max server name (FQDN) length
-constexpr auto NTP_PACKET_SIZE = 48; ///< @brief NTP time is in the first 48 bytes of message
 
 /* Useful Constants */
 #ifndef SECS_PER_MIN
@@ -97,184 +106,107 @@ constexpr auto SECS_YR_2000 = ((time_t)(946684800UL)); ///< @brief The time at t
 #include <ESP8266WiFi.h>
 #endif
 #include <Ticker.h>
+#include <MD5Builder.h>
 
 #include "NTPEventTypes.h"
+#include "NTPTimeZone.h"
+#include "NTPTimeFormat.h"
+#include "NTPEventQueue.h"
+#include "NTPEventSerializer.h"
+#include "NTPAllanDeviation.h"
+#ifdef NTP_PACKET_CAPTURE
+#include "NTPPacketCapture.h"
+#endif // NTP_PACKET_CAPTURE
 
   /**
-    * @brief NTP client status code
+    * @brief Origin of a time sample
     */
-typedef enum NTPStatus {
-    syncd = 0, // Time synchronized correctly
-    unsyncd = -1, // Time may not be valid
-    partialSync = 1 // NPT is synchronised but precission is below threshold
-} NTPStatus_t; // Only for internal library use
+typedef enum {
+    unicastSample, // Response to a request sent to NTP server
+    broadcastSample, // Packet from a broadcast or multicast server
+    peerSample // Symmetric mode response from a peer
+} NTPSampleSource_t; // Only for internal library use
+
 
   /**
-    * @brief Flags in NTP packet
+    * @brief NTP server address got from DNS. A name may resolve to several of them, as in pool.ntp.org
     */
 typedef struct {
-    /**
-      * @brief 2-bit integer warning of an impending leap
-      * second to be inserted or deleted in the last minute of the current
-      * month with values defined in this table
-      * 
-      * | Value | Meaning |
-      * |:----------:|-------------|
-      * | 0     | no warning                             |
-      * | 1     | last minute of the day has 61 seconds  |
-      * | 2     | last minute of the day has 59 seconds  |
-      * | 3     | unknown (clock unsynchronized)         |
-      */
-    int li;
-    int vers; ///< @brief 3-bit integer representing the NTP version number, currently 4
-    /**
-      * @brief 3-bit integer representing the mode, with values defined in this table
-      * 
-      * | Value | Meaning                  |
-      * |:-----:|--------------------------|
-      * | 0     | reserved                 |
-      * | 1     | symmetric active         |
-      * | 2     | symmetric passive        |
-      * | 3     | client                   |
-      * | 4     | server                   |
-      * | 5     | broadcast                |
-      * | 6     | NTP control message      |
-      * | 7     | reserved for private use |
-      */
-    int mode;
-} NTPFlags_t;
+    ip_addr_t address; ///< @brief Server address. May be IPv4 or IPv6
+    unsigned long resolved; ///< @brief `millis()` value when address was last got from DNS
+    unsigned int requests; ///< @brief Number of requests sent to this address
+    unsigned int failures; ///< @brief Consecutive timeouts or invalid responses from this address
+} NTPPoolMember_t;
 
   /**
-    * @brief NTP packet structure
+    * @brief Sync cycle phase boundaries
     */
-typedef struct {
-    bool valid = false; ///< @brief true if following data is valid
-    NTPFlags_t flags; ///< @brief NTP packet flags as NTPFlags_t
-    
-    /**
-      * @brief 8-bit integer representing the stratum
-      * 
-      * | Value  | Meaning                                             |
-      * |:------:|-----------------------------------------------------|
-      * | 0      | unspecified or invalid                              |
-      * | 1      | primary server (e.g., equipped with a GPS receiver) |
-      * | 2-15   | secondary server (via NTP)                          |
-      * | 16     | unsynchronized                                      |
-      * | 17-255 | reserved                                            |
-      */
-    uint8_t peerStratum;
-    
-     /**
-      * @brief Maximum interval between successive messages, in seconds.
-      *
-      * Calculated from 8-bit signed integer representing log2 value. Suggested default limits for 
-      * minimum and maximum poll intervals are 6 and 10, what represent 64 to 1024 seconds, respectively
-      */
-    uint32_t pollingInterval;
-    
-    /**
-      * @brief 8-bit signed integer representing the precision of the
-      * system clock, in log2 seconds
-      * 
-      * For instance, a value of -18 corresponds to a precision of about one microsecond.
-      * The precision can be determined when the service first starts up as the minimum
-      * time of several iterations to read the system clock
-      */
-    float clockPrecission;
-       
-    float rootDelay; ///< @brief Total round-trip delay to the reference clock
-    
-    float dispersion; ///< @brief Total dispersion to the reference clock
-    
-     /**
-      * @brief 32-bit code identifying the particular server or reference clock
-      * 
-      * The interpretation depends on the value in the stratum field.
-      * For packet stratum 0 (unspecified or invalid), this is a four-character ASCII [RFC1345] string,
-      * called the "kiss code", used for debugging and monitoring purposes. For stratum 1 (reference
-      * clock), this is a four-octet, left-justified, zero-padded ASCII string assigned to the
-      * reference clock. 
-      * 
-      * The authoritative list of Reference Identifiers is maintained by IANA; however, any string
-      * beginning with the ASCII character "X" is reserved for unregistered experimentation and 
-      * development. Next identifiers have been used as ASCII identifiers:
-      * 
-      * | ID   | Clock Source                                             |
-      * |:----:|----------------------------------------------------------|
-      * | GOES | Geosynchronous Orbit Environment Satellite               |
-      * | GPS  | Global Position System                                   |
-      * | GAL  | Galileo Positioning System                               |
-      * | PPS  | Generic pulse-per-second                                 |
-      * | IRIG | Inter-Range Instrumentation Group                        |
-      * | WWVB | LF Radio WWVB Ft. Collins, CO 60 kHz                     |
-      * | DCF  | LF Radio DCF77 Mainflingen, DE 77.5 kHz                  |
-      * | HBG  | LF Radio HBG Prangins, HB 75 kHz                         |
-      * | MSF  | LF Radio MSF Anthorn, UK 60 kHz                          |
-      * | JJY  | LF Radio JJY Fukushima, JP 40 kHz, Saga, JP 60 kHz       |
-      * | LORC | MF Radio LORAN C station, 100 kHz                        |
-      * | TDF  | MF Radio Allouis, FR 162 kHz                             |
-      * | CHU  | HF Radio CHU Ottawa, Ontario                             |
-      * | WWV  | HF Radio WWV Ft. Collins, CO                             |
-      * | WWVH | HF Radio WWVH Kauai, HI                                  |
-      * | NIST | NIST telephone modem                                     |
-      * | ACTS | NIST telephone modem                                     |
-      * | USNO | USNO telephone modem                                     |
-      * | PTB  | European telephone modem                                 |
-      * 
-      * Above stratum 1 (secondary servers and clients): this is the reference identifier of
-      * the server and can be used to detect timing loops. If using the IPv4 address family,
-      * the identifier is the four-octet IPv4 address. If using the IPv6 address family, it is the
-      * first four octets of the MD5 hash of the IPv6 address. Note that, when using the IPv6 address
-      * family on an NTPv4 server with a NTPv3 client, the Reference Identifier field appears to be a 
-      * random value and a timing loop might not be detected
-      */
-    uint8_t refID[4];
-    
-    timeval reference; ///< @brief Time when the system clock was last set or corrected
-    timeval origin; ///< @brief Time at the client when the request departed for the server
-    timeval receive; ///< @brief Time at the server when the request arrived from the client
-    timeval transmit; ///< @brief Time at the server when the response left for the client
-    timeval destination; ///< Time at the client when the reply arrived from the server, in NTP timestamp format
-} NTPPacket_t;
+typedef enum {
+    traceStart, ///< @brief `getTime()` started a sync cycle
+    traceResolved, ///< @brief Server address got from cache or DNS
+    traceConnected, ///< @brief `udp_connect()` returned
+    traceSent, ///< @brief Request handed to lwIP
+    traceReceived, ///< @brief Response got in lwIP receive callback
+    traceProcessing, ///< @brief Receiver task picked response
+    traceDecoded, ///< @brief Response decoded and offset calculated
+    traceAdjusted, ///< @brief System clock adjusted
+    NUM_TRACE_PHASES ///< @brief Number of phases
+} NTPTracePhase_t;
 
+  /**
+    * @brief Timing of a sync cycle
+    */
+typedef struct {
+    uint32_t cycle; ///< @brief Sync cycle number since boot
+    uint64_t startUs; ///< @brief Uptime when cycle started, in microseconds
+    uint32_t phaseUs[NUM_TRACE_PHASES]; ///< @brief Time of every phase since `startUs`, in microseconds. `NTP_TRACE_NOT_REACHED` if cycle ended before it
+} NTPSyncTrace_t;
 
   /**
-    * @brief NTP Timestamp Format
-    * The prime epoch, or base date of era 0, is 0 h 1 January 1900 UTC, when all bits are zero
+    * @brief Symmetric mode peer status
     */
 typedef struct {
-    int32_t secondsOffset; ///< @brief 32-bit seconds field spanning 136 years since 1-Jan-1900 00:00 UTC
-    uint32_t fraction; ///< @brief 32-bit fraction field resolving 232 picoseconds (1/2^32)
-} timestamp64_t;
+    ip_addr_t address; ///< @brief Peer address
+    uint8_t stratum; ///< @brief Last stratum announced by peer. 16 if it is not synchronized
+    double offset; ///< @brief Last measured offset to peer clock, in seconds
+    double delay; ///< @brief Last measured round trip delay to peer, in seconds
+    float rootDistance; ///< @brief Peer distance to its reference clock, in seconds
+    unsigned long lastResponse; ///< @brief `millis()` value when last valid response was got
+    unsigned int sent; ///< @brief Number of packets sent to peer
+    unsigned int received; ///< @brief Number of valid responses got from peer
+    timestamp64_t transmit; ///< @brief Transmit timestamp of last packet sent, to match response
+} NTPPeer_t;
 
   /**
-    * @brief Short NTP Timestamp Format
-    * 
-    * Used for precission, dispersion, etc
+    * @brief Clock source of last applied sample. Replies to clients and peers are built from it
     */
 typedef struct {
-    int16_t secondsOffset; ///< @brief 16-bit seconds field spanning 18 hours
-    uint16_t fraction; ///< @brief 16-bit fraction field resolving 15.3 microseconds (1/2^16)
-} timestamp32_t;
-
-typedef struct __attribute__ ((packed, aligned (1))) {
-    uint8_t flags;
-    uint8_t peerStratum;
-    uint8_t pollingInterval;
-    int8_t clockPrecission;
-    timestamp32_t rootDelay;
-    timestamp32_t dispersion;
-    uint8_t refID[4];
-    timestamp64_t reference;
-    timestamp64_t origin;
-    timestamp64_t receive;
-    timestamp64_t transmit;
-} NTPUndecodedPacket_t;
+    bool valid; ///< @brief A sample has been applied
+    ip_addr_t address; ///< @brief Sample source. NTP server, broadcast server or peer
+    uint8_t stratum; ///< @brief Source stratum
+    float rootDelay; ///< @brief Source root delay plus round trip delay to it, in seconds
+    float rootDispersion; ///< @brief Source root dispersion, in seconds
+    timeval reference; ///< @brief Local time when sample was applied
+} NTPUpstream_t;
 
 
 typedef std::function<void (NTPEvent_t)> onSyncEvent_t; ///< @brief Event notifier callback
 
-static char strBuffer[35]; ///< @brief Temporary buffer for time and date strings
+/**
+  * @brief How events are delivered to listeners
+  */
+typedef enum {
+    eventsAuto, ///< @brief Queued and delivered from a low priority task on ESP32. Same as `eventsImmediate` on ESP8266
+    eventsManual, ///< @brief Queued until user code calls `handleEvents()`
+    eventsImmediate ///< @brief Handler is called from context that generates event, as timer or network callbacks
+} NTPEventDispatch_t;
+
+constexpr auto STR_BUFFER_LENGTH = TIME_CACHE_STR_LENGTH; ///< @brief Length of buffer for time and date strings
+constexpr size_t TIME_BATCH_CHUNK = 16; ///< @brief Timestamps converted at once by batch formatter, on stack
+constexpr auto TIME_STR_FORMAT = "%H:%M:%S"; ///< @brief Format used by `getTimeStr()`
+constexpr auto DATE_STR_FORMAT = "%02d/%m/%04Y"; ///< @brief Format used by `getDateStr()`
+constexpr auto TIME_DATE_STR_FORMAT = "%02d/%02m/%04Y %02H:%02M:%02S"; ///< @brief Default format used by `getTimeDateString()`
+constexpr auto EVENT_STR_LENGTH = 150; ///< @brief Length of buffer for event descriptions
 
 /// weak functions to get connection status, reconnect and IP address of device
 extern "C"
@@ -295,24 +227,104 @@ protected:
     timeval firstSync;              ///< @brief Stored time of first successful sync after boot
     timeval packetLastReceived;     ///< @brief Moment when a NTP response has arrived
     bool ntpRequested = false;      ///< @brief Indicates that a NTP response is pending
-    unsigned long uptime = 0;       ///< @brief Time since boot
+    NTPUptimeFormatter uptimeFormatter; ///< @brief Last rendered uptime string
     unsigned int shortInterval = DEFAULT_NTP_SHORTINTERVAL * 1000;  ///< @brief Interval to set periodic time sync until first synchronization.
     unsigned int longInterval = DEFAULT_NTP_INTERVAL * 1000;        ///< @brief Interval to set periodic time sync
     unsigned int actualInterval = DEFAULT_NTP_SHORTINTERVAL * 1000; ///< @brief Currently selected interval
-    onSyncEvent_t onSyncEvent;      ///< @brief Event handler callback
+    NTPStats_t stats = {};          ///< @brief Sync statistics, written under `statsSequence`
+    volatile uint32_t statsSequence = 0; ///< @brief Seqlock counter for `stats`. Odd while an update is in progress
+    NTPAllanDeviation allan;        ///< @brief Oscillator stability estimation, written under `statsSequence`
+    int64_t lastSampleOffset = 0;   ///< @brief Offset of previous sample for jitter calculation, in microseconds
+    bool lastSampleValid = false;   ///< @brief `lastSampleOffset` has a value
+#ifdef ESP32
+    portMUX_TYPE statsMux = portMUX_INITIALIZER_UNLOCKED; ///< @brief Serializes statistics writers running on different tasks
+    portMUX_TYPE poolMux = portMUX_INITIALIZER_UNLOCKED; ///< @brief Guards `serverPool`. DNS callback updates it from lwIP task
+    portMUX_TYPE upstreamMux = portMUX_INITIALIZER_UNLOCKED; ///< @brief Guards `upstream`. Server and peer replies read it from lwIP task
+#endif
+#ifdef NTP_PACKET_CAPTURE
+    NTPPacketCapture packetCapture; ///< @brief Last raw packets
+    unsigned long maxCaptureTime = 0; ///< @brief Maximum time spent capturing a received packet, in microseconds
+#endif // NTP_PACKET_CAPTURE
+#ifdef NTP_SYNC_TRACE
+    NTPSyncTrace_t traces[NTP_TRACE_RING_SIZE + 1]; ///< @brief Last sync cycle timings. Current one is at `traceIndex`, one extra slot keeps it from evicting a finished cycle
+    uint8_t traceIndex = 0;         ///< @brief Ring position of cycle in progress
+    uint32_t traceCycles = 0;       ///< @brief Number of sync cycles started
+    bool traceActive = false;       ///< @brief A cycle is being traced
+    bool traceEvents = false;       ///< @brief Emit `syncTraced` event when a cycle ends
+#endif // NTP_SYNC_TRACE
+    NTPEventRegistry<NTPEvent_t, onSyncEvent_t, MAX_NTP_EVENT_LISTENERS> eventListeners; ///< @brief Event listeners, masks built with `ntpEventMask()`
+    int legacyListener = -1;        ///< @brief Listener slot used by `onNTPSyncEvent()`
+    NTPEventQueue<NTPEvent_t, NTP_EVENT_QUEUE_SIZE> eventQueue; ///< @brief Events pending to be delivered
+    NTPEventDispatch_t eventDispatch = eventsAuto; ///< @brief Event delivery mode
+#ifdef ESP32
+    TaskHandle_t eventHandle = NULL; ///< @brief Event delivery task handle
+#endif
+    unsigned long maxTimerContextTime = 0;  ///< @brief Maximum time spent in response timeout callback, in microseconds
+    unsigned long maxReceiveContextTime = 0; ///< @brief Maximum time spent in packet receive callbacks and receiver task, in microseconds
     uint16_t ntpTimeout = DEFAULT_NTP_TIMEOUT;                      ///< @brief Response timeout for NTP requests
     long minSyncAccuracyUs = DEFAULT_MIN_SYNC_ACCURACY_US;          ///< @brief DEfault minimum offset value to consider a good sync
     unsigned int maxNumSyncRetry = DEFAULT_MAX_RESYNC_RETRY;                ///< @brief Number of resync repetitions if minimum accuracy has not been reached
-    unsigned int numSyncRetry;              ///< @brief Current resync repetition
     unsigned int maxDispersionErrors = DEFAULT_MAX_RESYNC_RETRY;            ///< @brief Number of resync repetitions if server has a dispersion value bigger than offset absolute value
-    unsigned int numDispersionErrors;
     long timeSyncThreshold = DEFAULT_TIME_SYNC_THRESHOLD;           ///< @brief If calculated offset is below this threshold it will not be applied. 
                                                                     //            This is to avoid continious innecesary glitches in clock
     unsigned int numTimeouts = 0;           ///< @brief After this number of timeout responses ntp sync time is increased
     NTPStatus_t status = unsyncd;   ///< @brief Sync status
     char ntpServerName[SERVER_NAME_LENGTH];                         ///< @brief  of NTP server on Internet or LAN
-    IPAddress ntpServerIPAddress;   ///< @brief  IP address of NTP server on Internet or LAN
+    ip_addr_t ntpServerAddr;        ///< @brief  IPv4 or IPv6 address of NTP server on Internet or LAN currently in use
+    NTPPoolMember_t serverPool[MAX_POOL_ADDRESSES]; ///< @brief Cached addresses of NTP server name
+    uint8_t poolSize = 0;           ///< @brief Number of valid entries in `serverPool`
+    uint8_t poolIndex = 0;          ///< @brief Rotation cursor. Entry of `serverPool` picked by last `getTime()`
+    uint8_t requestMember = NO_POOL_MEMBER; ///< @brief Entry of `serverPool` last request was sent to
+    ip_addr_t requestAddr;          ///< @brief Address last request was sent to. Finds its pool entry if it was moved
+    volatile bool poolFlushRequested = false; ///< @brief Set to discard all cached addresses on next request
+    unsigned int poolDistinctAddresses = 0;   ///< @brief Number of different addresses added to `serverPool` since name was set
+    uint32_t poolSeenHashes[POOL_DIVERSITY_HISTORY]; ///< @brief Hashes of last distinct pool addresses, to tell new ones from re-additions
+    unsigned long dnsCacheTtl = DEFAULT_DNS_CACHE_TTL * 1000;      ///< @brief Time a resolved address is reused, in milliseconds
+    unsigned long lastDnsRequest = 0;       ///< @brief `millis()` value when last DNS resolution was started. Limits cache refresh rate
+    volatile uint8_t dnsRequested = 0;      ///< @brief Number of DNS resolutions in progress, one per address family
+    volatile bool dnsRoundSucceeded = false; ///< @brief True if any address family got an address in current DNS resolution
+    volatile int preferredAddrType = -1;    ///< @brief Address family (`IPADDR_TYPE_V4` or `IPADDR_TYPE_V6`) that answered last. -1 if none
+    volatile bool sendAfterResolve = false; ///< @brief True if a NTP request has to be sent when DNS resolution finishes
+    volatile bool reconnectRequested = false; ///< @brief Set from lwIP context to ask loop task for a WiFi reconnection
+    unsigned long maxLoopBlockingTime = 0;  ///< @brief Maximum time spent in a single loop task run, in microseconds
     bool manageWifi = true;   ///< @brief  Enables this library to manage wifi reconnection. True by default
+    uint16_t localPort = DEFAULT_LOCAL_PORT; ///< @brief Local UDP port. Every instance needs a different one
+    unsigned int dnsErrors = 0;     ///< @brief Consecutive DNS resolution errors
+    unsigned long lastGotTime = 0;  ///< @brief `millis()` value when last sync was started by loop task
+    char strBuffer[STR_BUFFER_LENGTH];  ///< @brief Temporary buffer for time and date strings
+    char eventStrBuffer[EVENT_STR_LENGTH]; ///< @brief Buffer for `ntpEvent2str` result
+    static volatile uint32_t timeCacheGeneration; ///< @brief Incremented on time zone change or clock step to invalidate all cached times
+    NTPTimeZone localZone;          ///< @brief This instance copy of compiled process time zone rules, set with `setTimeZone()`
+    NTPLocalTimeCache timeCache;    ///< @brief Last local time and rendered time string, used by string formatters
+    
+    /**
+      * @brief Gets broken down local time. Result is cached so conversion runs at most once per second.
+      * Compiled time zone rules are used if `setTimeZone()` got a valid TZ string, `localtime_r()` otherwise
+      * @param moment UNIX time to convert
+      * @return Local time. Valid until next call
+      */
+    const tm* getLocalTm (time_t moment) {
+        return timeCache.localTm (moment, localZone, timeCacheGeneration);
+    }
+    
+    /**
+      * @brief Renders a time with microseconds into `strBuffer`. Part of the string that depends only on seconds is
+      * cached, so consecutive calls within the same second only render microseconds
+      * @param moment Time to render
+      * @param format Format as strftime for seconds part
+      * @param withZone Append time zone abbreviation
+      * @return `strBuffer`
+      */
+    char* renderTimeUs (const timeval& moment, const char* format, bool withZone) {
+        return timeCache.renderUs (strBuffer, sizeof (strBuffer), moment, format, withZone, localZone, timeCacheGeneration);
+    }
+    
+    /**
+      * @brief Invalidates cached local times of all instances
+      */
+    static void invalidateTimeCache () {
+        timeCacheGeneration++;
+    }
 public:
 #ifdef ESP32
     //bool terminateTasks = false;
@@ -325,6 +337,7 @@ public:
 protected:
     NTPPacket_t lastNtpPacket;			///< 
     NTPUndecodedPacket_t recPacket;	///< 
+    NTPUpstream_t upstream = {};    ///< @brief Clock source of last applied sample. Use `getUpstream()` and `setUpstream()`
     
     Ticker responseTimer;           ///< @brief Timer to trigger response timeout
     bool isConnected = false;       ///< @brief True if client has resolved correctly server IP address
@@ -333,11 +346,36 @@ protected:
     timezone timeZone;              ///< @brief 
     char tzname[TZNAME_LENGTH];     ///< @brief Configuration string for local time zone
     
-    int64_t offsetSum;              ///< @brief Sum of offsets for average calculation
-    int64_t offsetAve;              ///< @brief Average calculated value
-    unsigned int round = 0;                 ///< @brief Number of offset values added during last sync 
+    NTPSyncFilter syncFilter;       ///< @brief Averaging, thresholds and retry logic
+    NTPSyncFilter peerFilter;       ///< @brief Same as `syncFilter` for peer samples, so they never join a server averaging round
     unsigned int numAveRounds = DEFAULT_NUM_OFFSET_AVE_ROUNDS;          ///< @brief Number of request to be done to calculate average.
     
+    udp_pcb* listenUdp = NULL;      ///< @brief UDP connection object for server and broadcast modes
+    uint16_t listenPort = DEFAULT_NTP_PORT; ///< @brief Port `listenUdp` is bound to
+    bool serverEnabled = false;     ///< @brief True if requests from other devices are answered
+    unsigned long serverRequests = 0;   ///< @brief Requests received in server mode
+    unsigned long serverResponses = 0;  ///< @brief Responses sent in server mode
+    unsigned long serverRefused = 0;    ///< @brief Requests not answered in server mode
+    
+    bool broadcastEnabled = false;  ///< @brief True if time is got from broadcast or multicast packets
+    bool multicastJoined = false;   ///< @brief True if NTP multicast group has been joined
+    volatile bool broadcastCalibrated = false;  ///< @brief True if one way delay to broadcast server is known
+    volatile bool broadcastCalibrating = false; ///< @brief True while a unicast request to broadcast server is pending
+    volatile bool broadcastSourceValid = false; ///< @brief True if `broadcastSourceAddr` holds a broadcast server address
+    ip_addr_t broadcastSourceAddr;  ///< @brief Address of last broadcast server
+    double broadcastDelay = 0;      ///< @brief One way delay to broadcast server in seconds
+    NTPUndecodedPacket_t broadcastPacket; ///< @brief Last broadcast packet to be processed by receiver task
+    timeval broadcastPacketReceived;      ///< @brief Moment when `broadcastPacket` arrived
+    volatile bool broadcastPacketValid = false; ///< @brief Is `broadcastPacket` pending to be processed?
+    unsigned long lastBroadcastReceived = 0;    ///< @brief `millis()` value when last broadcast was processed
+    
+    NTPPeer_t peers[MAX_NTP_PEERS]; ///< @brief Symmetric mode peers
+    uint8_t numPeers = 0;           ///< @brief Number of valid entries in `peers`
+    unsigned int upstreamFailures = 0;  ///< @brief Consecutive failed requests to upstream servers
+    NTPUndecodedPacket_t peerPacket[MAX_NTP_PEERS]; ///< @brief Last response of every peer to be processed by receiver task
+    timeval peerPacketReceived[MAX_NTP_PEERS];      ///< @brief Moment when `peerPacket` arrived
+    volatile bool peerPacketValid[MAX_NTP_PEERS] = {}; ///< @brief Is `peerPacket` pending to be processed?
+    
     pbuf* lastNtpResponsePacket;    ///< @brief Last response packet to be processed by receiver task
     bool responsePacketValid = false;                           ///< @brief Is `lastNtpResponsePacket` already processed?
     
@@ -358,6 +396,274 @@ protected:
     static void s_recvPacket (void* arg, struct udp_pcb* pcb, struct pbuf* p,
                               const ip_addr_t* addr, u16_t port);
     
+    /**
+      * @brief Opens UDP socket used by server and broadcast modes, if not already open
+      * @param port UDP port to listen on
+      * @return `true` if socket is open
+      */
+    bool openListener (uint16_t port);
+    
+    /**
+      * @brief Closes UDP socket used by server and broadcast modes if no one uses it
+      * @param force Close it even if server, broadcast or peer modes are enabled
+      */
+    void closeListener (bool force = false);
+    
+    /**
+      * @brief Fills stratum, root delay, dispersion, reference ID and reference time of a packet from local clock status
+      * @param packet Packet to fill. It is cleared first
+      * @param version NTP version to put in packet
+      * @param mode NTP mode to put in packet
+      */
+    void fillLocalClockInfo (NTPUndecodedPacket_t* packet, uint8_t version, uint8_t mode);
+    
+    /**
+      * @brief Sets transmit timestamp and sends a packet
+      * @param pcb UDP connection to use
+      * @param packet Packet to send
+      * @param addr Destination address
+      * @param port Destination port
+      * @return lwIP error code
+      */
+    err_t sendNtpPacketTo (struct udp_pcb* pcb, NTPUndecodedPacket_t* packet, const ip_addr_t* addr, u16_t port);
+    
+    /**
+      * @brief Finds a configured peer
+      * @param address Peer address
+      * @return Peer status or `NULL` if address is not a peer
+      */
+    NTPPeer_t* findPeer (const ip_addr_t* address);
+    
+    /**
+      * @brief Sends a symmetric active packet to every peer
+      */
+    void sendPeerPackets ();
+    
+    /**
+      * @brief Answers a symmetric active packet from a peer
+      * @param pcb the udp_pcb which received data
+      * @param p the packet buffer that was received
+      * @param addr the remote IP address from which the packet was received
+      * @param port the remote port from which the packet was received
+      * @param received Time when packet was received
+      */
+    void processPeerRequest (struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port, const timeval* received);
+    
+    /**
+      * @brief Processes last peer response and uses it to discipline clock if upstream servers are not reachable
+      * @param index Peer index in `peers`
+      */
+    void processPeerPacket (uint8_t index);
+    
+    /**
+      * @brief Selects the peer closest to a reference clock among those with lower stratum than local clock or
+      * closer to a reference clock than it
+      * @return Selected peer or `NULL` if no peer is better than local clock
+      */
+    NTPPeer_t* selectPeer ();
+    
+    /**
+      * @brief Estimates local clock distance to reference clock as root delay / 2 + root dispersion
+      * @return Root distance in seconds
+      */
+    float rootDistance ();
+    
+    /**
+      * @brief Checks if upstream servers have stopped answering
+      * @return `true` if last `DEAULT_NUM_TIMEOUTS` requests or more have failed
+      */
+    bool upstreamLost () {
+        return upstreamFailures >= DEAULT_NUM_TIMEOUTS;
+    }
+    
+    /**
+      * @brief Starts a statistics update. Readers retry while an update is in progress
+      */
+    void statsBeginUpdate () {
+#ifdef ESP32
+        portENTER_CRITICAL (&statsMux);
+#endif
+        ntpSeqlockBeginWrite (&statsSequence);
+    }
+    
+    /**
+      * @brief Finishes a statistics update
+      */
+    void statsEndUpdate () {
+        ntpSeqlockEndWrite (&statsSequence);
+#ifdef ESP32
+        portEXIT_CRITICAL (&statsMux);
+#endif
+    }
+    
+    /**
+      * @brief Starts a server pool update or a read that needs a consistent view. Keep it short, no logging inside
+      */
+    void poolLock () {
+#ifdef ESP32
+        portENTER_CRITICAL (&poolMux);
+#endif
+    }
+    
+    /**
+      * @brief Finishes a server pool update
+      */
+    void poolUnlock () {
+#ifdef ESP32
+        portEXIT_CRITICAL (&poolMux);
+#endif
+    }
+    
+    /**
+      * @brief Gets a consistent copy of upstream clock information, from any task or lwIP callback
+      * @return Copy of `upstream`
+      */
+    NTPUpstream_t getUpstream () {
+        NTPUpstream_t copy;
+#ifdef ESP32
+        portENTER_CRITICAL (&upstreamMux);
+#endif
+        copy = upstream;
+#ifdef ESP32
+        portEXIT_CRITICAL (&upstreamMux);
+#endif
+        return copy;
+    }
+    
+    /**
+      * @brief Replaces upstream clock information
+      * @param source New value
+      */
+    void setUpstream (const NTPUpstream_t& source) {
+#ifdef ESP32
+        portENTER_CRITICAL (&upstreamMux);
+#endif
+        upstream = source;
+#ifdef ESP32
+        portEXIT_CRITICAL (&upstreamMux);
+#endif
+    }
+    
+    /**
+      * @brief Increments a statistics counter
+      * @param counter Counter in `stats`
+      */
+    void statsCount (uint32_t& counter) {
+        statsBeginUpdate ();
+        counter++;
+        statsEndUpdate ();
+    }
+    
+    /**
+      * @brief Adds a sample the sync filter accepted to statistics histograms
+      * @param offsetUs Sample offset in microseconds
+      * @param delayUs Sample round trip delay in microseconds
+      * @param dispersion Root dispersion announced by server in seconds
+      */
+    void statsAddSample (int64_t offsetUs, int64_t delayUs, float dispersion);
+    
+    /**
+      * @brief Feeds offset of an accepted sync round to Allan deviation estimation, if it is enabled
+      * @param tvOffset Averaged offset of the round, before applying it
+      */
+    void allanAddSample (timeval tvOffset);
+    
+    /**
+      * @brief Checks if any listener is subscribed to an event. Events are only built if this is `true`
+      * @param type Event code
+      * @return `true` if event has to be generated
+      */
+    bool wantsEvent (NTPSyncEventType_t type) {
+        return eventListeners.wants (ntpEventMask (type));
+    }
+    
+    /**
+      * @brief Calls every listener subscribed to an event
+      * @param event Event to deliver
+      */
+    void dispatchEvent (const NTPEvent_t& event);
+    
+    /**
+      * @brief Timestamps an event and delivers it as configured with `setEventDispatch()`
+      * @param event Event to deliver
+      */
+    void emitEvent (NTPEvent_t& event);
+    
+#ifdef ESP32
+    /**
+      * @brief Task that delivers queued events when it is notified
+      * @param arg Pointer to NTPClient instance
+      */
+    static void s_eventTask (void* arg);
+    
+    /**
+      * @brief Starts event delivery task if it is needed and it is not running
+      */
+    void startEventTask ();
+#endif // ESP32
+    
+    /**
+      * @brief Updates a maximum execution time measurement
+      * @param maxTime Maximum to update
+      * @param started `micros()` value when measured section started
+      */
+    static void updateMaxTime (unsigned long& maxTime, unsigned long started) {
+        unsigned long elapsed = ::micros () - started;
+        if (elapsed > maxTime) {
+            maxTime = elapsed;
+        }
+    }
+    
+#ifdef NTP_SYNC_TRACE
+    /**
+      * @brief Starts tracing a new sync cycle. An unfinished cycle is closed first
+      */
+    void traceBegin ();
+    
+    /**
+      * @brief Records a phase boundary of traced cycle. Safe from any context, it is only a few stores
+      * @param phase Phase reached
+      */
+    void traceMark (NTPTracePhase_t phase);
+    
+    /**
+      * @brief Closes traced cycle and emits `syncTraced` if enabled
+      */
+    void traceEnd ();
+#endif // NTP_SYNC_TRACE
+    
+    /**
+      * @brief Process last received broadcast packet
+      */
+    void processBroadcastPacket ();
+    
+    /**
+      * @brief Checks if time is being got from broadcasts, so no requests need to be sent
+      * @return `true` if delay is calibrated and broadcasts are arriving
+      */
+    bool broadcastSyncActive ();
+    
+    /**
+      * @brief Static method called when a packet arrives to server or broadcast port
+      * @param arg `NTPClient` instance
+      * @param pcb the udp_pcb which received data
+      * @param p the packet buffer that was received
+      * @param addr the remote IP address from which the packet was received
+      * @param port the remote port from which the packet was received
+      */
+    static void s_listenRecvPacket (void* arg, struct udp_pcb* pcb, struct pbuf* p,
+                                    const ip_addr_t* addr, u16_t port);
+    
+    /**
+      * @brief Answers a client request using local clock
+      * @param pcb the udp_pcb which received data
+      * @param p the packet buffer that was received
+      * @param addr the remote IP address from which the packet was received
+      * @param port the remote port from which the packet was received
+      * @param received Time when request was received
+      */
+    void processServerRequest (struct udp_pcb* pcb, struct pbuf* p, const ip_addr_t* addr, u16_t port, const timeval* received);
+    
     /**
       * @brief Receiver task to check for received packets and launch packet processor
       * @param arg `NTPClient` instance
@@ -365,12 +671,78 @@ protected:
     static void s_receiverTask (void* arg);
     
     /**
-      * @brief Checks if received packet may be used to get a good sync
-      * @param ntpPacket Packet to analyze
-      * @param offsetUs Microseconds offset, used to check dispersion
-      * @return `true` if NTP packet is good for sync
+      * @brief Starts asynchronous NTP server name resolution. Result is stored in DNS cache
+      * @param sendWhenResolved `true` if a NTP request should be sent as soon as address is got
+      */
+    void resolveNtpServer (bool sendWhenResolved);
+    
+    /**
+      * @brief Static method called by lwIP when DNS resolution finishes
+      * @param name Host name that was resolved
+      * @param ipaddr Resolved address or `NULL` if resolution failed
+      * @param callback_arg `NTPClient` instance
+      */
+    static void s_dnsFound (const char* name, const ip_addr_t* ipaddr, void* callback_arg);
+    
+    /**
+      * @brief Updates DNS cache with resolved address and sends pending NTP request, if any
+      * @param address Resolved address or `NULL` if resolution failed
+      */
+    void processDnsResponse (const ip_addr_t* address);
+    
+    /**
+      * @brief Sends a NTP request to current server address
+      * @param member Entry of `serverPool` that address was taken from, or `NO_POOL_MEMBER`
+      */
+    void sendRequest (uint8_t member = NO_POOL_MEMBER);
+    
+    /**
+      * @brief Checks if cached NTP server address should be refreshed before it expires.
+      * A lookup refreshes only the address DNS returns, so at most one is started every tenth of `dnsCacheTtl`
+      * @return `true` if a cached address is about to expire and no lookup was started recently
+      */
+    bool dnsCacheNeedsRefresh ();
+    
+    /**
+      * @brief Adds an address to server pool or refreshes it if it was already there. Rotation cursor is not changed
+      * @param address Resolved address
+      * @return Entry number of address in `serverPool`
+      */
+    uint8_t addPoolMember (const ip_addr_t* address);
+    
+    /**
+      * @brief Sets destination for next request
+      * @param address Server address, usually a copy of a `serverPool` entry
+      */
+    void setCurrentServer (const ip_addr_t* address);
+    
+    /**
+      * @brief Removes expired and failing addresses from server pool
+      */
+    void prunePool ();
+    
+    /**
+      * @brief Finds server pool entry last request was sent to. Call it with pool locked
+      * @return Pool entry or `NULL` if request was not sent to a pool address or it has been replaced
+      */
+    NTPPoolMember_t* requestPoolMember ();
+    
+    /**
+      * @brief Counts a failure for the address used in last request. It will be evicted after `MAX_POOL_MEMBER_FAILURES`
+      * @param evict `true` to evict it in next request, regardless of failure count
       */
-    bool checkNTPresponse (NTPPacket_t* ntpPacket, int64_t offsetUs);
+    void poolMemberFailed (bool evict = false);
+    
+    /**
+      * @brief Clears failure count of the address used in last request after a valid response
+      */
+    void poolMemberSucceeded ();
+    
+    /**
+      * @brief Gets current sync filter settings
+      * @return Settings for `syncFilter`
+      */
+    NTPSyncConfig_t getSyncConfig ();
     
     /**
       * @brief Static method to call NTP response timeout processor
@@ -395,6 +767,22 @@ protected:
       */
     void processPacket (struct pbuf* p);
     
+    /**
+      * @brief Averages, checks and applies a time sample
+      * @param packet Decoded NTP packet
+      * @param tvOffset Offset calculated from packet
+      * @param source Kind of packet the sample comes from
+      * @param sourceAddress Sender address, for event notification
+      */
+    void processSample (NTPPacket_t* packet, timeval tvOffset, NTPSampleSource_t source, const ip_addr_t* sourceAddress);
+    
+    /**
+      * @brief Sets server address of an event, both as lwIP address and as `IPAddress`
+      * @param event Event to fill
+      * @param address Server address
+      */
+    static void setEventAddress (NTPEvent_t& event, const ip_addr_t* address);
+    
     /**
       * @brief Decodes NTP response contained in buffer
       * @param messageBuffer Pointer to message buffer
@@ -441,11 +829,20 @@ public:
             //DEBUGLOGI ("Receiver task handle deleted");
             receiverHandle = NULL;
         }
+        if (eventHandle) {
+            vTaskDelete (eventHandle);
+            eventHandle = NULL;
+        }
 #else
         loopTimer.detach ();
         receiverTimer.detach ();
 #endif // ESP8266
         responseTimer.detach ();
+        stopServer ();
+        setBroadcastMode (false); // Also leaves multicast group
+        numPeers = 0;
+        peerFilter.reset ();
+        closeListener (true); // Listener has this instance as receive argument, it must not outlive it
 #ifdef ESP8266
         if (udp) {
             udp_remove (udp);
@@ -471,6 +868,103 @@ public:
       */
     bool begin (const char* ntpServerName = NULL, bool manageWifi = true);
     
+    /**
+      * @brief Starts SNTP server mode. Requests from other devices are answered using local clock, only while it is synchronized
+      * @param port UDP port to listen on. Ignored if broadcast mode already opened a port
+      * @return `true` if server could be started
+      */
+    bool beginServer (uint16_t port = DEFAULT_NTP_PORT);
+    
+    /**
+      * @brief Stops SNTP server mode
+      */
+    void stopServer ();
+    
+    /**
+      * @brief Enables or disables broadcast client mode. Time is got from NTP broadcast (mode 5) packets. A single
+      * unicast request is sent to the broadcast server to calibrate delay. No more requests are sent while broadcasts
+      * keep arriving at least once per sync interval. Broadcasts are not authenticated, use only on trusted networks
+      * @param enable `true` to enable broadcast mode
+      * @param joinMulticast `true` to join NTP IPv4 multicast group 224.0.1.1
+      * @return `true` if everything went ok
+      */
+    bool setBroadcastMode (bool enable, bool joinMulticast = false);
+    
+    /**
+      * @brief Gets broadcast mode status
+      * @return `true` if broadcast mode is enabled
+      */
+    bool getBroadcastMode () {
+        return broadcastEnabled;
+    }
+    
+    /**
+      * @brief Gets one way delay to broadcast server
+      * @return One way delay in seconds. 0 if it has not been calibrated yet
+      */
+    double getBroadcastDelay () {
+        return broadcastCalibrated ? broadcastDelay : 0;
+    }
+    
+    /**
+      * @brief Adds a symmetric mode peer. Peers exchange time between them and are used when upstream servers are not
+      * reachable. Peer with lowest root distance is followed, only if it is better than local clock
+      * @param address Peer IP address as text
+      * @return `true` if peer was added
+      */
+    bool addPeer (const char* address);
+    
+    /**
+      * @brief Removes a symmetric mode peer
+      * @param address Peer IP address as text
+      * @return `true` if peer was found and removed
+      */
+    bool removePeer (const char* address);
+    
+    /**
+      * @brief Gets number of configured peers
+      * @return Number of peers
+      */
+    uint8_t getNumPeers () {
+        return numPeers;
+    }
+    
+    /**
+      * @brief Gets peer status
+      * @param index Peer number 0.. `getNumPeers()` - 1
+      * @return Peer status or `NULL` if index is not valid
+      */
+    const NTPPeer_t* getPeer (uint8_t index) {
+        if (index >= numPeers) {
+            return NULL;
+        }
+        return &peers[index];
+    }
+    
+    /**
+      * @brief Gets number of requests received in server mode
+      * @return Number of received requests
+      */
+    unsigned long getServerRequests () {
+        return serverRequests;
+    }
+    
+    /**
+      * @brief Gets number of responses sent in server mode
+      * @return Number of responses
+      */
+    unsigned long getServerResponses () {
+        return serverResponses;
+    }
+    
+    /**
+      * @brief Gets number of requests that were not answered because they were not valid or clock was not synchronized
+      * @return Number of refused requests
+      */
+    unsigned long getServerRefused () {
+        return serverRefused;
+    }
+    
     /**
       * @brief Sets NTP server name
       * @param serverName New NTP server name
@@ -487,15 +981,241 @@ public:
     }
     
     /**
-      * @brief Set a callback that triggers after a sync event
+      * @brief Gets maximum time a single run of loop task has taken since boot or last reset
+      * @return Maximum loop blocking time in microseconds
+      */
+    unsigned long getMaxLoopBlockingTime () {
+        return maxLoopBlockingTime;
+    }
+    
+    /**
+      * @brief Resets maximum loop blocking time measurement
+      */
+    void resetMaxLoopBlockingTime () {
+        maxLoopBlockingTime = 0;
+    }
+    
+    /**
+      * @brief Gets a consistent copy of sync statistics. It never blocks sync process, it just retries if
+      * statistics change while they are being copied
+      * @return Statistics snapshot
+      */
+    NTPStats_t getStats ();
+    
+    /**
+      * @brief Clears sync statistics
+      */
+    void resetStats ();
+    
+    /**
+      * @brief Starts estimating local oscillator Allan deviation from sync history. Measured offsets are
+      * referred to monotonic uptime, so clock adjustments do not disturb them
+      * @param tau0 Shortest averaging time in seconds. Sync interval is a good choice. 0 disables estimation
+      */
+    void enableAllanDeviation (uint32_t tau0);
+    
+    /**
+      * @brief Gets estimated Allan deviation at one averaging time
+      * @param octave Averaging time index, 0 to `NTP_ALLAN_OCTAVES - 1`. Averaging time is `tau0 * 2^octave`
+      * @param point Output result
+      * @return `false` if estimation is disabled, octave is out of range or there are not enough samples yet
+      */
+    bool getAllanDeviation (uint8_t octave, NTPAllanPoint_t* point);
+    
+    /**
+      * @brief Gets maximum time spent in response timeout timer callback
+      * @return Maximum time in microseconds
+      */
+    unsigned long getMaxTimerContextTime () {
+        return maxTimerContextTime;
+    }
+    
+    /**
+      * @brief Gets maximum time spent in network receive callbacks and receiver task
+      * @return Maximum time in microseconds
+      */
+    unsigned long getMaxReceiveContextTime () {
+        return maxReceiveContextTime;
+    }
+    
+    /**
+      * @brief Resets timer and receive context time measurements
+      */
+    void resetMaxContextTimes () {
+        maxTimerContextTime = 0;
+        maxReceiveContextTime = 0;
+    }
+    
+#ifdef NTP_PACKET_CAPTURE
+    /**
+      * @brief Starts or stops keeping a copy of every NTP packet sent and received. Only available if
+      * `NTP_PACKET_CAPTURE` is defined
+      * @param enable `true` to capture packets
+      */
+    void setPacketCapture (bool enable) {
+        packetCapture.setEnabled (enable);
+    }
+    
+    /**
+      * @brief Writes last captured packets as a pcapng stream with raw IP link type. Every packet has
+      * direction flag, system time as timestamp and monotonic time as comment
+      * @param out Output stream, like `Serial` or a `File`
+      * @return Number of bytes written
+      */
+    size_t dumpPacketCapture (Print& out) {
+        return packetCapture.writePcapng (out);
+    }
+    
+    /**
+      * @brief Gets maximum time spent copying a received packet into capture ring, in lwIP context
+      * @return Maximum time in microseconds
+      */
+    unsigned long getMaxCaptureTime () {
+        return maxCaptureTime;
+    }
+#endif // NTP_PACKET_CAPTURE
+    
+#ifdef NTP_SYNC_TRACE
+    /**
+      * @brief Gets timing of a finished sync cycle. Only available if `NTP_SYNC_TRACE` is defined
+      * @param age 0 for last finished cycle, 1 for the one before and so on, up to `NTP_TRACE_RING_SIZE - 1`
+      * @param trace Output trace
+      * @return `false` if there is no such cycle
+      */
+    bool getSyncTrace (uint8_t age, NTPSyncTrace_t* trace);
+    
+    /**
+      * @brief Enables `syncTraced` event at the end of every sync cycle. Only available if `NTP_SYNC_TRACE` is defined
+      * @param enable `true` to emit events
+      */
+    void setTraceEvents (bool enable) {
+        traceEvents = enable;
+    }
+#endif // NTP_SYNC_TRACE
+    
+    /**
+      * @brief Selects how events are delivered to handler. By default they are queued and delivered from a low
+      * priority task on ESP32, so user code never runs inside timer or network callbacks. ESP8266 has no task to
+      * deliver them from, so they are delivered immediately unless `eventsManual` is selected
+      * @param mode Delivery mode
+      */
+    void setEventDispatch (NTPEventDispatch_t mode);
+    
+    /**
+      * @brief Gets event delivery mode
+      * @return Delivery mode
+      */
+    NTPEventDispatch_t getEventDispatch () {
+        return eventDispatch;
+    }
+    
+    /**
+      * @brief Delivers queued events to handler. Call it from `loop()` if `eventsManual` mode is used
+      * @return Number of events delivered
+      */
+    unsigned int handleEvents ();
+    
+    /**
+      * @brief Gets number of events lost because queue was full
+      * @return Number of lost events
+      */
+    uint32_t getEventOverflows () {
+        return eventQueue.getOverflows ();
+    }
+    
+    /**
+      * @brief Sets local UDP port used to send requests. Needed if several `NTPClient` instances run at the same time
+      * @param port Local UDP port. Takes effect on next `begin()` or reconnection
+      */
+    void setLocalPort (uint16_t port) {
+        localPort = port;
+    }
+    
+    /**
+      * @brief Gets local UDP port used to send requests
+      * @return Local UDP port
+      */
+    uint16_t getLocalPort () {
+        return localPort;
+    }
+    
+    /**
+      * @brief Sets how long a resolved NTP server address is reused before asking DNS again
+      * @param seconds New TTL in seconds. Minimum is `MIN_DNS_CACHE_TTL`
+      * @return `true` if value was accepted
+      */
+    bool setDnsCacheTtl (unsigned int seconds);
+    
+    /**
+      * @brief Gets DNS cache TTL
+      * @return Time a resolved address is reused, in seconds
+      */
+    unsigned int getDnsCacheTtl () {
+        return dnsCacheTtl / 1000;
+    }
+    
+    /**
+      * @brief Discards cached NTP server address. Next request will resolve server name again
+      */
+    void flushDnsCache () {
+        poolFlushRequested = true;
+    }
+    
+    /**
+      * @brief Gets number of addresses currently cached for NTP server name
+      * @return Number of addresses in server pool
+      */
+    uint8_t getServerPoolSize () {
+        return poolSize;
+    }
+    
+    /**
+      * @brief Gets information about a cached address of NTP server name
+      * @param index Entry number 0.. `getServerPoolSize()` - 1
+      * @return Copy of pool member information, taken under pool lock as DNS callback may rewrite the pool.
+      * All zero if index is not valid
+      */
+    NTPPoolMember_t getServerPoolMember (uint8_t index);
+    
+    /**
+      * @brief Gets the number of different server addresses used since NTP server name was set.
+      * An address that left the pool and came back is not counted again, unless `POOL_DIVERSITY_HISTORY` other addresses were seen meanwhile
+      * @return Number of distinct addresses got from DNS
+      */
+    unsigned int getServerPoolDiversity () {
+        return poolDistinctAddresses;
+    }
+    
+    /**
+      * @brief Set a callback that triggers after a sync event. It is subscribed to all events and replaces handler
+      * set by a previous call
       * @param handler function with `onSyncEvent_t` to notify events to user code
       */
     void onNTPSyncEvent (onSyncEvent_t handler){
         if (handler){
-            onSyncEvent = handler;
+            if (legacyListener >= 0) {
+                removeEventListener (legacyListener);
+            }
+            legacyListener = addEventListener (handler);
         }
     }
     
+    /**
+      * @brief Adds an event listener. Events no listener is subscribed to are never generated.
+      * Listeners should be changed from the same context events are delivered on, or before `begin()`
+      * @param handler Callback
+      * @param mask Subscribed events, like `ntpEventMask (timeSyncd) | ntpEventMask (noResponse)`
+      * @return Listener id to remove it later. -1 if there is no free slot
+      */
+    int addEventListener (onSyncEvent_t handler, uint16_t mask = NTP_ALL_EVENTS);
+    
+    /**
+      * @brief Removes an event listener
+      * @param id Listener id returned by `addEventListener()`
+      * @return `true` if listener existed
+      */
+    bool removeEventListener (int id);
+    
     /**
       * @brief Changes sync period
       * @param interval New interval in seconds
@@ -578,13 +1298,41 @@ public:
     bool setNTPTimeout (uint16_t milliseconds);
 
     /**
-      * @brief Sets time zone for getting local time
+      * @brief Sets time zone for getting local time. Time zone is process wide: it is also set in `TZ` environment
+      * variable for libc functions and every `NTPClient` instance converts with the same compiled rules
       * @param TZ Time zone description
       */
     void setTimeZone (const char* TZ){
         strncpy (tzname, TZ, TZNAME_LENGTH);
+        tzname[TZNAME_LENGTH - 1] = '\0';
         setenv ("TZ", tzname, 1);
         tzset ();
+        NTPTimeZone::setProcessRule (tzname);
+        invalidateTimeCache ();
+    }
+    
+    /**
+      * @brief Sets time zone by its IANA name, for names received on runtime. Time zone is shared by all `NTPClient` instances
+      * @param name Zone name like `Europe/Madrid`, as in `TZdef.h` macros with `_` replaced by `/` where needed
+      * @return `true` if zone was found
+      */
+    bool setTimeZoneByName (const char* name) {
+        char rule[TZNAME_LENGTH];
+        if (!NTPTimeZone::findRule (name, rule, sizeof (rule))) {
+            return false;
+        }
+        setTimeZone (rule);
+        return true;
+    }
+    
+    /**
+      * @brief Gets compiled rules of time zone set with `setTimeZone()`, for fast UTC and local time conversion.
+      * They belong to this instance, use them from a single task
+      * @return Time zone rules. Check `isValid()` before using them
+      */
+    NTPTimeZone& getLocalZone () {
+        localZone.followProcessRule ();
+        return localZone;
     }
     
     /**
@@ -602,10 +1350,7 @@ public:
       * @return String built from given time
       */
     char* getTimeStr (timeval moment) {
-        tm* local_tm = localtime (&moment.tv_sec);
-        size_t index = strftime (strBuffer, sizeof (strBuffer), "%H:%M:%S", local_tm);
-        snprintf (strBuffer + index, sizeof (strBuffer) - index, ".%06ld", moment.tv_usec);
-        return strBuffer;
+        return renderTimeUs (moment, TIME_STR_FORMAT, false);
     }
     
     /**
@@ -614,8 +1359,7 @@ public:
       * @return String built from given time
       */
     char* getTimeStr (time_t moment) {
-        tm* local_tm = localtime (&moment);
-        strftime (strBuffer, sizeof(strBuffer), "%H:%M:%S", local_tm);
+        strftime (strBuffer, sizeof(strBuffer), TIME_STR_FORMAT, getLocalTm (moment));
         return strBuffer;
     }
 
@@ -643,8 +1387,7 @@ public:
     * @return String built from given time
     */
     char* getDateStr (time_t moment) {
-        tm* local_tm = localtime (&moment);
-        strftime (strBuffer, sizeof (strBuffer), "%02d/%m/%04Y", local_tm);
+        strftime (strBuffer, sizeof (strBuffer), DATE_STR_FORMAT, getLocalTm (moment));
         return strBuffer;
     }
     
@@ -681,12 +1424,8 @@ public:
     * @param format Format as printf
     * @return Char string built from current time
     */
-    char* getTimeDateString (timeval moment, const char* format = "%02d/%02m/%04Y %02H:%02M:%02S") {
-        tm* local_tm = localtime (&moment.tv_sec);
-        size_t index = strftime (strBuffer, sizeof (strBuffer), format, local_tm);
-        index += snprintf (strBuffer + index, sizeof (strBuffer) - index, ".%06ld", moment.tv_usec);
-        strftime (strBuffer + index, sizeof (strBuffer) - index, " %Z", local_tm);
-        return strBuffer;
+    char* getTimeDateString (timeval moment, const char* format = TIME_DATE_STR_FORMAT) {
+        return renderTimeUs (moment, format, true);
     }
 
     /**
@@ -695,13 +1434,143 @@ public:
     * @param format Format as printf
     * @return Char string built from current time
     */
-    char* getTimeDateString (time_t moment, const char* format = "%02d/%02m/%04Y %02H:%02M:%02S") {
-        tm* local_tm = localtime (&moment);
-        strftime (strBuffer, sizeof (strBuffer), format, local_tm);
+    char* getTimeDateString (time_t moment, const char* format = TIME_DATE_STR_FORMAT) {
+        strftime (strBuffer, sizeof (strBuffer), format, getLocalTm (moment));
 
         return strBuffer;
     }
     
+    /**
+    * @brief Renders local time into a caller supplied buffer. It does not use any shared buffer so it may be called
+    * from any task. Result is always null terminated and truncated if it does not fit
+    * @param buffer Destination buffer
+    * @param length Destination buffer size
+    * @param moment UNIX time to render
+    * @param usec Microseconds to append after seconds part. Negative value to omit them
+    * @param format Format as strftime
+    * @param withZone Append time zone abbreviation
+    * @return Length of complete string, without null terminator. Result was truncated if it is `length` or more
+    */
+    static size_t formatLocalTime (char* buffer, size_t length, time_t moment, long usec, const char* format, bool withZone);
+    
+    /**
+    * @brief Converts a time to a char string representing time, into a caller supplied buffer
+    * @param buffer Destination buffer
+    * @param length Destination buffer size
+    * @param moment `timeval` object to convert
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    static size_t getTimeStr (char* buffer, size_t length, timeval moment) {
+        return formatLocalTime (buffer, length, moment.tv_sec, moment.tv_usec, TIME_STR_FORMAT, false);
+    }
+    
+    /**
+    * @brief Converts a time to a char string representing time, into a caller supplied buffer
+    * @param buffer Destination buffer
+    * @param length Destination buffer size
+    * @param moment `time_t` value (UNIX time) to convert
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    static size_t getTimeStr (char* buffer, size_t length, time_t moment) {
+        return formatLocalTime (buffer, length, moment, -1, TIME_STR_FORMAT, false);
+    }
+    
+    /**
+    * @brief Converts a time to a char string representing its date, into a caller supplied buffer
+    * @param buffer Destination buffer
+    * @param length Destination buffer size
+    * @param moment `time_t` value (UNIX time) to convert
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    static size_t getDateStr (char* buffer, size_t length, time_t moment) {
+        return formatLocalTime (buffer, length, moment, -1, DATE_STR_FORMAT, false);
+    }
+    
+    /**
+    * @brief Converts a time to a char string with date, time, microseconds and time zone, into a caller supplied buffer
+    * @param buffer Destination buffer
+    * @param length Destination buffer size
+    * @param moment `timeval` object to convert
+    * @param format Format as strftime
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    static size_t getTimeDateString (char* buffer, size_t length, timeval moment, const char* format = TIME_DATE_STR_FORMAT) {
+        return formatLocalTime (buffer, length, moment.tv_sec, moment.tv_usec, format, true);
+    }
+    
+    /**
+    * @brief Converts a time to a char string with date and time, into a caller supplied buffer
+    * @param buffer Destination buffer
+    * @param length Destination buffer size
+    * @param moment `time_t` value (UNIX time) to convert
+    * @param format Format as strftime
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    static size_t getTimeDateString (char* buffer, size_t length, time_t moment, const char* format = TIME_DATE_STR_FORMAT) {
+        return formatLocalTime (buffer, length, moment, -1, format, false);
+    }
+    
+    /**
+    * @brief Renders a time with a layout fixed at compile time, like `NTPFormatRFC3339Us`. Faster than
+    * `getTimeDateString()` as there is no format parsing. Uses same local time cache as `get*Str()` methods, so
+    * calendar fields and UTC offset are only calculated once per second
+    * @tparam Layout `NTPTimeLayout` type
+    * @param buffer Output buffer. `Layout::maxLength + 1` is always enough
+    * @param length Output buffer size
+    * @param moment Time to render
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    template <typename Layout>
+    size_t getTimeFormatted (char* buffer, size_t length, timeval moment) {
+        return Layout::format (buffer, length, timeCache.localFields (moment, localZone, timeCacheGeneration));
+    }
+    
+    /**
+    * @brief Renders current time with a layout fixed at compile time, like `NTPFormatRFC3339Us`
+    * @tparam Layout `NTPTimeLayout` type
+    * @param buffer Output buffer. `Layout::maxLength + 1` is always enough
+    * @param length Output buffer size
+    * @return Length of complete string. Result was truncated if it is `length` or more
+    */
+    template <typename Layout>
+    size_t getTimeFormatted (char* buffer, size_t length) {
+        timeval currentTime;
+        gettimeofday (&currentTime, NULL);
+        return getTimeFormatted<Layout> (buffer, length, currentTime);
+    }
+    
+    /**
+    * @brief Converts a batch of timestamps to local calendar fields. Compiled time zone rules are used if
+    * `setTimeZone()` got a valid TZ string, otherwise every distinct second goes through `localtime_r()`
+    * @param epochUs Timestamps in microseconds since 1970-01-01 UTC
+    * @param fields Output array with `count` elements
+    * @param count Number of timestamps
+    */
+    void getTimeFields (const int64_t* epochUs, NTPTimeFields_t* fields, size_t count);
+    
+    /**
+    * @brief Renders a batch of timestamps with a layout fixed at compile time
+    * @tparam Layout `NTPTimeLayout` type
+    * @param epochUs Timestamps in microseconds since 1970-01-01 UTC
+    * @param count Number of timestamps
+    * @param buffer Output buffer, `count * stride` long. String `i` starts at `buffer + i * stride`
+    * @param stride Space reserved for every string. `Layout::maxLength + 1` avoids truncation
+    */
+    template <typename Layout>
+    void getTimeFormatted (const int64_t* epochUs, size_t count, char* buffer, size_t stride) {
+        NTPTimeFields_t fields[TIME_BATCH_CHUNK];
+        while (count) {
+            size_t chunk = count < TIME_BATCH_CHUNK ? count : TIME_BATCH_CHUNK;
+            getTimeFields (epochUs, fields, chunk);
+            for (size_t i = 0; i < chunk; i++) {
+                Layout::format (buffer, stride, fields[i]);
+                buffer += stride;
+            }
+            epochUs += chunk;
+            count -= chunk;
+        }
+    }
+    
     /**
     * @brief Gets last successful sync time in UNIX format, with microseconds
     * @return Last successful sync time. 0 equals never
@@ -720,18 +1589,31 @@ public:
     }
 
     /**
-    * @brief Gets uptime in human readable String format
+    * @brief Gets uptime in human readable String format. Days part is only rendered again when day changes
     * @return Uptime
     */
-    char* getUptimeString ();
+    char* getUptimeString () {
+        return uptimeFormatter.render (getUptimeUs ());
+    }
+
+    /**
+    * @brief Gets time since MCU was last rebooted, with microseconds. It does not wrap as `millis()` does
+    * @return Uptime in microseconds
+    */
+    static uint64_t getUptimeUs () {
+#ifdef ESP32
+        return (uint64_t)esp_timer_get_time ();
+#else
+        return micros64 ();
+#endif
+    }
 
     /**
     * @brief Gets uptime in UNIX format, time since MCU was last rebooted
     * @return Uptime
     */
     time_t getUptime () {
-        uptime = uptime + (::millis () - uptime);
-        return uptime / 1000;
+        return (time_t)(getUptimeUs () / 1000000);
     }
 
     /**
@@ -785,7 +1667,7 @@ public:
     /**
      * @brief Gets text description from error. Useful for debugging
      * @param e NTP event
-     * @return Text description
+     * @return Text description. It is stored in an instance buffer, valid until next call
      */
     char* ntpEvent2str (NTPEvent_t e);
 
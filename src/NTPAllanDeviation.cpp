@@ -0,0 +1,67 @@
+#include "NTPAllanDeviation.h"
+#include <math.h>
+
+void NTPAllanDeviation::begin (uint32_t tau0) {
+    tau0Us = (int64_t)tau0 * 1000000;
+    started = false;
+    head = 0;
+    points = 0;
+    for (uint8_t k = 0; k < NTP_ALLAN_OCTAVES; k++) {
+        sum[k] = 0;
+        terms[k] = 0;
+    }
+}
+
+void NTPAllanDeviation::addSample (int64_t timeUs, int64_t phaseUs) {
+    if (!tau0Us) {
+        return;
+    }
+    if (started && (timeUs <= lastTime || timeUs - lastTime > NTP_ALLAN_MAX_GAP * tau0Us)) {
+        // Interpolating over a long gap would make up data. Start a new grid, keeping accumulated sums
+        started = false;
+        points = 0;
+    }
+    if (!started) {
+        started = true;
+        nextGrid = timeUs;
+    }
+    while (nextGrid <= timeUs) {
+        int64_t phase = phaseUs;
+        if (nextGrid < timeUs) {
+            // Interpolate in floating point, as products may overflow 64 bits with long intervals
+            phase = lastPhase + (int64_t)llround ((double)(phaseUs - lastPhase) * (double)(nextGrid - lastTime) / (double)(timeUs - lastTime));
+        }
+        addGridPoint (phase);
+        nextGrid += tau0Us;
+    }
+    lastTime = timeUs;
+    lastPhase = phaseUs;
+}
+
+void NTPAllanDeviation::addGridPoint (int64_t phase) {
+    history[head] = phase;
+    head = (head + 1) % NTP_ALLAN_HISTORY;
+    if (points < NTP_ALLAN_HISTORY) {
+        points++;
+    }
+    for (uint8_t k = 0; k < NTP_ALLAN_OCTAVES; k++) {
+        uint16_t m = 1 << k;
+        if (points <= 2 * m) {
+            break;
+        }
+        double diff = (double)(phase - 2 * past (m) + past (2 * m));
+        sum[k] += diff * diff;
+        terms[k]++;
+    }
+}
+
+bool NTPAllanDeviation::getPoint (uint8_t octave, NTPAllanPoint_t* point) const {
+    if (!point || octave >= NTP_ALLAN_OCTAVES || !terms[octave]) {
+        return false;
+    }
+    double tau = (double)tau0Us * (1 << octave);
+    point->tau = tau / 1000000.0;
+    point->deviation = sqrt (sum[octave] / (2.0 * tau * tau * terms[octave]));
+    point->terms = terms[octave];
+    return true;
+}
@@ -0,0 +1,92 @@
+/**
+  * @file NTPAllanDeviation.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Incremental overlapping Allan deviation of local oscillator, in fixed memory
+  */
+
+#ifndef _NtpAllanDeviation_h
+#define _NtpAllanDeviation_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+constexpr auto NTP_ALLAN_OCTAVES = 6; ///< @brief Number of tau values. Octave `k` is `tau0 * 2^k`
+constexpr auto NTP_ALLAN_HISTORY = (2 << (NTP_ALLAN_OCTAVES - 1)) + 1; ///< @brief Phase points needed for longest tau
+constexpr auto NTP_ALLAN_MAX_GAP = 4; ///< @brief Grid restarts if samples are more than this number of `tau0` apart
+
+/**
+  * @brief Allan deviation at one averaging time
+  */
+typedef struct {
+    double tau; ///< @brief Averaging time in seconds
+    double deviation; ///< @brief Overlapping Allan deviation, dimensionless
+    uint32_t terms; ///< @brief Number of second differences averaged. Estimation is poor with few terms
+} NTPAllanPoint_t;
+
+/**
+  * @brief Estimates overlapping Allan deviation at octave spaced tau values from irregular phase measurements.
+  * Samples are linearly interpolated to a regular `tau0` grid and every new grid point adds one second difference
+  * per octave, so memory and time per sample are constant
+  */
+class NTPAllanDeviation {
+public:
+    /**
+      * @brief Clears history and sets grid spacing
+      * @param tau0 Grid spacing in seconds. Usually sync interval. 0 disables estimation
+      */
+    void begin (uint32_t tau0);
+
+    /**
+      * @brief Checks if estimation is enabled
+      * @return `true` if `tau0` is not 0
+      */
+    bool isEnabled () const {
+        return tau0Us != 0;
+    }
+
+    /**
+      * @brief Adds a phase measurement
+      * @param timeUs Monotonic time of measurement, in microseconds
+      * @param phaseUs Reference time minus local monotonic time, in microseconds
+      */
+    void addSample (int64_t timeUs, int64_t phaseUs);
+
+    /**
+      * @brief Gets Allan deviation at one tau
+      * @param octave Tau index. Tau is `tau0 * 2^octave`
+      * @param point Output result
+      * @return `false` if octave is out of range or has no terms yet
+      */
+    bool getPoint (uint8_t octave, NTPAllanPoint_t* point) const;
+
+protected:
+    int64_t tau0Us = 0; ///< @brief Grid spacing in microseconds
+    int64_t lastTime = 0; ///< @brief Time of last sample
+    int64_t lastPhase = 0; ///< @brief Phase of last sample
+    int64_t nextGrid = 0; ///< @brief Time of next grid point
+    bool started = false; ///< @brief At least one sample after last grid restart
+    int64_t history[NTP_ALLAN_HISTORY]; ///< @brief Last grid phase points, ring buffer
+    uint16_t head = 0; ///< @brief Ring position of next grid point
+    uint16_t points = 0; ///< @brief Valid grid points in `history`, up to `NTP_ALLAN_HISTORY`
+    double sum[NTP_ALLAN_OCTAVES]; ///< @brief Sum of squared second differences per octave, in square microseconds
+    uint32_t terms[NTP_ALLAN_OCTAVES]; ///< @brief Number of second differences per octave
+
+    /**
+      * @brief Appends a grid phase point and updates sums
+      * @param phase Phase at grid point, in microseconds
+      */
+    void addGridPoint (int64_t phase);
+
+    /**
+      * @brief Gets a previous grid phase point
+      * @param back Number of grid points before last one
+      * @return Phase in microseconds
+      */
+    int64_t past (uint16_t back) const {
+        return history[(head + NTP_ALLAN_HISTORY - 1 - back) % NTP_ALLAN_HISTORY];
+    }
+};
+
+#endif // _NtpAllanDeviation_h
@@ -0,0 +1,236 @@
+#include "NTPCore.h"
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+
+int32_t flipInt32 (int32_t number) {
+    uint8_t output[sizeof (int32_t)];
+    uint8_t* input = (uint8_t*)&number;
+
+    for (unsigned int i = 1; i <= sizeof (int32_t); i++) {
+        output[i - 1] = input[sizeof (int32_t) - i];
+    }
+
+    int32_t result;
+    memcpy (&result, output, sizeof (int32_t));
+    return result;
+}
+
+int16_t flipInt16 (int16_t number) {
+    uint8_t output[sizeof (int16_t)];
+    uint8_t* input = (uint8_t*)&number;
+
+    for (unsigned int i = 1; i <= sizeof (int16_t); i++) {
+        output[i - 1] = input[sizeof (int16_t) - i];
+    }
+
+    int16_t result;
+    memcpy (&result, output, sizeof (int16_t));
+    return result;
+}
+
+timestamp64_t timeval2timestamp64 (const timeval* moment) {
+    timestamp64_t timestamp;
+    if (moment->tv_sec != 0) {
+        timestamp.secondsOffset = flipInt32 ((uint32_t)moment->tv_sec + NTP_SEVENTY_YEARS);
+        uint32_t timestamp_us = (uint32_t)((double)(moment->tv_usec) / 1000000.0 * (double)0x100000000);
+        timestamp.fraction = flipInt32 (timestamp_us);
+    } else {
+        timestamp.secondsOffset = 0;
+        timestamp.fraction = 0;
+    }
+    return timestamp;
+}
+
+timestamp32_t seconds2timestamp32 (float seconds) {
+    timestamp32_t timestamp;
+    if (seconds < 0) {
+        seconds = 0;
+    }
+    int16_t ts16_s = (int16_t)seconds;
+    uint16_t ts16_us = (uint16_t)((seconds - (float)ts16_s) * (float)0x10000);
+    timestamp.secondsOffset = flipInt16 (ts16_s);
+    timestamp.fraction = flipInt16 (ts16_us);
+    return timestamp;
+}
+
+/**
+  * @brief Converts NTP timestamp in network order to UNIX time
+  * @param timestamp NTP timestamp
+  * @return UNIX time. Zero timestamp gives zero
+  */
+static timeval timestamp642timeval (const timestamp64_t& timestamp) {
+    timeval result;
+    // Unsigned arithmetic gives right result until 2106 on 32 and 64 bit `time_t`
+    uint32_t timestamp_s = flipInt32 (timestamp.secondsOffset);
+    uint32_t timestamp_us = flipInt32 (timestamp.fraction);
+    
+    result.tv_sec = timestamp_s ? (time_t)(uint32_t)(timestamp_s - NTP_SEVENTY_YEARS) : 0;
+    result.tv_usec = ((float)(timestamp_us) / (float)0x100000000 * 1000000.0);
+    return result;
+}
+
+bool ntpDecodePacket (const uint8_t* buffer, size_t length, const timeval* destination, NTPPacket_t* packet) {
+    NTPUndecodedPacket_t raw;
+    
+    if (!buffer || !packet || length < NTP_PACKET_SIZE) {
+        return false;
+    }
+    memcpy (&raw, buffer, NTP_PACKET_SIZE);
+    
+    packet->flags.li = raw.flags >> 6;
+    packet->flags.vers = raw.flags >> 3 & 0b111;
+    packet->flags.mode = raw.flags & 0b111;
+    packet->peerStratum = raw.peerStratum;
+    packet->pollingInterval = pow (2, raw.pollingInterval);
+    packet->clockPrecission = pow (2, raw.clockPrecission);
+    
+    int16_t ts16_s = flipInt16 (raw.rootDelay.secondsOffset);
+    uint16_t ts16_us = flipInt16 (raw.rootDelay.fraction);
+    packet->rootDelay = (float)ts16_s + (float)ts16_us / (float)0x10000;
+    
+    ts16_s = flipInt16 (raw.dispersion.secondsOffset);
+    ts16_us = flipInt16 (raw.dispersion.fraction);
+    packet->dispersion = (float)ts16_s + (float)ts16_us / (float)0x10000;
+    
+    memcpy (&(packet->refID), &(raw.refID), 4);
+    packet->reference = timestamp642timeval (raw.reference);
+    packet->origin = timestamp642timeval (raw.origin);
+    packet->receive = timestamp642timeval (raw.receive);
+    packet->transmit = timestamp642timeval (raw.transmit);
+    packet->destination = *destination;
+    packet->valid = true;
+    
+    return true;
+}
+
+void ntpCalculateOffset (const NTPPacket_t* packet, double* offset, double* delay) {
+    double t1, t2, t3, t4;
+
+    t1 = packet->origin.tv_sec + packet->origin.tv_usec / 1000000.0;
+    t2 = packet->receive.tv_sec + packet->receive.tv_usec / 1000000.0;
+    t3 = packet->transmit.tv_sec + packet->transmit.tv_usec / 1000000.0;
+    t4 = packet->destination.tv_sec + packet->destination.tv_usec / 1000000.0;
+    *offset = ((t2 - t1) / 2.0 + (t3 - t4) / 2.0);
+    *delay = (t4 - t1) - (t3 - t2);
+}
+
+bool ntpCheckResponse (const NTPPacket_t* packet, int64_t offsetUs, NTPStatus_t status, const NTPSyncConfig_t& config, NTPRejectReason_t* reason) {
+    NTPRejectReason_t failed;
+    
+    if (packet->flags.li != 0) {
+        failed = rejectLeapIndicator;
+    } else if (packet->flags.vers < NTP_MIN_VER) {
+        failed = rejectVersion;
+    } else if (packet->flags.mode != 4 && !(config.acceptBroadcast && packet->flags.mode == 5) && !(config.acceptPeer && packet->flags.mode == 2)) {
+        failed = rejectMode;
+    } else if (packet->peerStratum < 1 || packet->peerStratum > 15) {
+        failed = rejectStratum;
+    } else if ((status == syncd || status == partialSync)
+               && packet->clockPrecission > (float)(config.minSyncAccuracyUs / 10000000.0)) { // 5 zeroes, that's correct. us*1000000 / 10
+        failed = rejectPrecision;
+    } else if ((status == syncd || status == partialSync)
+               && (packet->dispersion > fabs (offsetUs / 1000000.0) || packet->dispersion == 0.0)) {
+        failed = rejectDispersion;
+    } else {
+        return true;
+    }
+    if (reason) {
+        *reason = failed;
+    }
+    return false;
+}
+
+uint8_t ntpHistogramBucket (uint64_t us) {
+    if (!us) {
+        return 0;
+    }
+    uint8_t bucket = 64 - __builtin_clzll (us);
+    return bucket < NTP_HISTOGRAM_BUCKETS ? bucket : NTP_HISTOGRAM_BUCKETS - 1;
+}
+
+void ntpStatsAddSample (NTPStats_t* stats, int64_t offsetUs, int64_t delayUs, float dispersion, const int64_t* previousOffsetUs) {
+    uint64_t absOffset = offsetUs < 0 ? -offsetUs : offsetUs;
+
+    stats->offset[ntpHistogramBucket (absOffset)]++;
+    stats->delay[ntpHistogramBucket (delayUs < 0 ? 0 : delayUs)]++;
+    stats->dispersion[ntpHistogramBucket ((uint64_t)(dispersion * 1000000.0))]++;
+    if (previousOffsetUs) {
+        int64_t jitter = offsetUs - *previousOffsetUs;
+        stats->jitter[ntpHistogramBucket (jitter < 0 ? -jitter : jitter)]++;
+    }
+}
+
+NTPSyncDecision_t NTPSyncFilter::processSample (const NTPPacket_t& packet, int64_t offsetUs, NTPStatus_t status, const NTPSyncConfig_t& config) {
+    NTPSyncDecision_t decision;
+    
+    decision.status = status;
+    decision.retries = numSyncRetry;
+    decision.reason = NUM_REJECT_REASONS;
+    
+    offsetSum += offsetUs;
+    round++;
+    decision.offsetUs = offsetSum / round;
+    
+    if (round < config.numAveRounds) {
+        decision.action = syncAveraging;
+        decision.interval = config.ntpTimeout + 500; // Set retry period equal to timeout + 500 ms
+        return decision;
+    }
+    round = 0;
+    offsetSum = 0;
+    
+    int64_t offsetAve = decision.offsetUs;
+    if (llabs (offsetAve) < config.timeSyncThreshold) {
+        decision.status = syncd;
+        decision.interval = config.longInterval;
+        decision.action = wasPartial ? syncConverged : syncSkipped;
+        numDispersionErrors = 0;
+        numSyncRetry = 0;
+        wasPartial = false;
+        decision.retries = 0;
+        return decision;
+    }
+    
+    if (!ntpCheckResponse (&packet, offsetAve, status, config, &decision.reason)) {
+        numDispersionErrors++;
+        if (numDispersionErrors > config.maxDispersionErrors) {
+            numDispersionErrors = 0;
+            decision.action = syncAccuracyError;
+            decision.interval = config.shortInterval;
+        } else {
+            decision.action = syncRejected;
+            decision.interval = config.shortInterval * 4;
+        }
+        return decision;
+    }
+    numDispersionErrors = 0;
+    
+    decision.action = syncApply;
+    if (offsetAve / 1000000 != 0 || llabs (offsetAve % 1000000) > config.minSyncAccuracyUs) {
+        if (numSyncRetry < config.maxNumSyncRetry) {
+            decision.status = partialSync;
+            numSyncRetry++;
+            wasPartial = true;
+        } else {
+            decision.status = syncd;
+            numSyncRetry = 0;
+            wasPartial = false;
+        }
+    } else {
+        decision.status = syncd;
+        numSyncRetry = 0;
+        wasPartial = false;
+    }
+    decision.retries = numSyncRetry;
+    decision.interval = decision.status == partialSync ? config.ntpTimeout + 500 : config.longInterval;
+    return decision;
+}
+
+void NTPSyncFilter::reset () {
+    offsetSum = 0;
+    round = 0;
+    numSyncRetry = 0;
+    numDispersionErrors = 0;
+    wasPartial = false;
+}
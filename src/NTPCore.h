@@ -0,0 +1,417 @@
+/**
+  * @file NTPCore.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief NTP packet decoding, offset calculation, response checks and sync filter. No platform dependencies,
+  * so the same code runs in the library and in host tools under `extras`
+  */
+
+#ifndef _NtpCore_h
+#define _NtpCore_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/time.h>
+#include <string.h>
+
+constexpr auto NTP_MIN_VER = 3; /// 
+constexpr auto DEFAULT_NTP_INTERVAL = 1800; ///< @brief Default sync interval 30 minutes
+constexpr auto DEFAULT_NTP_SHORTINTERVAL = 15; ///< @brief Sync interval when sync has not been achieved. 15 seconds
+constexpr auto DEFAULT_NTP_TIMEOUT = 5000; ///< @brief Default NTP timeout ms
+constexpr auto DEFAULT_MIN_SYNC_ACCURACY_US = 5000; ///< @brief Minimum sync accuracy in us
+constexpr auto DEFAULT_MAX_RESYNC_RETRY = 3; ///< @brief Maximum number of sync retrials if offset is above accuravy
+constexpr auto DEFAULT_TIME_SYNC_THRESHOLD = 2500; ///< @brief If calculated offset is less than this in us clock will not be corrected
+constexpr auto DEFAULT_NUM_OFFSET_AVE_ROUNDS = 1; ///< @brief Number of NTP request and response rounds to calculate offset average
+constexpr auto NTP_PACKET_SIZE = 48; ///< @brief NTP time is in the first 48 bytes of message
+constexpr uint32_t NTP_SEVENTY_YEARS = 2208988800UL; ///< @brief Seconds from 1900 to 1970
+constexpr auto NTP_HISTOGRAM_BUCKETS = 24; ///< @brief Log2 histogram buckets. Bucket 0 is under 1 us, bucket n covers [2^(n-1), 2^n) us, last one is open
+
+  /**
+    * @brief NTP client status code
+    */
+typedef enum NTPStatus {
+    syncd = 0, // Time synchronized correctly
+    unsyncd = -1, // Time may not be valid
+    partialSync = 1 // NPT is synchronised but precission is below threshold
+} NTPStatus_t; // Only for internal library use
+
+  /**
+    * @brief Flags in NTP packet
+    */
+typedef struct {
+    /**
+      * @brief 2-bit integer warning of an impending leap
+      * second to be inserted or deleted in the last minute of the current
+      * month with values defined in this table
+      * 
+      * | Value | Meaning |
+      * |:----------:|-------------|
+      * | 0     | no warning                             |
+      * | 1     | last minute of the day has 61 seconds  |
+      * | 2     | last minute of the day has 59 seconds  |
+      * | 3     | unknown (clock unsynchronized)         |
+      */
+    int li;
+    int vers; ///< @brief 3-bit integer representing the NTP version number, currently 4
+    /**
+      * @brief 3-bit integer representing the mode, with values defined in this table
+      * 
+      * | Value | Meaning                  |
+      * |:-----:|--------------------------|
+      * | 0     | reserved                 |
+      * | 1     | symmetric active         |
+      * | 2     | symmetric passive        |
+      * | 3     | client                   |
+      * | 4     | server                   |
+      * | 5     | broadcast                |
+      * | 6     | NTP control message      |
+      * | 7     | reserved for private use |
+      */
+    int mode;
+} NTPFlags_t;
+
+  /**
+    * @brief NTP packet structure
+    */
+typedef struct {
+    bool valid = false; ///< @brief true if following data is valid
+    NTPFlags_t flags; ///< @brief NTP packet flags as NTPFlags_t
+    
+    /**
+      * @brief 8-bit integer representing the stratum
+      * 
+      * | Value  | Meaning                                             |
+      * |:------:|-----------------------------------------------------|
+      * | 0      | unspecified or invalid                              |
+      * | 1      | primary server (e.g., equipped with a GPS receiver) |
+      * | 2-15   | secondary server (via NTP)                          |
+      * | 16     | unsynchronized                                      |
+      * | 17-255 | reserved                                            |
+      */
+    uint8_t peerStratum;
+    
+     /**
+      * @brief Maximum interval between successive messages, in seconds.
+      *
+      * Calculated from 8-bit signed integer representing log2 value. Suggested default limits for 
+      * minimum and maximum poll intervals are 6 and 10, what represent 64 to 1024 seconds, respectively
+      */
+    uint32_t pollingInterval;
+    
+    /**
+      * @brief 8-bit signed integer representing the precision of the
+      * system clock, in log2 seconds
+      * 
+      * For instance, a value of -18 corresponds to a precision of about one microsecond.
+      * The precision can be determined when the service first starts up as the minimum
+      * time of several iterations to read the system clock
+      */
+    float clockPrecission;
+       
+    float rootDelay; ///< @brief Total round-trip delay to the reference clock
+    
+    float dispersion; ///< @brief Total dispersion to the reference clock
+    
+     /**
+      * @brief 32-bit code identifying the particular server or reference clock
+      * 
+      * The interpretation depends on the value in the stratum field.
+      * For packet stratum 0 (unspecified or invalid), this is a four-character ASCII [RFC1345] string,
+      * called the "kiss code", used for debugging and monitoring purposes. For stratum 1 (reference
+      * clock), this is a four-octet, left-justified, zero-padded ASCII string assigned to the
+      * reference clock. 
+      * 
+      * The authoritative list of Reference Identifiers is maintained by IANA; however, any string
+      * beginning with the ASCII character "X" is reserved for unregistered experimentation and 
+      * development. Next identifiers have been used as ASCII identifiers:
+      * 
+      * | ID   | Clock Source                                             |
+      * |:----:|----------------------------------------------------------|
+      * | GOES | Geosynchronous Orbit Environment Satellite               |
+      * | GPS  | Global Position System                                   |
+      * | GAL  | Galileo Positioning System                               |
+      * | PPS  | Generic pulse-per-second                                 |
+      * | IRIG | Inter-Range Instrumentation Group                        |
+      * | WWVB | LF Radio WWVB Ft. Collins, CO 60 kHz                     |
+      * | DCF  | LF Radio DCF77 Mainflingen, DE 77.5 kHz                  |
+      * | HBG  | LF Radio HBG Prangins, HB 75 kHz                         |
+      * | MSF  | LF Radio MSF Anthorn, UK 60 kHz                          |
+      * | JJY  | LF Radio JJY Fukushima, JP 40 kHz, Saga, JP 60 kHz       |
+      * | LORC | MF Radio LORAN C station, 100 kHz                        |
+      * | TDF  | MF Radio Allouis, FR 162 kHz                             |
+      * | CHU  | HF Radio CHU Ottawa, Ontario                             |
+      * | WWV  | HF Radio WWV Ft. Collins, CO                             |
+      * | WWVH | HF Radio WWVH Kauai, HI                                  |
+      * | NIST | NIST telephone modem                                     |
+      * | ACTS | NIST telephone modem                                     |
+      * | USNO | USNO telephone modem                                     |
+      * | PTB  | European telephone modem                                 |
+      * 
+      * Above stratum 1 (secondary servers and clients): this is the reference identifier of
+      * the server and can be used to detect timing loops. If using the IPv4 address family,
+      * the identifier is the four-octet IPv4 address. If using the IPv6 address family, it is the
+      * first four octets of the MD5 hash of the IPv6 address. Note that, when using the IPv6 address
+      * family on an NTPv4 server with a NTPv3 client, the Reference Identifier field appears to be a 
+      * random value and a timing loop might not be detected
+      */
+    uint8_t refID[4];
+    
+    timeval reference; ///< @brief Time when the system clock was last set or corrected
+    timeval origin; ///< @brief Time at the client when the request departed for the server
+    timeval receive; ///< @brief Time at the server when the request arrived from the client
+    timeval transmit; ///< @brief Time at the server when the response left for the client
+    timeval destination; ///< Time at the client when the reply arrived from the server, in NTP timestamp format
+} NTPPacket_t;
+
+  /**
+    * @brief NTP Timestamp Format
+    * The prime epoch, or base date of era 0, is 0 h 1 January 1900 UTC, when all bits are zero
+    */
+typedef struct {
+    int32_t secondsOffset; ///< @brief 32-bit seconds field spanning 136 years since 1-Jan-1900 00:00 UTC
+    uint32_t fraction; ///< @brief 32-bit fraction field resolving 232 picoseconds (1/2^32)
+} timestamp64_t;
+
+  /**
+    * @brief Short NTP Timestamp Format
+    * 
+    * Used for precission, dispersion, etc
+    */
+typedef struct {
+    int16_t secondsOffset; ///< @brief 16-bit seconds field spanning 18 hours
+    uint16_t fraction; ///< @brief 16-bit fraction field resolving 15.3 microseconds (1/2^16)
+} timestamp32_t;
+
+  /**
+    * @brief Raw NTP packet as sent on the network
+    */
+typedef struct __attribute__ ((packed, aligned (1))) {
+    uint8_t flags;
+    uint8_t peerStratum;
+    uint8_t pollingInterval;
+    int8_t clockPrecission;
+    timestamp32_t rootDelay;
+    timestamp32_t dispersion;
+    uint8_t refID[4];
+    timestamp64_t reference;
+    timestamp64_t origin;
+    timestamp64_t receive;
+    timestamp64_t transmit;
+} NTPUndecodedPacket_t;
+
+  /**
+    * @brief Reasons to reject an NTP response
+    */
+typedef enum {
+    rejectShortPacket, ///< @brief Response shorter than an NTP packet
+    rejectDecode, ///< @brief Response could not be decoded
+    rejectLeapIndicator, ///< @brief Server clock not synchronized or leap second pending
+    rejectVersion, ///< @brief NTP version too old
+    rejectMode, ///< @brief Unexpected NTP mode
+    rejectStratum, ///< @brief Stratum out of 1..15 range
+    rejectPrecision, ///< @brief Server precision worse than required accuracy
+    rejectDispersion, ///< @brief Dispersion bigger than offset or zero
+    NUM_REJECT_REASONS ///< @brief Number of reject reasons
+} NTPRejectReason_t;
+
+  /**
+    * @brief Sync filter settings. Intervals are in milliseconds
+    */
+typedef struct {
+    unsigned int numAveRounds = DEFAULT_NUM_OFFSET_AVE_ROUNDS; ///< @brief Responses averaged before offset is used
+    long timeSyncThreshold = DEFAULT_TIME_SYNC_THRESHOLD; ///< @brief Offsets below this, in microseconds, are not applied
+    long minSyncAccuracyUs = DEFAULT_MIN_SYNC_ACCURACY_US; ///< @brief Offset, in microseconds, over which sync is repeated
+    unsigned int maxNumSyncRetry = DEFAULT_MAX_RESYNC_RETRY; ///< @brief Sync repetitions until accuracy is reached
+    unsigned int maxDispersionErrors = DEFAULT_MAX_RESYNC_RETRY; ///< @brief Rejected responses before `syncAccuracyError`
+    uint32_t shortInterval = DEFAULT_NTP_SHORTINTERVAL * 1000; ///< @brief Request interval while not synced
+    uint32_t longInterval = DEFAULT_NTP_INTERVAL * 1000; ///< @brief Request interval once synced
+    uint16_t ntpTimeout = DEFAULT_NTP_TIMEOUT; ///< @brief Response timeout
+    bool acceptBroadcast = false; ///< @brief Mode 5 packets are valid
+    bool acceptPeer = false; ///< @brief Mode 2 packets are valid
+} NTPSyncConfig_t;
+
+  /**
+    * @brief What to do with a processed sample
+    */
+typedef enum {
+    syncAveraging, ///< @brief Sample added to average. Request again after `interval`
+    syncSkipped, ///< @brief Offset under threshold, clock is already right
+    syncConverged, ///< @brief Offset under threshold after a partial sync. Sync has finished
+    syncRejected, ///< @brief Response failed a check, see `reason`
+    syncAccuracyError, ///< @brief Too many rejected responses in a row, see `reason`
+    syncApply ///< @brief Clock has to be adjusted by `offsetUs`
+} NTPSyncAction_t;
+
+  /**
+    * @brief Result of processing a sample
+    */
+typedef struct {
+    NTPSyncAction_t action; ///< @brief Action to take
+    NTPStatus_t status; ///< @brief New sync status
+    uint32_t interval; ///< @brief Time until next request, in milliseconds
+    int64_t offsetUs; ///< @brief Averaged offset, in microseconds
+    NTPRejectReason_t reason; ///< @brief Check that failed, for `syncRejected` and `syncAccuracyError`
+    unsigned int retries; ///< @brief Partial sync repetitions so far
+} NTPSyncDecision_t;
+
+  /**
+    * @brief Sync statistics. Histogram values are in microseconds, see `NTP_HISTOGRAM_BUCKETS`
+    */
+typedef struct {
+    uint32_t requests; ///< @brief Requests sent
+    uint32_t responses; ///< @brief Responses received to a pending request
+    uint32_t timeouts; ///< @brief Requests without response
+    uint32_t dnsFailures; ///< @brief Failed server name resolutions
+    uint32_t rejected[NUM_REJECT_REASONS]; ///< @brief Rejected responses, by `NTPRejectReason_t`
+    uint32_t steps; ///< @brief Clock adjustments applied
+    uint32_t poolDiversity; ///< @brief Distinct addresses seen for server name, when snapshot was taken
+    uint32_t offset[NTP_HISTOGRAM_BUCKETS]; ///< @brief Absolute offset of every accepted sample
+    uint32_t delay[NTP_HISTOGRAM_BUCKETS]; ///< @brief Round trip delay of every accepted sample
+    uint32_t jitter[NTP_HISTOGRAM_BUCKETS]; ///< @brief Absolute offset difference between consecutive accepted samples
+    uint32_t dispersion[NTP_HISTOGRAM_BUCKETS]; ///< @brief Root dispersion announced by server in accepted samples
+} NTPStats_t;
+
+/**
+  * @brief Reverses byte order of a 32 bit value
+  * @param number Value
+  * @return Value with bytes reversed
+  */
+int32_t flipInt32 (int32_t number);
+
+/**
+  * @brief Reverses byte order of a 16 bit value
+  * @param number Value
+  * @return Value with bytes reversed
+  */
+int16_t flipInt16 (int16_t number);
+
+/**
+  * @brief Converts UNIX time to NTP timestamp in network order
+  * @param moment Time to convert. 0 gives a zero timestamp
+  * @return NTP timestamp
+  */
+timestamp64_t timeval2timestamp64 (const timeval* moment);
+
+/**
+  * @brief Converts seconds to NTP short format in network order
+  * @param seconds Value to convert. Negative values are set to 0
+  * @return NTP short timestamp
+  */
+timestamp32_t seconds2timestamp32 (float seconds);
+
+/**
+  * @brief Decodes a raw NTP packet
+  * @param buffer Raw packet
+  * @param length Packet length
+  * @param destination Time when packet was received
+  * @param packet Decoded packet
+  * @return `false` if packet is too short
+  */
+bool ntpDecodePacket (const uint8_t* buffer, size_t length, const timeval* destination, NTPPacket_t* packet);
+
+/**
+  * @brief Calculates clock offset and round trip delay from packet timestamps
+  * @param packet Decoded packet
+  * @param offset Output. Time to add to local clock, in seconds
+  * @param delay Output. Round trip delay, in seconds
+  */
+void ntpCalculateOffset (const NTPPacket_t* packet, double* offset, double* delay);
+
+/**
+  * @brief Checks if a response can be used to adjust clock
+  * @param packet Decoded packet
+  * @param offsetUs Calculated offset in microseconds
+  * @param status Current sync status. Precision and dispersion are only checked once synced
+  * @param config Filter settings
+  * @param reason Output. Failed check if response is not valid
+  * @return `true` if response is valid
+  */
+bool ntpCheckResponse (const NTPPacket_t* packet, int64_t offsetUs, NTPStatus_t status, const NTPSyncConfig_t& config, NTPRejectReason_t* reason);
+
+/**
+  * @brief Gets log2 histogram bucket of a value, see `NTP_HISTOGRAM_BUCKETS`
+  * @param us Value in microseconds
+  * @return Bucket index
+  */
+uint8_t ntpHistogramBucket (uint64_t us);
+
+/**
+  * @brief Adds a sample to offset, delay, jitter and dispersion histograms. Call it inside a write section
+  * @param stats Statistics to update
+  * @param offsetUs Sample offset in microseconds
+  * @param delayUs Sample round trip delay in microseconds
+  * @param dispersion Root dispersion announced by server in seconds
+  * @param previousOffsetUs Offset of previous sample, for jitter. `NULL` if there is none
+  */
+void ntpStatsAddSample (NTPStats_t* stats, int64_t offsetUs, int64_t delayUs, float dispersion, const int64_t* previousOffsetUs);
+
+/**
+  * @brief Starts a write section of data guarded by a sequence counter. Writers must be serialized by caller
+  * @param sequence Sequence counter. Odd while a write is in progress
+  */
+inline void ntpSeqlockBeginWrite (volatile uint32_t* sequence) {
+    *sequence = *sequence + 1;
+    __sync_synchronize ();
+}
+
+/**
+  * @brief Finishes a write section started with `ntpSeqlockBeginWrite()`
+  * @param sequence Sequence counter
+  */
+inline void ntpSeqlockEndWrite (volatile uint32_t* sequence) {
+    __sync_synchronize ();
+    *sequence = *sequence + 1;
+}
+
+/**
+  * @brief Copies data guarded by a sequence counter without blocking writers. Copy is retried while a write is in
+  * progress or if one happened during copy, so result is always consistent
+  * @param sequence Sequence counter
+  * @param source Guarded data
+  * @param copy Output
+  * @param length Bytes to copy
+  */
+inline void ntpSeqlockRead (const volatile uint32_t* sequence, const volatile void* source, void* copy, size_t length) {
+    uint32_t start;
+    do {
+        start = *sequence;
+        if (start & 1) {
+            continue; // Write in progress
+        }
+        __sync_synchronize ();
+        memcpy (copy, (const void*)source, length);
+        __sync_synchronize ();
+    } while ((start & 1) || start != *sequence);
+}
+
+/**
+  * @brief Sample averaging, thresholds, retries and interval logic of sync process. It decides what to do with
+  * every sample but does not touch the clock, so it can be driven from recorded or simulated data
+  */
+class NTPSyncFilter {
+public:
+    /**
+      * @brief Processes an offset sample
+      * @param packet Decoded packet the sample comes from
+      * @param offsetUs Measured offset in microseconds
+      * @param status Current sync status
+      * @param config Filter settings
+      * @return Decision
+      */
+    NTPSyncDecision_t processSample (const NTPPacket_t& packet, int64_t offsetUs, NTPStatus_t status, const NTPSyncConfig_t& config);
+
+    /**
+      * @brief Clears averaging and retry state
+      */
+    void reset ();
+
+protected:
+    int64_t offsetSum = 0; ///< @brief Sum of offsets for average calculation
+    unsigned int round = 0; ///< @brief Number of offset values added during last sync
+    unsigned int numSyncRetry = 0; ///< @brief Current resync repetition
+    unsigned int numDispersionErrors = 0; ///< @brief Consecutive rejected responses
+    bool wasPartial = false; ///< @brief True if last sync did not reach required accuracy
+};
+
+#endif // _NtpCore_h
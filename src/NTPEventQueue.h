@@ -0,0 +1,243 @@
+/**
+  * @file NTPEventQueue.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Bounded lock-free queue to defer event delivery out of timer and network contexts, and listener registry
+  */
+
+#ifndef _NtpEventQueue_h
+#define _NtpEventQueue_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef ESP8266
+#include <Arduino.h> // xt_rsil, xt_wsr_ps
+#endif
+
+/**
+  * @brief Bounded multi producer, multi consumer queue after Dmitry Vyukov's design. Every cell carries a sequence
+  * number so producers and consumers only contend on one compare and swap. It never allocates and never blocks
+  * @tparam T Element type
+  * @tparam N Number of cells. Must be a power of two
+  */
+template <typename T, size_t N>
+class NTPEventQueue {
+    static_assert (N >= 2 && (N & (N - 1)) == 0, "Queue size must be a power of two");
+
+public:
+    NTPEventQueue () {
+        for (size_t i = 0; i < N; i++) {
+            cells[i].sequence = i;
+        }
+    }
+
+    /**
+      * @brief Adds an element. Safe from any task or callback context
+      * @param item Element to copy into queue
+      * @return `false` if queue was full. Element is dropped and overflow counter incremented
+      */
+    bool push (const T& item) {
+        Cell* cell;
+        size_t pos = load (&enqueuePos);
+        for (;;) {
+            cell = &cells[pos & (N - 1)];
+            intptr_t diff = (intptr_t)load (&cell->sequence) - (intptr_t)pos;
+            if (diff == 0) {
+                if (compareAndSwap (&enqueuePos, pos, pos + 1)) {
+                    break;
+                }
+                pos = load (&enqueuePos);
+            } else if (diff < 0) {
+                increment (&overflows);
+                return false;
+            } else {
+                pos = load (&enqueuePos);
+            }
+        }
+        cell->data = item;
+        store (&cell->sequence, pos + 1);
+        return true;
+    }
+
+    /**
+      * @brief Takes oldest element
+      * @param item Output element
+      * @return `false` if queue was empty
+      */
+    bool pop (T& item) {
+        Cell* cell;
+        size_t pos = load (&dequeuePos);
+        for (;;) {
+            cell = &cells[pos & (N - 1)];
+            intptr_t diff = (intptr_t)load (&cell->sequence) - (intptr_t)(pos + 1);
+            if (diff == 0) {
+                if (compareAndSwap (&dequeuePos, pos, pos + 1)) {
+                    break;
+                }
+                pos = load (&dequeuePos);
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = load (&dequeuePos);
+            }
+        }
+        item = cell->data;
+        store (&cell->sequence, pos + N);
+        return true;
+    }
+
+    /**
+      * @brief Gets number of elements dropped because queue was full
+      * @return Overflow count
+      */
+    uint32_t getOverflows () const {
+        return overflows;
+    }
+
+protected:
+    /**
+      * @brief Queue cell
+      */
+    struct Cell {
+        volatile size_t sequence; ///< @brief Position this cell is waiting to be written or read at
+        T data; ///< @brief Element
+    };
+
+    Cell cells[N]; ///< @brief Queue storage
+    volatile size_t enqueuePos = 0; ///< @brief Next position to write
+    volatile size_t dequeuePos = 0; ///< @brief Next position to read
+    volatile uint32_t overflows = 0; ///< @brief Elements dropped because queue was full
+
+    /// @brief Reads a position with acquire semantics
+    static size_t load (volatile size_t* value) {
+#ifndef ESP8266
+        return __atomic_load_n (value, __ATOMIC_ACQUIRE);
+#else
+        return *value; // Single core, aligned 32 bit reads are atomic
+#endif
+    }
+
+    /// @brief Writes a position with release semantics
+    static void store (volatile size_t* value, size_t newValue) {
+#ifndef ESP8266
+        __atomic_store_n (value, newValue, __ATOMIC_RELEASE);
+#else
+        *value = newValue;
+#endif
+    }
+
+    /// @brief Increments a counter atomically
+    static void increment (volatile uint32_t* value) {
+#ifndef ESP8266
+        __atomic_fetch_add (value, 1, __ATOMIC_RELAXED);
+#else
+        uint32_t savedPS = xt_rsil (15);
+        (*value)++;
+        xt_wsr_ps (savedPS);
+#endif
+    }
+
+    /// @brief Sets `value` to `desired` only if it still is `expected`. Returns `true` on success
+    static bool compareAndSwap (volatile size_t* value, size_t expected, size_t desired) {
+#ifndef ESP8266
+        return __atomic_compare_exchange_n (value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED);
+#else
+        // ESP8266 has no compare and swap instruction. Block interrupts for two instructions instead
+        uint32_t savedPS = xt_rsil (15);
+        bool swapped = *value == expected;
+        if (swapped) {
+            *value = desired;
+        }
+        xt_wsr_ps (savedPS);
+        return swapped;
+#endif
+    }
+};
+
+/**
+  * @brief Fixed set of event listeners, each one with a subscription mask. Union of all masks is kept, so event
+  * sources check a single word before building an event nobody listens to. It never allocates
+  * @tparam Event Event type
+  * @tparam Handler Callable taking an `Event`, testable for emptiness
+  * @tparam N Maximum number of listeners
+  */
+template <typename Event, typename Handler, size_t N>
+class NTPEventRegistry {
+public:
+    /**
+      * @brief Adds a listener
+      * @param handler Callback
+      * @param mask Subscribed events. Bit meaning is defined by caller
+      * @return Listener id to remove it later. -1 if handler or mask are empty, or there is no free slot
+      */
+    int add (const Handler& handler, uint16_t mask) {
+        if (!handler || !mask) {
+            return -1;
+        }
+        for (size_t i = 0; i < N; i++) {
+            if (!listeners[i].mask) {
+                listeners[i].handler = handler;
+                listeners[i].mask = mask;
+                subscribed |= mask;
+                return (int)i;
+            }
+        }
+        return -1;
+    }
+
+    /**
+      * @brief Removes a listener. It stops getting events before its handler is released
+      * @param id Listener id returned by `add()`
+      * @return `true` if listener existed
+      */
+    bool remove (int id) {
+        if (id < 0 || id >= (int)N || !listeners[id].mask) {
+            return false;
+        }
+        listeners[id].mask = 0;
+        uint16_t remaining = 0;
+        for (size_t i = 0; i < N; i++) {
+            remaining |= listeners[i].mask;
+        }
+        subscribed = remaining;
+        return true;
+    }
+
+    /**
+      * @brief Checks if any listener is subscribed to an event
+      * @param mask Event bit
+      * @return `true` if event has to be generated
+      */
+    bool wants (uint16_t mask) const {
+        return subscribed & mask;
+    }
+
+    /**
+      * @brief Calls every listener subscribed to an event
+      * @param event Event to deliver
+      * @param mask Event bit
+      */
+    void dispatch (const Event& event, uint16_t mask) const {
+        for (size_t i = 0; i < N; i++) {
+            if ((listeners[i].mask & mask) && listeners[i].handler) {
+                listeners[i].handler (event);
+            }
+        }
+    }
+
+protected:
+    /**
+      * @brief Registered listener
+      */
+    struct Listener {
+        Handler handler; ///< @brief Listener callback
+        uint16_t mask = 0; ///< @brief Subscribed events. 0 if slot is free
+    };
+
+    Listener listeners[N]; ///< @brief Listener slots
+    volatile uint16_t subscribed = 0; ///< @brief Events at least one listener is subscribed to
+};
+
+#endif // _NtpEventQueue_h
@@ -0,0 +1,194 @@
+#include "NTPEventSerializer.h"
+
+extern "C" {
+#include "lwip/ip_addr.h"
+}
+
+const char* ntpEventName (NTPSyncEventType_t event) {
+    switch (event) {
+    case timeSyncd:
+        return "timeSyncd";
+    case noResponse:
+        return "noResponse";
+    case invalidAddress:
+        return "invalidAddress";
+    case invalidPort:
+        return "invalidPort";
+    case requestSent:
+        return "requestSent";
+    case partlySync:
+        return "partlySync";
+    case syncNotNeeded:
+        return "syncNotNeeded";
+    case syncTraced:
+        return "syncTraced";
+    case errorSending:
+        return "errorSending";
+    case responseError:
+        return "responseError";
+    case syncError:
+        return "syncError";
+    case accuracyError:
+        return "accuracyError";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+  * @brief Converts core IPAddress to lwIP address
+  * @param address Address to convert
+  * @param result lwIP address
+  */
+static void iPAddress2IpAddr (const IPAddress& address, ip_addr_t* result) {
+#if defined ESP32 && ESP_ARDUINO_VERSION_MAJOR >= 3
+    address.to_ip_addr_t (result);
+#elif defined ESP8266
+    ip_addr_copy (*result, *(const ip_addr_t*)address);
+#else // ESP32 Arduino 2.x IPAddress is IPv4 only
+    ip_addr_set_ip4_u32 (result, (uint32_t)address);
+#endif
+}
+
+char* ntpFormatIPAddress (const ip_addr_t* address, char* buffer, size_t length) {
+    if (!buffer || !length) {
+        return buffer;
+    }
+    if (!ipaddr_ntoa_r (address, buffer, length)) {
+        buffer[0] = '\0';
+    }
+    return buffer;
+}
+
+char* ntpFormatIPAddress (const IPAddress& address, char* buffer, size_t length) {
+    ip_addr_t lwipAddress;
+
+    iPAddress2IpAddr (address, &lwipAddress);
+    return ntpFormatIPAddress (&lwipAddress, buffer, length);
+}
+
+/**
+  * @brief Writes an integer in little endian order
+  * @param buffer Output position
+  * @param value Value to write
+  * @param bytes Number of bytes to write
+  */
+static void putLittleEndian (uint8_t* buffer, uint64_t value, uint8_t bytes) {
+    for (uint8_t i = 0; i < bytes; i++) {
+        buffer[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+/**
+  * @brief Converts seconds to nanoseconds, saturated to a range
+  * @param seconds Value in seconds
+  * @param min Minimum result
+  * @param max Maximum result
+  * @return Nanoseconds
+  */
+static int64_t toNanoseconds (double seconds, int64_t min, int64_t max) {
+    double ns = seconds * 1e9;
+    if (ns <= (double)min) {
+        return min;
+    }
+    if (ns >= (double)max) {
+        return max;
+    }
+    return (int64_t)(ns < 0 ? ns - 0.5 : ns + 0.5);
+}
+
+size_t ntpEventToRecord (const NTPEvent_t& event, uint8_t* buffer) {
+    const ip_addr_t* address = &event.info.serverAddr;
+
+    memset (buffer, 0, NTP_EVENT_RECORD_SIZE);
+    buffer[0] = NTP_EVENT_RECORD_VERSION;
+    buffer[1] = (uint8_t)(int8_t)event.event;
+    putLittleEndian (buffer + 2, event.info.port, 2);
+    putLittleEndian (buffer + 4, event.info.retrials > 0xFFFF ? 0xFFFF : event.info.retrials, 2);
+    putLittleEndian (buffer + 8, event.uptimeUs, 8);
+    putLittleEndian (buffer + 16, (uint64_t)toNanoseconds (event.info.offset, INT64_MIN, INT64_MAX), 8);
+    putLittleEndian (buffer + 24, (uint64_t)toNanoseconds (event.info.delay, INT32_MIN, INT32_MAX), 4);
+    putLittleEndian (buffer + 28, (uint64_t)toNanoseconds (event.info.dispersion, 0, UINT32_MAX), 4);
+
+#if LWIP_IPV6
+    if (IP_IS_V6 (address)) {
+        buffer[6] = 6;
+        memcpy (buffer + 32, ip_2_ip6 (address)->addr, 16);
+    } else
+#endif // LWIP_IPV6
+    {
+        uint32_t ipv4 = ip4_addr_get_u32 (ip_2_ip4 (address));
+        if (ipv4) {
+            buffer[6] = 4;
+            memcpy (buffer + 32, &ipv4, 4); // Already in network order
+        }
+    }
+    return NTP_EVENT_RECORD_SIZE;
+}
+
+/**
+  * @brief Writes a signed integer in decimal
+  * @param out Destination
+  * @param value Value to write
+  * @return Number of bytes written
+  */
+static size_t writeInt64 (Print& out, int64_t value) {
+    char digits[21];
+    uint8_t pos = sizeof (digits);
+    bool negative = value < 0;
+    uint64_t magnitude = negative ? (uint64_t)(-(value + 1)) + 1 : (uint64_t)value;
+
+    do {
+        digits[--pos] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+    if (negative) {
+        digits[--pos] = '-';
+    }
+    return out.write ((const uint8_t*)digits + pos, sizeof (digits) - pos);
+}
+
+/**
+  * @brief Writes `,"name":` JSON member prefix
+  * @param out Destination
+  * @param name Member name
+  * @return Number of bytes written
+  */
+static size_t writeKey (Print& out, const char* name) {
+    size_t written = out.write ((const uint8_t*)",\"", 2);
+    written += out.write ((const uint8_t*)name, strlen (name));
+    written += out.write ((const uint8_t*)"\":", 2);
+    return written;
+}
+
+size_t ntpEventToJson (const NTPEvent_t& event, Print& out) {
+    char address[IP_ADDRESS_STR_LENGTH];
+    const char* name = ntpEventName (event.event);
+    size_t written = 0;
+
+    written += out.write ((const uint8_t*)"{\"event\":", 9);
+    written += writeInt64 (out, event.event);
+    written += writeKey (out, "name");
+    written += out.write ((const uint8_t*)"\"", 1);
+    written += out.write ((const uint8_t*)name, strlen (name));
+    written += out.write ((const uint8_t*)"\"", 1);
+    written += writeKey (out, "uptime_us");
+    written += writeInt64 (out, (int64_t)event.uptimeUs);
+    written += writeKey (out, "server");
+    ntpFormatIPAddress (&event.info.serverAddr, address, sizeof (address));
+    written += out.write ((const uint8_t*)"\"", 1);
+    written += out.write ((const uint8_t*)address, strlen (address));
+    written += out.write ((const uint8_t*)"\"", 1);
+    written += writeKey (out, "port");
+    written += writeInt64 (out, event.info.port);
+    written += writeKey (out, "offset_ns");
+    written += writeInt64 (out, toNanoseconds (event.info.offset, INT64_MIN, INT64_MAX));
+    written += writeKey (out, "delay_ns");
+    written += writeInt64 (out, toNanoseconds (event.info.delay, INT64_MIN, INT64_MAX));
+    written += writeKey (out, "dispersion_ns");
+    written += writeInt64 (out, toNanoseconds (event.info.dispersion, INT64_MIN, INT64_MAX));
+    written += writeKey (out, "retrials");
+    written += writeInt64 (out, event.info.retrials);
+    written += out.write ((const uint8_t*)"}", 1);
+    return written;
+}
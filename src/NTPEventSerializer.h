@@ -0,0 +1,72 @@
+/**
+  * @file NTPEventSerializer.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Allocation free binary and JSON encoders for NTP events
+  */
+
+#ifndef _NtpEventSerializer_h
+#define _NtpEventSerializer_h
+
+#include <Arduino.h>
+#include "NTPEventTypes.h"
+
+constexpr uint8_t NTP_EVENT_RECORD_VERSION = 1; ///< @brief Binary event record layout version
+constexpr size_t NTP_EVENT_RECORD_SIZE = 48; ///< @brief Binary event record length in bytes
+constexpr size_t IP_ADDRESS_STR_LENGTH = 46; ///< @brief Buffer length enough for any IPv4 or IPv6 address text
+
+/**
+  * @brief Gets event code name
+  * @param event Event code
+  * @return Name like `timeSyncd`
+  */
+const char* ntpEventName (NTPSyncEventType_t event);
+
+/**
+  * @brief Formats an IP address without using `String`
+  * @param address Address to format
+  * @param buffer Output buffer. `IP_ADDRESS_STR_LENGTH` bytes are always enough
+  * @param length Output buffer size
+  * @return Output buffer
+  */
+char* ntpFormatIPAddress (const ip_addr_t* address, char* buffer, size_t length);
+
+/**
+  * @brief Formats an IP address without using `String`
+  * @param address Address to format. IPv4 only if core `IPAddress` does not support IPv6
+  * @param buffer Output buffer. `IP_ADDRESS_STR_LENGTH` bytes are always enough
+  * @param length Output buffer size
+  * @return Output buffer
+  */
+char* ntpFormatIPAddress (const IPAddress& address, char* buffer, size_t length);
+
+/**
+  * @brief Encodes an event as a fixed size little endian record. Layout, by byte offset:
+  * - 0: record version, `NTP_EVENT_RECORD_VERSION`
+  * - 1: event code, signed
+  * - 2: server port, uint16
+  * - 4: retrials, uint16
+  * - 6: address family. 0 none, 4 IPv4, 6 IPv6
+  * - 7: reserved, 0
+  * - 8: uptime when event was generated in microseconds, uint64
+  * - 16: offset in nanoseconds, int64
+  * - 24: delay in nanoseconds, int32, saturated
+  * - 28: dispersion in nanoseconds, uint32, saturated
+  * - 32: server address, 16 bytes. IPv4 uses first 4
+  * @param event Event to encode
+  * @param buffer Output buffer, `NTP_EVENT_RECORD_SIZE` bytes long
+  * @return Number of bytes written, `NTP_EVENT_RECORD_SIZE`
+  */
+size_t ntpEventToRecord (const NTPEvent_t& event, uint8_t* buffer);
+
+/**
+  * @brief Writes an event as a single line JSON object to a stream, without building it in memory. Time values
+  * are integer nanoseconds so no floating point formatting is needed
+  * @param event Event to write
+  * @param out Destination, like `Serial` or a network client
+  * @return Number of bytes written
+  */
+size_t ntpEventToJson (const NTPEvent_t& event, Print& out);
+
+#endif // _NtpEventSerializer_h
@@ -7,6 +7,10 @@
 #include <ESP8266WiFi.h>
 #endif
 
+extern "C" {
+#include "lwip/ip_addr.h"
+}
+
 /**
   * @brief NTP event codes
   */
@@ -18,12 +22,24 @@ typedef enum {
     requestSent = 1, /**< NTP request sent, waiting for response */
     partlySync = 2, /**< Successful sync but offset was over threshold */
     syncNotNeeded = 3, /**< Successful sync but offset was under minimum threshold */
+    syncTraced = 4, /**< Sync cycle finished. `offset` is cycle duration, `delay` time waiting for response, both in seconds, `retrials` is cycle number. Needs `NTP_SYNC_TRACE` */
     errorSending = -4, /**< An error happened while sending the request */
     responseError = -5, /**< Wrong response received */
     syncError = -6, /**< Error adjusting time */
     accuracyError = -7 /**< NTP server time is not accurate enough */
 } NTPSyncEventType_t;
 
+constexpr uint16_t NTP_ALL_EVENTS = 0xFFFF; ///< @brief Event mask to subscribe to every event
+
+/**
+  * @brief Gets subscription mask bit of an event. Event codes go from -8 to 7
+  * @param event Event code
+  * @return Mask with event bit set
+  */
+constexpr uint16_t ntpEventMask (NTPSyncEventType_t event) {
+    return (uint16_t)(1 << ((int)event + 8));
+}
+
 /**
   * @brief NTP event info
   */
@@ -31,7 +47,8 @@ typedef struct {
     double offset = 0.0; /**< Last offset applied */
     double delay = 0.0; /**< Last calculates round trip delay to NTP server */
     float dispersion = 0.0;
-    IPAddress serverAddress; /**< NTP server IP address */
+    IPAddress serverAddress; /**< NTP server IP address. IPv6 addresses are only available if core IPAddress supports them */
+    ip_addr_t serverAddr = {}; /**< NTP server address, IPv4 or IPv6 on any core */
     unsigned int port = 0; /**< NTP port used */
     unsigned int retrials = 0; /**< Number of resync retrials until time was got with required accuracy */
 } NTPSyncEventInfo_t;
@@ -42,6 +59,8 @@ typedef struct {
 typedef struct {
     NTPSyncEventType_t event; /**< Event code */
     NTPSyncEventInfo_t info; /**< Event related information */
+    uint64_t uptimeUs = 0; /**< Uptime when event was generated, in microseconds. Deferred events are delivered later */
+    timeval time = {}; /**< Wall clock time when event was generated */
 } NTPEvent_t;
 
 #endif // _NtpEventTypes_h
@@ -0,0 +1,267 @@
+#include "NTPPacketCapture.h"
+
+constexpr uint32_t PCAPNG_SECTION_HEADER = 0x0A0D0D0A; ///< @brief Section Header Block type
+constexpr uint32_t PCAPNG_INTERFACE_DESCRIPTION = 0x00000001; ///< @brief Interface Description Block type
+constexpr uint32_t PCAPNG_ENHANCED_PACKET = 0x00000006; ///< @brief Enhanced Packet Block type
+constexpr uint32_t PCAPNG_BYTE_ORDER_MAGIC = 0x1A2B3C4D; ///< @brief Byte order magic
+constexpr uint16_t PCAPNG_OPT_COMMENT = 1; ///< @brief Comment option code
+constexpr uint16_t PCAPNG_OPT_EPB_FLAGS = 2; ///< @brief Packet flags option code. Bits 0-1 are direction
+constexpr auto PCAPNG_BLOCK_BUFFER = 256; ///< @brief Enough for any packet block
+
+/**
+  * @brief Writes a 16 bit little endian value
+  * @param out Output position
+  * @param value Value
+  * @return Position after value
+  */
+static uint8_t* putLe16 (uint8_t* out, uint16_t value) {
+    out[0] = value;
+    out[1] = value >> 8;
+    return out + 2;
+}
+
+/**
+  * @brief Writes a 32 bit little endian value
+  * @param out Output position
+  * @param value Value
+  * @return Position after value
+  */
+static uint8_t* putLe32 (uint8_t* out, uint32_t value) {
+    out = putLe16 (out, value);
+    return putLe16 (out, value >> 16);
+}
+
+/**
+  * @brief Writes a 16 bit big endian value, as IP headers use
+  * @param out Output position
+  * @param value Value
+  * @return Position after value
+  */
+static uint8_t* putBe16 (uint8_t* out, uint16_t value) {
+    out[0] = value >> 8;
+    out[1] = value;
+    return out + 2;
+}
+
+/**
+  * @brief Adds bytes to an Internet checksum
+  * @param sum Running sum
+  * @param data Bytes
+  * @param length Number of bytes
+  * @return New running sum
+  */
+static uint32_t checksumAdd (uint32_t sum, const uint8_t* data, size_t length) {
+    for (size_t i = 0; i + 1 < length; i += 2) {
+        sum += (data[i] << 8) | data[i + 1];
+    }
+    if (length & 1) {
+        sum += data[length - 1] << 8;
+    }
+    return sum;
+}
+
+/**
+  * @brief Folds a running sum into final Internet checksum
+  * @param sum Running sum
+  * @return Checksum
+  */
+static uint16_t checksumFold (uint32_t sum) {
+    while (sum >> 16) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return ~sum;
+}
+
+/**
+  * @brief Converts lwIP address to raw bytes
+  * @param address lwIP address. May be `NULL`
+  * @param raw Output, 16 bytes. IPv4 uses first 4
+  * @return IP version, or 0 if address is `NULL` or any
+  */
+static uint8_t addressToRaw (const ip_addr_t* address, uint8_t* raw) {
+    memset (raw, 0, 16);
+    if (!address || ip_addr_isany (address)) {
+        return 0;
+    }
+#if LWIP_IPV6
+    if (IP_IS_V6 (address)) {
+        memcpy (raw, ip_2_ip6 (address)->addr, 16);
+        return 6;
+    }
+#endif // LWIP_IPV6
+    uint32_t ip4 = ip4_addr_get_u32 (ip_2_ip4 (address));
+    memcpy (raw, &ip4, 4);
+    return 4;
+}
+
+uint32_t NTPPacketCapture::claimSlot () {
+#ifdef ESP32
+    return __atomic_fetch_add (&writeIndex, 1, __ATOMIC_RELAXED);
+#else
+    uint32_t savedPS = xt_rsil (15);
+    uint32_t slot = writeIndex++;
+    xt_wsr_ps (savedPS);
+    return slot;
+#endif
+}
+
+void NTPPacketCapture::capture (NTPCaptureDirection_t direction, const uint8_t* data, size_t length,
+                                const ip_addr_t* local, uint16_t localPort, const ip_addr_t* remote, uint16_t remotePort,
+                                uint64_t uptimeUs, const timeval* wall) {
+    if (!enabled || !data) {
+        return;
+    }
+    uint32_t slot = claimSlot ();
+    NTPCaptureRecord_t& record = records[slot % NTP_CAPTURE_RING_SIZE];
+    uint32_t lap = slot / NTP_CAPTURE_RING_SIZE;
+    
+    // Sequence comes from claimed slot, not from previous value. Writers that lapped each other never leave it
+    // even while writing, and export can tell which packet a slot holds
+    record.sequence = 2 * lap + 1;
+    __sync_synchronize ();
+    record.direction = direction;
+    record.ipVersion = addressToRaw (remote, record.remoteAddress);
+    if (addressToRaw (local, record.localAddress) != record.ipVersion) {
+        memset (record.localAddress, 0, sizeof (record.localAddress));
+    }
+    record.localPort = localPort;
+    record.remotePort = remotePort;
+    record.length = length;
+    record.captured = length < NTP_CAPTURE_SNAPLEN ? length : NTP_CAPTURE_SNAPLEN;
+    memcpy (record.payload, data, record.captured);
+    record.uptimeUs = uptimeUs;
+    record.wall = *wall;
+    __sync_synchronize ();
+    record.sequence = 2 * lap + 2;
+}
+
+size_t NTPPacketCapture::writePacketBlock (Print& out, const NTPCaptureRecord_t& record, const uint8_t* local) {
+    uint8_t block[PCAPNG_BLOCK_BUFFER];
+    uint8_t* packet = block + 28; // After block header and Enhanced Packet Block fixed fields
+    uint8_t* udp;
+    size_t ipHeaderLength = record.ipVersion == 6 ? 40 : 20;
+    uint16_t udpLength = 8 + record.length;
+    const uint8_t* source = record.direction == captureSent ? local : record.remoteAddress;
+    const uint8_t* destination = record.direction == captureSent ? record.remoteAddress : local;
+    
+    memset (packet, 0, ipHeaderLength + 8);
+    if (record.ipVersion == 6) {
+        packet[0] = 0x60;
+        putBe16 (packet + 4, udpLength);
+        packet[6] = 17; // UDP
+        packet[7] = 64; // Hop limit
+        memcpy (packet + 8, source, 16);
+        memcpy (packet + 24, destination, 16);
+    } else {
+        packet[0] = 0x45;
+        putBe16 (packet + 2, 20 + udpLength);
+        packet[6] = 0x40; // Don't fragment
+        packet[8] = 64; // TTL
+        packet[9] = 17; // UDP
+        memcpy (packet + 12, source, 4);
+        memcpy (packet + 16, destination, 4);
+        putBe16 (packet + 10, checksumFold (checksumAdd (0, packet, 20)));
+    }
+    udp = packet + ipHeaderLength;
+    putBe16 (udp, record.direction == captureSent ? record.localPort : record.remotePort);
+    putBe16 (udp + 2, record.direction == captureSent ? record.remotePort : record.localPort);
+    putBe16 (udp + 4, udpLength);
+    memcpy (udp + 8, record.payload, record.captured);
+    if (record.ipVersion == 6 && record.captured == record.length) {
+        // Checksum is mandatory on IPv6. Pseudo header is addresses, length and next header
+        uint32_t sum = checksumAdd (0, packet + 8, 32);
+        sum += udpLength + 17;
+        sum = checksumAdd (sum, udp, udpLength);
+        uint16_t checksum = checksumFold (sum);
+        putBe16 (udp + 6, checksum ? checksum : 0xFFFF);
+    }
+    
+    size_t capturedLength = ipHeaderLength + 8 + record.captured;
+    uint8_t* p = packet + ((capturedLength + 3) & ~3);
+    memset (packet + capturedLength, 0, p - packet - capturedLength);
+    
+    // Options: direction flags, monotonic time comment and end of options
+    p = putLe16 (p, PCAPNG_OPT_EPB_FLAGS);
+    p = putLe16 (p, 4);
+    p = putLe32 (p, record.direction == captureSent ? 2 : 1);
+    char comment[32];
+    int commentLength;
+    if (record.uptimeUs < 1000000) {
+        commentLength = snprintf (comment, sizeof (comment), "uptime_us=%lu", (unsigned long)record.uptimeUs);
+    } else { // No 64 bit printf support on every core
+        commentLength = snprintf (comment, sizeof (comment), "uptime_us=%lu%06lu",
+                                  (unsigned long)(record.uptimeUs / 1000000), (unsigned long)(record.uptimeUs % 1000000));
+    }
+    p = putLe16 (p, PCAPNG_OPT_COMMENT);
+    p = putLe16 (p, commentLength);
+    memcpy (p, comment, commentLength);
+    memset (p + commentLength, 0, 3);
+    p += (commentLength + 3) & ~3;
+    p = putLe32 (p, 0);
+    
+    uint32_t blockLength = p - block + 4;
+    uint64_t timestamp = (uint64_t)record.wall.tv_sec * 1000000 + record.wall.tv_usec;
+    putLe32 (block, PCAPNG_ENHANCED_PACKET);
+    putLe32 (block + 4, blockLength);
+    putLe32 (block + 8, 0); // Interface
+    putLe32 (block + 12, timestamp >> 32);
+    putLe32 (block + 16, timestamp);
+    putLe32 (block + 20, capturedLength);
+    putLe32 (block + 24, ipHeaderLength + udpLength);
+    putLe32 (p, blockLength);
+    return out.write (block, blockLength);
+}
+
+size_t NTPPacketCapture::writePcapng (Print& out) {
+    uint8_t header[48];
+    uint8_t* p = header;
+    size_t written;
+    
+    // Section Header Block, version 1.0, unknown section length
+    p = putLe32 (p, PCAPNG_SECTION_HEADER);
+    p = putLe32 (p, 28);
+    p = putLe32 (p, PCAPNG_BYTE_ORDER_MAGIC);
+    p = putLe16 (p, 1);
+    p = putLe16 (p, 0);
+    p = putLe32 (p, 0xFFFFFFFF);
+    p = putLe32 (p, 0xFFFFFFFF);
+    p = putLe32 (p, 28);
+    // Interface Description Block. Default timestamp resolution is microseconds
+    p = putLe32 (p, PCAPNG_INTERFACE_DESCRIPTION);
+    p = putLe32 (p, 20);
+    p = putLe16 (p, NTP_PCAP_LINKTYPE_RAW);
+    p = putLe16 (p, 0);
+    p = putLe32 (p, 0); // No snap length limit
+    p = putLe32 (p, 20);
+    written = out.write (header, p - header);
+    
+    uint32_t last = writeIndex;
+    uint32_t first = last > NTP_CAPTURE_RING_SIZE ? last - NTP_CAPTURE_RING_SIZE : 0;
+    uint8_t local4[16] = { 0 };
+    uint8_t local6[16] = { 0 };
+    
+    // Requests are sent before lwIP tells which local address it used. Take it from received packets
+    for (uint32_t i = first; i < last; i++) {
+        const NTPCaptureRecord_t& record = records[i % NTP_CAPTURE_RING_SIZE];
+        if (record.direction == captureReceived) {
+            memcpy (record.ipVersion == 6 ? local6 : local4, record.localAddress, 16);
+        }
+    }
+    for (uint32_t i = first; i < last; i++) {
+        NTPCaptureRecord_t record;
+        const NTPCaptureRecord_t& slot = records[i % NTP_CAPTURE_RING_SIZE];
+        uint32_t sequence = slot.sequence;
+        __sync_synchronize ();
+        memcpy (&record, (const void*)&slot, sizeof (NTPCaptureRecord_t));
+        __sync_synchronize ();
+        if (sequence != 2 * (i / NTP_CAPTURE_RING_SIZE) + 2 || sequence != slot.sequence || !record.ipVersion) {
+            continue; // Being written or already replaced by a newer packet
+        }
+        bool hasLocal = false;
+        for (uint8_t j = 0; j < 16; j++) {
+            hasLocal |= record.localAddress[j] != 0;
+        }
+        written += writePacketBlock (out, record, hasLocal ? record.localAddress : (record.ipVersion == 6 ? local6 : local4));
+    }
+    return written;
+}
@@ -0,0 +1,125 @@
+/**
+  * @file NTPPacketCapture.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Ring of last raw NTP packets, exportable as pcapng for offline analysis and replay
+  */
+
+#ifndef _NtpPacketCapture_h
+#define _NtpPacketCapture_h
+
+#include <Arduino.h>
+
+extern "C" {
+#include "lwip/ip_addr.h"
+#include "sys/time.h"
+}
+
+constexpr auto NTP_CAPTURE_RING_SIZE = 8; ///< @brief Number of packets kept
+constexpr auto NTP_CAPTURE_SNAPLEN = 68; ///< @brief Bytes kept of every UDP payload. NTP header plus one MAC
+constexpr uint16_t NTP_PCAP_LINKTYPE_RAW = 101; ///< @brief pcap link type for packets that begin with an IPv4 or IPv6 header
+
+/**
+  * @brief Captured packet direction
+  */
+typedef enum : uint8_t {
+    captureReceived, ///< @brief Packet got from network
+    captureSent ///< @brief Packet handed to lwIP for sending
+} NTPCaptureDirection_t;
+
+/**
+  * @brief Captured packet
+  */
+typedef struct {
+    volatile uint32_t sequence; ///< @brief `2 * lap + 1` while record is being written, `2 * lap + 2` when done. Lap is packet number divided by `NTP_CAPTURE_RING_SIZE`
+    NTPCaptureDirection_t direction; ///< @brief Packet direction
+    uint8_t ipVersion; ///< @brief 4 or 6
+    uint8_t captured; ///< @brief Bytes stored in `payload`
+    uint16_t length; ///< @brief Original UDP payload length
+    uint16_t localPort; ///< @brief Local UDP port
+    uint16_t remotePort; ///< @brief Remote UDP port
+    uint8_t localAddress[16]; ///< @brief Local address, network order. All zero if unknown
+    uint8_t remoteAddress[16]; ///< @brief Remote address, network order
+    uint64_t uptimeUs; ///< @brief Monotonic time of capture, in microseconds
+    timeval wall; ///< @brief System time of capture
+    uint8_t payload[NTP_CAPTURE_SNAPLEN]; ///< @brief UDP payload
+} NTPCaptureRecord_t;
+
+/**
+  * @brief Keeps last sent and received NTP packets with their timestamps. Capture is a copy into a preallocated
+  * slot so it is cheap enough for lwIP callbacks. Export builds IP and UDP headers around every payload and writes
+  * a pcapng stream that Wireshark and the replay tool can read. Monotonic time goes in every packet comment
+  */
+class NTPPacketCapture {
+public:
+    /**
+      * @brief Enables or disables capture. Ring contents are kept
+      * @param enable `true` to capture packets
+      */
+    void setEnabled (bool enable) {
+        enabled = enable;
+    }
+
+    /**
+      * @brief Checks if capture is enabled
+      * @return `true` if packets are being captured
+      */
+    bool isEnabled () const {
+        return enabled;
+    }
+
+    /**
+      * @brief Stores a packet. Safe from lwIP callbacks and tasks
+      * @param direction Packet direction
+      * @param data UDP payload
+      * @param length Payload length
+      * @param local Local address. May be `NULL` or any if unknown
+      * @param localPort Local UDP port
+      * @param remote Remote address
+      * @param remotePort Remote UDP port
+      * @param uptimeUs Monotonic time in microseconds
+      * @param wall System time
+      */
+    void capture (NTPCaptureDirection_t direction, const uint8_t* data, size_t length,
+                  const ip_addr_t* local, uint16_t localPort, const ip_addr_t* remote, uint16_t remotePort,
+                  uint64_t uptimeUs, const timeval* wall);
+
+    /**
+      * @brief Gets number of packets captured since boot
+      * @return Packet count. Only last `NTP_CAPTURE_RING_SIZE` are kept
+      */
+    uint32_t getCaptured () const {
+        return writeIndex;
+    }
+
+    /**
+      * @brief Writes captured packets, oldest first, as a pcapng stream with `LINKTYPE_RAW` interface.
+      * Records being written while exporting are skipped
+      * @param out Output stream, like `Serial` or a `File`
+      * @return Number of bytes written
+      */
+    size_t writePcapng (Print& out);
+
+protected:
+    NTPCaptureRecord_t records[NTP_CAPTURE_RING_SIZE] = {}; ///< @brief Packet ring
+    volatile uint32_t writeIndex = 0; ///< @brief Number of slots claimed. Next slot is `writeIndex % NTP_CAPTURE_RING_SIZE`
+    bool enabled = false; ///< @brief Capture enabled
+
+    /**
+      * @brief Claims next ring slot
+      * @return Claimed packet number
+      */
+    uint32_t claimSlot ();
+
+    /**
+      * @brief Writes one Enhanced Packet Block
+      * @param out Output stream
+      * @param record Packet to write
+      * @param local Local address to use if record has none
+      * @return Number of bytes written
+      */
+    static size_t writePacketBlock (Print& out, const NTPCaptureRecord_t& record, const uint8_t* local);
+};
+
+#endif // _NtpPacketCapture_h
@@ -0,0 +1,430 @@
+/**
+  * @file NTPTimeFormat.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Time formatting with layout fixed at compile time. No format parsing and no allocation
+  */
+
+#ifndef _NtpTimeFormat_h
+#define _NtpTimeFormat_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include "NTPTimeZone.h"
+
+constexpr auto TIME_CACHE_STR_LENGTH = 35; ///< @brief Size of cached seconds part and zone suffix of a time string
+constexpr auto MAX_TIME_STR_LENGTH = 64; ///< @brief Maximum length of a time string rendered into a caller buffer, including time zone
+
+/**
+  * @brief Two ASCII digits for every number 0..99
+  */
+constexpr char NTP_DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/**
+  * @brief Output length of a layout character
+  * @param field Layout character. `Y` year, `m` month, `d` day, `H` hour, `M` minute, `S` second,
+  * `l` milliseconds, `u` microseconds, `z` UTC offset as `+hh:mm`, `Z` UTC offset as `Z` or `+hh:mm`.
+  * Any other character is copied as is
+  * @return Number of characters written for this field
+  */
+constexpr size_t ntpLayoutFieldLength (char field) {
+    return field == 'Y' ? 4 :
+           field == 'u' ? 6 :
+           field == 'l' ? 3 :
+           field == 'z' ? 6 :
+           field == 'Z' ? 6 :
+           (field == 'm' || field == 'd' || field == 'H' || field == 'M' || field == 'S') ? 2 : 1;
+}
+
+/**
+  * @brief Writes two digits from table
+  * @param out Output position
+  * @param value Number 0..99
+  */
+inline void ntpWrite2Digits (char* out, uint32_t value) {
+    memcpy (out, NTP_DIGIT_PAIRS + 2 * value, 2);
+}
+
+/**
+  * @brief Writes UTC offset as `+hh:mm`
+  * @param out Output position
+  * @param offset Offset in seconds
+  */
+inline void ntpWriteUtcOffset (char* out, int32_t offset) {
+    out[0] = offset < 0 ? '-' : '+';
+    if (offset < 0) {
+        offset = -offset;
+    }
+    offset /= 60;
+    ntpWrite2Digits (out + 1, (offset / 60) % 100);
+    out[3] = ':';
+    ntpWrite2Digits (out + 4, offset % 60);
+}
+
+/**
+  * @brief Writes one layout field. Switch is resolved at compile time
+  * @tparam field Layout character
+  * @param out Output position
+  * @param t Time fields
+  * @return Number of characters written
+  */
+template <char field>
+inline size_t ntpWriteField (char* out, const NTPTimeFields_t& t) {
+    switch (field) {
+    case 'Y':
+        ntpWrite2Digits (out, (t.year / 100) % 100);
+        ntpWrite2Digits (out + 2, t.year % 100);
+        break;
+    case 'm':
+        ntpWrite2Digits (out, t.month);
+        break;
+    case 'd':
+        ntpWrite2Digits (out, t.day);
+        break;
+    case 'H':
+        ntpWrite2Digits (out, t.hour);
+        break;
+    case 'M':
+        ntpWrite2Digits (out, t.minute);
+        break;
+    case 'S':
+        ntpWrite2Digits (out, t.second);
+        break;
+    case 'l':
+        out[0] = '0' + t.usec / 100000;
+        ntpWrite2Digits (out + 1, (t.usec / 1000) % 100);
+        break;
+    case 'u':
+        ntpWrite2Digits (out, t.usec / 10000);
+        ntpWrite2Digits (out + 2, (t.usec / 100) % 100);
+        ntpWrite2Digits (out + 4, t.usec % 100);
+        break;
+    case 'z':
+        ntpWriteUtcOffset (out, t.utcOffset);
+        break;
+    case 'Z':
+        if (t.utcOffset == 0) {
+            out[0] = 'Z';
+            return 1;
+        }
+        ntpWriteUtcOffset (out, t.utcOffset);
+        break;
+    default:
+        out[0] = field;
+        break;
+    }
+    return ntpLayoutFieldLength (field);
+}
+
+/**
+  * @brief Time layout defined by a list of characters, see `ntpLayoutFieldLength()` for field codes
+  * @tparam layout Layout characters
+  */
+template <char... layout>
+struct NTPTimeLayout;
+
+/**
+  * @brief Empty layout, ends recursion
+  */
+template <>
+struct NTPTimeLayout<> {
+    static constexpr size_t maxLength = 0; ///< @brief Maximum output length, without null terminator
+
+    /**
+      * @brief Writes nothing
+      * @return 0
+      */
+    static size_t write (char*, const NTPTimeFields_t&) {
+        return 0;
+    }
+};
+
+template <char field, char... rest>
+struct NTPTimeLayout<field, rest...> {
+    static constexpr size_t maxLength = ntpLayoutFieldLength (field) + NTPTimeLayout<rest...>::maxLength; ///< @brief Maximum output length, without null terminator
+
+    /**
+      * @brief Writes layout without null terminator
+      * @param out Output buffer, at least `maxLength` long
+      * @param t Time fields
+      * @return Number of characters written
+      */
+    static size_t write (char* out, const NTPTimeFields_t& t) {
+        size_t written = ntpWriteField<field> (out, t);
+        return written + NTPTimeLayout<rest...>::write (out + written, t);
+    }
+
+    /**
+      * @brief Renders time into a buffer. Result is always null terminated and truncated if it does not fit
+      * @param buffer Output buffer
+      * @param length Output buffer size
+      * @param t Time fields
+      * @return Length of complete string. Result was truncated if it is `length` or more
+      */
+    static size_t format (char* buffer, size_t length, const NTPTimeFields_t& t) {
+        if (length > maxLength) {
+            size_t written = write (buffer, t);
+            buffer[written] = '\0';
+            return written;
+        }
+        char temp[maxLength + 1];
+        size_t written = write (temp, t);
+        if (buffer && length) {
+            size_t copied = written < length ? written : length - 1;
+            memcpy (buffer, temp, copied);
+            buffer[copied] = '\0';
+        }
+        return written;
+    }
+};
+
+/**
+  * @brief Fills time fields from broken down time
+  * @param local_tm Local broken down time
+  * @param usec Microseconds
+  * @param utc UNIX time `local_tm` was calculated from, used to get UTC offset
+  * @return Time fields
+  */
+inline NTPTimeFields_t ntpTimeFields (const tm& local_tm, uint32_t usec, time_t utc) {
+    NTPTimeFields_t t;
+    t.year = local_tm.tm_year + 1900;
+    t.month = local_tm.tm_mon + 1;
+    t.day = local_tm.tm_mday;
+    t.hour = local_tm.tm_hour;
+    t.minute = local_tm.tm_min;
+    t.second = local_tm.tm_sec;
+    t.usec = usec;
+    // Local time as seconds since epoch, minus UTC
+    int64_t local = (int64_t)NTPTimeZone::daysFromCivil (t.year, t.month, t.day) * SECS_PER_DAY_TZ + t.hour * 3600 + t.minute * 60 + t.second;
+    t.utcOffset = (int32_t)(local - (int64_t)utc);
+    return t;
+}
+
+/**
+  * @brief Renders local time into a caller supplied buffer with `localtime_r()` and `strftime()`. It uses no shared
+  * state or heap, so any thread may call it. Result is always null terminated and truncated if it does not fit
+  * @param buffer Destination buffer
+  * @param length Destination buffer size
+  * @param moment UNIX time to render
+  * @param usec Microseconds to append after seconds part. Negative value to omit them
+  * @param format Format as strftime
+  * @param withZone Append time zone abbreviation
+  * @return Length of complete string, without null terminator. Result was truncated if it is `length` or more
+  */
+inline size_t ntpFormatLocalTime (char* buffer, size_t length, time_t moment, long usec, const char* format, bool withZone) {
+    char temp[MAX_TIME_STR_LENGTH];
+    tm local_tm;
+    size_t index;
+    
+    localtime_r (&moment, &local_tm);
+    // strftime gives no hint about needed length, so render on a temporary buffer and measure it
+    index = strftime (temp, sizeof (temp), format, &local_tm);
+    if (usec >= 0 && index < sizeof (temp)) {
+        int written = snprintf (temp + index, sizeof (temp) - index, ".%06ld", usec);
+        if (written > 0) {
+            index += written;
+        }
+    }
+    if (withZone && index < sizeof (temp)) {
+        index += strftime (temp + index, sizeof (temp) - index, " %Z", &local_tm);
+    }
+    if (index >= sizeof (temp)) {
+        index = sizeof (temp) - 1;
+    }
+    
+    if (buffer && length) {
+        size_t copied = index < length ? index : length - 1;
+        memcpy (buffer, temp, copied);
+        buffer[copied] = '\0';
+    }
+    return index;
+}
+
+/**
+  * @brief Renders uptime as `ddd days hh:mm:ss`. Days part is only rendered again when day changes, and nothing is
+  * rendered while second does not change. Uptime is 64 bit, so it does not depend on `millis()` wrapping
+  */
+class NTPUptimeFormatter {
+public:
+    /**
+      * @brief Renders uptime
+      * @param uptimeUs Time since boot in microseconds
+      * @return Rendered string. It is overwritten by next call
+      */
+    char* render (uint64_t uptimeUs) {
+        uint64_t uptime = uptimeUs / 1000000;
+
+        if (uptime == renderedSeconds && str[0]) {
+            return str;
+        }
+        uint32_t days = (uint32_t)(uptime / SECS_PER_DAY_TZ);
+        uint32_t secondOfDay = (uint32_t)(uptime - (uint64_t)days * SECS_PER_DAY_TZ);
+
+        if (!str[0] || days != renderedDays) {
+            int written = snprintf (str, sizeof (str), "%4lu days ", (unsigned long)days);
+            daysLength = written > 0 && (size_t)written < sizeof (str) - 9 ? written : sizeof (str) - 9;
+            renderedDays = days;
+        }
+        char* timePart = str + daysLength;
+        ntpWrite2Digits (timePart, secondOfDay / 3600);
+        timePart[2] = ':';
+        ntpWrite2Digits (timePart + 3, secondOfDay / 60 % 60);
+        timePart[5] = ':';
+        ntpWrite2Digits (timePart + 6, secondOfDay % 60);
+        timePart[8] = '\0';
+        renderedSeconds = uptime;
+
+        return str;
+    }
+
+protected:
+    uint64_t renderedSeconds = 0;   ///< @brief Uptime in seconds rendered in `str`
+    uint32_t renderedDays = 0;      ///< @brief Days part rendered in `str`
+    size_t daysLength = 0;          ///< @brief Length of days part of `str`, including trailing space
+    char str[TIME_CACHE_STR_LENGTH] = ""; ///< @brief Last rendered uptime string
+};
+
+/**
+  * @brief Cache of last broken down local time, its layout fields and last rendered time string without
+  * microseconds. Time zone rules are evaluated at most once per second, and `strftime()` runs at most once per
+  * second and format.
+  * Not thread safe, every user needs its own instance
+  */
+class NTPLocalTimeCache {
+public:
+    /**
+      * @brief Gets broken down local time. Compiled time zone rules are used if they are valid, `localtime_r()`
+      * otherwise
+      * @param moment UNIX time to convert
+      * @param zone Time zone. It follows process wide rule before conversion
+      * @param generation Cache generation. Cached values are discarded if it differs from the one they were got with
+      * @return Local time. Valid until next call
+      */
+    const tm* localTm (time_t moment, NTPTimeZone& zone, uint32_t generation) {
+        if (!tmValid || moment != tmSecond || tmGeneration != generation) {
+            tmGeneration = generation;
+            zone.followProcessRule ();
+            if (zone.isValid ()) {
+                zone.localTime (moment, &tmCache);
+            } else {
+                localtime_r (&moment, &tmCache);
+            }
+            tmSecond = moment;
+            tmValid = true;
+            fieldsValid = false;
+        }
+        return &tmCache;
+    }
+
+    /**
+      * @brief Gets local time fields for layouts. Fields of the second, UTC offset included, are cached with broken
+      * down time, so a hit only copies them and sets microseconds
+      * @param moment Time to convert
+      * @param zone Time zone, as in `localTm()`
+      * @param generation Cache generation, as in `localTm()`
+      * @return Time fields
+      */
+    NTPTimeFields_t localFields (const timeval& moment, NTPTimeZone& zone, uint32_t generation) {
+        const tm* local_tm = localTm (moment.tv_sec, zone, generation);
+        if (!fieldsValid) {
+            fieldsCache = ntpTimeFields (*local_tm, 0, moment.tv_sec);
+            fieldsValid = true;
+        }
+        NTPTimeFields_t fields = fieldsCache;
+        fields.usec = moment.tv_usec;
+        return fields;
+    }
+
+    /**
+      * @brief Renders a time with microseconds. Consecutive calls within the same second and with same format
+      * only render microseconds
+      * @param buffer Output buffer
+      * @param length Output buffer size
+      * @param moment Time to render
+      * @param format Format as strftime for seconds part. Compared by address
+      * @param withZone Append time zone abbreviation
+      * @param zone Time zone, as in `localTm()`
+      * @param generation Cache generation, as in `localTm()`
+      * @return `buffer`
+      */
+    char* renderUs (char* buffer, size_t length, const timeval& moment, const char* format, bool withZone,
+                    NTPTimeZone& zone, uint32_t generation) {
+        if (format != strFormat || moment.tv_sec != strSecond || strGeneration != generation) {
+            const tm* local_tm = localTm (moment.tv_sec, zone, generation);
+            prefixLength = strftime (prefix, sizeof (prefix), format, local_tm);
+            strftime (zoneSuffix, sizeof (zoneSuffix), " %Z", local_tm);
+            strFormat = format;
+            strSecond = moment.tv_sec;
+            strGeneration = generation;
+        }
+        if (!buffer || !length) {
+            return buffer;
+        }
+        size_t index = prefixLength < length ? prefixLength : length - 1;
+        memcpy (buffer, prefix, index);
+        if (moment.tv_usec >= 0 && moment.tv_usec < 1000000 && length - index > 7) {
+            uint32_t usec = moment.tv_usec;
+            buffer[index] = '.';
+            ntpWrite2Digits (buffer + index + 1, usec / 10000);
+            ntpWrite2Digits (buffer + index + 3, (usec / 100) % 100);
+            ntpWrite2Digits (buffer + index + 5, usec % 100);
+            index += 7;
+            buffer[index] = '\0';
+        } else {
+            index += snprintf (buffer + index, length - index, ".%06ld", (long)moment.tv_usec);
+        }
+        if (withZone && index < length) {
+            strncpy (buffer + index, zoneSuffix, length - index);
+            buffer[length - 1] = '\0';
+        }
+        return buffer;
+    }
+
+protected:
+    uint32_t tmGeneration = 0;  ///< @brief Generation `tmCache` was calculated with
+    time_t tmSecond = 0;        ///< @brief UNIX time `tmCache` belongs to
+    tm tmCache;                 ///< @brief Last broken down local time
+    bool tmValid = false;       ///< @brief Is there anything in `tmCache`?
+    NTPTimeFields_t fieldsCache;    ///< @brief Fields of `tmCache`, without microseconds
+    bool fieldsValid = false;       ///< @brief Is `fieldsCache` calculated from current `tmCache`?
+    const char* strFormat = NULL;   ///< @brief Format used to render `prefix`. `NULL` if cache is empty
+    uint32_t strGeneration = 0;     ///< @brief Generation `prefix` was rendered with
+    time_t strSecond = 0;           ///< @brief UNIX time `prefix` belongs to
+    size_t prefixLength = 0;        ///< @brief Length of `prefix`
+    char prefix[TIME_CACHE_STR_LENGTH];     ///< @brief Last rendered time string without microseconds
+    char zoneSuffix[TIME_CACHE_STR_LENGTH]; ///< @brief Time zone suffix that goes with `prefix`
+};
+
+/// @brief ISO 8601 extended format with UTC offset: `2021-12-29T18:30:05+01:00`
+typedef NTPTimeLayout<'Y', '-', 'm', '-', 'd', 'T', 'H', ':', 'M', ':', 'S', 'z'> NTPFormatISO8601;
+/// @brief RFC 3339 without fraction: `2021-12-29T18:30:05+01:00`, `Z` for UTC
+typedef NTPTimeLayout<'Y', '-', 'm', '-', 'd', 'T', 'H', ':', 'M', ':', 'S', 'Z'> NTPFormatRFC3339;
+/// @brief RFC 3339 with milliseconds: `2021-12-29T18:30:05.123+01:00`
+typedef NTPTimeLayout<'Y', '-', 'm', '-', 'd', 'T', 'H', ':', 'M', ':', 'S', '.', 'l', 'Z'> NTPFormatRFC3339Ms;
+/// @brief RFC 3339 with microseconds: `2021-12-29T18:30:05.123456+01:00`
+typedef NTPTimeLayout<'Y', '-', 'm', '-', 'd', 'T', 'H', ':', 'M', ':', 'S', '.', 'u', 'Z'> NTPFormatRFC3339Us;
+/// @brief Same layout as `getTimeDateString()`: `29/12/2021 18:30:05`
+typedef NTPTimeLayout<'d', '/', 'm', '/', 'Y', ' ', 'H', ':', 'M', ':', 'S'> NTPFormatDefault;
+/// @brief Same layout as `getTimeDateStringUs()`, without zone name: `29/12/2021 18:30:05.123456`
+typedef NTPTimeLayout<'d', '/', 'm', '/', 'Y', ' ', 'H', ':', 'M', ':', 'S', '.', 'u'> NTPFormatDefaultUs;
+/// @brief Same layout as `getTimeDateStringForJS()`: `12/29/2021 18:30:05`
+typedef NTPTimeLayout<'m', '/', 'd', '/', 'Y', ' ', 'H', ':', 'M', ':', 'S'> NTPFormatJS;
+/// @brief Same layout as `getTimeStr(timeval)`: `18:30:05.123456`
+typedef NTPTimeLayout<'H', ':', 'M', ':', 'S', '.', 'u'> NTPFormatTimeUs;
+
+#endif // _NtpTimeFormat_h
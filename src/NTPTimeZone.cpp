@@ -0,0 +1,464 @@
+#include "NTPTimeZone.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#ifdef ESP8266
+#include <Arduino.h> // xt_rsil, xt_wsr_ps
+#endif
+
+#if defined(ESP32) || defined(ESP8266)
+#include <pgmspace.h>
+#else
+#define PROGMEM
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define strcmp_P strcmp
+#define strncpy_P strncpy
+#endif
+
+#include "TZtable.h"
+
+volatile uint32_t NTPTimeZone::processGeneration = 0;
+char NTPTimeZone::processRule[TZ_RULE_LENGTH] = "";
+
+void NTPTimeZone::setProcessRule (const char* tz) {
+    uint32_t generation;
+
+    // Writers take the counter from even to odd, so only one of them changes the rule at a time
+#ifndef ESP8266
+    do {
+        generation = processGeneration;
+    } while ((generation & 1) || !__sync_bool_compare_and_swap (&processGeneration, generation, generation + 1));
+#else
+    // ESP8266 has no compare and swap instruction. Block interrupts while counter is checked and taken instead
+    bool taken;
+    do {
+        uint32_t savedPS = xt_rsil (15);
+        generation = processGeneration;
+        taken = !(generation & 1);
+        if (taken) {
+            processGeneration = generation + 1;
+        }
+        xt_wsr_ps (savedPS);
+    } while (!taken);
+#endif
+    __sync_synchronize ();
+    if (tz) {
+        strncpy (processRule, tz, TZ_RULE_LENGTH - 1);
+        processRule[TZ_RULE_LENGTH - 1] = '\0';
+    } else {
+        processRule[0] = '\0';
+    }
+    __sync_synchronize ();
+    processGeneration = generation + 2;
+}
+
+bool NTPTimeZone::followProcessRule () {
+    char rule[TZ_RULE_LENGTH];
+    uint32_t generation = processGeneration;
+
+    if (generation == followedGeneration) {
+        return false;
+    }
+    do {
+        generation = processGeneration;
+        if (generation & 1) {
+            continue; // Update in progress
+        }
+        __sync_synchronize ();
+        memcpy (rule, processRule, TZ_RULE_LENGTH);
+        __sync_synchronize ();
+    } while ((generation & 1) || generation != processGeneration);
+    followedGeneration = generation;
+    rule[TZ_RULE_LENGTH - 1] = '\0';
+    parse (rule);
+    return true;
+}
+
+int32_t NTPTimeZone::daysFromCivil (int32_t year, uint8_t month, uint8_t day) {
+    // Gregorian calendar on 400 years eras starting in March, so leap day is the last one of each year
+    year -= month <= 2;
+    const int32_t era = (year >= 0 ? year : year - 399) / 400;
+    const uint32_t yoe = (uint32_t)(year - era * 400); // [0, 399]
+    const uint32_t doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1; // [0, 365]
+    const uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy; // [0, 146096]
+    return era * 146097 + (int32_t)doe - 719468;
+}
+
+void NTPTimeZone::civilFromDays (int32_t days, int32_t* year, uint8_t* month, uint8_t* day) {
+    days += 719468;
+    const int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const uint32_t doe = (uint32_t)(days - era * 146097); // [0, 146096]
+    const uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365; // [0, 399]
+    const uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100); // [0, 365]
+    const uint32_t mp = (5 * doy + 2) / 153; // [0, 11]
+    *day = doy - (153 * mp + 2) / 5 + 1;
+    *month = mp < 10 ? mp + 3 : mp - 9;
+    *year = (int32_t)yoe + era * 400 + (*month <= 2);
+}
+
+bool NTPTimeZone::parseName (const char** str, char* name) {
+    const char* p = *str;
+    uint8_t len = 0;
+
+    if (*p == '<') {
+        p++;
+        while (*p && *p != '>') {
+            if (len < TZ_ABBR_LENGTH - 1) {
+                name[len++] = *p;
+            }
+            p++;
+        }
+        if (*p != '>') {
+            return false;
+        }
+        p++;
+    } else {
+        while (isalpha ((unsigned char)*p)) {
+            if (len < TZ_ABBR_LENGTH - 1) {
+                name[len++] = *p;
+            }
+            p++;
+        }
+    }
+    name[len] = '\0';
+    *str = p;
+    return len >= 3;
+}
+
+bool NTPTimeZone::parseTime (const char** str, int32_t* seconds) {
+    const char* p = *str;
+    int32_t sign = 1;
+    int32_t value[3] = { 0, 0, 0 };
+
+    if (*p == '+' || *p == '-') {
+        sign = *p == '-' ? -1 : 1;
+        p++;
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        if (i > 0) {
+            if (*p != ':') {
+                break;
+            }
+            p++;
+        }
+        if (!isdigit ((unsigned char)*p)) {
+            return false;
+        }
+        while (isdigit ((unsigned char)*p)) {
+            value[i] = value[i] * 10 + (*p - '0');
+            if (value[i] > 167) {
+                return false;
+            }
+            p++;
+        }
+    }
+    *seconds = sign * (value[0] * 3600 + value[1] * 60 + value[2]);
+    *str = p;
+    return true;
+}
+
+bool NTPTimeZone::parseRule (const char** str, NTPTZRule_t* rule) {
+    const char* p = *str;
+    char* end;
+
+    memset (rule, 0, sizeof (NTPTZRule_t));
+    if (*p == 'M') {
+        unsigned long field[3];
+        p++;
+        for (uint8_t i = 0; i < 3; i++) {
+            if (i > 0) {
+                if (*p != '.') {
+                    return false;
+                }
+                p++;
+            }
+            field[i] = strtoul (p, &end, 10);
+            if (end == p) {
+                return false;
+            }
+            p = end;
+        }
+        if (field[0] < 1 || field[0] > 12 || field[1] < 1 || field[1] > 5 || field[2] > 6) {
+            return false;
+        }
+        rule->type = monthWeekDay;
+        rule->month = field[0];
+        rule->week = field[1];
+        rule->weekDay = field[2];
+    } else {
+        rule->type = julianLeap;
+        if (*p == 'J') {
+            rule->type = julianNoLeap;
+            p++;
+        }
+        unsigned long day = strtoul (p, &end, 10);
+        if (end == p || day > 365 || (rule->type == julianNoLeap && day < 1)) {
+            return false;
+        }
+        p = end;
+        rule->day = day;
+    }
+    rule->time = TZ_DEFAULT_TRANSITION_TIME;
+    if (*p == '/') {
+        p++;
+        if (!parseTime (&p, &rule->time)) {
+            return false;
+        }
+    }
+    *str = p;
+    return true;
+}
+
+bool NTPTimeZone::parse (const char* tz) {
+    const char* p = tz;
+    int32_t posixOffset;
+
+    valid = false;
+    hasDst = false;
+    stdOffset = dstOffset = 0;
+    strcpy (stdName, "UTC");
+    dstName[0] = '\0';
+    currentStart = 1;
+    currentEnd = 0;
+
+    if (!p) {
+        return false;
+    }
+    if (*p == ':') {
+        return false; // Implementation defined format, not supported
+    }
+    if (!parseName (&p, stdName) || !parseTime (&p, &posixOffset)) {
+        strcpy (stdName, "UTC");
+        return false;
+    }
+    // POSIX offsets are positive west of Greenwich
+    stdOffset = -posixOffset;
+    if (*p == '\0') {
+        valid = true;
+        return true;
+    }
+
+    if (!parseName (&p, dstName)) {
+        return false;
+    }
+    dstOffset = stdOffset + 3600;
+    if (*p && *p != ',') {
+        if (!parseTime (&p, &posixOffset)) {
+            return false;
+        }
+        dstOffset = -posixOffset;
+    }
+    if (*p == ',') {
+        p++;
+        if (!parseRule (&p, &dstStart) || *p != ',') {
+            return false;
+        }
+        p++;
+        if (!parseRule (&p, &dstEnd)) {
+            return false;
+        }
+    } else {
+        // No rules given. Same default as newlib, current US rules
+        const char* defaultRules = "M3.2.0,M11.1.0";
+        parseRule (&defaultRules, &dstStart);
+        defaultRules++;
+        parseRule (&defaultRules, &dstEnd);
+    }
+    if (*p != '\0') {
+        return false;
+    }
+    hasDst = true;
+    valid = true;
+    return true;
+}
+
+time_t NTPTimeZone::transitionTime (const NTPTZRule_t& rule, int32_t year, int32_t offset) {
+    int32_t days;
+
+    switch (rule.type) {
+    case julianNoLeap:
+        days = daysFromCivil (year, 1, 1) + rule.day - 1;
+        if (isLeapYear (year) && rule.day >= 60) {
+            days++;
+        }
+        break;
+    case julianLeap:
+        days = daysFromCivil (year, 1, 1) + rule.day;
+        break;
+    default: {
+        int32_t first = daysFromCivil (year, rule.month, 1);
+        // 1970-01-01 was Thursday
+        int32_t firstWeekDay = ((first % 7) + 11) % 7;
+        days = first + (rule.weekDay - firstWeekDay + 7) % 7 + (rule.week - 1) * 7;
+        if (rule.week == 5) {
+            uint8_t nextMonth = rule.month == 12 ? 1 : rule.month + 1;
+            int32_t monthEnd = daysFromCivil (rule.month == 12 ? year + 1 : year, nextMonth, 1);
+            while (days >= monthEnd) {
+                days -= 7;
+            }
+        }
+        break;
+    }
+    }
+    return (time_t)days * SECS_PER_DAY_TZ + rule.time - offset;
+}
+
+void NTPTimeZone::updateCurrent (time_t utc) {
+    int32_t year;
+    uint8_t month;
+    uint8_t day;
+    time_t transitions[6];
+    bool toDst[6];
+    uint8_t n = 0;
+
+    if (!hasDst) {
+        currentOffset = stdOffset;
+        currentDst = false;
+        currentStart = (time_t)1 << (sizeof (time_t) * 8 - 2);
+        currentStart = -currentStart;
+        currentEnd = -currentStart;
+        return;
+    }
+
+    civilFromDays ((int32_t)((utc >= 0 ? utc : utc - SECS_PER_DAY_TZ + 1) / SECS_PER_DAY_TZ), &year, &month, &day);
+    // Transitions from previous year to next one, in time order. Southern hemisphere zones start DST at end of year
+    for (int32_t y = year - 1; y <= year + 1; y++) {
+        time_t start = transitionTime (dstStart, y, stdOffset);
+        time_t end = transitionTime (dstEnd, y, dstOffset);
+        bool startFirst = start < end;
+        transitions[n] = startFirst ? start : end;
+        toDst[n++] = startFirst;
+        transitions[n] = startFirst ? end : start;
+        toDst[n++] = !startFirst;
+    }
+
+    uint8_t i = 0;
+    while (i < n - 1 && transitions[i + 1] <= utc) {
+        i++;
+    }
+    if (transitions[i] > utc) {
+        // Before first transition. Never happens with previous year included, but keep state consistent
+        currentDst = !toDst[i];
+        currentStart = utc;
+        currentEnd = transitions[i];
+    } else {
+        currentDst = toDst[i];
+        currentStart = transitions[i];
+        currentEnd = i < n - 1 ? transitions[i + 1] : utc + 1;
+    }
+    currentOffset = currentDst ? dstOffset : stdOffset;
+}
+
+int32_t NTPTimeZone::getOffset (time_t utc, bool* isDst) {
+    if (utc < currentStart || utc >= currentEnd) {
+        updateCurrent (utc);
+    }
+    if (isDst) {
+        *isDst = currentDst;
+    }
+    return currentOffset;
+}
+
+time_t NTPTimeZone::toUtc (time_t local, int isDst) {
+    if (!hasDst) {
+        return local - stdOffset;
+    }
+    time_t asDst = local - dstOffset;
+    time_t asStd = local - stdOffset;
+    bool dstValid = getOffset (asDst) == dstOffset && currentDst;
+    bool stdValid = getOffset (asStd) == stdOffset && !currentDst;
+
+    if (dstValid && stdValid) {
+        // Ambiguous time, repeated when DST ends
+        if (isDst == 0) {
+            return asStd;
+        }
+        if (isDst > 0) {
+            return asDst;
+        }
+        return asDst < asStd ? asDst : asStd;
+    }
+    if (dstValid) {
+        return asDst;
+    }
+    if (stdValid) {
+        return asStd;
+    }
+    // Time in a gap. Use offset in force before transition so result moves forward
+    return asDst > asStd ? asDst : asStd;
+}
+
+struct tm* NTPTimeZone::localTime (time_t utc, struct tm* result) {
+    bool dst;
+    int32_t year;
+    uint8_t month;
+    uint8_t day;
+
+    time_t local = utc + getOffset (utc, &dst);
+    int32_t days = (int32_t)((local >= 0 ? local : local - SECS_PER_DAY_TZ + 1) / SECS_PER_DAY_TZ);
+    int32_t seconds = (int32_t)(local - (time_t)days * SECS_PER_DAY_TZ);
+
+    civilFromDays (days, &year, &month, &day);
+    memset (result, 0, sizeof (struct tm));
+    result->tm_sec = seconds % 60;
+    result->tm_min = seconds / 60 % 60;
+    result->tm_hour = seconds / 3600;
+    result->tm_mday = day;
+    result->tm_mon = month - 1;
+    result->tm_year = year - 1900;
+    result->tm_wday = ((days % 7) + 11) % 7;
+    result->tm_yday = days - daysFromCivil (year, 1, 1);
+    result->tm_isdst = dst ? 1 : 0;
+    return result;
+}
+
+bool NTPTimeZone::findRule (const char* name, char* rule, size_t length) {
+    int32_t low = 0;
+    int32_t high = TZ_TABLE_SIZE - 1;
+
+    if (!name || !rule || !length) {
+        return false;
+    }
+    while (low <= high) {
+        int32_t middle = (low + high) / 2;
+        const char* entry = tzTableNames + pgm_read_word (&tzTableIndex[middle][0]);
+        int comparison = strcmp_P (name, entry);
+        if (comparison == 0) {
+            strncpy_P (rule, tzTableRules + pgm_read_word (&tzTableIndex[middle][1]), length);
+            rule[length - 1] = '\0';
+            return true;
+        }
+        if (comparison > 0) {
+            low = middle + 1;
+        } else {
+            high = middle - 1;
+        }
+    }
+    return false;
+}
+
+void NTPTimeZone::localFields (const int64_t* utcUs, NTPTimeFields_t* fields, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        // Floor division, so times before epoch get positive microseconds
+        int64_t seconds = utcUs[i] / 1000000;
+        int32_t usec = (int32_t)(utcUs[i] - seconds * 1000000);
+        seconds -= usec < 0;
+        usec += usec < 0 ? 1000000 : 0;
+
+        int32_t offset = (time_t)seconds >= currentStart && (time_t)seconds < currentEnd ? currentOffset : getOffset ((time_t)seconds);
+        int64_t local = seconds + offset;
+        int32_t days = (int32_t)(local / SECS_PER_DAY_TZ);
+        int32_t secondOfDay = (int32_t)(local - (int64_t)days * SECS_PER_DAY_TZ);
+        days -= secondOfDay < 0;
+        secondOfDay += secondOfDay < 0 ? SECS_PER_DAY_TZ : 0;
+
+        NTPTimeFields_t* t = &fields[i];
+        civilFromDays (days, &t->year, &t->month, &t->day);
+        t->hour = secondOfDay / 3600;
+        t->minute = secondOfDay / 60 % 60;
+        t->second = secondOfDay % 60;
+        t->usec = usec;
+        t->utcOffset = offset;
+    }
+}
@@ -0,0 +1,246 @@
+/**
+  * @file NTPTimeZone.h
+  * @version 0.2.7
+  * @date 19/10/2026
+  * @author German Martin
+  * @brief Compiled POSIX TZ rules for fast UTC to local time conversion and back
+  */
+
+#ifndef _NtpTimeZone_h
+#define _NtpTimeZone_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+constexpr auto TZ_ABBR_LENGTH = 11; ///< @brief Max time zone abbreviation length, including null terminator
+constexpr int32_t TZ_DEFAULT_TRANSITION_TIME = 7200; ///< @brief Transition time if rule does not define it. 02:00:00
+constexpr int32_t SECS_PER_DAY_TZ = 86400; ///< @brief Seconds per day
+constexpr size_t TZ_RULE_LENGTH = 60; ///< @brief Max length of process wide TZ rule, including null terminator
+
+/**
+  * @brief DST transition date rule types, as defined by POSIX TZ
+  */
+typedef enum : uint8_t {
+    julianNoLeap, ///< @brief `Jn`. Day 1..365, February 29th is never counted
+    julianLeap, ///< @brief `n`. Day 0..365, February 29th is counted
+    monthWeekDay ///< @brief `Mm.w.d`. Day `d` of week `w` of month `m`. Week 5 means last one
+} NTPTZRuleType_t;
+
+/**
+  * @brief DST transition rule
+  */
+typedef struct {
+    NTPTZRuleType_t type; ///< @brief Rule type
+    uint8_t month; ///< @brief Month 1..12 for `monthWeekDay` rules
+    uint8_t week; ///< @brief Week 1..5 for `monthWeekDay` rules
+    uint8_t weekDay; ///< @brief Day of week 0..6, Sunday is 0, for `monthWeekDay` rules
+    uint16_t day; ///< @brief Day for julian rules
+    int32_t time; ///< @brief Transition local time in seconds since midnight. May be negative or over 24 hours
+} NTPTZRule_t;
+
+/**
+  * @brief Broken down time that layouts render
+  */
+typedef struct {
+    int32_t year; ///< @brief Year, 0..9999
+    uint8_t month; ///< @brief Month 1..12
+    uint8_t day; ///< @brief Day of month 1..31
+    uint8_t hour; ///< @brief Hour 0..23
+    uint8_t minute; ///< @brief Minute 0..59
+    uint8_t second; ///< @brief Second 0..60
+    uint32_t usec; ///< @brief Microseconds 0..999999
+    int32_t utcOffset; ///< @brief Offset of local time to UTC in seconds, positive east
+} NTPTimeFields_t;
+
+/**
+  * @brief POSIX TZ string parsed once into rules. Current UTC offset and its validity interval are kept so most
+  * conversions are a comparison and an addition. Not thread safe, every user should have its own instance.
+  * Instances may follow a process wide rule, so every user gets the same zone without sharing an instance
+  */
+class NTPTimeZone {
+public:
+    /**
+      * @brief Parses a POSIX TZ string like `CET-1CEST,M3.5.0,M10.5.0/3`
+      * @param tz TZ string
+      * @return `true` if string was valid. If not, zone is set to UTC
+      */
+    bool parse (const char* tz);
+
+    /**
+      * @brief Checks if a TZ string has been parsed successfully
+      * @return `true` if rules are valid
+      */
+    bool isValid () const {
+        return valid;
+    }
+
+    /**
+      * @brief Gets offset to add to UTC to get local time
+      * @param utc UNIX time
+      * @param isDst Optional output. Set to `true` if daylight saving time applies
+      * @return Offset in seconds, positive east of Greenwich
+      */
+    int32_t getOffset (time_t utc, bool* isDst = NULL);
+
+    /**
+      * @brief Converts UTC to local time
+      * @param utc UNIX time
+      * @return Local time as seconds since 1970-01-01 00:00:00 local
+      */
+    time_t toLocal (time_t utc) {
+        return utc + getOffset (utc);
+    }
+
+    /**
+      * @brief Converts local time to UTC. Times that do not exist because of a DST start gap are moved forward
+      * @param local Local time as seconds since 1970-01-01 00:00:00 local
+      * @param isDst 1 to use DST offset if time is ambiguous, 0 for standard time and -1 to get the first occurrence
+      * @return UNIX time
+      */
+    time_t toUtc (time_t local, int isDst = -1);
+
+    /**
+      * @brief Converts UTC to broken down local time, as `localtime_r()`
+      * @param utc UNIX time
+      * @param result Broken down local time
+      * @return `result`
+      */
+    struct tm* localTime (time_t utc, struct tm* result);
+
+    /**
+      * @brief Converts a batch of UTC timestamps to local calendar fields. Offset is only recalculated when a
+      * timestamp falls out of current DST interval, so sorted batches do one comparison per element
+      * @param utcUs Timestamps in microseconds since 1970-01-01 UTC
+      * @param fields Output array with `count` elements
+      * @param count Number of timestamps
+      */
+    void localFields (const int64_t* utcUs, NTPTimeFields_t* fields, size_t count);
+
+    /**
+      * @brief Gets time zone abbreviation
+      * @param dst `true` to get daylight saving time abbreviation
+      * @return Abbreviation, like `CET` or `+03`
+      */
+    const char* getAbbreviation (bool dst) const {
+        return dst && hasDst ? dstName : stdName;
+    }
+
+    /**
+      * @brief Looks up the POSIX TZ rule of an IANA zone name in built in table
+      * @param name Zone name like `Europe/Madrid`. Case sensitive
+      * @param rule Output buffer for rule string
+      * @param length Size of `rule` buffer
+      * @return `true` if zone was found
+      */
+    static bool findRule (const char* name, char* rule, size_t length);
+
+    /**
+      * @brief Sets process wide TZ rule. Instances pick it up on their next `followProcessRule()` call.
+      * Safe to call from any thread
+      * @param tz TZ string. Empty string or `NULL` to clear it
+      */
+    static void setProcessRule (const char* tz);
+
+    /**
+      * @brief Parses process wide rule again if it changed since last call on this instance. When nothing changed
+      * this is a single comparison
+      * @return `true` if rules were reloaded. They are left invalid if process rule is empty or malformed
+      */
+    bool followProcessRule ();
+
+    /**
+      * @brief Gets process wide rule change counter
+      * @return Counter, incremented on every `setProcessRule()` call. Odd while a change is in progress
+      */
+    static uint32_t getProcessRuleGeneration () {
+        return processGeneration;
+    }
+
+    /**
+      * @brief Converts a civil date to days since 1970-01-01
+      * @param year Year
+      * @param month Month 1..12
+      * @param day Day of month 1..31
+      * @return Days since epoch. Negative before 1970
+      */
+    static int32_t daysFromCivil (int32_t year, uint8_t month, uint8_t day);
+
+    /**
+      * @brief Converts days since 1970-01-01 to civil date
+      * @param days Days since epoch
+      * @param[out] year Year
+      * @param[out] month Month 1..12
+      * @param[out] day Day of month 1..31
+      */
+    static void civilFromDays (int32_t days, int32_t* year, uint8_t* month, uint8_t* day);
+
+    /**
+      * @brief Checks for leap year
+      * @param year Year
+      * @return `true` if year has 366 days
+      */
+    static bool isLeapYear (int32_t year) {
+        return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    }
+
+protected:
+    bool valid = false; ///< @brief Rules have been parsed
+    bool hasDst = false; ///< @brief Zone has daylight saving time
+    int32_t stdOffset = 0; ///< @brief Standard time offset to UTC, seconds positive east
+    int32_t dstOffset = 0; ///< @brief Daylight saving time offset to UTC, seconds positive east
+    char stdName[TZ_ABBR_LENGTH] = "UTC"; ///< @brief Standard time abbreviation
+    char dstName[TZ_ABBR_LENGTH] = ""; ///< @brief Daylight saving time abbreviation
+    NTPTZRule_t dstStart; ///< @brief Rule for change to daylight saving time, in standard local time
+    NTPTZRule_t dstEnd; ///< @brief Rule for change to standard time, in daylight saving local time
+
+    time_t currentStart = 1; ///< @brief First UTC instant where `currentOffset` applies. Empty interval until calculated
+    time_t currentEnd = 0; ///< @brief Next transition. `currentOffset` applies up to this UTC instant, excluded
+    int32_t currentOffset = 0; ///< @brief Offset valid between `currentStart` and `currentEnd`
+    bool currentDst = false; ///< @brief Daylight saving time applies between `currentStart` and `currentEnd`
+    uint32_t followedGeneration = 0; ///< @brief `processGeneration` value rules were last loaded from
+
+    static volatile uint32_t processGeneration; ///< @brief Seqlock counter for `processRule`. Odd while it is being written
+    static char processRule[TZ_RULE_LENGTH]; ///< @brief Process wide TZ rule
+
+    /**
+      * @brief Calculates offset interval that includes a given instant
+      * @param utc UNIX time
+      */
+    void updateCurrent (time_t utc);
+
+    /**
+      * @brief Calculates UTC instant of a transition for a year
+      * @param rule Transition rule
+      * @param year Year
+      * @param offset Offset in force before transition
+      * @return UNIX time of transition
+      */
+    static time_t transitionTime (const NTPTZRule_t& rule, int32_t year, int32_t offset);
+
+    /**
+      * @brief Parses a time zone abbreviation, alphabetic or quoted with `<>`
+      * @param str Pointer to string position. Updated to next character after abbreviation
+      * @param name Output buffer, `TZ_ABBR_LENGTH` long
+      * @return `true` if abbreviation is valid
+      */
+    static bool parseName (const char** str, char* name);
+
+    /**
+      * @brief Parses a time in `[+|-]hh[:mm[:ss]]` format
+      * @param str Pointer to string position. Updated to next character after time
+      * @param seconds Output value in seconds
+      * @return `true` if time is valid
+      */
+    static bool parseTime (const char** str, int32_t* seconds);
+
+    /**
+      * @brief Parses a transition rule `date[/time]`
+      * @param str Pointer to string position. Updated to next character after rule
+      * @param rule Output rule
+      * @return `true` if rule is valid
+      */
+    static bool parseRule (const char** str, NTPTZRule_t* rule);
+};
+
+#endif // _NtpTimeZone_h
@@ -0,0 +1,1042 @@
+// autogenerated from TZdef.h by tools/tztable.py. Do not edit
+//
+// 460 zones, 99 distinct rules
+// names 7377 bytes, rules 1530 bytes, index 1840 bytes
+
+#ifndef _TZtable_h
+#define _TZtable_h
+
+constexpr uint16_t TZ_TABLE_SIZE = 460; ///< @brief Number of zones in table
+
+/// @brief POSIX TZ rule strings, null separated
+static const char tzTableRules[] PROGMEM =
+    "<+00>0<+02>-2,M3.5.0/1,M10.5.0/3\0"
+    "<+01>-1\0"
+    "<+02>-2\0"
+    "<+0330>-3:30\0"
+    "<+03>-3\0"
+    "<+0430>-4:30\0"
+    "<+04>-4\0"
+    "<+0530>-5:30\0"
+    "<+0545>-5:45\0"
+    "<+05>-5\0"
+    "<+0630>-6:30\0"
+    "<+06>-6\0"
+    "<+07>-7\0"
+    "<+0845>-8:45\0"
+    "<+08>-8\0"
+    "<+09>-9\0"
+    "<+1030>-10:30<+11>-11,M10.1.0,M4.1.0\0"
+    "<+10>-10\0"
+    "<+11>-11\0"
+    "<+11>-11<+12>,M10.1.0,M4.1.0/3\0"
+    "<+1245>-12:45<+1345>,M9.5.0/2:45,M4.1.0/3:45\0"
+    "<+12>-12\0"
+    "<+12>-12<+13>,M11.2.0,M1.2.3/99\0"
+    "<+13>-13\0"
+    "<+13>-13<+14>,M9.5.0/3,M4.1.0/4\0"
+    "<+14>-14\0"
+    "<-01>1\0"
+    "<-01>1<+00>,M3.5.0/0,M10.5.0/1\0"
+    "<-02>2\0"
+    "<-03>3\0"
+    "<-03>3<-02>,M3.2.0,M11.1.0\0"
+    "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1\0"
+    "<-04>4\0"
+    "<-04>4<-03>,M10.1.0/0,M3.4.0/0\0"
+    "<-04>4<-03>,M9.1.6/24,M4.1.6/24\0"
+    "<-05>5\0"
+    "<-06>6\0"
+    "<-06>6<-05>,M9.1.6/22,M4.1.6/22\0"
+    "<-07>7\0"
+    "<-08>8\0"
+    "<-0930>9:30\0"
+    "<-09>9\0"
+    "<-10>10\0"
+    "<-11>11\0"
+    "<-12>12\0"
+    "ACST-9:30\0"
+    "ACST-9:30ACDT,M10.1.0,M4.1.0/3\0"
+    "AEST-10\0"
+    "AEST-10AEDT,M10.1.0,M4.1.0/3\0"
+    "AKST9AKDT,M3.2.0,M11.1.0\0"
+    "AST4\0"
+    "AST4ADT,M3.2.0,M11.1.0\0"
+    "AWST-8\0"
+    "CAT-2\0"
+    "CET-1\0"
+    "CET-1CEST,M3.5.0,M10.5.0/3\0"
+    "CST-8\0"
+    "CST5CDT,M3.2.0/0,M11.1.0/1\0"
+    "CST6\0"
+    "CST6CDT,M3.2.0,M11.1.0\0"
+    "CST6CDT,M4.1.0,M10.5.0\0"
+    "ChST-10\0"
+    "EAT-3\0"
+    "EET-2\0"
+    "EET-2EEST,M3.4.4/48,M10.4.4/49\0"
+    "EET-2EEST,M3.5.0,M10.5.0/3\0"
+    "EET-2EEST,M3.5.0/0,M10.5.0/0\0"
+    "EET-2EEST,M3.5.0/3,M10.5.0/4\0"
+    "EET-2EEST,M3.5.4/24,M10.5.5/1\0"
+    "EET-2EEST,M3.5.5/0,M10.5.5/0\0"
+    "EST5\0"
+    "EST5EDT,M3.2.0,M11.1.0\0"
+    "GMT0\0"
+    "GMT0BST,M3.5.0/1,M10.5.0\0"
+    "HKT-8\0"
+    "HST10\0"
+    "HST10HDT,M3.2.0,M11.1.0\0"
+    "IST-1GMT0,M10.5.0,M3.5.0/1\0"
+    "IST-2IDT,M3.4.4/26,M10.5.0\0"
+    "IST-5:30\0"
+    "JST-9\0"
+    "KST-9\0"
+    "MSK-3\0"
+    "MST7\0"
+    "MST7MDT,M3.2.0,M11.1.0\0"
+    "MST7MDT,M4.1.0,M10.5.0\0"
+    "NST3:30NDT,M3.2.0,M11.1.0\0"
+    "NZST-12NZDT,M9.5.0,M4.1.0/3\0"
+    "PKT-5\0"
+    "PST-8\0"
+    "PST8PDT,M3.2.0,M11.1.0\0"
+    "SAST-2\0"
+    "SST11\0"
+    "UTC0\0"
+    "WAT-1\0"
+    "WET0WEST,M3.5.0/1,M10.5.0\0"
+    "WIB-7\0"
+    "WIT-9\0"
+    "WITA-8\0"
+    ;
+
+/// @brief Zone names sorted for binary search, null separated
+static const char tzTableNames[] PROGMEM =
+    "Africa/Abidjan\0"
+    "Africa/Accra\0"
+    "Africa/Addis_Ababa\0"
+    "Africa/Algiers\0"
+    "Africa/Asmara\0"
+    "Africa/Bamako\0"
+    "Africa/Bangui\0"
+    "Africa/Banjul\0"
+    "Africa/Bissau\0"
+    "Africa/Blantyre\0"
+    "Africa/Brazzaville\0"
+    "Africa/Bujumbura\0"
+    "Africa/Cairo\0"
+    "Africa/Casablanca\0"
+    "Africa/Ceuta\0"
+    "Africa/Conakry\0"
+    "Africa/Dakar\0"
+    "Africa/Dar_es_Salaam\0"
+    "Africa/Djibouti\0"
+    "Africa/Douala\0"
+    "Africa/El_Aaiun\0"
+    "Africa/Freetown\0"
+    "Africa/Gaborone\0"
+    "Africa/Harare\0"
+    "Africa/Johannesburg\0"
+    "Africa/Juba\0"
+    "Africa/Kampala\0"
+    "Africa/Khartoum\0"
+    "Africa/Kigali\0"
+    "Africa/Kinshasa\0"
+    "Africa/Lagos\0"
+    "Africa/Libreville\0"
+    "Africa/Lome\0"
+    "Africa/Luanda\0"
+    "Africa/Lubumbashi\0"
+    "Africa/Lusaka\0"
+    "Africa/Malabo\0"
+    "Africa/Maputo\0"
+    "Africa/Maseru\0"
+    "Africa/Mbabane\0"
+    "Africa/Mogadishu\0"
+    "Africa/Monrovia\0"
+    "Africa/Nairobi\0"
+    "Africa/Ndjamena\0"
+    "Africa/Niamey\0"
+    "Africa/Nouakchott\0"
+    "Africa/Ouagadougou\0"
+    "Africa/Porto-Novo\0"
+    "Africa/Sao_Tome\0"
+    "Africa/Tripoli\0"
+    "Africa/Tunis\0"
+    "Africa/Windhoek\0"
+    "America/Adak\0"
+    "America/Anchorage\0"
+    "America/Anguilla\0"
+    "America/Antigua\0"
+    "America/Araguaina\0"
+    "America/Argentina/Buenos_Aires\0"
+    "America/Argentina/Catamarca\0"
+    "America/Argentina/Cordoba\0"
+    "America/Argentina/Jujuy\0"
+    "America/Argentina/La_Rioja\0"
+    "America/Argentina/Mendoza\0"
+    "America/Argentina/Rio_Gallegos\0"
+    "America/Argentina/Salta\0"
+    "America/Argentina/San_Juan\0"
+    "America/Argentina/San_Luis\0"
+    "America/Argentina/Tucuman\0"
+    "America/Argentina/Ushuaia\0"
+    "America/Aruba\0"
+    "America/Asuncion\0"
+    "America/Atikokan\0"
+    "America/Bahia\0"
+    "America/Bahia_Banderas\0"
+    "America/Barbados\0"
+    "America/Belem\0"
+    "America/Belize\0"
+    "America/Blanc-Sablon\0"
+    "America/Boa_Vista\0"
+    "America/Bogota\0"
+    "America/Boise\0"
+    "America/Cambridge_Bay\0"
+    "America/Campo_Grande\0"
+    "America/Cancun\0"
+    "America/Caracas\0"
+    "America/Cayenne\0"
+    "America/Cayman\0"
+    "America/Chicago\0"
+    "America/Chihuahua\0"
+    "America/Costa_Rica\0"
+    "America/Creston\0"
+    "America/Cuiaba\0"
+    "America/Curacao\0"
+    "America/Danmarkshavn\0"
+    "America/Dawson\0"
+    "America/Dawson_Creek\0"
+    "America/Denver\0"
+    "America/Detroit\0"
+    "America/Dominica\0"
+    "America/Edmonton\0"
+    "America/Eirunepe\0"
+    "America/El_Salvador\0"
+    "America/Fort_Nelson\0"
+    "America/Fortaleza\0"
+    "America/Glace_Bay\0"
+    "America/Godthab\0"
+    "America/Goose_Bay\0"
+    "America/Grand_Turk\0"
+    "America/Grenada\0"
+    "America/Guadeloupe\0"
+    "America/Guatemala\0"
+    "America/Guayaquil\0"
+    "America/Guyana\0"
+    "America/Halifax\0"
+    "America/Havana\0"
+    "America/Hermosillo\0"
+    "America/Indiana/Indianapolis\0"
+    "America/Indiana/Knox\0"
+    "America/Indiana/Marengo\0"
+    "America/Indiana/Petersburg\0"
+    "America/Indiana/Tell_City\0"
+    "America/Indiana/Vevay\0"
+    "America/Indiana/Vincennes\0"
+    "America/Indiana/Winamac\0"
+    "America/Inuvik\0"
+    "America/Iqaluit\0"
+    "America/Jamaica\0"
+    "America/Juneau\0"
+    "America/Kentucky/Louisville\0"
+    "America/Kentucky/Monticello\0"
+    "America/Kralendijk\0"
+    "America/La_Paz\0"
+    "America/Lima\0"
+    "America/Los_Angeles\0"
+    "America/Lower_Princes\0"
+    "America/Maceio\0"
+    "America/Managua\0"
+    "America/Manaus\0"
+    "America/Marigot\0"
+    "America/Martinique\0"
+    "America/Matamoros\0"
+    "America/Mazatlan\0"
+    "America/Menominee\0"
+    "America/Merida\0"
+    "America/Metlakatla\0"
+    "America/Mexico_City\0"
+    "America/Miquelon\0"
+    "America/Moncton\0"
+    "America/Monterrey\0"
+    "America/Montevideo\0"
+    "America/Montreal\0"
+    "America/Montserrat\0"
+    "America/Nassau\0"
+    "America/New_York\0"
+    "America/Nipigon\0"
+    "America/Nome\0"
+    "America/Noronha\0"
+    "America/North_Dakota/Beulah\0"
+    "America/North_Dakota/Center\0"
+    "America/North_Dakota/New_Salem\0"
+    "America/Ojinaga\0"
+    "America/Panama\0"
+    "America/Pangnirtung\0"
+    "America/Paramaribo\0"
+    "America/Phoenix\0"
+    "America/Port-au-Prince\0"
+    "America/Port_of_Spain\0"
+    "America/Porto_Velho\0"
+    "America/Puerto_Rico\0"
+    "America/Punta_Arenas\0"
+    "America/Rainy_River\0"
+    "America/Rankin_Inlet\0"
+    "America/Recife\0"
+    "America/Regina\0"
+    "America/Resolute\0"
+    "America/Rio_Branco\0"
+    "America/Santarem\0"
+    "America/Santiago\0"
+    "America/Santo_Domingo\0"
+    "America/Sao_Paulo\0"
+    "America/Scoresbysund\0"
+    "America/Sitka\0"
+    "America/St_Barthelemy\0"
+    "America/St_Johns\0"
+    "America/St_Kitts\0"
+    "America/St_Lucia\0"
+    "America/St_Thomas\0"
+    "America/St_Vincent\0"
+    "America/Swift_Current\0"
+    "America/Tegucigalpa\0"
+    "America/Thule\0"
+    "America/Thunder_Bay\0"
+    "America/Tijuana\0"
+    "America/Toronto\0"
+    "America/Tortola\0"
+    "America/Vancouver\0"
+    "America/Whitehorse\0"
+    "America/Winnipeg\0"
+    "America/Yakutat\0"
+    "America/Yellowknife\0"
+    "Antarctica/Casey\0"
+    "Antarctica/Davis\0"
+    "Antarctica/DumontDUrville\0"
+    "Antarctica/Macquarie\0"
+    "Antarctica/Mawson\0"
+    "Antarctica/McMurdo\0"
+    "Antarctica/Palmer\0"
+    "Antarctica/Rothera\0"
+    "Antarctica/Syowa\0"
+    "Antarctica/Troll\0"
+    "Antarctica/Vostok\0"
+    "Arctic/Longyearbyen\0"
+    "Asia/Aden\0"
+    "Asia/Almaty\0"
+    "Asia/Amman\0"
+    "Asia/Anadyr\0"
+    "Asia/Aqtau\0"
+    "Asia/Aqtobe\0"
+    "Asia/Ashgabat\0"
+    "Asia/Atyrau\0"
+    "Asia/Baghdad\0"
+    "Asia/Bahrain\0"
+    "Asia/Baku\0"
+    "Asia/Bangkok\0"
+    "Asia/Barnaul\0"
+    "Asia/Beirut\0"
+    "Asia/Bishkek\0"
+    "Asia/Brunei\0"
+    "Asia/Chita\0"
+    "Asia/Choibalsan\0"
+    "Asia/Colombo\0"
+    "Asia/Damascus\0"
+    "Asia/Dhaka\0"
+    "Asia/Dili\0"
+    "Asia/Dubai\0"
+    "Asia/Dushanbe\0"
+    "Asia/Famagusta\0"
+    "Asia/Gaza\0"
+    "Asia/Hebron\0"
+    "Asia/Ho_Chi_Minh\0"
+    "Asia/Hong_Kong\0"
+    "Asia/Hovd\0"
+    "Asia/Irkutsk\0"
+    "Asia/Jakarta\0"
+    "Asia/Jayapura\0"
+    "Asia/Jerusalem\0"
+    "Asia/Kabul\0"
+    "Asia/Kamchatka\0"
+    "Asia/Karachi\0"
+    "Asia/Kathmandu\0"
+    "Asia/Khandyga\0"
+    "Asia/Kolkata\0"
+    "Asia/Krasnoyarsk\0"
+    "Asia/Kuala_Lumpur\0"
+    "Asia/Kuching\0"
+    "Asia/Kuwait\0"
+    "Asia/Macau\0"
+    "Asia/Magadan\0"
+    "Asia/Makassar\0"
+    "Asia/Manila\0"
+    "Asia/Muscat\0"
+    "Asia/Nicosia\0"
+    "Asia/Novokuznetsk\0"
+    "Asia/Novosibirsk\0"
+    "Asia/Omsk\0"
+    "Asia/Oral\0"
+    "Asia/Phnom_Penh\0"
+    "Asia/Pontianak\0"
+    "Asia/Pyongyang\0"
+    "Asia/Qatar\0"
+    "Asia/Qyzylorda\0"
+    "Asia/Riyadh\0"
+    "Asia/Sakhalin\0"
+    "Asia/Samarkand\0"
+    "Asia/Seoul\0"
+    "Asia/Shanghai\0"
+    "Asia/Singapore\0"
+    "Asia/Srednekolymsk\0"
+    "Asia/Taipei\0"
+    "Asia/Tashkent\0"
+    "Asia/Tbilisi\0"
+    "Asia/Tehran\0"
+    "Asia/Thimphu\0"
+    "Asia/Tokyo\0"
+    "Asia/Tomsk\0"
+    "Asia/Ulaanbaatar\0"
+    "Asia/Urumqi\0"
+    "Asia/Ust-Nera\0"
+    "Asia/Vientiane\0"
+    "Asia/Vladivostok\0"
+    "Asia/Yakutsk\0"
+    "Asia/Yangon\0"
+    "Asia/Yekaterinburg\0"
+    "Asia/Yerevan\0"
+    "Atlantic/Azores\0"
+    "Atlantic/Bermuda\0"
+    "Atlantic/Canary\0"
+    "Atlantic/Cape_Verde\0"
+    "Atlantic/Faroe\0"
+    "Atlantic/Madeira\0"
+    "Atlantic/Reykjavik\0"
+    "Atlantic/South_Georgia\0"
+    "Atlantic/St_Helena\0"
+    "Atlantic/Stanley\0"
+    "Australia/Adelaide\0"
+    "Australia/Brisbane\0"
+    "Australia/Broken_Hill\0"
+    "Australia/Currie\0"
+    "Australia/Darwin\0"
+    "Australia/Eucla\0"
+    "Australia/Hobart\0"
+    "Australia/Lindeman\0"
+    "Australia/Lord_Howe\0"
+    "Australia/Melbourne\0"
+    "Australia/Perth\0"
+    "Australia/Sydney\0"
+    "Etc/GMT\0"
+    "Etc/GMT+0\0"
+    "Etc/GMT+1\0"
+    "Etc/GMT+10\0"
+    "Etc/GMT+11\0"
+    "Etc/GMT+12\0"
+    "Etc/GMT+2\0"
+    "Etc/GMT+3\0"
+    "Etc/GMT+4\0"
+    "Etc/GMT+5\0"
+    "Etc/GMT+6\0"
+    "Etc/GMT+7\0"
+    "Etc/GMT+8\0"
+    "Etc/GMT+9\0"
+    "Etc/GMT-0\0"
+    "Etc/GMT-1\0"
+    "Etc/GMT-10\0"
+    "Etc/GMT-11\0"
+    "Etc/GMT-12\0"
+    "Etc/GMT-13\0"
+    "Etc/GMT-14\0"
+    "Etc/GMT-2\0"
+    "Etc/GMT-3\0"
+    "Etc/GMT-4\0"
+    "Etc/GMT-5\0"
+    "Etc/GMT-6\0"
+    "Etc/GMT-7\0"
+    "Etc/GMT-8\0"
+    "Etc/GMT-9\0"
+    "Etc/GMT0\0"
+    "Etc/Greenwich\0"
+    "Etc/UCT\0"
+    "Etc/UTC\0"
+    "Etc/Universal\0"
+    "Etc/Zulu\0"
+    "Europe/Amsterdam\0"
+    "Europe/Andorra\0"
+    "Europe/Astrakhan\0"
+    "Europe/Athens\0"
+    "Europe/Belgrade\0"
+    "Europe/Berlin\0"
+    "Europe/Bratislava\0"
+    "Europe/Brussels\0"
+    "Europe/Bucharest\0"
+    "Europe/Budapest\0"
+    "Europe/Busingen\0"
+    "Europe/Chisinau\0"
+    "Europe/Copenhagen\0"
+    "Europe/Dublin\0"
+    "Europe/Gibraltar\0"
+    "Europe/Guernsey\0"
+    "Europe/Helsinki\0"
+    "Europe/Isle_of_Man\0"
+    "Europe/Istanbul\0"
+    "Europe/Jersey\0"
+    "Europe/Kaliningrad\0"
+    "Europe/Kiev\0"
+    "Europe/Kirov\0"
+    "Europe/Lisbon\0"
+    "Europe/Ljubljana\0"
+    "Europe/London\0"
+    "Europe/Luxembourg\0"
+    "Europe/Madrid\0"
+    "Europe/Malta\0"
+    "Europe/Mariehamn\0"
+    "Europe/Minsk\0"
+    "Europe/Monaco\0"
+    "Europe/Moscow\0"
+    "Europe/Oslo\0"
+    "Europe/Paris\0"
+    "Europe/Podgorica\0"
+    "Europe/Prague\0"
+    "Europe/Riga\0"
+    "Europe/Rome\0"
+    "Europe/Samara\0"
+    "Europe/San_Marino\0"
+    "Europe/Sarajevo\0"
+    "Europe/Saratov\0"
+    "Europe/Simferopol\0"
+    "Europe/Skopje\0"
+    "Europe/Sofia\0"
+    "Europe/Stockholm\0"
+    "Europe/Tallinn\0"
+    "Europe/Tirane\0"
+    "Europe/Ulyanovsk\0"
+    "Europe/Uzhgorod\0"
+    "Europe/Vaduz\0"
+    "Europe/Vatican\0"
+    "Europe/Vienna\0"
+    "Europe/Vilnius\0"
+    "Europe/Volgograd\0"
+    "Europe/Warsaw\0"
+    "Europe/Zagreb\0"
+    "Europe/Zaporozhye\0"
+    "Europe/Zurich\0"
+    "Indian/Antananarivo\0"
+    "Indian/Chagos\0"
+    "Indian/Christmas\0"
+    "Indian/Cocos\0"
+    "Indian/Comoro\0"
+    "Indian/Kerguelen\0"
+    "Indian/Mahe\0"
+    "Indian/Maldives\0"
+    "Indian/Mauritius\0"
+    "Indian/Mayotte\0"
+    "Indian/Reunion\0"
+    "Pacific/Apia\0"
+    "Pacific/Auckland\0"
+    "Pacific/Bougainville\0"
+    "Pacific/Chatham\0"
+    "Pacific/Chuuk\0"
+    "Pacific/Easter\0"
+    "Pacific/Efate\0"
+    "Pacific/Enderbury\0"
+    "Pacific/Fakaofo\0"
+    "Pacific/Fiji\0"
+    "Pacific/Funafuti\0"
+    "Pacific/Galapagos\0"
+    "Pacific/Gambier\0"
+    "Pacific/Guadalcanal\0"
+    "Pacific/Guam\0"
+    "Pacific/Honolulu\0"
+    "Pacific/Kiritimati\0"
+    "Pacific/Kosrae\0"
+    "Pacific/Kwajalein\0"
+    "Pacific/Majuro\0"
+    "Pacific/Marquesas\0"
+    "Pacific/Midway\0"
+    "Pacific/Nauru\0"
+    "Pacific/Niue\0"
+    "Pacific/Norfolk\0"
+    "Pacific/Noumea\0"
+    "Pacific/Pago_Pago\0"
+    "Pacific/Palau\0"
+    "Pacific/Pitcairn\0"
+    "Pacific/Pohnpei\0"
+    "Pacific/Port_Moresby\0"
+    "Pacific/Rarotonga\0"
+    "Pacific/Saipan\0"
+    "Pacific/Tahiti\0"
+    "Pacific/Tarawa\0"
+    "Pacific/Tongatapu\0"
+    "Pacific/Wake\0"
+    "Pacific/Wallis\0"
+    ;
+
+/// @brief Name offset and rule offset of every zone, in name order
+static const uint16_t tzTableIndex[TZ_TABLE_SIZE][2] PROGMEM = {
+    {     0, 1174 }, // Africa/Abidjan
+    {    15, 1174 }, // Africa/Accra
+    {    28,  959 }, // Africa/Addis_Ababa
+    {    47,  834 }, // Africa/Algiers
+    {    62,  959 }, // Africa/Asmara
+    {    76, 1174 }, // Africa/Bamako
+    {    90, 1479 }, // Africa/Bangui
+    {   104, 1174 }, // Africa/Banjul
+    {   118, 1174 }, // Africa/Bissau
+    {   132,  828 }, // Africa/Blantyre
+    {   148, 1479 }, // Africa/Brazzaville
+    {   167,  828 }, // Africa/Bujumbura
+    {   184,  965 }, // Africa/Cairo
+    {   197,   33 }, // Africa/Casablanca
+    {   215,  840 }, // Africa/Ceuta
+    {   228, 1174 }, // Africa/Conakry
+    {   243, 1174 }, // Africa/Dakar
+    {   256,  959 }, // Africa/Dar_es_Salaam
+    {   277,  959 }, // Africa/Djibouti
+    {   293, 1479 }, // Africa/Douala
+    {   307,   33 }, // Africa/El_Aaiun
+    {   323, 1174 }, // Africa/Freetown
+    {   339,  828 }, // Africa/Gaborone
+    {   355,  828 }, // Africa/Harare
+    {   369, 1461 }, // Africa/Johannesburg
+    {   389,  959 }, // Africa/Juba
+    {   401,  959 }, // Africa/Kampala
+    {   416,  828 }, // Africa/Khartoum
+    {   432,  828 }, // Africa/Kigali
+    {   446, 1479 }, // Africa/Kinshasa
+    {   462, 1479 }, // Africa/Lagos
+    {   475, 1479 }, // Africa/Libreville
+    {   493, 1174 }, // Africa/Lome
+    {   505, 1479 }, // Africa/Luanda
+    {   519,  828 }, // Africa/Lubumbashi
+    {   537,  828 }, // Africa/Lusaka
+    {   551, 1479 }, // Africa/Malabo
+    {   565,  828 }, // Africa/Maputo
+    {   579, 1461 }, // Africa/Maseru
+    {   593, 1461 }, // Africa/Mbabane
+    {   608,  959 }, // Africa/Mogadishu
+    {   625, 1174 }, // Africa/Monrovia
+    {   641,  959 }, // Africa/Nairobi
+    {   656, 1479 }, // Africa/Ndjamena
+    {   672, 1479 }, // Africa/Niamey
+    {   686, 1174 }, // Africa/Nouakchott
+    {   704, 1174 }, // Africa/Ouagadougou
+    {   723, 1479 }, // Africa/Porto-Novo
+    {   741, 1174 }, // Africa/Sao_Tome
+    {   757,  965 }, // Africa/Tripoli
+    {   772,  834 }, // Africa/Tunis
+    {   785,  828 }, // Africa/Windhoek
+    {   801, 1216 }, // America/Adak
+    {   814,  768 }, // America/Anchorage
+    {   832,  793 }, // America/Anguilla
+    {   849,  793 }, // America/Antigua
+    {   865,  450 }, // America/Araguaina
+    {   883,  450 }, // America/Argentina/Buenos_Aires
+    {   914,  450 }, // America/Argentina/Catamarca
+    {   942,  450 }, // America/Argentina/Cordoba
+    {   968,  450 }, // America/Argentina/Jujuy
+    {   992,  450 }, // America/Argentina/La_Rioja
+    {  1019,  450 }, // America/Argentina/Mendoza
+    {  1045,  450 }, // America/Argentina/Rio_Gallegos
+    {  1076,  450 }, // America/Argentina/Salta
+    {  1100,  450 }, // America/Argentina/San_Juan
+    {  1127,  450 }, // America/Argentina/San_Luis
+    {  1154,  450 }, // America/Argentina/Tucuman
+    {  1180,  450 }, // America/Argentina/Ushuaia
+    {  1206,  793 }, // America/Aruba
+    {  1220,  524 }, // America/Asuncion
+    {  1237, 1146 }, // America/Atikokan
+    {  1254,  450 }, // America/Bahia
+    {  1268,  928 }, // America/Bahia_Banderas
+    {  1291,  793 }, // America/Barbados
+    {  1308,  450 }, // America/Belem
+    {  1322,  900 }, // America/Belize
+    {  1337,  793 }, // America/Blanc-Sablon
+    {  1358,  517 }, // America/Boa_Vista
+    {  1376,  587 }, // America/Bogota
+    {  1391, 1326 }, // America/Boise
+    {  1405, 1326 }, // America/Cambridge_Bay
+    {  1427,  517 }, // America/Campo_Grande
+    {  1448, 1146 }, // America/Cancun
+    {  1463,  517 }, // America/Caracas
+    {  1479,  450 }, // America/Cayenne
+    {  1495, 1146 }, // America/Cayman
+    {  1510,  905 }, // America/Chicago
+    {  1526, 1349 }, // America/Chihuahua
+    {  1544,  900 }, // America/Costa_Rica
+    {  1563, 1321 }, // America/Creston
+    {  1579,  517 }, // America/Cuiaba
+    {  1594,  793 }, // America/Curacao
+    {  1610, 1174 }, // America/Danmarkshavn
+    {  1631, 1321 }, // America/Dawson
+    {  1646, 1321 }, // America/Dawson_Creek
+    {  1667, 1326 }, // America/Denver
+    {  1682, 1151 }, // America/Detroit
+    {  1698,  793 }, // America/Dominica
+    {  1715, 1326 }, // America/Edmonton
+    {  1732,  587 }, // America/Eirunepe
+    {  1749,  900 }, // America/El_Salvador
+    {  1769, 1321 }, // America/Fort_Nelson
+    {  1789,  450 }, // America/Fortaleza
+    {  1807,  798 }, // America/Glace_Bay
+    {  1825,  484 }, // America/Godthab
+    {  1841,  798 }, // America/Goose_Bay
+    {  1859, 1151 }, // America/Grand_Turk
+    {  1878,  793 }, // America/Grenada
+    {  1894,  793 }, // America/Guadeloupe
+    {  1913,  900 }, // America/Guatemala
+    {  1931,  587 }, // America/Guayaquil
+    {  1949,  517 }, // America/Guyana
+    {  1964,  798 }, // America/Halifax
+    {  1980,  873 }, // America/Havana
+    {  1995, 1321 }, // America/Hermosillo
+    {  2014, 1151 }, // America/Indiana/Indianapolis
+    {  2043,  905 }, // America/Indiana/Knox
+    {  2064, 1151 }, // America/Indiana/Marengo
+    {  2088, 1151 }, // America/Indiana/Petersburg
+    {  2115,  905 }, // America/Indiana/Tell_City
+    {  2141, 1151 }, // America/Indiana/Vevay
+    {  2163, 1151 }, // America/Indiana/Vincennes
+    {  2189, 1151 }, // America/Indiana/Winamac
+    {  2213, 1326 }, // America/Inuvik
+    {  2228, 1151 }, // America/Iqaluit
+    {  2244, 1146 }, // America/Jamaica
+    {  2260,  768 }, // America/Juneau
+    {  2275, 1151 }, // America/Kentucky/Louisville
+    {  2303, 1151 }, // America/Kentucky/Monticello
+    {  2331,  793 }, // America/Kralendijk
+    {  2350,  517 }, // America/La_Paz
+    {  2365,  587 }, // America/Lima
+    {  2378, 1438 }, // America/Los_Angeles
+    {  2398,  793 }, // America/Lower_Princes
+    {  2420,  450 }, // America/Maceio
+    {  2435,  900 }, // America/Managua
+    {  2451,  517 }, // America/Manaus
+    {  2466,  793 }, // America/Marigot
+    {  2482,  793 }, // America/Martinique
+    {  2501,  905 }, // America/Matamoros
+    {  2519, 1349 }, // America/Mazatlan
+    {  2536,  905 }, // America/Menominee
+    {  2554,  928 }, // America/Merida
+    {  2569,  768 }, // America/Metlakatla
+    {  2588,  928 }, // America/Mexico_City
+    {  2608,  457 }, // America/Miquelon
+    {  2625,  798 }, // America/Moncton
+    {  2641,  928 }, // America/Monterrey
+    {  2659,  450 }, // America/Montevideo
+    {  2678, 1151 }, // America/Montreal
+    {  2695,  793 }, // America/Montserrat
+    {  2714, 1151 }, // America/Nassau
+    {  2729, 1151 }, // America/New_York
+    {  2746, 1151 }, // America/Nipigon
+    {  2762,  768 }, // America/Nome
+    {  2775,  443 }, // America/Noronha
+    {  2791,  905 }, // America/North_Dakota/Beulah
+    {  2819,  905 }, // America/North_Dakota/Center
+    {  2847,  905 }, // America/North_Dakota/New_Salem
+    {  2878, 1326 }, // America/Ojinaga
+    {  2894, 1146 }, // America/Panama
+    {  2909, 1151 }, // America/Pangnirtung
+    {  2929,  450 }, // America/Paramaribo
+    {  2948, 1321 }, // America/Phoenix
+    {  2964, 1151 }, // America/Port-au-Prince
+    {  2987,  793 }, // America/Port_of_Spain
+    {  3009,  517 }, // America/Porto_Velho
+    {  3029,  793 }, // America/Puerto_Rico
+    {  3049,  450 }, // America/Punta_Arenas
+    {  3070,  905 }, // America/Rainy_River
+    {  3090,  905 }, // America/Rankin_Inlet
+    {  3111,  450 }, // America/Recife
+    {  3126,  900 }, // America/Regina
+    {  3141,  905 }, // America/Resolute
+    {  3158,  587 }, // America/Rio_Branco
+    {  3177,  450 }, // America/Santarem
+    {  3194,  555 }, // America/Santiago
+    {  3211,  793 }, // America/Santo_Domingo
+    {  3233,  450 }, // America/Sao_Paulo
+    {  3251,  412 }, // America/Scoresbysund
+    {  3272,  768 }, // America/Sitka
+    {  3286,  793 }, // America/St_Barthelemy
+    {  3308, 1372 }, // America/St_Johns
+    {  3325,  793 }, // America/St_Kitts
+    {  3342,  793 }, // America/St_Lucia
+    {  3359,  793 }, // America/St_Thomas
+    {  3377,  793 }, // America/St_Vincent
+    {  3396,  900 }, // America/Swift_Current
+    {  3418,  900 }, // America/Tegucigalpa
+    {  3438,  798 }, // America/Thule
+    {  3452, 1151 }, // America/Thunder_Bay
+    {  3472, 1438 }, // America/Tijuana
+    {  3488, 1151 }, // America/Toronto
+    {  3504,  793 }, // America/Tortola
+    {  3520, 1438 }, // America/Vancouver
+    {  3538, 1321 }, // America/Whitehorse
+    {  3557,  905 }, // America/Winnipeg
+    {  3574,  768 }, // America/Yakutat
+    {  3590, 1326 }, // America/Yellowknife
+    {  3610,  229 }, // Antarctica/Casey
+    {  3627,  146 }, // Antarctica/Davis
+    {  3644,  220 }, // Antarctica/DumontDUrville
+    {  3670,  739 }, // Antarctica/Macquarie
+    {  3691,  117 }, // Antarctica/Mawson
+    {  3709, 1398 }, // Antarctica/McMurdo
+    {  3728,  450 }, // Antarctica/Palmer
+    {  3746,  450 }, // Antarctica/Rothera
+    {  3765,   62 }, // Antarctica/Syowa
+    {  3782,    0 }, // Antarctica/Troll
+    {  3799,  138 }, // Antarctica/Vostok
+    {  3817,  840 }, // Arctic/Longyearbyen
+    {  3837,   62 }, // Asia/Aden
+    {  3847,  138 }, // Asia/Almaty
+    {  3859, 1087 }, // Asia/Amman
+    {  3870,  314 }, // Asia/Anadyr
+    {  3882,  117 }, // Asia/Aqtau
+    {  3893,  117 }, // Asia/Aqtobe
+    {  3905,  117 }, // Asia/Ashgabat
+    {  3919,  117 }, // Asia/Atyrau
+    {  3931,   62 }, // Asia/Baghdad
+    {  3944,   62 }, // Asia/Bahrain
+    {  3957,   83 }, // Asia/Baku
+    {  3967,  146 }, // Asia/Bangkok
+    {  3980,  146 }, // Asia/Barnaul
+    {  3993, 1029 }, // Asia/Beirut
+    {  4005,  138 }, // Asia/Bishkek
+    {  4018,  167 }, // Asia/Brunei
+    {  4030,  175 }, // Asia/Chita
+    {  4041,  167 }, // Asia/Choibalsan
+    {  4057,   91 }, // Asia/Colombo
+    {  4070, 1117 }, // Asia/Damascus
+    {  4084,  138 }, // Asia/Dhaka
+    {  4095,  175 }, // Asia/Dili
+    {  4105,   83 }, // Asia/Dubai
+    {  4116,  117 }, // Asia/Dushanbe
+    {  4130, 1058 }, // Asia/Famagusta
+    {  4145,  971 }, // Asia/Gaza
+    {  4155,  971 }, // Asia/Hebron
+    {  4167,  146 }, // Asia/Ho_Chi_Minh
+    {  4184, 1204 }, // Asia/Hong_Kong
+    {  4199,  146 }, // Asia/Hovd
+    {  4209,  167 }, // Asia/Irkutsk
+    {  4222, 1511 }, // Asia/Jakarta
+    {  4235, 1517 }, // Asia/Jayapura
+    {  4249, 1267 }, // Asia/Jerusalem
+    {  4264,   70 }, // Asia/Kabul
+    {  4275,  314 }, // Asia/Kamchatka
+    {  4290, 1426 }, // Asia/Karachi
+    {  4303,  104 }, // Asia/Kathmandu
+    {  4318,  175 }, // Asia/Khandyga
+    {  4332, 1294 }, // Asia/Kolkata
+    {  4345,  146 }, // Asia/Krasnoyarsk
+    {  4362,  167 }, // Asia/Kuala_Lumpur
+    {  4380,  167 }, // Asia/Kuching
+    {  4393,   62 }, // Asia/Kuwait
+    {  4405,  867 }, // Asia/Macau
+    {  4416,  229 }, // Asia/Magadan
+    {  4429, 1523 }, // Asia/Makassar
+    {  4443, 1432 }, // Asia/Manila
+    {  4455,   83 }, // Asia/Muscat
+    {  4467, 1058 }, // Asia/Nicosia
+    {  4480,  146 }, // Asia/Novokuznetsk
+    {  4498,  146 }, // Asia/Novosibirsk
+    {  4515,  138 }, // Asia/Omsk
+    {  4525,  117 }, // Asia/Oral
+    {  4535,  146 }, // Asia/Phnom_Penh
+    {  4551, 1511 }, // Asia/Pontianak
+    {  4566, 1309 }, // Asia/Pyongyang
+    {  4581,   62 }, // Asia/Qatar
+    {  4592,  117 }, // Asia/Qyzylorda
+    {  4607,   62 }, // Asia/Riyadh
+    {  4619,  229 }, // Asia/Sakhalin
+    {  4633,  117 }, // Asia/Samarkand
+    {  4648, 1309 }, // Asia/Seoul
+    {  4659,  867 }, // Asia/Shanghai
+    {  4673,  167 }, // Asia/Singapore
+    {  4688,  229 }, // Asia/Srednekolymsk
+    {  4707,  867 }, // Asia/Taipei
+    {  4719,  117 }, // Asia/Tashkent
+    {  4733,   83 }, // Asia/Tbilisi
+    {  4746,   49 }, // Asia/Tehran
+    {  4758,  138 }, // Asia/Thimphu
+    {  4771, 1303 }, // Asia/Tokyo
+    {  4782,  146 }, // Asia/Tomsk
+    {  4793,  167 }, // Asia/Ulaanbaatar
+    {  4810,  138 }, // Asia/Urumqi
+    {  4822,  220 }, // Asia/Ust-Nera
+    {  4836,  146 }, // Asia/Vientiane
+    {  4851,  220 }, // Asia/Vladivostok
+    {  4868,  175 }, // Asia/Yakutsk
+    {  4881,  125 }, // Asia/Yangon
+    {  4893,  117 }, // Asia/Yekaterinburg
+    {  4912,   83 }, // Asia/Yerevan
+    {  4925,  412 }, // Atlantic/Azores
+    {  4941,  798 }, // Atlantic/Bermuda
+    {  4958, 1485 }, // Atlantic/Canary
+    {  4974,  405 }, // Atlantic/Cape_Verde
+    {  4994, 1485 }, // Atlantic/Faroe
+    {  5009, 1485 }, // Atlantic/Madeira
+    {  5026, 1174 }, // Atlantic/Reykjavik
+    {  5045,  443 }, // Atlantic/South_Georgia
+    {  5068, 1174 }, // Atlantic/St_Helena
+    {  5087,  450 }, // Atlantic/Stanley
+    {  5104,  700 }, // Australia/Adelaide
+    {  5123,  731 }, // Australia/Brisbane
+    {  5142,  700 }, // Australia/Broken_Hill
+    {  5164,  739 }, // Australia/Currie
+    {  5181,  690 }, // Australia/Darwin
+    {  5198,  154 }, // Australia/Eucla
+    {  5214,  739 }, // Australia/Hobart
+    {  5231,  731 }, // Australia/Lindeman
+    {  5250,  183 }, // Australia/Lord_Howe
+    {  5270,  739 }, // Australia/Melbourne
+    {  5290,  821 }, // Australia/Perth
+    {  5306,  739 }, // Australia/Sydney
+    {  5323, 1174 }, // Etc/GMT
+    {  5331, 1174 }, // Etc/GMT+0
+    {  5341,  405 }, // Etc/GMT+1
+    {  5351,  666 }, // Etc/GMT+10
+    {  5362,  674 }, // Etc/GMT+11
+    {  5373,  682 }, // Etc/GMT+12
+    {  5384,  443 }, // Etc/GMT+2
+    {  5394,  450 }, // Etc/GMT+3
+    {  5404,  517 }, // Etc/GMT+4
+    {  5414,  587 }, // Etc/GMT+5
+    {  5424,  594 }, // Etc/GMT+6
+    {  5434,  633 }, // Etc/GMT+7
+    {  5444,  640 }, // Etc/GMT+8
+    {  5454,  659 }, // Etc/GMT+9
+    {  5464, 1174 }, // Etc/GMT-0
+    {  5474,   33 }, // Etc/GMT-1
+    {  5484,  220 }, // Etc/GMT-10
+    {  5495,  229 }, // Etc/GMT-11
+    {  5506,  314 }, // Etc/GMT-12
+    {  5517,  355 }, // Etc/GMT-13
+    {  5528,  396 }, // Etc/GMT-14
+    {  5539,   41 }, // Etc/GMT-2
+    {  5549,   62 }, // Etc/GMT-3
+    {  5559,   83 }, // Etc/GMT-4
+    {  5569,  117 }, // Etc/GMT-5
+    {  5579,  138 }, // Etc/GMT-6
+    {  5589,  146 }, // Etc/GMT-7
+    {  5599,  167 }, // Etc/GMT-8
+    {  5609,  175 }, // Etc/GMT-9
+    {  5619, 1174 }, // Etc/GMT0
+    {  5628, 1174 }, // Etc/Greenwich
+    {  5642, 1474 }, // Etc/UCT
+    {  5650, 1474 }, // Etc/UTC
+    {  5658, 1474 }, // Etc/Universal
+    {  5672, 1474 }, // Etc/Zulu
+    {  5681,  840 }, // Europe/Amsterdam
+    {  5698,  840 }, // Europe/Andorra
+    {  5713,   83 }, // Europe/Astrakhan
+    {  5730, 1058 }, // Europe/Athens
+    {  5744,  840 }, // Europe/Belgrade
+    {  5760,  840 }, // Europe/Berlin
+    {  5774,  840 }, // Europe/Bratislava
+    {  5792,  840 }, // Europe/Brussels
+    {  5808, 1058 }, // Europe/Bucharest
+    {  5825,  840 }, // Europe/Budapest
+    {  5841,  840 }, // Europe/Busingen
+    {  5857, 1002 }, // Europe/Chisinau
+    {  5873,  840 }, // Europe/Copenhagen
+    {  5891, 1240 }, // Europe/Dublin
+    {  5905,  840 }, // Europe/Gibraltar
+    {  5922, 1179 }, // Europe/Guernsey
+    {  5938, 1058 }, // Europe/Helsinki
+    {  5954, 1179 }, // Europe/Isle_of_Man
+    {  5973,   62 }, // Europe/Istanbul
+    {  5989, 1179 }, // Europe/Jersey
+    {  6003,  965 }, // Europe/Kaliningrad
+    {  6022, 1058 }, // Europe/Kiev
+    {  6034,   62 }, // Europe/Kirov
+    {  6047, 1485 }, // Europe/Lisbon
+    {  6061,  840 }, // Europe/Ljubljana
+    {  6078, 1179 }, // Europe/London
+    {  6092,  840 }, // Europe/Luxembourg
+    {  6110,  840 }, // Europe/Madrid
+    {  6124,  840 }, // Europe/Malta
+    {  6137, 1058 }, // Europe/Mariehamn
+    {  6154,   62 }, // Europe/Minsk
+    {  6167,  840 }, // Europe/Monaco
+    {  6181, 1315 }, // Europe/Moscow
+    {  6195,  840 }, // Europe/Oslo
+    {  6207,  840 }, // Europe/Paris
+    {  6220,  840 }, // Europe/Podgorica
+    {  6237,  840 }, // Europe/Prague
+    {  6251, 1058 }, // Europe/Riga
+    {  6263,  840 }, // Europe/Rome
+    {  6275,   83 }, // Europe/Samara
+    {  6289,  840 }, // Europe/San_Marino
+    {  6307,  840 }, // Europe/Sarajevo
+    {  6323,   83 }, // Europe/Saratov
+    {  6338, 1315 }, // Europe/Simferopol
+    {  6356,  840 }, // Europe/Skopje
+    {  6370, 1058 }, // Europe/Sofia
+    {  6383,  840 }, // Europe/Stockholm
+    {  6400, 1058 }, // Europe/Tallinn
+    {  6415,  840 }, // Europe/Tirane
+    {  6429,   83 }, // Europe/Ulyanovsk
+    {  6446, 1058 }, // Europe/Uzhgorod
+    {  6462,  840 }, // Europe/Vaduz
+    {  6475,  840 }, // Europe/Vatican
+    {  6490,  840 }, // Europe/Vienna
+    {  6504, 1058 }, // Europe/Vilnius
+    {  6519,   83 }, // Europe/Volgograd
+    {  6536,  840 }, // Europe/Warsaw
+    {  6550,  840 }, // Europe/Zagreb
+    {  6564, 1058 }, // Europe/Zaporozhye
+    {  6582,  840 }, // Europe/Zurich
+    {  6596,  959 }, // Indian/Antananarivo
+    {  6616,  138 }, // Indian/Chagos
+    {  6630,  146 }, // Indian/Christmas
+    {  6647,  125 }, // Indian/Cocos
+    {  6660,  959 }, // Indian/Comoro
+    {  6674,  117 }, // Indian/Kerguelen
+    {  6691,   83 }, // Indian/Mahe
+    {  6703,  117 }, // Indian/Maldives
+    {  6719,   83 }, // Indian/Mauritius
+    {  6736,  959 }, // Indian/Mayotte
+    {  6751,   83 }, // Indian/Reunion
+    {  6766,  364 }, // Pacific/Apia
+    {  6779, 1398 }, // Pacific/Auckland
+    {  6796,  229 }, // Pacific/Bougainville
+    {  6817,  269 }, // Pacific/Chatham
+    {  6833,  220 }, // Pacific/Chuuk
+    {  6847,  601 }, // Pacific/Easter
+    {  6862,  229 }, // Pacific/Efate
+    {  6876,  355 }, // Pacific/Enderbury
+    {  6894,  355 }, // Pacific/Fakaofo
+    {  6910,  323 }, // Pacific/Fiji
+    {  6923,  314 }, // Pacific/Funafuti
+    {  6940,  594 }, // Pacific/Galapagos
+    {  6958,  659 }, // Pacific/Gambier
+    {  6974,  229 }, // Pacific/Guadalcanal
+    {  6994,  951 }, // Pacific/Guam
+    {  7007, 1210 }, // Pacific/Honolulu
+    {  7024,  396 }, // Pacific/Kiritimati
+    {  7043,  229 }, // Pacific/Kosrae
+    {  7058,  314 }, // Pacific/Kwajalein
+    {  7076,  314 }, // Pacific/Majuro
+    {  7091,  647 }, // Pacific/Marquesas
+    {  7109, 1468 }, // Pacific/Midway
+    {  7124,  314 }, // Pacific/Nauru
+    {  7138,  674 }, // Pacific/Niue
+    {  7151,  238 }, // Pacific/Norfolk
+    {  7167,  229 }, // Pacific/Noumea
+    {  7182, 1468 }, // Pacific/Pago_Pago
+    {  7200,  175 }, // Pacific/Palau
+    {  7214,  640 }, // Pacific/Pitcairn
+    {  7231,  229 }, // Pacific/Pohnpei
+    {  7247,  220 }, // Pacific/Port_Moresby
+    {  7268,  666 }, // Pacific/Rarotonga
+    {  7286,  951 }, // Pacific/Saipan
+    {  7301,  666 }, // Pacific/Tahiti
+    {  7316,  314 }, // Pacific/Tarawa
+    {  7331,  355 }, // Pacific/Tongatapu
+    {  7349,  314 }, // Pacific/Wake
+    {  7362,  314 }, // Pacific/Wallis
+};
+
+#endif // _TZtable_h
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Generates src/TZtable.h from src/TZdef.h.
+
+Builds a table of IANA zone names sorted for binary search, pointing to
+deduplicated POSIX TZ rule strings. Everything is stored in two string
+blobs and an index of 16 bit offsets so it stays in flash on ESP8266.
+
+Usage: tools/tztable.py [src/TZdef.h] [src/TZtable.h]
+"""
+
+import re
+import sys
+
+# Zone groups with a second path level, like America/Argentina/Cordoba
+NESTED_REGIONS = {
+    "America": ["Argentina", "Indiana", "Kentucky", "North_Dakota"],
+}
+
+# Names the generic rules cannot recover
+EXCEPTIONS = {
+    "America_PortmaumPrince": "America/Port-au-Prince",
+}
+
+DEFINE = re.compile(r'^#define\s+TZ_(\w+)\s+PSTR\("([^"]*)"\)')
+
+
+def macro_to_zone(macro):
+    """Recovers IANA name from macro suffix.
+
+    TZupdate.sh replaces '/' with '_', '-' with 'm' and '+' with 'p', so
+    'Etc_GMTp3' is 'Etc/GMT+3' and 'America_BlancmSablon' is 'America/Blanc-Sablon'.
+    """
+    if macro in EXCEPTIONS:
+        return EXCEPTIONS[macro]
+    region, _, rest = macro.partition("_")
+    parts = [region]
+    for nested in NESTED_REGIONS.get(region, []):
+        if rest.startswith(nested + "_"):
+            parts.append(nested)
+            rest = rest[len(nested) + 1:]
+            break
+    if rest:
+        rest = re.sub(r"(?<=[A-Za-z])m(?=[A-Z0-9])", "-", rest)
+        rest = re.sub(r"(?<=GMT)p(?=[0-9])", "+", rest)
+        parts.append(rest)
+    return "/".join(parts)
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '\\0"'
+
+
+def main():
+    source = sys.argv[1] if len(sys.argv) > 1 else "src/TZdef.h"
+    target = sys.argv[2] if len(sys.argv) > 2 else "src/TZtable.h"
+
+    zones = {}
+    macro_bytes = 0
+    with open(source) as f:
+        for line in f:
+            match = DEFINE.match(line)
+            if match:
+                zones[macro_to_zone(match.group(1))] = match.group(2)
+                macro_bytes += len(match.group(2)) + 1
+
+    rules = sorted(set(zones.values()))
+    rule_offsets = {}
+    offset = 0
+    for rule in rules:
+        rule_offsets[rule] = offset
+        offset += len(rule) + 1
+    rules_size = offset
+
+    names = sorted(zones, key=lambda name: name.encode())
+    name_offsets = []
+    offset = 0
+    for name in names:
+        name_offsets.append(offset)
+        offset += len(name) + 1
+    names_size = offset
+    if max(names_size, rules_size) > 0xFFFF:
+        sys.exit("Table too big for 16 bit offsets")
+
+    out = []
+    out.append("// autogenerated from TZdef.h by tools/tztable.py. Do not edit")
+    out.append("//")
+    out.append("// %d zones, %d distinct rules" % (len(names), len(rules)))
+    out.append("// names %d bytes, rules %d bytes, index %d bytes" % (names_size, rules_size, len(names) * 4))
+    out.append("")
+    out.append("#ifndef _TZtable_h")
+    out.append("#define _TZtable_h")
+    out.append("")
+    out.append("constexpr uint16_t TZ_TABLE_SIZE = %d; ///< @brief Number of zones in table" % len(names))
+    out.append("")
+    out.append("/// @brief POSIX TZ rule strings, null separated")
+    out.append("static const char tzTableRules[] PROGMEM =")
+    for rule in rules:
+        out.append("    " + c_string(rule))
+    out.append("    ;")
+    out.append("")
+    out.append("/// @brief Zone names sorted for binary search, null separated")
+    out.append("static const char tzTableNames[] PROGMEM =")
+    for name in names:
+        out.append("    " + c_string(name))
+    out.append("    ;")
+    out.append("")
+    out.append("/// @brief Name offset and rule offset of every zone, in name order")
+    out.append("static const uint16_t tzTableIndex[TZ_TABLE_SIZE][2] PROGMEM = {")
+    for name, offset in zip(names, name_offsets):
+        out.append("    { %5d, %4d }, // %s" % (offset, rule_offsets[zones[name]], name))
+    out.append("};")
+    out.append("")
+    out.append("#endif // _TZtable_h")
+    with open(target, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+    print("%d zones, %d distinct rules" % (len(names), len(rules)))
+    print("Table: %d bytes (names %d, rules %d, index %d)" %
+          (names_size + rules_size + len(names) * 4, names_size, rules_size, len(names) * 4))
+    print("Rule strings if every macro is used: %d bytes" % macro_bytes)
+
+
+if __name__ == "__main__":
+    main()